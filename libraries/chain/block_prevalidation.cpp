@@ -0,0 +1,31 @@
+#include <amalgam/chain/block_prevalidation.hpp>
+
+#include <fc/io/raw.hpp>
+
+namespace amalgam { namespace chain {
+
+block_prevalidation prevalidate_block( const signed_block& block )
+{
+   block_prevalidation result;
+   result.block_id = block.id();
+   result.block_size = fc::raw::pack_size( block );
+   result.merkle_root_valid = block.transaction_merkle_root == block.calculate_merkle_root();
+
+   try
+   {
+      result.signee = block.signee( fc::ecc::bip_0062 );
+   }
+   catch( const fc::exception& ) {}
+
+   try
+   {
+      for( const auto& trx : block.transactions )
+         trx.validate();
+      result.transactions_valid = true;
+   }
+   catch( const fc::exception& ) {}
+
+   return result;
+}
+
+} } // amalgam::chain
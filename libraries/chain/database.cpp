@@ -87,6 +87,7 @@ void database::open( const open_args& args )
    {
       init_schema();
       chainbase::database::open( args.shared_mem_dir, args.chainbase_flags, args.shared_file_size );
+      check_shared_memory_version();
 
       initialize_indexes();
       initialize_evaluators();
@@ -477,7 +478,7 @@ bool database::before_last_checkpoint()const
  *
  * @return true if we switched forks as a result of this push.
  */
-bool database::push_block(const signed_block& new_block, uint32_t skip)
+bool database::push_block(const signed_block& new_block, uint32_t skip, const block_prevalidation* prevalidation)
 {
    //fc::time_point begin_time = fc::time_point::now();
 
@@ -504,6 +505,12 @@ bool database::push_block(const signed_block& new_block, uint32_t skip)
               ;
    }
 
+   BOOST_SCOPE_EXIT( this_ )
+   {
+      this_->_current_block_prevalidation = nullptr;
+   } BOOST_SCOPE_EXIT_END
+   _current_block_prevalidation = prevalidation;
+
    bool result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -1701,6 +1708,30 @@ void database::init_schema()
 {
 }
 
+/**
+ * Objects are mapped from the file as they are, so a file written with
+ * another layout must not be opened. A new file is tagged with the version,
+ * files from before versioning only hold indexes besides the environment.
+ */
+void database::check_shared_memory_version()
+{
+#ifndef ENABLE_STD_ALLOCATOR
+   auto* segment = get_segment_manager();
+   auto version = segment->find< uint32_t >( "amalgam_shared_memory_version" ).first;
+   if( version == nullptr )
+   {
+      FC_ASSERT( segment->get_num_named_objects() <= 1,
+         "Shared memory file has no version, replay the blockchain to rebuild it" );
+      segment->construct< uint32_t >( "amalgam_shared_memory_version" )( AMALGAM_SHARED_MEMORY_VERSION );
+      return;
+   }
+
+   FC_ASSERT( *version == AMALGAM_SHARED_MEMORY_VERSION,
+      "Shared memory file has version ${v} while ${e} is required, replay the blockchain to rebuild it",
+      ("v", *version)("e", AMALGAM_SHARED_MEMORY_VERSION) );
+#endif
+}
+
 void database::init_genesis( uint64_t init_supply )
 {
    try
@@ -2003,7 +2034,13 @@ void database::_apply_block( const signed_block& next_block )
       }
    }
 
-   if( !( skip & skip_merkle_check ) )
+   // A fork switch applies other blocks from within the same push_block() call,
+   // so the pre-validation result is only used for the block it was computed on.
+   const block_prevalidation* prevalidation = nullptr;
+   if( _current_block_prevalidation != nullptr && _current_block_prevalidation->block_id == note.block_id )
+      prevalidation = _current_block_prevalidation;
+
+   if( !( skip & skip_merkle_check ) && !( prevalidation && prevalidation->merkle_root_valid ) )
    {
       auto merkle_root = next_block.calculate_merkle_root();
 
@@ -2021,10 +2058,21 @@ void database::_apply_block( const signed_block& next_block )
       }
    }
 
-   const witness_object& signing_witness = validate_block_header(skip, next_block);
+   const witness_object* signing_witness_ptr = nullptr;
+   if( prevalidation && prevalidation->signee.valid() )
+   {
+      signing_witness_ptr = &validate_block_header( skip | skip_witness_signature, next_block );
+      if( !( skip & skip_witness_signature ) )
+         FC_ASSERT( public_key_type( *prevalidation->signee ) == signing_witness_ptr->signing_key );
+   }
+   else
+   {
+      signing_witness_ptr = &validate_block_header( skip, next_block );
+   }
+   const witness_object& signing_witness = *signing_witness_ptr;
 
    const auto& gprops = get_dynamic_global_properties();
-   auto block_size = fc::raw::pack_size( next_block );
+   auto block_size = prevalidation ? prevalidation->block_size : fc::raw::pack_size( next_block );
    FC_ASSERT( block_size <= gprops.maximum_block_size, "Block Size is too big", ("next_block_num",next_block_num)("block_size", block_size)("max",gprops.maximum_block_size) );
 
    if( block_size < AMALGAM_MIN_BLOCK_SIZE )
@@ -2058,7 +2106,7 @@ void database::_apply_block( const signed_block& next_block )
        * for transactions when validating broadcast transactions or
        * when building a block.
        */
-      apply_transaction( trx, skip );
+      apply_transaction( trx, ( prevalidation && prevalidation->transactions_valid ) ? ( skip | skip_validate ) : skip );
       ++_current_trx_in_block;
    }
 
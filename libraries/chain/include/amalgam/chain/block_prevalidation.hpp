@@ -0,0 +1,31 @@
+#pragma once
+#include <amalgam/protocol/block.hpp>
+
+#include <fc/optional.hpp>
+
+namespace amalgam { namespace chain {
+
+   using amalgam::protocol::signed_block;
+   using amalgam::protocol::block_id_type;
+
+   /**
+    *  The state independent part of block validation: transaction merkle root,
+    *  witness signature recovery, serialized size and transaction::validate().
+    *  None of it reads the database, so it can be computed on any thread before
+    *  the block is handed to the write queue.  database::push_block() only
+    *  trusts a result whose block_id matches the block being applied; anything
+    *  that did not pass here is simply checked again under the write lock so
+    *  the resulting error is unchanged.
+    */
+   struct block_prevalidation
+   {
+      block_id_type                    block_id;
+      bool                             merkle_root_valid  = false;
+      bool                             transactions_valid = false;
+      uint32_t                         block_size         = 0;
+      fc::optional< fc::ecc::public_key > signee;
+   };
+
+   block_prevalidation prevalidate_block( const signed_block& block );
+
+} } // amalgam::chain
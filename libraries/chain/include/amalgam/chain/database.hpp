@@ -3,6 +3,7 @@
  */
 #pragma once
 #include <amalgam/chain/block_log.hpp>
+#include <amalgam/chain/block_prevalidation.hpp>
 #include <amalgam/chain/fork_database.hpp>
 #include <amalgam/chain/global_property_object.hpp>
 #include <amalgam/chain/hardfork_property_object.hpp>
@@ -150,6 +151,9 @@ namespace amalgam { namespace chain {
          const signed_transaction   get_recent_transaction( const transaction_id_type& trx_id )const;
          std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const;
 
+         /// irreversible blocks, reads may come from any thread
+         const block_log&           get_block_log()const { return _block_log; }
+
          chain_id_type             get_chain_id()const;
 
          const witness_object&  get_witness(  const account_name_type& name )const;
@@ -187,7 +191,11 @@ namespace amalgam { namespace chain {
          const flat_map<uint32_t,block_id_type> get_checkpoints()const { return _checkpoints; }
          bool                                   before_last_checkpoint()const;
 
-         bool push_block( const signed_block& b, uint32_t skip = skip_nothing );
+         /**
+          *  @param prevalidation optional result of prevalidate_block() for b, computed off the
+          *         write lock; the checks it already passed are not repeated while applying b
+          */
+         bool push_block( const signed_block& b, uint32_t skip = skip_nothing, const block_prevalidation* prevalidation = nullptr );
          void push_transaction( const signed_transaction& trx, uint32_t skip = skip_nothing );
          void _maybe_warn_multiple_production( uint32_t height )const;
          bool _push_block( const signed_block& b );
@@ -348,6 +356,7 @@ namespace amalgam { namespace chain {
          /// Reset the object graph in-memory
          void initialize_indexes();
          void init_schema();
+         void check_shared_memory_version();
          void init_genesis(uint64_t initial_supply = AMALGAM_INIT_SUPPLY );
 
          /**
@@ -458,6 +467,8 @@ namespace amalgam { namespace chain {
 
          optional< block_id_type >     _currently_processing_block_id;
 
+         const block_prevalidation*    _current_block_prevalidation = nullptr;
+
          flat_map<uint32_t,block_id_type>  _checkpoints;
 
          node_property_object              _node_property_object;
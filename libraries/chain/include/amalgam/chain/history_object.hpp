@@ -71,11 +71,13 @@ namespace amalgam { namespace chain {
 
          account_name_type account;
          uint32_t          sequence = 0;
+         uint32_t          op_type = 0; ///< which() of the operation, so history can be filtered without unpacking it
          operation_id_type op;
    };
 
    struct by_account;
    struct by_account_rev;
+   struct by_account_op_type;
    typedef multi_index_container<
       account_history_object,
       indexed_by<
@@ -86,6 +88,14 @@ namespace amalgam { namespace chain {
                member< account_history_object, uint32_t, &account_history_object::sequence>
             >,
             composite_key_compare< std::less< account_name_type >, std::greater< uint32_t > >
+         >,
+         ordered_unique< tag< by_account_op_type >,
+            composite_key< account_history_object,
+               member< account_history_object, account_name_type, &account_history_object::account>,
+               member< account_history_object, uint32_t, &account_history_object::op_type>,
+               member< account_history_object, uint32_t, &account_history_object::sequence>
+            >,
+            composite_key_compare< std::less< account_name_type >, std::less< uint32_t >, std::greater< uint32_t > >
          >
       >,
       allocator< account_history_object >
@@ -95,7 +105,7 @@ namespace amalgam { namespace chain {
 FC_REFLECT( amalgam::chain::operation_object, (id)(trx_id)(block)(trx_in_block)(op_in_trx)(virtual_op)(timestamp)(serialized_op) )
 CHAINBASE_SET_INDEX_TYPE( amalgam::chain::operation_object, amalgam::chain::operation_index )
 
-FC_REFLECT( amalgam::chain::account_history_object, (id)(account)(sequence)(op) )
+FC_REFLECT( amalgam::chain::account_history_object, (id)(account)(sequence)(op_type)(op) )
 CHAINBASE_SET_INDEX_TYPE( amalgam::chain::account_history_object, amalgam::chain::account_history_index )
 
 namespace helpers
@@ -681,6 +681,24 @@ namespace chainbase {
       virtual const char* what() const noexcept { return "Unable to acquire database lock"; }
    };
 
+   /**
+    * Time spent waiting for locks that were held by another thread. Locks
+    * taken without waiting are not counted, so the fast path costs nothing.
+    */
+   struct lock_statistics
+   {
+      std::atomic< uint64_t > read_waits{ 0 };
+      std::atomic< uint64_t > read_wait_micros{ 0 };
+      std::atomic< uint64_t > write_waits{ 0 };
+      std::atomic< uint64_t > write_wait_micros{ 0 };
+
+      static void record( std::atomic< uint64_t >& waits, std::atomic< uint64_t >& micros, boost::chrono::steady_clock::time_point start )
+      {
+         waits.fetch_add( 1, std::memory_order_relaxed );
+         micros.fetch_add( boost::chrono::duration_cast< boost::chrono::microseconds >( boost::chrono::steady_clock::now() - start ).count(), std::memory_order_relaxed );
+      }
+   };
+
    /**
     *  This class
     */
@@ -988,14 +1006,19 @@ namespace chainbase {
             int_incrementer ii( _read_lock_count );
 #endif
 
-            if( !wait_micro )
-            {
-               lock.lock();
-            }
-            else
+            if( !lock.try_lock() )
             {
-               if( !lock.timed_lock( boost::posix_time::microsec_clock::universal_time() + boost::posix_time::microseconds( wait_micro ) ) )
-                  BOOST_THROW_EXCEPTION( lock_exception() );
+               auto start = boost::chrono::steady_clock::now();
+               if( !wait_micro )
+               {
+                  lock.lock();
+               }
+               else
+               {
+                  if( !lock.timed_lock( boost::posix_time::microsec_clock::universal_time() + boost::posix_time::microseconds( wait_micro ) ) )
+                     BOOST_THROW_EXCEPTION( lock_exception() );
+               }
+               lock_statistics::record( _lock_stats.read_waits, _lock_stats.read_wait_micros, start );
             }
 
             return callback();
@@ -1010,18 +1033,23 @@ namespace chainbase {
             int_incrementer ii( _write_lock_count );
 #endif
 
-            if( !wait_micro )
-            {
-               lock.lock();
-            }
-            else
+            if( !lock.try_lock() )
             {
-               while( !lock.timed_lock( boost::posix_time::microsec_clock::universal_time() + boost::posix_time::microseconds( wait_micro ) ) )
+               auto start = boost::chrono::steady_clock::now();
+               if( !wait_micro )
                {
-                  _rw_manager.next_lock();
-                  std::cerr << "Lock timeout, moving to lock " << _rw_manager.current_lock_num() << std::endl;
-                  lock = write_lock( _rw_manager.current_lock(), boost::defer_lock_t() );
+                  lock.lock();
                }
+               else
+               {
+                  while( !lock.timed_lock( boost::posix_time::microsec_clock::universal_time() + boost::posix_time::microseconds( wait_micro ) ) )
+                  {
+                     _rw_manager.next_lock();
+                     std::cerr << "Lock timeout, moving to lock " << _rw_manager.current_lock_num() << std::endl;
+                     lock = write_lock( _rw_manager.current_lock(), boost::defer_lock_t() );
+                  }
+               }
+               lock_statistics::record( _lock_stats.write_waits, _lock_stats.write_wait_micros, start );
             }
 
             return callback();
@@ -1042,6 +1070,8 @@ namespace chainbase {
             }
          }
 
+         const lock_statistics& get_lock_statistics()const { return _lock_stats; }
+
          typedef vector<abstract_index*> abstract_index_cntr_t;
 
          const abstract_index_cntr_t& get_abstract_index_cntr() const
@@ -1077,6 +1107,7 @@ namespace chainbase {
          }
 
          read_write_mutex_manager                                    _rw_manager;
+         lock_statistics                                             _lock_stats;
 #ifndef ENABLE_STD_ALLOCATOR
          unique_ptr<bip::managed_mapped_file>                        _segment;
          unique_ptr<bip::managed_mapped_file>                        _meta;
@@ -5,6 +5,12 @@
 namespace fc 
 {
 
-  string zlib_compress(const string& in);
+  /**
+   * level runs from 1 (fastest) to 10 (smallest) like zlib's, 0 only writes Huffman codes.
+   */
+  string zlib_compress(const string& in, int level = 6);
+
+  /** Compresses in to the gzip format (RFC 1952), as used by HTTP Content-Encoding: gzip */
+  string gzip_compress(const string& in, int level = 6);
 
 } // namespace fc
@@ -37,6 +37,52 @@ namespace fc {
          fc::fwd<impl,96> my;
     };
 
+    /**
+     *  AES-256-GCM authenticated encryption of discrete frames.  Each call to
+     *  encode() seals one frame with a fresh 96-bit nonce built from the low
+     *  32 bits of init_value and a 64-bit frame counter, so the matching
+     *  aes_gcm_decoder must see frames in the same order.  OpenSSL selects
+     *  the AES-NI/PCLMULQDQ code path on its own when the CPU supports it.
+     */
+    class aes_gcm_encoder
+    {
+       public:
+         static const uint32_t tag_size = 16;
+
+         aes_gcm_encoder();
+         ~aes_gcm_encoder();
+
+         void init( const fc::sha256& key, const fc::uint128& init_value );
+         /**
+          *  Encrypts len bytes of plaintxt into ciphertxt and writes the
+          *  tag_size byte authentication tag to tag.  The optional additional
+          *  data is authenticated but not encrypted.
+          */
+         uint32_t encode( const char* plaintxt, uint32_t len, char* ciphertxt, char* tag,
+                          const char* aad = nullptr, uint32_t aad_len = 0 );
+
+       private:
+         struct      impl;
+         fc::fwd<impl,96> my;
+    };
+    class aes_gcm_decoder
+    {
+       public:
+         static const uint32_t tag_size = aes_gcm_encoder::tag_size;
+
+         aes_gcm_decoder();
+         ~aes_gcm_decoder();
+
+         void     init( const fc::sha256& key, const fc::uint128& init_value );
+         /** throws aes_exception if the tag does not authenticate the frame */
+         uint32_t decode( const char* ciphertxt, uint32_t len, const char* tag, char* plaintext,
+                          const char* aad = nullptr, uint32_t aad_len = 0 );
+
+       private:
+         struct      impl;
+         fc::fwd<impl,96> my;
+    };
+
     unsigned aes_encrypt(unsigned char *plaintext, int plaintext_len, unsigned char *key,
                          unsigned char *iv, unsigned char *ciphertext);
     unsigned aes_decrypt(unsigned char *ciphertext, int ciphertext_len, unsigned char *key,
@@ -79,4 +79,10 @@ namespace fc
          } 
    };
 
+   /**
+    *  Appends the UTF-8 encoding of a code point.  Both JSON parsers decode
+    *  \u escapes through it, a lone surrogate is encoded as it is.
+    */
+   void append_utf8( std::string& out, uint32_t code_point );
+
 } // fc
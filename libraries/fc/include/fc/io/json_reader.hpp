@@ -0,0 +1,216 @@
+#pragma once
+#include <fc/io/json.hpp>
+#include <fc/optional.hpp>
+#include <fc/reflect/variant.hpp>
+
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace fc
+{
+   /**
+    *  True when T is filled by the FC_REFLECT based from_variant() rather
+    *  than by a hand written overload.
+    */
+   template<typename T>
+   struct has_reflected_from_variant : std::is_same<
+      decltype( from_variant( std::declval< const variant& >(), std::declval< T& >() ) ),
+      reflected_from_variant > {};
+
+   /** A range of JSON text inside a buffer owned by someone else */
+   struct json_span
+   {
+      json_span() {}
+      json_span( const char* b, const char* e ) : begin( b ), end( e ) {}
+      explicit json_span( const std::string& s ) : begin( s.data() ), end( s.data() + s.size() ) {}
+
+      bool        valid()const { return begin != nullptr; }
+      size_t      size()const { return end - begin; }
+      std::string str()const { return std::string( begin, end ); }
+
+      const char* begin = nullptr;
+      const char* end   = nullptr;
+   };
+
+   /**
+    *  Pull parser over JSON text held in memory.
+    *
+    *  Reflected structs, vectors, optionals, strings and variants are decoded
+    *  in place, without building an fc::variant for the whole document.  Any
+    *  other value, and any value whose JSON type does not match the fast
+    *  path, is read into a variant and handed to from_variant(), so the
+    *  conversions and errors are those of variant::as<T>().
+    *
+    *  The grammar is strict JSON.  The legacy fc::json parser accepts a few
+    *  more forms (missing commas, bare words); callers that must accept those
+    *  can normalize the text with fc::json first.
+    */
+   class json_reader
+   {
+      public:
+         json_reader( json_span text, uint32_t max_depth = JSON_MAX_RECURSION_DEPTH )
+            : _pos( text.begin ), _end( text.end ), _max_depth( max_depth ) {}
+
+         /** first character of the next value, '\0' at the end of the text */
+         char peek();
+         bool at_end() { return peek() == '\0'; }
+         const char* position()const { return _pos; }
+
+         /** throws unless only white space is left */
+         void expect_end();
+
+         /** validates the next value and returns its text */
+         json_span skip_value();
+
+         void     read_string( std::string& out );
+         variant  read_variant();
+         void     read_null();
+
+         /**
+          *  Object and array iteration:
+          *
+          *  @code
+          *     r.begin_object();
+          *     for( bool first = true; r.next_member( key, first ); first = false )
+          *        ... consume exactly one value ...
+          *  @endcode
+          */
+         void begin_object();
+         bool next_member( std::string& key, bool first );
+         void begin_array();
+         bool next_element( bool first );
+
+         void read( variant& v ) { v = read_variant(); }
+         void read( std::string& s );
+         void read( std::vector<char>& v ) { from_variant( read_variant(), v ); }
+
+         template<typename T>
+         void read( optional<T>& v )
+         {
+            if( peek() == 'n' )
+            {
+               read_null();
+               v.reset();
+               return;
+            }
+            T tmp;
+            read( tmp );
+            v = std::move( tmp );
+         }
+
+         template<typename T, typename A>
+         void read( std::vector<T,A>& v )
+         {
+            if( peek() != '[' )
+            {
+               from_variant( read_variant(), v );
+               return;
+            }
+            v.clear();
+            begin_array();
+            for( bool first = true; next_element( first ); first = false )
+            {
+               v.emplace_back();
+               read( v.back() );
+            }
+         }
+
+         template<typename T>
+         void read( T& v )
+         {
+            read_value( v, std::integral_constant< bool, is_reflected_object<T>::value >() );
+         }
+
+         /** decodes a whole document into a T */
+         template<typename T>
+         static void decode( json_span text, T& v )
+         {
+            json_reader r( text );
+            r.read( v );
+            r.expect_end();
+         }
+
+      private:
+         template<typename T, bool = std::is_class<T>::value>
+         struct is_reflected_object : std::false_type {};
+
+         template<typename T>
+         struct is_reflected_object<T, true> : std::integral_constant< bool,
+            has_reflected_from_variant<T>::value &&
+            fc::reflector<T>::is_defined::value &&
+            !fc::reflector<T>::is_enum::value > {};
+
+         /** reads the member named key, duplicate keys keep the first value like variant_object */
+         template<typename T>
+         class member_visitor
+         {
+            public:
+               member_visitor( json_reader& r, const std::string& key, T& v, uint64_t& seen, bool& found )
+                  : _r( r ), _key( key ), _val( v ), _seen( seen ), _found( found ) {}
+
+               template<typename Member, class Class, Member (Class::*member)>
+               void operator()( const char* name )const
+               {
+                  uint64_t bit = _index < 64 ? uint64_t( 1 ) << _index : 0;
+                  ++_index;
+                  if( _found || _key != name )
+                     return;
+                  _found = true;
+                  if( _seen & bit )
+                     _r.skip_value();
+                  else
+                     _r.read( _val.*member );
+                  _seen |= bit;
+               }
+
+            private:
+               json_reader&         _r;
+               const std::string&   _key;
+               T&                   _val;
+               uint64_t&            _seen;
+               bool&                _found;
+               mutable uint32_t     _index = 0;
+         };
+
+         template<typename T>
+         void read_value( T& v, std::false_type ) { from_variant( read_variant(), v ); }
+
+         template<typename T>
+         void read_value( T& v, std::true_type )
+         {
+            if( peek() != '{' )
+            {
+               from_variant( read_variant(), v );
+               return;
+            }
+            std::string key;
+            uint64_t seen = 0;
+            begin_object();
+            for( bool first = true; next_member( key, first ); first = false )
+            {
+               bool found = false;
+               fc::reflector<T>::visit( member_visitor<T>( *this, key, v, seen, found ) );
+               if( !found )
+                  skip_value();
+            }
+         }
+
+         void skip_white_space();
+         void expect( char c );
+         void enter();
+         void leave() { --_depth; }
+         void skip_string();
+         void skip_literal( const char* word );
+         variant read_number();
+         void read_hex_escape( std::string* out );
+
+         const char*    _pos;
+         const char*    _end;
+         uint32_t       _depth = 0;
+         uint32_t       _max_depth;
+   };
+
+} // namespace fc
@@ -0,0 +1,219 @@
+#pragma once
+#include <fc/io/json.hpp>
+#include <fc/optional.hpp>
+#include <fc/reflect/variant.hpp>
+#include <fc/container/flat_fwd.hpp>
+#include <fc/static_variant.hpp>
+
+#include <deque>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace fc
+{
+   /**
+    *  True when T is converted by the FC_REFLECT based to_variant() rather
+    *  than by a hand written overload.
+    */
+   template<typename T>
+   struct has_reflected_to_variant : std::is_same<
+      decltype( to_variant( std::declval< const T& >(), std::declval< variant& >() ) ),
+      reflected_to_variant > {};
+
+   /**
+    *  Appends the JSON text of a value to a string without building the
+    *  intermediate fc::variant tree.
+    *
+    *  Strings, integers, bools, optionals, sequences, static_variants,
+    *  reflected enums and reflected structs are written directly.  Types with their own
+    *  to_variant() (asset, public keys, hashes, times, ...) and floating
+    *  point values still go through a variant, one leaf at a time, so the
+    *  output is byte for byte what fc::json::to_string( fc::variant( v ) )
+    *  would produce.
+    */
+   class json_writer
+   {
+      public:
+         json_writer( std::string& out, json::output_formatting format = json::stringify_large_ints_and_doubles )
+            : _out( out ), _format( format ) {}
+
+         template<typename T>
+         static std::string to_string( const T& v, json::output_formatting format = json::stringify_large_ints_and_doubles )
+         {
+            std::string out;
+            json_writer( out, format ).write( v );
+            return out;
+         }
+
+         void write( bool b ) { _out += b ? "true" : "false"; }
+         void write( const std::string& s ) { write_string( s.data(), s.size() ); }
+         void write( const char* s ) { write_string( s, strlen( s ) ); }
+         void write( const variant& v );
+         void write( const variant_object& v );
+         void write( const std::vector<char>& v ) { write_variant( variant( v ) ); }
+
+         template<typename T>
+         void write( const optional<T>& v )
+         {
+            if( v.valid() )
+               write( *v );
+            else
+               _out += "null";
+         }
+
+         template<typename T, typename A>
+         void write( const std::vector<T,A>& v ) { write_array( v ); }
+         template<typename T>
+         void write( const std::deque<T>& v ) { write_array( v ); }
+         template<typename T>
+         void write( const std::set<T>& v ) { write_array( v ); }
+         template<typename T>
+         void write( const flat_set<T>& v ) { write_array( v ); }
+
+         /** same {"type":...,"value":...} layout as fc::to_variant( static_variant ) */
+         template<typename... T>
+         void write( const static_variant<T...>& v ) { v.visit( static_variant_writer( *this ) ); }
+
+         template<typename T>
+         void write( const T& v )
+         {
+            write_value( v, std::integral_constant< int, kind<T>::value >() );
+         }
+
+         /** writes the separator (unless first) and the quoted key of an object member */
+         void write_key( const char* name, bool first )
+         {
+            if( !first )
+               _out += ',';
+            write_string( name, strlen( name ) );
+            _out += ':';
+         }
+
+         void write_string( const char* s, size_t len );
+         void write_int64( int64_t i );
+         void write_uint64( uint64_t u );
+         void write_variant( const variant& v );
+
+         std::string&  output() { return _out; }
+
+      private:
+         enum value_kind
+         {
+            variant_kind = 0,
+            signed_kind,
+            unsigned_kind,
+            enum_kind,
+            object_kind
+         };
+
+         template<typename T, bool Arithmetic = std::is_arithmetic<T>::value>
+         struct kind
+         {
+            static const int value =
+               ( !std::is_integral<T>::value || std::is_same<T, bool>::value || std::is_same<T, char>::value ) ? variant_kind :
+               std::is_signed<T>::value ? signed_kind : unsigned_kind;
+         };
+
+         template<typename T>
+         struct kind<T, false>
+         {
+            static const int value = !has_reflected_to_variant<T>::value || !fc::reflector<T>::is_defined::value ? variant_kind :
+                                     fc::reflector<T>::is_enum::value ? enum_kind : object_kind;
+         };
+
+         struct static_variant_writer
+         {
+            typedef void result_type;
+
+            static_variant_writer( json_writer& w ) : _w( w ) {}
+
+            template<typename T>
+            void operator()( const T& v )const
+            {
+               _w._out += "{\"type\":";
+               _w.write( trim_typename_namespace( fc::get_typename< T >::name() ) );
+               _w._out += ",\"value\":";
+               _w.write( v );
+               _w._out += '}';
+            }
+
+            json_writer& _w;
+         };
+
+         template<typename T>
+         class member_visitor
+         {
+            public:
+               member_visitor( json_writer& w, const T& v ) : _w( w ), _val( v ) {}
+
+               template<typename Member, class Class, Member (Class::*member)>
+               void operator()( const char* name )const
+               {
+                  add( name, _val.*member );
+               }
+
+            private:
+               template<typename M>
+               void add( const char* name, const optional<M>& v )const
+               {
+                  if( v.valid() )
+                     add( name, *v );
+               }
+
+               template<typename M>
+               void add( const char* name, const M& v )const
+               {
+                  _w.write_key( name, _first );
+                  _w.write( v );
+                  _first = false;
+               }
+
+               json_writer&   _w;
+               const T&       _val;
+               mutable bool   _first = true;
+         };
+
+         void write_digits( uint64_t u, bool negative, bool quote );
+
+         template<typename C>
+         void write_array( const C& c )
+         {
+            _out += '[';
+            bool first = true;
+            for( const auto& item : c )
+            {
+               if( !first )
+                  _out += ',';
+               write( item );
+               first = false;
+            }
+            _out += ']';
+         }
+
+         template<typename T>
+         void write_value( const T& v, std::integral_constant< int, variant_kind > ) { write_variant( variant( v ) ); }
+         template<typename T>
+         void write_value( const T& v, std::integral_constant< int, signed_kind > ) { write_int64( v ); }
+         template<typename T>
+         void write_value( const T& v, std::integral_constant< int, unsigned_kind > ) { write_uint64( v ); }
+         template<typename T>
+         void write_value( const T& v, std::integral_constant< int, enum_kind > )
+         {
+            write( fc::reflector<T>::to_fc_string( v ) );
+         }
+         template<typename T>
+         void write_value( const T& v, std::integral_constant< int, object_kind > )
+         {
+            _out += '{';
+            fc::reflector<T>::visit( member_visitor<T>( *this, v ) );
+            _out += '}';
+         }
+
+         std::string&               _out;
+         json::output_formatting    _format;
+   };
+
+} // namespace fc
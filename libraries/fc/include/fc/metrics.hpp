@@ -0,0 +1,202 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fc { namespace metrics {
+
+   typedef std::vector< std::pair< std::string, std::string > > label_list;
+
+   /// Counter shards, each thread adds to the one it was assigned
+   constexpr uint32_t counter_shards = 16;
+
+   inline uint32_t thread_shard() noexcept
+   {
+      static std::atomic< uint32_t > next( 0 );
+      thread_local uint32_t shard = next.fetch_add( 1, std::memory_order_relaxed ) % counter_shards;
+      return shard;
+   }
+
+   /**
+    * Sum spread over a cache line per shard. Padding keeps the shard values
+    * 64 bytes apart, so no two share a line wherever the sum is placed, and
+    * unlike alignas the owners can be allocated with plain new.
+    */
+   class sharded_sum
+   {
+      public:
+         void add( uint64_t n ) noexcept
+         {
+            _shards[ thread_shard() ].value.fetch_add( n, std::memory_order_relaxed );
+         }
+
+         uint64_t value()const noexcept;
+
+      private:
+         struct shard
+         {
+            std::atomic< uint64_t > value{ 0 };
+            char                    pad[ 64 - sizeof( std::atomic< uint64_t > ) ];
+         };
+
+         shard _shards[ counter_shards ];
+   };
+
+   /**
+    * Monotonic counter. Threads add to separate cache lines, so counting on
+    * a hot path is one uncontended relaxed atomic add. Reading sums the shards.
+    */
+   class counter
+   {
+      public:
+         void add( uint64_t n = 1 ) noexcept { _value.add( n ); }
+
+         uint64_t value()const noexcept { return _value.value(); }
+
+      private:
+         sharded_sum _value;
+   };
+
+   class gauge
+   {
+      public:
+         void set( int64_t v ) noexcept { _value.store( v, std::memory_order_relaxed ); }
+         void add( int64_t n ) noexcept { _value.fetch_add( n, std::memory_order_relaxed ); }
+
+         int64_t value()const noexcept { return _value.load( std::memory_order_relaxed ); }
+
+      private:
+         std::atomic< int64_t > _value{ 0 };
+   };
+
+   /**
+    * Latency histogram in microseconds, log-linear like HdrHistogram.
+    *
+    * Values below 2 * sub_buckets have a bucket each. Above that every power
+    * of two is split into sub_buckets equal buckets, so a bucket is never
+    * wider than 1/sub_buckets of its values. Values from 2^max_exponent up,
+    * about 19 hours, share the last bucket. Concurrent records of different
+    * latencies mostly touch different buckets, the sum is sharded.
+    */
+   class histogram
+   {
+      public:
+         static constexpr uint32_t sub_bucket_bits = 4;
+         static constexpr uint32_t sub_buckets = 1 << sub_bucket_bits;
+         static constexpr uint32_t max_exponent = 36;
+         static constexpr uint32_t bucket_count = ( max_exponent - sub_bucket_bits + 1 ) * sub_buckets;
+
+         void record( uint64_t micros ) noexcept
+         {
+            _buckets[ bucket_index( micros ) ].fetch_add( 1, std::memory_order_relaxed );
+            _sum.add( micros );
+         }
+
+         uint64_t count()const noexcept;
+         uint64_t sum()const noexcept { return _sum.value(); }
+         uint64_t bucket( uint32_t index )const noexcept { return _buckets[ index ].load( std::memory_order_relaxed ); }
+
+         /** Largest value the bucket holding the q-th quantile may contain, 0 when empty */
+         uint64_t percentile( double q )const noexcept;
+
+         static uint32_t bucket_index( uint64_t micros ) noexcept;
+         static uint64_t bucket_lowest( uint32_t index ) noexcept;
+
+      private:
+         std::atomic< uint64_t > _buckets[ bucket_count ] = {};
+         sharded_sum             _sum;
+   };
+
+   /** Records the time from construction to stop() or destruction, nothing when given no histogram */
+   class scoped_timer
+   {
+      public:
+         explicit scoped_timer( histogram& h ) : _histogram( &h ), _start( std::chrono::steady_clock::now() ) {}
+         explicit scoped_timer( histogram* h ) : _histogram( h ), _start( h ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point() ) {}
+         ~scoped_timer() { stop(); }
+
+         scoped_timer( const scoped_timer& ) = delete;
+         scoped_timer& operator=( const scoped_timer& ) = delete;
+
+         void stop() noexcept
+         {
+            if( _histogram == nullptr )
+               return;
+            _histogram->record( std::chrono::duration_cast< std::chrono::microseconds >( std::chrono::steady_clock::now() - _start ).count() );
+            _histogram = nullptr;
+         }
+
+      private:
+         histogram*                                _histogram;
+         std::chrono::steady_clock::time_point     _start;
+   };
+
+   enum class metric_type
+   {
+      counter,
+      gauge,
+      histogram
+   };
+
+   /** One metric as seen by registry::visit() */
+   struct metric_sample
+   {
+      const std::string&   name;
+      const std::string&   help;
+      const label_list&    labels;
+      metric_type          type;
+      /// counter and gauge value
+      double               value = 0;
+      /// set for histograms
+      const histogram*     hist = nullptr;
+   };
+
+   namespace detail { class registry_impl; }
+
+   /**
+    * Named metrics of the process.
+    *
+    * Metrics are created on first use and live as long as the registry, so
+    * callers look them up once and keep the reference. Only the lookup takes
+    * a lock. A name and label set always returns the same metric, asking for
+    * it with another type throws.
+    *
+    * Histograms record microseconds and are exported in seconds, the
+    * Prometheus convention, so their names should end with _seconds.
+    */
+   class registry
+   {
+      public:
+         registry();
+         ~registry();
+
+         static registry& global();
+
+         counter&   get_counter( const std::string& name, const std::string& help, const label_list& labels = label_list() );
+         gauge&     get_gauge( const std::string& name, const std::string& help, const label_list& labels = label_list() );
+         histogram& get_histogram( const std::string& name, const std::string& help, const label_list& labels = label_list() );
+
+         /**
+          * Adds a counter or gauge whose value is read by calling value when
+          * the metrics are visited, for statistics kept elsewhere.
+          */
+         void add_callback( const std::string& name, const std::string& help, metric_type type,
+            const std::function< double() >& value, const label_list& labels = label_list() );
+
+         /** Calls visitor for every metric, grouped by name */
+         void visit( const std::function< void(const metric_sample&) >& visitor )const;
+
+         /** The metrics in the Prometheus text exposition format */
+         std::string render_prometheus()const;
+
+      private:
+         std::unique_ptr< detail::registry_impl > my;
+   };
+
+} } // fc::metrics
@@ -13,6 +13,7 @@
 
 namespace fc {
   class value;
+  class variant_object;
   class exception;
   namespace ip { class address; }
 
@@ -32,6 +33,7 @@ namespace fc {
   template<> struct get_typename<void>     { static const char* name()  { return "char";     } };
   template<> struct get_typename<string>   { static const char* name()  { return "string";   } };
   template<> struct get_typename<value>    { static const char* name()   { return "value";   } };
+  template<> struct get_typename<variant_object>   { static const char* name()   { return "variant_object";   } };
   template<> struct get_typename<fc::exception>   { static const char* name()   { return "fc::exception";   } };
   template<> struct get_typename<std::vector<char>>   { static const char* name()   { return "std::vector<char>";   } };
   template<typename T> struct get_typename<std::vector<T>>
@@ -80,6 +82,15 @@ namespace fc {
      }
   };
 
+  template<typename E> struct get_typename< std::multiset<E> >
+  {
+     static const char* name()
+     {
+        static std::string n = std::string("std::multiset<") + std::string(get_typename<E>::name()) + std::string(">");
+        return n.c_str();
+     }
+  };
+
   template<typename A, typename B> struct get_typename< std::pair<A,B> >
   {
       static const char* name()
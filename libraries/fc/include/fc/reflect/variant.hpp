@@ -4,10 +4,18 @@
 
 namespace fc
 {
+   /**
+    *  Return types of the reflection based to_variant() and from_variant()
+    *  below.  Custom overloads return void, which lets fc::json_writer and
+    *  fc::json_reader tell the two apart.
+    */
+   struct reflected_to_variant {};
+   struct reflected_from_variant {};
+
    template<typename T>
-   void to_variant( const T& o, variant& v );
+   reflected_to_variant to_variant( const T& o, variant& v );
    template<typename T>
-   void from_variant( const variant& v, T& o );
+   reflected_from_variant from_variant( const variant& v, T& o );
 
 
    template<typename T>
@@ -95,15 +103,17 @@ namespace fc
 
 
    template<typename T>
-   void to_variant( const T& o, variant& v )
+   reflected_to_variant to_variant( const T& o, variant& v )
    {
       if_enum<typename fc::reflector<T>::is_enum>::to_variant( o, v );
+      return reflected_to_variant();
    }
 
    template<typename T>
-   void from_variant( const variant& v, T& o )
+   reflected_from_variant from_variant( const variant& v, T& o )
    {
       if_enum<typename fc::reflector<T>::is_enum>::from_variant( v, o );
+      return reflected_from_variant();
    }
 
 }
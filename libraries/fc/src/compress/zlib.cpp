@@ -2,14 +2,50 @@
 
 #include "miniz.c"
 
+#include <algorithm>
+
 namespace fc
 {
-  string zlib_compress(const string& in)
+  namespace
+  {
+    /** deflate flags for a zlib style level, as in miniz's tdefl_create_comp_flags_from_zip_params() */
+    int compression_flags(int level)
+    {
+      static const mz_uint probes[11] = { 0, 1, 6, 32, 16, 32, 128, 256, 512, 768, 1500 };
+      level = std::max(0, std::min(level, 10));
+      return probes[level] | (level <= 3 ? TDEFL_GREEDY_PARSING_FLAG : 0);
+    }
+  }
+
+  string zlib_compress(const string& in, int level)
   {
     size_t compressed_message_length;
-    char* compressed_message = (char*)tdefl_compress_mem_to_heap(in.c_str(), in.size(), &compressed_message_length,  TDEFL_WRITE_ZLIB_HEADER | TDEFL_DEFAULT_MAX_PROBES);
+    char* compressed_message = (char*)tdefl_compress_mem_to_heap(in.c_str(), in.size(), &compressed_message_length,  TDEFL_WRITE_ZLIB_HEADER | compression_flags(level));
     string result(compressed_message, compressed_message_length);
     free(compressed_message);
     return result;
   }
+
+  string gzip_compress(const string& in, int level)
+  {
+    static const char header[10] = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff' };
+
+    size_t deflated_length;
+    char* deflated = (char*)tdefl_compress_mem_to_heap(in.c_str(), in.size(), &deflated_length, compression_flags(level));
+
+    string result;
+    result.reserve(sizeof(header) + deflated_length + 8);
+    result.append(header, sizeof(header));
+    result.append(deflated, deflated_length);
+    free(deflated);
+
+    // trailer: CRC-32 and size of the input, both little endian
+    uint32_t crc = uint32_t(mz_crc32(MZ_CRC32_INIT, (const unsigned char*)in.c_str(), in.size()));
+    uint32_t size = uint32_t(in.size());
+    for (int i = 0; i < 4; ++i)
+      result += char((crc >> (8 * i)) & 0xff);
+    for (int i = 0; i < 4; ++i)
+      result += char((size >> (8 * i)) & 0xff);
+    return result;
+  }
 }
@@ -10,6 +10,7 @@
 
 #include <fc/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
+#include <limits>
 #include <openssl/opensslconf.h>
 #ifndef OPENSSL_THREADS
 # error "OpenSSL must be configured to support threads"
@@ -163,16 +164,186 @@ uint32_t aes_decoder::final_decode( char* plaintext )
 }
 #endif
 
+namespace {
 
+const int aes_gcm_nonce_size = 12;
 
+/** nonce = 32 bit salt from init_value || 64 bit big endian frame counter */
+void aes_gcm_nonce( const unsigned char* salt, uint64_t counter, unsigned char* nonce )
+{
+    memcpy( nonce, salt, 4 );
+    for( int i = aes_gcm_nonce_size - 1; i >= 4; --i )
+    {
+        nonce[i] = static_cast<unsigned char>( counter & 0xff );
+        counter >>= 8;
+    }
+}
 
+} // anonymous namespace
 
+struct aes_gcm_encoder::impl
+{
+   evp_cipher_ctx ctx;
+   unsigned char  salt[4];
+   uint64_t       counter = 0;
+};
 
+aes_gcm_encoder::aes_gcm_encoder()
+{
+   static int init = init_openssl();
+   FC_UNUSED(init);
+}
 
+aes_gcm_encoder::~aes_gcm_encoder()
+{
+}
 
+void aes_gcm_encoder::init( const fc::sha256& key, const fc::uint128& init_value )
+{
+    my->ctx.obj = EVP_CIPHER_CTX_new();
+    if(!my->ctx)
+    {
+        FC_THROW_EXCEPTION( aes_exception, "error allocating evp cipher context",
+                           ("s", ERR_error_string( ERR_get_error(), nullptr) ) );
+    }
 
+    /* The key is bound once, the nonce is supplied per frame in encode() */
+    if(1 != EVP_EncryptInit_ex(my->ctx, EVP_aes_256_gcm(), NULL, (unsigned char*)&key, NULL))
+    {
+        FC_THROW_EXCEPTION( aes_exception, "error during aes 256 gcm encryption init",
+                           ("s", ERR_error_string( ERR_get_error(), nullptr) ) );
+    }
+    if(1 != EVP_CIPHER_CTX_ctrl(my->ctx, EVP_CTRL_GCM_SET_IVLEN, aes_gcm_nonce_size, NULL))
+    {
+        FC_THROW_EXCEPTION( aes_exception, "error setting aes 256 gcm nonce length",
+                           ("s", ERR_error_string( ERR_get_error(), nullptr) ) );
+    }
+    uint32_t salt = init_value.low_bits();
+    memcpy( my->salt, (char*)&salt, sizeof(my->salt) );
+    my->counter = 0;
+}
 
+uint32_t aes_gcm_encoder::encode( const char* plaintxt, uint32_t plaintext_len, char* ciphertxt, char* tag,
+                                  const char* aad, uint32_t aad_len )
+{
+    FC_ASSERT( my->counter != std::numeric_limits<uint64_t>::max(), "aes 256 gcm nonce space exhausted" );
+    unsigned char nonce[aes_gcm_nonce_size];
+    aes_gcm_nonce( my->salt, my->counter++, nonce );
+    if(1 != EVP_EncryptInit_ex(my->ctx, NULL, NULL, NULL, nonce))
+    {
+        FC_THROW_EXCEPTION( aes_exception, "error during aes 256 gcm encryption init",
+                           ("s", ERR_error_string( ERR_get_error(), nullptr) ) );
+    }
+
+    int len = 0;
+    if( aad_len && 1 != EVP_EncryptUpdate(my->ctx, NULL, &len, (const unsigned char*)aad, aad_len) )
+    {
+        FC_THROW_EXCEPTION( aes_exception, "error during aes 256 gcm encryption aad update",
+                           ("s", ERR_error_string( ERR_get_error(), nullptr) ) );
+    }
+
+    int ciphertext_len = 0;
+    if(1 != EVP_EncryptUpdate(my->ctx, (unsigned char*)ciphertxt, &ciphertext_len, (const unsigned char*)plaintxt, plaintext_len))
+    {
+        FC_THROW_EXCEPTION( aes_exception, "error during aes 256 gcm encryption update",
+                           ("s", ERR_error_string( ERR_get_error(), nullptr) ) );
+    }
+    if(1 != EVP_EncryptFinal_ex(my->ctx, (unsigned char*)ciphertxt + ciphertext_len, &len))
+    {
+        FC_THROW_EXCEPTION( aes_exception, "error during aes 256 gcm encryption final",
+                           ("s", ERR_error_string( ERR_get_error(), nullptr) ) );
+    }
+    ciphertext_len += len;
+    if(1 != EVP_CIPHER_CTX_ctrl(my->ctx, EVP_CTRL_GCM_GET_TAG, tag_size, tag))
+    {
+        FC_THROW_EXCEPTION( aes_exception, "error reading aes 256 gcm tag",
+                           ("s", ERR_error_string( ERR_get_error(), nullptr) ) );
+    }
+    FC_ASSERT( static_cast<uint32_t>(ciphertext_len) == plaintext_len, "",
+       ("ciphertext_len",ciphertext_len)("plaintext_len",plaintext_len) );
+    return ciphertext_len;
+}
 
+struct aes_gcm_decoder::impl
+{
+   evp_cipher_ctx ctx;
+   unsigned char  salt[4];
+   uint64_t       counter = 0;
+};
+
+aes_gcm_decoder::aes_gcm_decoder()
+{
+   static int init = init_openssl();
+   FC_UNUSED(init);
+}
+
+aes_gcm_decoder::~aes_gcm_decoder()
+{
+}
+
+void aes_gcm_decoder::init( const fc::sha256& key, const fc::uint128& init_value )
+{
+    my->ctx.obj = EVP_CIPHER_CTX_new();
+    if(!my->ctx)
+    {
+        FC_THROW_EXCEPTION( aes_exception, "error allocating evp cipher context",
+                           ("s", ERR_error_string( ERR_get_error(), nullptr) ) );
+    }
+
+    if(1 != EVP_DecryptInit_ex(my->ctx, EVP_aes_256_gcm(), NULL, (unsigned char*)&key, NULL))
+    {
+        FC_THROW_EXCEPTION( aes_exception, "error during aes 256 gcm decryption init",
+                           ("s", ERR_error_string( ERR_get_error(), nullptr) ) );
+    }
+    if(1 != EVP_CIPHER_CTX_ctrl(my->ctx, EVP_CTRL_GCM_SET_IVLEN, aes_gcm_nonce_size, NULL))
+    {
+        FC_THROW_EXCEPTION( aes_exception, "error setting aes 256 gcm nonce length",
+                           ("s", ERR_error_string( ERR_get_error(), nullptr) ) );
+    }
+    uint32_t salt = init_value.low_bits();
+    memcpy( my->salt, (char*)&salt, sizeof(my->salt) );
+    my->counter = 0;
+}
+
+uint32_t aes_gcm_decoder::decode( const char* ciphertxt, uint32_t ciphertxt_len, const char* tag, char* plaintext,
+                                  const char* aad, uint32_t aad_len )
+{
+    unsigned char nonce[aes_gcm_nonce_size];
+    aes_gcm_nonce( my->salt, my->counter++, nonce );
+    if(1 != EVP_DecryptInit_ex(my->ctx, NULL, NULL, NULL, nonce))
+    {
+        FC_THROW_EXCEPTION( aes_exception, "error during aes 256 gcm decryption init",
+                           ("s", ERR_error_string( ERR_get_error(), nullptr) ) );
+    }
+
+    int len = 0;
+    if( aad_len && 1 != EVP_DecryptUpdate(my->ctx, NULL, &len, (const unsigned char*)aad, aad_len) )
+    {
+        FC_THROW_EXCEPTION( aes_exception, "error during aes 256 gcm decryption aad update",
+                           ("s", ERR_error_string( ERR_get_error(), nullptr) ) );
+    }
+
+    int plaintext_len = 0;
+    if(1 != EVP_DecryptUpdate(my->ctx, (unsigned char*)plaintext, &plaintext_len, (const unsigned char*)ciphertxt, ciphertxt_len))
+    {
+        FC_THROW_EXCEPTION( aes_exception, "error during aes 256 gcm decryption update",
+                           ("s", ERR_error_string( ERR_get_error(), nullptr) ) );
+    }
+    if(1 != EVP_CIPHER_CTX_ctrl(my->ctx, EVP_CTRL_GCM_SET_TAG, tag_size, (void*)tag))
+    {
+        FC_THROW_EXCEPTION( aes_exception, "error setting aes 256 gcm tag",
+                           ("s", ERR_error_string( ERR_get_error(), nullptr) ) );
+    }
+    if(1 != EVP_DecryptFinal_ex(my->ctx, (unsigned char*)plaintext + plaintext_len, &len))
+    {
+        FC_THROW_EXCEPTION( aes_exception, "aes 256 gcm frame failed authentication",
+                           ("ciphertxt_len",ciphertxt_len) );
+    }
+    plaintext_len += len;
+    FC_ASSERT( ciphertxt_len == static_cast<uint32_t>(plaintext_len), "",
+       ("ciphertxt_len",ciphertxt_len)("plaintext_len",plaintext_len) );
+    return plaintext_len;
+}
 
 /** example method from wiki.opensslfoundation.com */
 unsigned aes_encrypt(unsigned char *plaintext, int plaintext_len, unsigned char *key,
@@ -2,6 +2,14 @@
 #include <fc/bitutil.hpp>
 #include <fc/crypto/restartable_sha256.hpp>
 
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FC_SHA256_SHANI 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
 namespace fc {
 
 static uint32_t kvalues[] = {
@@ -18,6 +26,86 @@ static uint32_t kvalues[] = {
 #define RIGHT_ROT(a, n) \
    ((uint32_t(a) >> n) | (uint32_t(a) << (32-n)))
 
+static void process_chunks_generic( uint32_t* state, const uint8_t* p, size_t count );
+
+#ifdef FC_SHA256_SHANI
+
+/**
+ * Hashes count chunks with the SHA extensions. The state is kept in two
+ * registers as ABEF and CDGH, the layout sha256rnds2 works on.
+ */
+__attribute__((target("sha,sse4.1,ssse3")))
+static void process_chunks_shani( uint32_t* state, const uint8_t* p, size_t count )
+{
+   const __m128i byte_swap = _mm_set_epi64x( 0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL );
+
+   __m128i tmp = _mm_shuffle_epi32( _mm_loadu_si128( (const __m128i*) &state[0] ), 0xB1 ); // CDAB
+   __m128i state1 = _mm_shuffle_epi32( _mm_loadu_si128( (const __m128i*) &state[4] ), 0x1B ); // EFGH
+   __m128i state0 = _mm_alignr_epi8( tmp, state1, 8 ); // ABEF
+   state1 = _mm_blend_epi16( state1, tmp, 0xF0 ); // CDGH
+
+   for( ; count > 0; --count, p += 0x40 )
+   {
+      __m128i abef = state0;
+      __m128i cdgh = state1;
+      __m128i w[4];
+
+      for( int i=0; i<16; i++ )
+      {
+         __m128i& cur = w[i & 3];
+         if( i < 4 )
+         {
+            cur = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i*) (p + 16*i) ), byte_swap );
+         }
+         else
+         {
+            const __m128i& prev = w[(i-1) & 3];
+            cur = _mm_sha256msg1_epu32( cur, w[(i-3) & 3] );
+            cur = _mm_add_epi32( cur, _mm_alignr_epi8( prev, w[(i-2) & 3], 4 ) );
+            cur = _mm_sha256msg2_epu32( cur, prev );
+         }
+
+         __m128i msg = _mm_add_epi32( cur, _mm_loadu_si128( (const __m128i*) &kvalues[4*i] ) );
+         state1 = _mm_sha256rnds2_epu32( state1, state0, msg );
+         state0 = _mm_sha256rnds2_epu32( state0, state1, _mm_shuffle_epi32( msg, 0x0E ) );
+      }
+
+      state0 = _mm_add_epi32( state0, abef );
+      state1 = _mm_add_epi32( state1, cdgh );
+   }
+
+   tmp = _mm_shuffle_epi32( state0, 0x1B ); // FEBA
+   state1 = _mm_shuffle_epi32( state1, 0xB1 ); // DCHG
+   _mm_storeu_si128( (__m128i*) &state[0], _mm_blend_epi16( tmp, state1, 0xF0 ) ); // DCBA
+   _mm_storeu_si128( (__m128i*) &state[4], _mm_alignr_epi8( state1, tmp, 8 ) ); // HGFE
+}
+
+static bool cpu_has_shani()
+{
+   unsigned int a, b, c, d;
+   if( !__get_cpuid( 1, &a, &b, &c, &d ) )
+      return false;
+   bool sse = ( c & bit_SSSE3 ) && ( c & bit_SSE4_1 );
+   if( !__get_cpuid_count( 7, 0, &a, &b, &c, &d ) )
+      return false;
+   return sse && ( b & ( 1u << 29 ) );
+}
+
+#endif
+
+typedef void (*process_chunks_func)( uint32_t* state, const uint8_t* p, size_t count );
+
+/** the fastest kernel the CPU supports, chosen on first use */
+static process_chunks_func get_process_chunks()
+{
+#ifdef FC_SHA256_SHANI
+   static const process_chunks_func f = cpu_has_shani() ? &process_chunks_shani : &process_chunks_generic;
+   return f;
+#else
+   return &process_chunks_generic;
+#endif
+}
+
 restartable_sha256::restartable_sha256()
 {
    _h[0] = 0x6a09e667;
@@ -48,14 +136,13 @@ void restartable_sha256::update( const void* data, size_t count )
 
    if( (_length & 0x3F) == 0 )
       process_chunk( chunk );
-   ((uint64_t*) (&_data))[7] = 0;
 
    _length += count;
-   while( count >= 0x40 )
+   if( count >= 0x40 )
    {
-      process_chunk( p );
-      count -= 0x40;
-      p += 0x40;
+      get_process_chunks()( _h.data, p, count >> 6 );
+      p += count & ~size_t(0x3F);
+      count &= 0x3F;
    }
 
    memcpy( chunk, p, count );
@@ -73,6 +160,7 @@ void restartable_sha256::finish()
    chunk[offset++] = 0x80;
    if( offset > 0x38 )
    {
+      memset( chunk+offset, 0, 0x40-offset );
       process_chunk( chunk );
       memset( chunk, 0, 0x38 );
    }
@@ -119,57 +207,65 @@ std::string restartable_sha256::hexdigest()const
 // chunk must be exactly be 512 bytes
 void restartable_sha256::process_chunk( const void* chunk )
 {
-   uint32_t w[64];
-   const uint32_t* chnk = (const uint32_t*) chunk;
+   get_process_chunks()( _h.data, (const uint8_t*) chunk, 1 );
+}
 
-   for( int i=0; i<16; i++ )
+static void process_chunks_generic( uint32_t* state, const uint8_t* p, size_t count )
+{
+   for( ; count > 0; --count, p += 0x40 )
    {
-      w[i] = endian_reverse_u32( chnk[i] );
-   }
+      uint32_t w[64];
+      const uint32_t* chnk = (const uint32_t*) p;
 
-   for( int i=16; i<64; i++ )
-   {
-      uint32_t s0 = RIGHT_ROT( w[i-15],  7 ) ^ RIGHT_ROT( w[i-15], 18 ) ^ ( w[i-15] >>  3 );
-      uint32_t s1 = RIGHT_ROT( w[i- 2], 17 ) ^ RIGHT_ROT( w[i- 2], 19 ) ^ ( w[i- 2] >> 10 );
-      w[i] = w[i-16] + s0 + w[i-7] + s1;
-   }
+      for( int i=0; i<16; i++ )
+      {
+         w[i] = endian_reverse_u32( chnk[i] );
+      }
 
-   uint32_t a = _h[0];
-   uint32_t b = _h[1];
-   uint32_t c = _h[2];
-   uint32_t d = _h[3];
-   uint32_t e = _h[4];
-   uint32_t f = _h[5];
-   uint32_t g = _h[6];
-   uint32_t h = _h[7];
+      for( int i=16; i<64; i++ )
+      {
+         uint32_t s0 = RIGHT_ROT( w[i-15],  7 ) ^ RIGHT_ROT( w[i-15], 18 ) ^ ( w[i-15] >>  3 );
+         uint32_t s1 = RIGHT_ROT( w[i- 2], 17 ) ^ RIGHT_ROT( w[i- 2], 19 ) ^ ( w[i- 2] >> 10 );
+         w[i] = w[i-16] + s0 + w[i-7] + s1;
+      }
 
-   for( int i=0; i<64; i++ )
-   {
-      uint32_t s1 = RIGHT_ROT( e, 6 ) ^ RIGHT_ROT( e, 11 ) ^ RIGHT_ROT( e, 25 );
-      uint32_t ch = (e & f) ^ ((~e) & g);
-      uint32_t temp1 = h + s1 + ch + kvalues[i] + w[i];
-      uint32_t s0 = RIGHT_ROT( a, 2 ) ^ RIGHT_ROT( a, 13 ) ^ RIGHT_ROT( a, 22 );
-      uint32_t maj = (a&b) ^ (a&c) ^ (b&c);
-      uint32_t temp2 = s0 + maj;
-
-      h = g;
-      g = f;
-      f = e;
-      e = d + temp1;
-      d = c;
-      c = b;
-      b = a;
-      a = temp1 + temp2;
-   }
+      uint32_t a = state[0];
+      uint32_t b = state[1];
+      uint32_t c = state[2];
+      uint32_t d = state[3];
+      uint32_t e = state[4];
+      uint32_t f = state[5];
+      uint32_t g = state[6];
+      uint32_t h = state[7];
+
+      for( int i=0; i<64; i++ )
+      {
+         uint32_t s1 = RIGHT_ROT( e, 6 ) ^ RIGHT_ROT( e, 11 ) ^ RIGHT_ROT( e, 25 );
+         uint32_t ch = (e & f) ^ ((~e) & g);
+         uint32_t temp1 = h + s1 + ch + kvalues[i] + w[i];
+         uint32_t s0 = RIGHT_ROT( a, 2 ) ^ RIGHT_ROT( a, 13 ) ^ RIGHT_ROT( a, 22 );
+         uint32_t maj = (a&b) ^ (a&c) ^ (b&c);
+         uint32_t temp2 = s0 + maj;
 
-   _h[0] += a;
-   _h[1] += b;
-   _h[2] += c;
-   _h[3] += d;
-   _h[4] += e;
-   _h[5] += f;
-   _h[6] += g;
-   _h[7] += h;
+         h = g;
+         g = f;
+         f = e;
+         e = d + temp1;
+         d = c;
+         c = b;
+         b = a;
+         a = temp1 + temp2;
+      }
+
+      state[0] += a;
+      state[1] += b;
+      state[2] += c;
+      state[3] += d;
+      state[4] += e;
+      state[5] += f;
+      state[6] += g;
+      state[7] += h;
+   }
 }
 
 }
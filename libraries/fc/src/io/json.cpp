@@ -16,7 +16,7 @@ namespace fc
 {
     // forward declarations of provided functions
     template<typename T, json::parse_type parser_type> variant variant_from_stream( T& in, uint32_t depth = 0 );
-    template<typename T> char parseEscape( T& in, uint32_t depth = 0 );
+    template<typename T> fc::string parseEscape( T& in, uint32_t depth = 0 );
     template<typename T> fc::string stringFromStream( T& in, uint32_t depth = 0 );
     template<typename T> bool skip_white_space( T& in, uint32_t depth = 0 );
     template<typename T> fc::string stringFromToken( T& in, uint32_t depth = 0 );
@@ -36,29 +36,78 @@ namespace fc
 namespace fc
 {
    template<typename T>
-   char parseEscape( T& in, uint32_t )
+   uint32_t parse_hex4( T& in )
+   {
+      uint32_t v = 0;
+      for( int i = 0; i < 4; ++i )
+      {
+         char c = in.get();
+         v <<= 4;
+         if( c >= '0' && c <= '9' )      v |= c - '0';
+         else if( c >= 'a' && c <= 'f' ) v |= c - 'a' + 10;
+         else if( c >= 'A' && c <= 'F' ) v |= c - 'A' + 10;
+         else FC_THROW_EXCEPTION( parse_error_exception, "Invalid \\u escape" );
+      }
+      return v;
+   }
+
+   template<typename T>
+   fc::string parse_escaped_char( T& in );
+
+   /**
+    *  Decodes the code unit of a \u escape that was just read, pairing a high
+    *  surrogate with a low one escaped right after it like json_reader does.
+    */
+   template<typename T>
+   fc::string parse_code_unit( T& in, uint32_t cp )
+   {
+      fc::string result;
+      if( cp >= 0xd800 && cp < 0xdc00 && in.peek() == '\\' )
+      {
+         in.get();
+         if( in.peek() != 'u' )
+         {
+            append_utf8( result, cp );
+            return result + parse_escaped_char( in );
+         }
+         in.get();
+         uint32_t low = parse_hex4( in );
+         if( low < 0xdc00 || low >= 0xe000 )
+         {
+            append_utf8( result, cp );
+            return result + parse_code_unit( in, low );
+         }
+         cp = 0x10000 + ( ( cp - 0xd800 ) << 10 ) + ( low - 0xdc00 );
+      }
+      append_utf8( result, cp );
+      return result;
+   }
+
+   /** Decodes the escape after a '\\', other characters stand for themselves */
+   template<typename T>
+   fc::string parse_escaped_char( T& in )
+   {
+      char c = in.get();
+      switch( c )
+      {
+         case 'b': return fc::string( 1, '\b' );
+         case 'f': return fc::string( 1, '\f' );
+         case 'n': return fc::string( 1, '\n' );
+         case 'r': return fc::string( 1, '\r' );
+         case 't': return fc::string( 1, '\t' );
+         case 'u': return parse_code_unit( in, parse_hex4( in ) );
+         default:  return fc::string( 1, c );
+      }
+   }
+
+   template<typename T>
+   fc::string parseEscape( T& in, uint32_t )
    {
       if( in.peek() == '\\' )
       {
          try {
             in.get();
-            switch( in.peek() )
-            {
-               case 't':
-                  in.get();
-                  return '\t';
-               case 'n':
-                  in.get();
-                  return '\n';
-               case 'r':
-                  in.get();
-                  return '\r';
-               case '\\':
-                  in.get();
-                  return '\\';
-               default:
-                  return in.get();
-            }
+            return parse_escaped_char( in );
          } FC_RETHROW_EXCEPTIONS( info, "Stream ended with '\\'" );
       }
 	    FC_THROW_EXCEPTION( parse_error_exception, "Expected '\\'"  );
@@ -0,0 +1,374 @@
+#include <fc/io/json_reader.hpp>
+#include <fc/exception/exception.hpp>
+
+namespace fc
+{
+   void json_reader::skip_white_space()
+   {
+      while( _pos != _end && ( *_pos == ' ' || *_pos == '\t' || *_pos == '\n' || *_pos == '\r' ) )
+         ++_pos;
+   }
+
+   char json_reader::peek()
+   {
+      skip_white_space();
+      return _pos == _end ? '\0' : *_pos;
+   }
+
+   void json_reader::expect( char c )
+   {
+      if( peek() != c )
+      {
+         if( _pos == _end )
+            FC_THROW_EXCEPTION( parse_error_exception, "Expected '${c}' but reached the end of the JSON text", ("c", std::string( 1, c )) );
+         FC_THROW_EXCEPTION( parse_error_exception, "Expected '${c}' but read '${r}'", ("c", std::string( 1, c ))("r", std::string( 1, *_pos )) );
+      }
+      ++_pos;
+   }
+
+   void json_reader::expect_end()
+   {
+      if( !at_end() )
+         FC_THROW_EXCEPTION( parse_error_exception, "Unexpected '${r}' after the JSON value", ("r", std::string( 1, *_pos )) );
+   }
+
+   void json_reader::enter()
+   {
+      FC_ASSERT( ++_depth <= _max_depth, "object graph too deep" );
+   }
+
+   void json_reader::begin_object()
+   {
+      expect( '{' );
+      enter();
+   }
+
+   bool json_reader::next_member( std::string& key, bool first )
+   {
+      char c = peek();
+      if( c == '}' )
+      {
+         ++_pos;
+         leave();
+         return false;
+      }
+      if( !first )
+         expect( ',' );
+      read_string( key );
+      expect( ':' );
+      return true;
+   }
+
+   void json_reader::begin_array()
+   {
+      expect( '[' );
+      enter();
+   }
+
+   bool json_reader::next_element( bool first )
+   {
+      if( peek() == ']' )
+      {
+         ++_pos;
+         leave();
+         return false;
+      }
+      if( !first )
+         expect( ',' );
+      return true;
+   }
+
+   void json_reader::read_null()
+   {
+      skip_literal( "null" );
+   }
+
+   void json_reader::skip_literal( const char* word )
+   {
+      size_t len = strlen( word );
+      if( peek() == '\0' || size_t( _end - _pos ) < len || memcmp( _pos, word, len ) != 0 )
+         FC_THROW_EXCEPTION( parse_error_exception, "Expected '${w}'", ("w", word) );
+      _pos += len;
+   }
+
+   void append_utf8( std::string& out, uint32_t cp )
+   {
+      if( cp < 0x80 )
+         out += char( cp );
+      else if( cp < 0x800 )
+      {
+         out += char( 0xc0 | ( cp >> 6 ) );
+         out += char( 0x80 | ( cp & 0x3f ) );
+      }
+      else if( cp < 0x10000 )
+      {
+         out += char( 0xe0 | ( cp >> 12 ) );
+         out += char( 0x80 | ( ( cp >> 6 ) & 0x3f ) );
+         out += char( 0x80 | ( cp & 0x3f ) );
+      }
+      else
+      {
+         out += char( 0xf0 | ( cp >> 18 ) );
+         out += char( 0x80 | ( ( cp >> 12 ) & 0x3f ) );
+         out += char( 0x80 | ( ( cp >> 6 ) & 0x3f ) );
+         out += char( 0x80 | ( cp & 0x3f ) );
+      }
+   }
+
+   void json_reader::read_hex_escape( std::string* out )
+   {
+      auto hex4 = [this]() -> uint32_t
+      {
+         if( _end - _pos < 4 )
+            FC_THROW_EXCEPTION( parse_error_exception, "Truncated \\u escape" );
+         uint32_t v = 0;
+         for( int i = 0; i < 4; ++i, ++_pos )
+         {
+            char c = *_pos;
+            v <<= 4;
+            if( c >= '0' && c <= '9' )      v |= c - '0';
+            else if( c >= 'a' && c <= 'f' ) v |= c - 'a' + 10;
+            else if( c >= 'A' && c <= 'F' ) v |= c - 'A' + 10;
+            else FC_THROW_EXCEPTION( parse_error_exception, "Invalid \\u escape" );
+         }
+         return v;
+      };
+
+      uint32_t cp = hex4();
+      if( cp >= 0xd800 && cp < 0xdc00 && _end - _pos >= 6 && _pos[0] == '\\' && _pos[1] == 'u' )
+      {
+         const char* save = _pos;
+         _pos += 2;
+         uint32_t low = hex4();
+         if( low >= 0xdc00 && low < 0xe000 )
+            cp = 0x10000 + ( ( cp - 0xd800 ) << 10 ) + ( low - 0xdc00 );
+         else
+            _pos = save;
+      }
+
+      if( out )
+         append_utf8( *out, cp );
+   }
+
+   void json_reader::read_string( std::string& out )
+   {
+      expect( '"' );
+      out.clear();
+      const char* run = _pos;
+      while( true )
+      {
+         if( _pos == _end )
+            FC_THROW_EXCEPTION( parse_error_exception, "EOF before closing '\"' in string" );
+         char c = *_pos;
+         if( c == '"' )
+         {
+            out.append( run, _pos - run );
+            ++_pos;
+            return;
+         }
+         if( c != '\\' )
+         {
+            ++_pos;
+            continue;
+         }
+
+         out.append( run, _pos - run );
+         if( ++_pos == _end )
+            FC_THROW_EXCEPTION( parse_error_exception, "Stream ended with '\\'" );
+         switch( *_pos++ )
+         {
+            case '"':  out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/':  out += '/'; break;
+            case 'b':  out += '\b'; break;
+            case 'f':  out += '\f'; break;
+            case 'n':  out += '\n'; break;
+            case 'r':  out += '\r'; break;
+            case 't':  out += '\t'; break;
+            case 'u':  read_hex_escape( &out ); break;
+            default:
+               FC_THROW_EXCEPTION( parse_error_exception, "Invalid escape '\\${c}'", ("c", std::string( 1, _pos[-1] )) );
+         }
+         run = _pos;
+      }
+   }
+
+   void json_reader::skip_string()
+   {
+      expect( '"' );
+      while( true )
+      {
+         if( _pos == _end )
+            FC_THROW_EXCEPTION( parse_error_exception, "EOF before closing '\"' in string" );
+         char c = *_pos++;
+         if( c == '"' )
+            return;
+         if( c != '\\' )
+            continue;
+         if( _pos == _end )
+            FC_THROW_EXCEPTION( parse_error_exception, "Stream ended with '\\'" );
+         switch( *_pos++ )
+         {
+            case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+               break;
+            case 'u':
+               read_hex_escape( nullptr );
+               break;
+            default:
+               FC_THROW_EXCEPTION( parse_error_exception, "Invalid escape '\\${c}'", ("c", std::string( 1, _pos[-1] )) );
+         }
+      }
+   }
+
+   /** same result types as the legacy parser: double with a fraction or exponent, else int64 if negative, else uint64 */
+   variant json_reader::read_number()
+   {
+      skip_white_space();
+      const char* start = _pos;
+      bool neg = false;
+      bool fraction = false;
+      if( _pos != _end && *_pos == '-' )
+      {
+         neg = true;
+         ++_pos;
+      }
+
+      const char* digits = _pos;
+      uint64_t value = 0;
+      while( _pos != _end && *_pos >= '0' && *_pos <= '9' )
+         value = value * 10 + uint64_t( *_pos++ - '0' );
+      size_t digit_count = _pos - digits;
+      if( digit_count == 0 )
+         FC_THROW_EXCEPTION( parse_error_exception, "Can't parse token \"${t}\" as a JSON numeric constant", ("t", std::string( start, _pos )) );
+
+      if( _pos != _end && *_pos == '.' )
+      {
+         fraction = true;
+         ++_pos;
+         while( _pos != _end && *_pos >= '0' && *_pos <= '9' )
+            ++_pos;
+      }
+      if( _pos != _end && ( *_pos == 'e' || *_pos == 'E' ) )
+      {
+         fraction = true;
+         ++_pos;
+         if( _pos != _end && ( *_pos == '+' || *_pos == '-' ) )
+            ++_pos;
+         const char* exponent = _pos;
+         while( _pos != _end && *_pos >= '0' && *_pos <= '9' )
+            ++_pos;
+         if( _pos == exponent )
+            FC_THROW_EXCEPTION( parse_error_exception, "Can't parse token \"${t}\" as a JSON numeric constant", ("t", std::string( start, _pos )) );
+      }
+
+      if( fraction )
+         return variant( to_double( std::string( start, _pos ) ) );
+      // 18 digits can not overflow, longer numbers keep the legacy conversion and its errors
+      if( digit_count > 18 )
+         return neg ? variant( to_int64( std::string( start, _pos ) ) ) : variant( to_uint64( std::string( start, _pos ) ) );
+      if( neg )
+         return variant( -int64_t( value ) );
+      return variant( value );
+   }
+
+   variant json_reader::read_variant()
+   {
+      switch( peek() )
+      {
+         case '"':
+         {
+            std::string s;
+            read_string( s );
+            return variant( std::move( s ) );
+         }
+         case '{':
+         {
+            mutable_variant_object obj;
+            std::string key;
+            begin_object();
+            for( bool first = true; next_member( key, first ); first = false )
+            {
+               variant value = read_variant();
+               obj( std::move( key ), std::move( value ) );
+            }
+            return variant( std::move( obj ) );
+         }
+         case '[':
+         {
+            variants arr;
+            begin_array();
+            for( bool first = true; next_element( first ); first = false )
+               arr.push_back( read_variant() );
+            return variant( std::move( arr ) );
+         }
+         case 't':
+            skip_literal( "true" );
+            return variant( true );
+         case 'f':
+            skip_literal( "false" );
+            return variant( false );
+         case 'n':
+            read_null();
+            return variant();
+         case '\0':
+            FC_THROW_EXCEPTION( parse_error_exception, "Unexpected end of the JSON text" );
+         default:
+            return read_number();
+      }
+   }
+
+   json_span json_reader::skip_value()
+   {
+      char c = peek();
+      const char* start = _pos;
+      switch( c )
+      {
+         case '"':
+            skip_string();
+            break;
+         case '{':
+         {
+            begin_object();
+            for( bool first = true; peek() != '}'; first = false )
+            {
+               if( !first )
+                  expect( ',' );
+               skip_string();
+               expect( ':' );
+               skip_value();
+            }
+            ++_pos;
+            leave();
+            break;
+         }
+         case '[':
+            begin_array();
+            for( bool first = true; next_element( first ); first = false )
+               skip_value();
+            break;
+         case 't':
+            skip_literal( "true" );
+            break;
+         case 'f':
+            skip_literal( "false" );
+            break;
+         case 'n':
+            read_null();
+            break;
+         case '\0':
+            FC_THROW_EXCEPTION( parse_error_exception, "Unexpected end of the JSON text" );
+         default:
+            read_number();
+      }
+      return json_span( start, _pos );
+   }
+
+   void json_reader::read( std::string& s )
+   {
+      if( peek() == '"' )
+         read_string( s );
+      else
+         from_variant( read_variant(), s );
+   }
+
+} // namespace fc
@@ -0,0 +1,127 @@
+#include <fc/io/json_writer.hpp>
+
+namespace fc
+{
+   void json_writer::write( const variant& v )
+   {
+      write_variant( v );
+   }
+
+   void json_writer::write( const variant_object& v )
+   {
+      write_variant( variant( v ) );
+   }
+
+   /** same escaping rules as escape_string() in json.cpp */
+   void json_writer::write_string( const char* s, size_t len )
+   {
+      static const char hex[] = "0123456789abcdef";
+
+      _out.reserve( _out.size() + len + 2 );
+      _out += '"';
+      const char* run = s;
+      const char* end = s + len;
+      for( const char* itr = s; itr != end; ++itr )
+      {
+         const char c = *itr;
+         if( c != '"' && c != '\\' && ( c & 0xe0 ) != 0 )
+            continue;
+
+         _out.append( run, itr - run );
+         run = itr + 1;
+         switch( c )
+         {
+            case '\b': _out += "\\b"; break;
+            case '\f': _out += "\\f"; break;
+            case '\n': _out += "\\n"; break;
+            case '\r': _out += "\\r"; break;
+            case '\t': _out += "\\t"; break;
+            case '\\': _out += "\\\\"; break;
+            case '"':  _out += "\\\""; break;
+            default:
+               _out += "\\u00";
+               _out += hex[ ( c >> 4 ) & 0x0f ];
+               _out += hex[ c & 0x0f ];
+         }
+      }
+      _out.append( run, end - run );
+      _out += '"';
+   }
+
+   void json_writer::write_int64( int64_t i )
+   {
+      if( i < 0 )
+         write_digits( 0 - uint64_t( i ), true, false );
+      else
+         write_digits( uint64_t( i ), false, _format == json::stringify_large_ints_and_doubles && i > 0xffffffff );
+   }
+
+   void json_writer::write_uint64( uint64_t u )
+   {
+      write_digits( u, false, _format == json::stringify_large_ints_and_doubles && u > 0xffffffff );
+   }
+
+   void json_writer::write_digits( uint64_t u, bool negative, bool quote )
+   {
+      char buf[24];
+      char* p = buf + sizeof( buf );
+      if( quote )
+         *--p = '"';
+      do
+      {
+         *--p = char( '0' + u % 10 );
+         u /= 10;
+      } while( u != 0 );
+      if( negative )
+         *--p = '-';
+      if( quote )
+         *--p = '"';
+      _out.append( p, buf + sizeof( buf ) - p );
+   }
+
+   void json_writer::write_variant( const variant& v )
+   {
+      switch( v.get_type() )
+      {
+         case variant::null_type:
+            _out += "null";
+            return;
+         case variant::int64_type:
+            write_int64( v.as_int64() );
+            return;
+         case variant::uint64_type:
+            write_uint64( v.as_uint64() );
+            return;
+         case variant::bool_type:
+            write( v.as_bool() );
+            return;
+         case variant::string_type:
+         {
+            const string& s = v.get_string();
+            write_string( s.data(), s.size() );
+            return;
+         }
+         case variant::array_type:
+            write_array( v.get_array() );
+            return;
+         case variant::object_type:
+         {
+            const variant_object& o = v.get_object();
+            _out += '{';
+            for( auto itr = o.begin(); itr != o.end(); ++itr )
+            {
+               if( itr != o.begin() )
+                  _out += ',';
+               write_string( itr->key().data(), itr->key().size() );
+               _out += ':';
+               write_variant( itr->value() );
+            }
+            _out += '}';
+            return;
+         }
+         default:
+            _out += json::to_string( v, _format );
+      }
+   }
+
+} // namespace fc
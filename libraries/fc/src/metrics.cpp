@@ -0,0 +1,379 @@
+#include <fc/metrics.hpp>
+#include <fc/exception/exception.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <mutex>
+
+namespace fc { namespace metrics {
+
+   uint64_t sharded_sum::value()const noexcept
+   {
+      uint64_t total = 0;
+      for( const auto& s : _shards )
+         total += s.value.load( std::memory_order_relaxed );
+      return total;
+   }
+
+   uint32_t histogram::bucket_index( uint64_t micros ) noexcept
+   {
+      if( micros < 2 * sub_buckets )
+         return uint32_t( micros );
+
+      uint32_t msb = 63 - __builtin_clzll( micros );
+      if( msb >= max_exponent )
+         return bucket_count - 1;
+
+      uint32_t shift = msb - sub_bucket_bits;
+      return ( shift + 1 ) * sub_buckets + uint32_t( ( micros >> shift ) - sub_buckets );
+   }
+
+   uint64_t histogram::bucket_lowest( uint32_t index ) noexcept
+   {
+      if( index < 2 * sub_buckets )
+         return index;
+
+      uint32_t shift = index / sub_buckets - 1;
+      return uint64_t( sub_buckets + index % sub_buckets ) << shift;
+   }
+
+   uint64_t histogram::count()const noexcept
+   {
+      uint64_t total = 0;
+      for( const auto& b : _buckets )
+         total += b.load( std::memory_order_relaxed );
+      return total;
+   }
+
+   uint64_t histogram::percentile( double q )const noexcept
+   {
+      uint64_t counts[ bucket_count ];
+      uint64_t total = 0;
+      for( uint32_t i = 0; i < bucket_count; ++i )
+      {
+         counts[i] = bucket( i );
+         total += counts[i];
+      }
+      if( total == 0 )
+         return 0;
+
+      uint64_t rank = uint64_t( std::ceil( std::min( std::max( q, 0.0 ), 1.0 ) * total ) );
+      rank = std::max< uint64_t >( rank, 1 );
+
+      uint64_t seen = 0;
+      for( uint32_t i = 0; i < bucket_count; ++i )
+      {
+         seen += counts[i];
+         if( seen >= rank )
+            return bucket_lowest( i + 1 ) - 1;
+      }
+      return bucket_lowest( bucket_count ) - 1;
+   }
+
+   namespace detail {
+
+      struct metric_entry
+      {
+         label_list                       labels;
+         std::unique_ptr< counter >       c;
+         std::unique_ptr< gauge >         g;
+         std::unique_ptr< histogram >     h;
+         std::function< double() >        callback;
+      };
+
+      struct metric_family
+      {
+         std::string                                     help;
+         metric_type                                     type;
+         std::vector< std::unique_ptr< metric_entry > >  entries;
+      };
+
+      class registry_impl
+      {
+         public:
+            metric_entry* find( const std::string& name, metric_type type, const label_list& labels );
+            metric_entry& add( const std::string& name, const std::string& help, metric_type type, const label_list& labels );
+
+            mutable std::mutex                           _mtx;
+            std::map< std::string, metric_family >       _families;
+      };
+
+      bool valid_name( const std::string& name )
+      {
+         if( name.empty() || ( name[0] >= '0' && name[0] <= '9' ) )
+            return false;
+         for( char c : name )
+         {
+            if( !( ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || ( c >= '0' && c <= '9' ) || c == '_' || c == ':' ) )
+               return false;
+         }
+         return true;
+      }
+
+      metric_entry* registry_impl::find( const std::string& name, metric_type type, const label_list& labels )
+      {
+         auto itr = _families.find( name );
+         if( itr == _families.end() )
+            return nullptr;
+
+         FC_ASSERT( itr->second.type == type, "Metric ${n} is registered with another type", ("n", name) );
+         for( auto& e : itr->second.entries )
+            if( e->labels == labels )
+               return e.get();
+         return nullptr;
+      }
+
+      metric_entry& registry_impl::add( const std::string& name, const std::string& help, metric_type type, const label_list& labels )
+      {
+         FC_ASSERT( valid_name( name ), "Invalid metric name ${n}", ("n", name) );
+         for( const auto& l : labels )
+            FC_ASSERT( valid_name( l.first ) && l.first.find( ':' ) == std::string::npos, "Invalid label name ${l} of metric ${n}", ("l", l.first)("n", name) );
+
+         auto& family = _families[ name ];
+         if( family.entries.empty() )
+         {
+            family.help = help;
+            family.type = type;
+         }
+
+         family.entries.emplace_back( new metric_entry() );
+         family.entries.back()->labels = labels;
+         return *family.entries.back();
+      }
+
+      void append_escaped( std::string& out, const std::string& s, bool quote )
+      {
+         for( char c : s )
+         {
+            if( c == '\\' )
+               out += "\\\\";
+            else if( c == '\n' )
+               out += "\\n";
+            else if( c == '"' && quote )
+               out += "\\\"";
+            else
+               out += c;
+         }
+      }
+
+      void append_labels( std::string& out, const label_list& labels, const char* le = nullptr )
+      {
+         if( labels.empty() && le == nullptr )
+            return;
+
+         out += '{';
+         bool first = true;
+         for( const auto& l : labels )
+         {
+            if( !first )
+               out += ',';
+            first = false;
+            out += l.first;
+            out += "=\"";
+            append_escaped( out, l.second, true );
+            out += '"';
+         }
+         if( le != nullptr )
+         {
+            if( !first )
+               out += ',';
+            out += "le=\"";
+            out += le;
+            out += '"';
+         }
+         out += '}';
+      }
+
+      /** Exact decimal seconds of a microsecond count */
+      std::string micros_to_seconds( uint64_t micros )
+      {
+         std::string s = std::to_string( micros / 1000000 );
+         uint64_t frac = micros % 1000000;
+         if( frac )
+         {
+            char buf[8];
+            std::snprintf( buf, sizeof( buf ), "%06u", unsigned( frac ) );
+            std::string f( buf );
+            f.erase( f.find_last_not_of( '0' ) + 1 );
+            s += '.';
+            s += f;
+         }
+         return s;
+      }
+
+      std::string format_value( double v )
+      {
+         if( std::isnan( v ) )
+            return "NaN";
+         if( std::isinf( v ) )
+            return v > 0 ? "+Inf" : "-Inf";
+         if( v == std::floor( v ) && std::fabs( v ) < 1e15 )
+            return std::to_string( int64_t( v ) );
+
+         char buf[32];
+         std::snprintf( buf, sizeof( buf ), "%.17g", v );
+         return buf;
+      }
+
+   } // detail
+
+   registry::registry() : my( new detail::registry_impl() ) {}
+   registry::~registry() {}
+
+   registry& registry::global()
+   {
+      static registry r;
+      return r;
+   }
+
+   counter& registry::get_counter( const std::string& name, const std::string& help, const label_list& labels )
+   {
+      std::lock_guard< std::mutex > guard( my->_mtx );
+      auto* e = my->find( name, metric_type::counter, labels );
+      if( e == nullptr )
+      {
+         e = &my->add( name, help, metric_type::counter, labels );
+         e->c.reset( new counter() );
+      }
+      FC_ASSERT( e->c, "Metric ${n} is a callback", ("n", name) );
+      return *e->c;
+   }
+
+   gauge& registry::get_gauge( const std::string& name, const std::string& help, const label_list& labels )
+   {
+      std::lock_guard< std::mutex > guard( my->_mtx );
+      auto* e = my->find( name, metric_type::gauge, labels );
+      if( e == nullptr )
+      {
+         e = &my->add( name, help, metric_type::gauge, labels );
+         e->g.reset( new gauge() );
+      }
+      FC_ASSERT( e->g, "Metric ${n} is a callback", ("n", name) );
+      return *e->g;
+   }
+
+   histogram& registry::get_histogram( const std::string& name, const std::string& help, const label_list& labels )
+   {
+      std::lock_guard< std::mutex > guard( my->_mtx );
+      auto* e = my->find( name, metric_type::histogram, labels );
+      if( e == nullptr )
+      {
+         e = &my->add( name, help, metric_type::histogram, labels );
+         e->h.reset( new histogram() );
+      }
+      return *e->h;
+   }
+
+   void registry::add_callback( const std::string& name, const std::string& help, metric_type type,
+      const std::function< double() >& value, const label_list& labels )
+   {
+      FC_ASSERT( type != metric_type::histogram, "Callback metric ${n} must be a counter or a gauge", ("n", name) );
+
+      std::lock_guard< std::mutex > guard( my->_mtx );
+      FC_ASSERT( my->find( name, type, labels ) == nullptr, "Metric ${n} is already registered", ("n", name) );
+      my->add( name, help, type, labels ).callback = value;
+   }
+
+   void registry::visit( const std::function< void(const metric_sample&) >& visitor )const
+   {
+      std::lock_guard< std::mutex > guard( my->_mtx );
+      for( const auto& f : my->_families )
+      {
+         for( const auto& e : f.second.entries )
+         {
+            metric_sample sample{ f.first, f.second.help, e->labels, f.second.type };
+            if( e->callback )
+               sample.value = e->callback();
+            else if( e->c )
+               sample.value = double( e->c->value() );
+            else if( e->g )
+               sample.value = double( e->g->value() );
+            else
+               sample.hist = e->h.get();
+
+            visitor( sample );
+         }
+      }
+   }
+
+   std::string registry::render_prometheus()const
+   {
+      std::string out;
+      const std::string* last_name = nullptr;
+
+      visit( [&]( const metric_sample& m )
+      {
+         if( last_name == nullptr || *last_name != m.name )
+         {
+            last_name = &m.name;
+            out += "# HELP ";
+            out += m.name;
+            out += ' ';
+            detail::append_escaped( out, m.help, false );
+            out += "\n# TYPE ";
+            out += m.name;
+            out += m.type == metric_type::counter ? " counter\n" : m.type == metric_type::gauge ? " gauge\n" : " histogram\n";
+         }
+
+         if( m.hist == nullptr )
+         {
+            out += m.name;
+            detail::append_labels( out, m.labels );
+            out += ' ';
+            out += detail::format_value( m.value );
+            out += '\n';
+            return;
+         }
+
+         /*
+          * Cumulative counts up to the end of the bucket holding every power of
+          * two microseconds. le is the largest value those buckets hold, the
+          * power of two itself while buckets are one microsecond wide and a
+          * sixteenth above it from 32 microseconds on.
+          */
+         uint64_t cumulative = 0;
+         uint32_t index = 0;
+         for( uint32_t exp = 0; exp < histogram::max_exponent; ++exp )
+         {
+            uint32_t bound = histogram::bucket_index( uint64_t( 1 ) << exp ) + 1;
+            for( ; index < bound; ++index )
+               cumulative += m.hist->bucket( index );
+
+            out += m.name;
+            out += "_bucket";
+            detail::append_labels( out, m.labels, detail::micros_to_seconds( histogram::bucket_lowest( bound ) - 1 ).c_str() );
+            out += ' ';
+            out += std::to_string( cumulative );
+            out += '\n';
+         }
+         for( ; index < histogram::bucket_count; ++index )
+            cumulative += m.hist->bucket( index );
+
+         out += m.name;
+         out += "_bucket";
+         detail::append_labels( out, m.labels, "+Inf" );
+         out += ' ';
+         out += std::to_string( cumulative );
+         out += '\n';
+
+         out += m.name;
+         out += "_sum";
+         detail::append_labels( out, m.labels );
+         out += ' ';
+         out += detail::micros_to_seconds( m.hist->sum() );
+         out += '\n';
+
+         out += m.name;
+         out += "_count";
+         detail::append_labels( out, m.labels );
+         out += ' ';
+         out += std::to_string( cumulative );
+         out += '\n';
+      });
+
+      return out;
+   }
+
+} } // fc::metrics
@@ -86,4 +86,38 @@ BOOST_AUTO_TEST_CASE(zlib_test)
     BOOST_CHECK_EQUAL( decomp, line );
 }
 
+static uint32_t read_le32( const std::string& s, size_t pos )
+{
+    uint32_t v = 0;
+    for( int i = 3; i >= 0; --i )
+        v = ( v << 8 ) | uint8_t( s[pos + i] );
+    return v;
+}
+
+BOOST_AUTO_TEST_CASE(gzip_test)
+{
+    std::string input;
+    for( int i = 0; i < 500; ++i )
+        input += "{\"block_num\":" + std::to_string( i ) + ",\"witness\":\"initminer\"},";
+
+    for( const std::string& text : { std::string(), std::string( "x" ), input } )
+    {
+        std::string gz = fc::gzip_compress( text );
+        BOOST_REQUIRE( gz.size() >= 18 );
+        BOOST_CHECK_EQUAL( uint8_t( gz[0] ), 0x1f );
+        BOOST_CHECK_EQUAL( uint8_t( gz[1] ), 0x8b );
+        BOOST_CHECK_EQUAL( uint8_t( gz[2] ), 8 );
+
+        size_t decomp_len;
+        char* decomp = tinfl_decompress_mem_to_heap( gz.data() + 10, gz.size() - 18, &decomp_len, 0 );
+        BOOST_REQUIRE( decomp != nullptr || text.empty() );
+        BOOST_CHECK_EQUAL( std::string( decomp, decomp_len ), text );
+        free( decomp );
+
+        BOOST_CHECK_EQUAL( read_le32( gz, gz.size() - 4 ), text.size() );
+    }
+
+    BOOST_CHECK( fc::gzip_compress( input ).size() < input.size() / 4 );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,160 @@
+/**
+ *  Measures encrypted loopback throughput of the two stcp transports:
+ *  AES-256-CBC in 4 KiB chunks (the original p2p stream) and AES-256-GCM
+ *  in length-prefixed 64 KiB frames.  Sender and receiver each run on
+ *  their own fc::thread so the reported CPU time is roughly per core.
+ *
+ *  usage: aes_bench [megabytes=256]
+ */
+#include <fc/crypto/aes.hpp>
+#include <fc/crypto/city.hpp>
+#include <fc/network/ip.hpp>
+#include <fc/network/tcp_socket.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/time.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace {
+
+const uint32_t cbc_chunk_size = 4096;
+const uint32_t gcm_frame_size = 64 * 1024;
+
+struct bench_result
+{
+   double seconds     = 0;
+   double cpu_seconds = 0;
+};
+
+void send_cbc( fc::tcp_socket& sock, const fc::sha256& key, const fc::uint128& iv, uint64_t total )
+{
+   fc::aes_encoder enc;
+   enc.init( key, iv );
+   std::vector<char> plain( cbc_chunk_size, 'x' );
+   std::shared_ptr<char> cipher( new char[cbc_chunk_size], [](char* p){ delete[] p; } );
+   for( uint64_t sent = 0; sent < total; sent += cbc_chunk_size )
+   {
+      enc.encode( plain.data(), cbc_chunk_size, cipher.get() );
+      sock.write( cipher, cbc_chunk_size );
+   }
+   sock.flush();
+}
+
+void recv_cbc( fc::tcp_socket& sock, const fc::sha256& key, const fc::uint128& iv, uint64_t total )
+{
+   fc::aes_decoder dec;
+   dec.init( key, iv );
+   std::shared_ptr<char> cipher( new char[cbc_chunk_size], [](char* p){ delete[] p; } );
+   std::vector<char> plain( cbc_chunk_size );
+   for( uint64_t received = 0; received < total; received += cbc_chunk_size )
+   {
+      sock.read( cipher, cbc_chunk_size, 0 );
+      dec.decode( cipher.get(), cbc_chunk_size, plain.data() );
+   }
+}
+
+void send_gcm( fc::tcp_socket& sock, const fc::sha256& key, const fc::uint128& iv, uint64_t total )
+{
+   fc::aes_gcm_encoder enc;
+   enc.init( key, iv );
+   std::vector<char> plain( gcm_frame_size, 'x' );
+   const uint32_t frame_buffer_size = sizeof(uint32_t) + gcm_frame_size + fc::aes_gcm_encoder::tag_size;
+   std::shared_ptr<char> frame( new char[frame_buffer_size], [](char* p){ delete[] p; } );
+   for( uint64_t sent = 0; sent < total; sent += gcm_frame_size )
+   {
+      char* header = frame.get();
+      char* cipher = header + sizeof(uint32_t);
+      memcpy( header, (char*)&gcm_frame_size, sizeof(uint32_t) );
+      enc.encode( plain.data(), gcm_frame_size, cipher, cipher + gcm_frame_size, header, sizeof(uint32_t) );
+      sock.write( frame, frame_buffer_size );
+   }
+   sock.flush();
+}
+
+void recv_gcm( fc::tcp_socket& sock, const fc::sha256& key, const fc::uint128& iv, uint64_t total )
+{
+   fc::aes_gcm_decoder dec;
+   dec.init( key, iv );
+   const uint32_t frame_buffer_size = sizeof(uint32_t) + gcm_frame_size + fc::aes_gcm_decoder::tag_size;
+   std::shared_ptr<char> frame( new char[frame_buffer_size], [](char* p){ delete[] p; } );
+   std::vector<char> plain( gcm_frame_size );
+   for( uint64_t received = 0; received < total; received += gcm_frame_size )
+   {
+      sock.read( frame, frame_buffer_size, 0 );
+      const char* cipher = frame.get() + sizeof(uint32_t);
+      dec.decode( cipher, gcm_frame_size, cipher + gcm_frame_size, plain.data(), frame.get(), sizeof(uint32_t) );
+   }
+}
+
+typedef void (*transfer_function)( fc::tcp_socket&, const fc::sha256&, const fc::uint128&, uint64_t );
+
+bench_result run( transfer_function sender, transfer_function receiver, uint64_t total )
+{
+   auto secret = fc::sha512::hash( "aes_bench", 9 );
+   auto key = fc::sha256::hash( (char*)&secret, sizeof(secret) );
+   auto iv = fc::city_hash_crc_128( (char*)&secret, sizeof(secret) );
+
+   fc::thread server_thread( "aes_bench server" );
+   fc::thread client_thread( "aes_bench client" );
+
+   fc::tcp_server server;
+   server.listen( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), 0 ) );
+   uint16_t port = server.get_port();
+
+   bench_result result;
+   std::clock_t cpu_start = std::clock();
+   fc::time_point start = fc::time_point::now();
+
+   auto receiving = server_thread.async( [&]() {
+      fc::tcp_socket sock;
+      server.accept( sock );
+      receiver( sock, key, iv, total );
+      sock.close();
+   } );
+   auto sending = client_thread.async( [&]() {
+      fc::tcp_socket sock;
+      sock.connect_to( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), port ) );
+      sender( sock, key, iv, total );
+      sock.close();
+   } );
+   sending.wait();
+   receiving.wait();
+
+   result.seconds = double( ( fc::time_point::now() - start ).count() ) / 1000000.0;
+   result.cpu_seconds = double( std::clock() - cpu_start ) / CLOCKS_PER_SEC;
+   server.close();
+   return result;
+}
+
+void report( const char* name, const bench_result& r, uint64_t total )
+{
+   double mb = double( total ) / ( 1024 * 1024 );
+   std::cout << name << ": " << mb / r.seconds << " MiB/s wall, "
+             << mb / ( r.cpu_seconds / 2 ) << " MiB/s per core ("
+             << r.seconds << "s wall, " << r.cpu_seconds << "s cpu)" << std::endl;
+}
+
+} // anonymous namespace
+
+int main( int argc, char** argv )
+{
+   try
+   {
+      uint64_t megabytes = argc > 1 ? std::stoull( argv[1] ) : 256;
+      uint64_t total = megabytes * 1024 * 1024;
+
+      report( "aes-256-cbc 4KiB chunks", run( &send_cbc, &recv_cbc, total ), total );
+      report( "aes-256-gcm 64KiB frames", run( &send_gcm, &recv_gcm, total ), total );
+   }
+   catch( const fc::exception& e )
+   {
+      std::cerr << e.to_detail_string() << std::endl;
+      return 1;
+   }
+   return 0;
+}
@@ -67,4 +67,47 @@ BOOST_AUTO_TEST_CASE(aes_test)
 //    BOOST_CHECK( !memcmp( dcrypt.data(), data.data(), len) );
 }
 
+BOOST_AUTO_TEST_CASE(aes_gcm_test)
+{
+    auto secret = fc::sha512::hash( "hello", 5 );
+    auto key = fc::sha256::hash( (char*)&secret, sizeof(secret) );
+    auto iv = fc::city_hash_crc_128( (char*)&secret, sizeof(secret) );
+
+    fc::aes_gcm_encoder enc;
+    fc::aes_gcm_decoder dec;
+    enc.init( key, iv );
+    dec.init( key, iv );
+
+    const std::string header = "hdr";
+    std::vector<std::string> frames = { "first frame", std::string( 1000, 'a' ), "x" };
+    std::vector<std::vector<char>> ciphertexts;
+    for( const std::string& plain : frames )
+    {
+        std::vector<char> crypt( plain.size() );
+        char tag[fc::aes_gcm_encoder::tag_size];
+        BOOST_CHECK_EQUAL( enc.encode( plain.data(), plain.size(), crypt.data(), tag, header.data(), header.size() ), plain.size() );
+        BOOST_CHECK( memcmp( crypt.data(), plain.data(), plain.size() ) != 0 );
+
+        std::vector<char> dcrypt( plain.size() );
+        BOOST_CHECK_EQUAL( dec.decode( crypt.data(), crypt.size(), tag, dcrypt.data(), header.data(), header.size() ), plain.size() );
+        BOOST_CHECK( std::string( dcrypt.begin(), dcrypt.end() ) == plain );
+        ciphertexts.push_back( crypt );
+    }
+
+    // each frame gets its own nonce, so repeating a plaintext does not repeat the ciphertext
+    std::vector<char> again( frames[0].size() );
+    char again_tag[fc::aes_gcm_encoder::tag_size];
+    enc.encode( frames[0].data(), frames[0].size(), again.data(), again_tag );
+    BOOST_CHECK( again != ciphertexts[0] );
+    dec.decode( again.data(), again.size(), again_tag, again.data() );
+
+    // a modified frame must fail authentication
+    std::string plain = "tamper";
+    std::vector<char> crypt( plain.size() ), dcrypt( plain.size() );
+    char tag[fc::aes_gcm_encoder::tag_size];
+    enc.encode( plain.data(), plain.size(), crypt.data(), tag, header.data(), header.size() );
+    crypt[0] ^= 1;
+    BOOST_CHECK_THROW( dec.decode( crypt.data(), crypt.size(), tag, dcrypt.data(), header.data(), header.size() ), fc::aes_exception );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -1,6 +1,7 @@
 #include <boost/test/unit_test.hpp>
 
 #include <fc/crypto/digest.hpp>
+#include <fc/crypto/restartable_sha256.hpp>
 #include <fc/crypto/ripemd160.hpp>
 #include <fc/crypto/sha1.hpp>
 #include <fc/crypto/sha224.hpp>
@@ -157,6 +158,28 @@ BOOST_AUTO_TEST_CASE(sha256_test)
     BOOST_CHECK_EQUAL( "d61967f63c7dd183914a4ae452c9f6ad5d462ce3d277798075b107615c1a8a30", (std::string) fc::sha256::hash(fourth) );
 }
 
+BOOST_AUTO_TEST_CASE(restartable_sha256_test)
+{
+    init_5();
+    const size_t len = 100000;
+
+    // Pieces of every size up to a few chunks, so every offset in the buffered chunk is crossed
+    for( size_t step = 1; step < 200; step += 7 )
+    {
+        fc::restartable_sha256 s;
+        for( size_t pos = 0; pos < len; pos += step )
+            s.update( TEST5 + pos, std::min( step, len - pos ) );
+        BOOST_CHECK_EQUAL( (std::string) fc::sha256::hash( TEST5, len ), s.hexdigest() );
+    }
+
+    for( size_t n = 0; n < 200; n++ )
+    {
+        fc::restartable_sha256 s;
+        s.update( TEST5, n );
+        BOOST_CHECK_EQUAL( (std::string) fc::sha256::hash( TEST5, n ), s.hexdigest() );
+    }
+}
+
 BOOST_AUTO_TEST_CASE(sha512_test)
 {
     init_5();
@@ -0,0 +1,128 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/io/json_reader.hpp>
+#include <fc/reflect/variant.hpp>
+#include <fc/time.hpp>
+#include <fc/crypto/sha256.hpp>
+
+namespace json_reader_test {
+
+enum shade { light, dark };
+
+struct inner
+{
+   std::string                   label;
+   fc::optional< int32_t >       weight;
+   shade                         tone = light;
+};
+
+struct outer
+{
+   uint32_t                      num = 0;
+   int64_t                       neg = 0;
+   uint64_t                      big = 0;
+   bool                          flag = false;
+   double                        ratio = 0;
+   std::string                   text;
+   fc::time_point_sec            when;
+   fc::sha256                    digest;
+   fc::optional< inner >         maybe;
+   std::vector< inner >          items;
+   std::vector< std::string >    words;
+   fc::variant                   any;
+};
+
+} // json_reader_test
+
+FC_REFLECT_ENUM( json_reader_test::shade, (light)(dark) )
+FC_REFLECT( json_reader_test::inner, (label)(weight)(tone) )
+FC_REFLECT( json_reader_test::outer, (num)(neg)(big)(flag)(ratio)(text)(when)(digest)(maybe)(items)(words)(any) )
+
+using namespace json_reader_test;
+
+/** decodes with json_reader and through a variant, and compares the results */
+template< typename T >
+static void check_same( const std::string& json )
+{
+   T streamed;
+   fc::json_reader::decode( fc::json_span( json ), streamed );
+   T expected = fc::json::from_string( json ).as< T >();
+   BOOST_CHECK_EQUAL( fc::json::to_string( fc::variant( streamed ) ), fc::json::to_string( fc::variant( expected ) ) );
+}
+
+BOOST_AUTO_TEST_SUITE(json_reader_tests)
+
+BOOST_AUTO_TEST_CASE(reflected)
+{
+   static_assert( fc::has_reflected_from_variant< outer >::value, "outer uses the reflected from_variant" );
+   static_assert( !fc::has_reflected_from_variant< fc::sha256 >::value, "sha256 has its own from_variant" );
+
+   check_same< outer >( "{}" );
+   check_same< outer >( " { \"num\" : 7 , \"neg\":-12, \"big\":18446744073709551615, \"flag\":true, \"ratio\":0.5 } " );
+   check_same< outer >( "{\"num\":\"42\",\"big\":\"123456789012\",\"flag\":\"true\",\"unknown\":{\"deep\":[1,2,{\"x\":null}]}}" );
+   check_same< outer >( "{\"text\":\"tab\\tquote\\\" back\\\\slash\",\"when\":\"2018-01-02T03:04:05\"}" );
+   check_same< outer >( "{\"digest\":\"" + std::string( fc::sha256::hash( std::string( "json_reader" ) ) ) + "\"}" );
+   check_same< outer >( "{\"maybe\":null,\"items\":[],\"words\":[\"a\",\"b\"]}" );
+   check_same< outer >( "{\"maybe\":{\"label\":\"m\",\"weight\":-3,\"tone\":\"dark\"},\"items\":[{\"label\":\"i\",\"tone\":1},{}]}" );
+   check_same< outer >( "{\"any\":{\"k\":[1,\"two\",null,true]},\"num\":1,\"num\":2}" );
+}
+
+BOOST_AUTO_TEST_CASE(strings)
+{
+   std::string s;
+   fc::json_reader::decode( fc::json_span( std::string( "\"\\u00e9\\ud83d\\ude00\\/\\b\\f\"" ) ), s );
+   BOOST_CHECK_EQUAL( s, "\xc3\xa9\xf0\x9f\x98\x80/\b\f" );
+}
+
+BOOST_AUTO_TEST_CASE(escapes)
+{
+   // json_rpc falls back to the legacy parser, both have to read the same text
+   const std::vector< std::string > escapes = {
+      "\\\"", "\\\\", "\\/", "\\b", "\\f", "\\n", "\\r", "\\t",
+      "\\u0000", "\\u0041", "\\u00e9", "\\u20AC", "\\uffff", "\\ud83d\\ude00",
+      "\\ud83d", "\\ude00", "\\ud83d\\n", "\\ud83d\\u0041", "\\ud83d\\ud83d\\ude00"
+   };
+   std::string all;
+   for( const auto& e : escapes )
+      all += e;
+
+   auto check = [&]( const std::string& content )
+   {
+      std::string json = "\"a" + content + "z\"";
+      std::string streamed;
+      fc::json_reader::decode( fc::json_span( json ), streamed );
+      BOOST_CHECK_EQUAL( fc::json::from_string( json, fc::json::legacy_parser ).as_string(), streamed );
+      BOOST_CHECK_EQUAL( fc::json::from_string( json, fc::json::strict_parser ).as_string(), streamed );
+      BOOST_CHECK_EQUAL( fc::json::from_string( json, fc::json::relaxed_parser ).as_string(), streamed );
+   };
+   for( const auto& e : escapes )
+      check( e );
+   check( all );
+}
+
+BOOST_AUTO_TEST_CASE(spans)
+{
+   std::string json = "{\"a\":[1,{\"b\":\"]}\"}],\"c\":2}";
+   fc::json_reader r( ( fc::json_span( json ) ) );
+   std::string key;
+   r.begin_object();
+   BOOST_REQUIRE( r.next_member( key, true ) );
+   BOOST_CHECK_EQUAL( key, "a" );
+   BOOST_CHECK_EQUAL( r.skip_value().str(), "[1,{\"b\":\"]}\"}]" );
+   BOOST_REQUIRE( r.next_member( key, false ) );
+   BOOST_CHECK_EQUAL( r.read_variant().as_uint64(), 2u );
+   BOOST_CHECK( !r.next_member( key, false ) );
+   r.expect_end();
+}
+
+BOOST_AUTO_TEST_CASE(errors)
+{
+   outer o;
+   BOOST_CHECK_THROW( fc::json_reader::decode( fc::json_span( std::string( "[1,2]" ) ), o ), fc::bad_cast_exception );
+   BOOST_CHECK_THROW( fc::json_reader::decode( fc::json_span( std::string( "{\"num\":1 \"neg\":2}" ) ), o ), fc::parse_error_exception );
+   BOOST_CHECK_THROW( fc::json_reader::decode( fc::json_span( std::string( "{\"num\":1}x" ) ), o ), fc::parse_error_exception );
+   BOOST_CHECK_THROW( fc::json_reader::decode( fc::json_span( std::string( "{\"text\":\"open" ) ), o ), fc::parse_error_exception );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
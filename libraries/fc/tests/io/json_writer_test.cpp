@@ -0,0 +1,117 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/io/json_writer.hpp>
+#include <fc/reflect/variant.hpp>
+#include <fc/time.hpp>
+#include <fc/crypto/sha256.hpp>
+#include <fc/static_variant.hpp>
+
+#include <limits>
+
+namespace json_writer_test {
+
+enum color { red, green, blue };
+
+struct leaf
+{
+   std::string                   name;
+   fc::optional< uint32_t >      count;
+   color                         hue = green;
+   fc::time_point_sec            when;
+   fc::sha256                    digest;
+   std::vector< char >           blob;
+};
+
+struct tree
+{
+   int64_t                       small = -7;
+   int64_t                       large = 0;
+   uint64_t                      ularge = 0;
+   int16_t                       shrt = 0;
+   bool                          flag = false;
+   double                        ratio = 0.25;
+   fc::optional< leaf >          single;
+   std::vector< leaf >           leaves;
+   std::set< std::string >       tags;
+   fc::variant                   extra;
+};
+
+} // json_writer_test
+
+FC_REFLECT_ENUM( json_writer_test::color, (red)(green)(blue) )
+FC_REFLECT( json_writer_test::leaf, (name)(count)(hue)(when)(digest)(blob) )
+FC_REFLECT( json_writer_test::tree, (small)(large)(ularge)(shrt)(flag)(ratio)(single)(leaves)(tags)(extra) )
+
+using namespace json_writer_test;
+
+template< typename T >
+static void check_same( const T& v )
+{
+   BOOST_CHECK_EQUAL( fc::json_writer::to_string( v ), fc::json::to_string( fc::variant( v ) ) );
+   BOOST_CHECK_EQUAL( fc::json_writer::to_string( v, fc::json::legacy_generator ),
+                      fc::json::to_string( fc::variant( v ), fc::json::legacy_generator ) );
+}
+
+BOOST_AUTO_TEST_SUITE(json_writer_tests)
+
+BOOST_AUTO_TEST_CASE(scalars)
+{
+   static_assert( fc::has_reflected_to_variant< tree >::value, "tree uses the reflected to_variant" );
+   static_assert( !fc::has_reflected_to_variant< fc::sha256 >::value, "sha256 has its own to_variant" );
+
+   check_same( true );
+   check_same( int64_t( 0 ) );
+   check_same( int64_t( 0xffffffff ) );
+   check_same( int64_t( 0x100000000ll ) );
+   check_same( int64_t( -0x100000000ll ) );
+   check_same( std::numeric_limits< int64_t >::min() );
+   check_same( std::numeric_limits< uint64_t >::max() );
+   check_same( uint8_t( 200 ) );
+   check_same( 1.5 );
+   check_same( std::string( "plain" ) );
+   check_same( std::string( "quote\" back\\slash \b\f\n\r\t \x01\x1f \x7f \xc3\xa9" ) );
+   check_same( std::string( "nul\0byte", 8 ) );
+   check_same( fc::optional< std::string >() );
+   check_same( blue );
+}
+
+BOOST_AUTO_TEST_CASE(nested)
+{
+   tree t;
+   t.large = 0x123456789ll;
+   t.ularge = 0xfedcba9876543210ull;
+   t.shrt = -300;
+   t.flag = true;
+   t.tags = { "b", "a", "needs \"escaping\"" };
+   t.extra = fc::mutable_variant_object( "k", 5 )( "l", fc::variants{ 1, "two", fc::variant() } );
+   check_same( t );
+
+   leaf l;
+   l.name = "first\n";
+   l.when = fc::time_point_sec( 1500000000 );
+   l.digest = fc::sha256::hash( std::string( "json_writer" ) );
+   l.blob = { 'a', '\0', char( 0xff ) };
+   t.leaves.push_back( l );
+   l.count = 3;
+   l.hue = red;
+   t.leaves.push_back( l );
+   t.single = l;
+   check_same( t );
+   check_same( t.leaves );
+   check_same( fc::optional< tree >( t ) );
+
+   typedef fc::static_variant< int64_t, std::string, leaf > choice;
+   std::vector< choice > choices{ choice( int64_t( 1 ) ), choice( std::string( "two" ) ), choice( l ) };
+   check_same( choices );
+}
+
+BOOST_AUTO_TEST_CASE(append)
+{
+   std::string out = "prefix:";
+   fc::json_writer w( out );
+   w.write( std::vector< uint32_t >{ 1, 2, 3 } );
+   BOOST_CHECK_EQUAL( out, "prefix:[1,2,3]" );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
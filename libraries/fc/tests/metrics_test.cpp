@@ -0,0 +1,109 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fc/metrics.hpp>
+#include <fc/exception/exception.hpp>
+
+#include <thread>
+#include <vector>
+
+using namespace fc::metrics;
+
+BOOST_AUTO_TEST_SUITE(fc_metrics)
+
+BOOST_AUTO_TEST_CASE(counter_sums_threads)
+{
+   counter c;
+   std::vector< std::thread > threads;
+   for( int t = 0; t < 8; ++t )
+      threads.emplace_back( [&c]() { for( int i = 0; i < 100000; ++i ) c.add(); } );
+   for( auto& t : threads )
+      t.join();
+
+   BOOST_CHECK_EQUAL( c.value(), 800000u );
+}
+
+BOOST_AUTO_TEST_CASE(histogram_buckets)
+{
+   // Every value falls in a bucket whose range holds it, ranges are contiguous
+   for( uint64_t v = 0; v < ( 1 << 20 ); v += ( v >> 6 ) + 1 )
+   {
+      uint32_t i = histogram::bucket_index( v );
+      BOOST_REQUIRE_LE( histogram::bucket_lowest( i ), v );
+      BOOST_REQUIRE_GT( histogram::bucket_lowest( i + 1 ), v );
+   }
+   for( uint32_t i = 0; i < histogram::bucket_count; ++i )
+      BOOST_REQUIRE_EQUAL( histogram::bucket_index( histogram::bucket_lowest( i ) ), i );
+
+   BOOST_CHECK_EQUAL( histogram::bucket_index( uint64_t( -1 ) ), histogram::bucket_count - 1 );
+
+   histogram h;
+   BOOST_CHECK_EQUAL( h.percentile( 0.5 ), 0u );
+   for( uint64_t v = 1; v <= 1000; ++v )
+      h.record( v );
+
+   BOOST_CHECK_EQUAL( h.count(), 1000u );
+   BOOST_CHECK_EQUAL( h.sum(), 500500u );
+   // Within the relative width of a bucket
+   BOOST_CHECK_GE( h.percentile( 0.5 ), 500u );
+   BOOST_CHECK_LE( h.percentile( 0.5 ), 500u + 500u / histogram::sub_buckets );
+   BOOST_CHECK_GE( h.percentile( 0.99 ), 990u );
+   BOOST_CHECK_LE( h.percentile( 0.99 ), 990u + 990u / histogram::sub_buckets );
+   BOOST_CHECK_GE( h.percentile( 1 ), 1000u );
+}
+
+BOOST_AUTO_TEST_CASE(registry_lookup)
+{
+   registry r;
+   auto& a = r.get_counter( "test_requests_total", "Requests", { { "method", "a" } } );
+   auto& b = r.get_counter( "test_requests_total", "Requests", { { "method", "b" } } );
+   BOOST_CHECK( &a == &r.get_counter( "test_requests_total", "Requests", { { "method", "a" } } ) );
+   BOOST_CHECK( &a != &b );
+
+   BOOST_CHECK_THROW( r.get_gauge( "test_requests_total", "Requests" ), fc::assert_exception );
+   BOOST_CHECK_THROW( r.get_counter( "test requests", "Requests" ), fc::assert_exception );
+}
+
+BOOST_AUTO_TEST_CASE(prometheus_format)
+{
+   registry r;
+   r.get_counter( "test_calls_total", "Calls", { { "api", "x\"y" } } ).add( 3 );
+   r.get_gauge( "test_depth", "Queue depth" ).set( -2 );
+   r.add_callback( "test_ratio", "Ratio", metric_type::gauge, []() { return 0.25; } );
+
+   auto& h = r.get_histogram( "test_latency_seconds", "Latency" );
+   h.record( 3 );
+   h.record( 1500000 );
+
+   std::string text = r.render_prometheus();
+   BOOST_CHECK( text.find( "# TYPE test_calls_total counter\ntest_calls_total{api=\"x\\\"y\"} 3\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "test_depth -2\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "test_ratio 0.25" ) != std::string::npos );
+   BOOST_CHECK( text.find( "# TYPE test_latency_seconds histogram\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "test_latency_seconds_bucket{le=\"0.000002\"} 0\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "test_latency_seconds_bucket{le=\"0.000004\"} 1\n" ) != std::string::npos );
+   // 2^20 and 2^21 plus the width of their buckets
+   BOOST_CHECK( text.find( "test_latency_seconds_bucket{le=\"1.114111\"} 1\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "test_latency_seconds_bucket{le=\"2.228223\"} 2\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "test_latency_seconds_bucket{le=\"+Inf\"} 2\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "test_latency_seconds_sum 1.500003\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "test_latency_seconds_count 2\n" ) != std::string::npos );
+}
+
+BOOST_AUTO_TEST_CASE(prometheus_bucket_bounds)
+{
+   registry r;
+   auto& h = r.get_histogram( "test_bounds_seconds", "Bounds" );
+   h.record( 4 );
+   h.record( 32 );
+   h.record( 34 );
+
+   // Boundaries are inclusive
+   std::string text = r.render_prometheus();
+   BOOST_CHECK( text.find( "test_bounds_seconds_bucket{le=\"0.000002\"} 0\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "test_bounds_seconds_bucket{le=\"0.000004\"} 1\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "test_bounds_seconds_bucket{le=\"0.000016\"} 1\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "test_bounds_seconds_bucket{le=\"0.000033\"} 2\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "test_bounds_seconds_bucket{le=\"0.000067\"} 3\n" ) != std::string::npos );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -23,7 +23,7 @@
  */
 #pragma once
 
-#define GRAPHENE_NET_PROTOCOL_VERSION                        106
+#define GRAPHENE_NET_PROTOCOL_VERSION                        107
 
 /**
  * Define this to enable debugging code in the p2p network interface.
@@ -37,6 +37,13 @@
  * 2MiB
  */
 #define MAX_MESSAGE_SIZE                                     1024*1024*2
+
+/**
+ * Largest plaintext frame sealed at once by the AES-GCM stcp transport.
+ * Bigger messages are split across several frames, each carrying its own
+ * 4-byte length header and 16-byte authentication tag.
+ */
+#define GRAPHENE_NET_STCP_MAX_FRAME_SIZE                     (64 * 1024)
 #define GRAPHENE_NET_DEFAULT_PEER_CONNECTION_RETRY_TIME      30 // seconds
 
 /**
@@ -57,6 +64,16 @@
 
 #define GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES        (1024 * 1024)
 
+/**
+ * Relative share of the link each class of outgoing traffic gets when several
+ * classes are waiting to be sent to the same peer (see peer_connection's send
+ * scheduler).  Control messages are not weighted, they always go first.
+ */
+#define GRAPHENE_NET_SEND_WEIGHT_BLOCK                       64
+#define GRAPHENE_NET_SEND_WEIGHT_BLOCK_INVENTORY             32
+#define GRAPHENE_NET_SEND_WEIGHT_SYNC                        4
+#define GRAPHENE_NET_SEND_WEIGHT_TRANSACTION                 1
+
 /**
  * When we receive a message from the network, we advertise it to
  * our peers and save a copy in a cache were we will find it if
@@ -104,6 +121,34 @@
 
 #define GRAPHENE_NET_MAX_TRX_PER_SECOND                      1000
 
+/**
+ * Peers at or above this protocol version understand trx_batch_message, so we
+ * can ask them for many transactions in one fetch_items_message and they
+ * will answer with batches instead of one trx_message per transaction.
+ */
+#define GRAPHENE_NET_TRX_BATCH_PROTOCOL_VERSION              107
+
+/**
+ * Default upper bound on the number of transactions requested from one peer
+ * in one fetch_items_message, and on the number of transactions advertised
+ * before the inventory is flushed without waiting for the batch delay.
+ */
+#define GRAPHENE_NET_MAX_TRX_PER_BATCH                       200
+
+/**
+ * A trx_batch_message is closed once its packed transactions reach this size,
+ * leaving plenty of headroom below MAX_MESSAGE_SIZE.
+ */
+#define GRAPHENE_NET_MAX_TRX_BATCH_SIZE_IN_BYTES             (256 * 1024)
+
+/**
+ * When transaction inventory is being advertised more often than this, the
+ * advertise loop holds new transactions back for up to this long so they go out
+ * in fewer, larger messages.  Under light load nothing is delayed.  Blocks are
+ * never held back.
+ */
+#define GRAPHENE_NET_TRX_BATCH_DELAY_MICROSECONDS            20000
+
 #define GRAPHENE_NET_MAX_NUMBER_OF_BLOCKS_TO_HANDLE_AT_ONE_TIME 200
 #define GRAPHENE_NET_MAX_NUMBER_OF_BLOCKS_TO_PREFETCH           (10 * GRAPHENE_NET_MAX_NUMBER_OF_BLOCKS_TO_HANDLE_AT_ONE_TIME)
 
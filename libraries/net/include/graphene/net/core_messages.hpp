@@ -86,6 +86,7 @@ namespace graphene { namespace net {
     check_firewall_reply_message_type            = 5015,
     get_current_connections_request_message_type = 5016,
     get_current_connections_reply_message_type   = 5017,
+    trx_batch_message_type                       = 5018,
     core_message_type_last                       = 5099
   };
 
@@ -115,6 +116,23 @@ namespace graphene { namespace net {
 
    };
 
+  /**
+   * Replies to a fetch_items_message for transactions with many transactions in one
+   * message.  Only sent to peers at GRAPHENE_NET_TRX_BATCH_PROTOCOL_VERSION or above;
+   * each transaction is handled exactly as if it had arrived in its own trx_message.
+   */
+  struct trx_batch_message
+  {
+    static const core_message_type_enum type;
+
+    std::vector<signed_transaction> transactions;
+
+    trx_batch_message() {}
+    trx_batch_message(std::vector<signed_transaction> transactions) :
+      transactions(std::move(transactions))
+    {}
+  };
+
   struct item_ids_inventory_message
   {
     static const core_message_type_enum type;
@@ -421,10 +439,12 @@ FC_REFLECT_ENUM( graphene::net::core_message_type_enum,
                  (check_firewall_reply_message_type)
                  (get_current_connections_request_message_type)
                  (get_current_connections_reply_message_type)
+                 (trx_batch_message_type)
                  (core_message_type_last) )
 
 FC_REFLECT( graphene::net::trx_message, (trx) )
 FC_REFLECT( graphene::net::block_message, (block)(block_id) )
+FC_REFLECT( graphene::net::trx_batch_message, (transactions) )
 
 FC_REFLECT( graphene::net::item_id, (item_type)
                                (item_hash) )
@@ -24,6 +24,7 @@
 #pragma once
 #include <fc/network/tcp_socket.hpp>
 #include <graphene/net/message.hpp>
+#include <graphene/net/stcp_socket.hpp>
 
 namespace graphene { namespace net {
 
@@ -46,6 +47,7 @@ namespace graphene { namespace net {
        message_oriented_connection(message_oriented_connection_delegate* delegate = nullptr);
        ~message_oriented_connection();
        fc::tcp_socket& get_socket();
+       void set_transport_mode(stcp_transport_mode mode);
 
        void accept();
        void bind(const fc::ip::endpoint& local_endpoint);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <graphene/net/config.hpp>
+#include <graphene/net/stcp_socket.hpp>
 
 #include <fc/crypto/elliptic.hpp>
 #include <fc/network/ip.hpp>
@@ -38,6 +39,14 @@ struct node_configuration
    uint32_t maximum_number_of_sync_blocks_to_prefetch = GRAPHENE_NET_MAX_NUMBER_OF_BLOCKS_TO_PREFETCH;
    uint32_t maximum_blocks_per_peer_during_syncing = GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING;
    int64_t active_ignored_request_timeout_microseconds = 6000000;
+
+   /** most transactions requested from a batch-capable peer in one fetch */
+   uint32_t maximum_transactions_per_batch = GRAPHENE_NET_MAX_TRX_PER_BATCH;
+   /** how long transaction inventory may be held back to build larger batches, 0 disables it */
+   int64_t transaction_batch_delay_microseconds = GRAPHENE_NET_TRX_BATCH_DELAY_MICROSECONDS;
+
+   /** every peer must use the same transport; only switch to gcm on networks where all nodes are configured for it */
+   stcp_transport_mode transport_mode = stcp_cbc_transport;
 };
 
 } }
@@ -56,4 +65,7 @@ FC_REFLECT(graphene::net::node_configuration,
    (maximum_number_of_sync_blocks_to_prefetch)
    (maximum_blocks_per_peer_during_syncing)
    (active_ignored_request_timeout_microseconds)
+   (maximum_transactions_per_batch)
+   (transaction_batch_delay_microseconds)
+   (transport_mode)
 )
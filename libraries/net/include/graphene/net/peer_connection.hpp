@@ -40,6 +40,7 @@
 #include <boost/multi_index/sequenced_index.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 
+#include <array>
 #include <queue>
 #include <boost/container/deque.hpp>
 #include <fc/thread/future.hpp>
@@ -105,6 +106,16 @@ namespace graphene { namespace net
         closing,
         closed
       };
+      /** classes of outgoing traffic, each with its own send queue */
+      enum class message_send_class
+      {
+        control,         // handshaking, addresses, timing, firewall checks and item requests
+        block,           // blocks sent during normal operation
+        block_inventory, // advertisements of new blocks
+        sync,            // block ids and blocks sent to a peer that is syncing from us
+        transaction,     // transactions and transaction advertisements
+        number_of_classes
+      };
     private:
       peer_connection_delegate*      _node;
       fc::optional<fc::ip::endpoint> _remote_endpoint;
@@ -118,6 +129,7 @@ namespace graphene { namespace net
         fc::time_point enqueue_time;
         fc::time_point transmission_start_time;
         fc::time_point transmission_finish_time;
+        message_send_class send_class = message_send_class::control;
 
         queued_message(fc::time_point enqueue_time = fc::time_point::now()) :
           enqueue_time(enqueue_time)
@@ -166,8 +178,20 @@ namespace graphene { namespace net
       };
 
 
+      /* Outgoing messages are scheduled with start-time fair queuing: control messages
+       * always go first, the other classes share the link in proportion to their
+       * GRAPHENE_NET_SEND_WEIGHT_* so a new block never waits behind a backlog of
+       * transactions or sync data.  Order is preserved within a class.
+       */
+      struct send_queue
+      {
+        std::queue<std::unique_ptr<queued_message>, std::list<std::unique_ptr<queued_message> > > messages;
+        uint64_t virtual_start_time = 0; // weighted bytes already sent from this queue, see select_send_queue()
+      };
+
       size_t _total_queued_messages_size = 0;
-      std::queue<std::unique_ptr<queued_message>, std::list<std::unique_ptr<queued_message> > > _queued_messages;
+      std::array<send_queue, (size_t)message_send_class::number_of_classes> _send_queues;
+      uint64_t _send_queues_virtual_time = 0;
       fc::future<void> _send_queued_messages_done;
     public:
       fc::time_point connection_initiation_time;
@@ -284,6 +308,7 @@ namespace graphene { namespace net
       virtual ~peer_connection();
 
       fc::tcp_socket& get_socket();
+      void set_transport_mode(stcp_transport_mode mode);
       void accept_connection();
       void connect_to(const fc::ip::endpoint& remote_endpoint, fc::optional<fc::ip::endpoint> local_endpoint = fc::optional<fc::ip::endpoint>());
 
@@ -318,6 +343,9 @@ namespace graphene { namespace net
       bool performing_firewall_check() const;
       fc::optional<fc::ip::endpoint> get_endpoint_for_connecting() const;
     private:
+      message_send_class get_message_send_class(const message& message_to_send) const;
+      message_send_class get_item_send_class(const item_id& item_to_send) const;
+      send_queue* select_send_queue();
       void send_queued_messages_task();
       void accept_connection_task();
       void connect_to_task(const fc::ip::endpoint& remote_endpoint);
@@ -25,9 +25,20 @@
 #include <fc/network/tcp_socket.hpp>
 #include <fc/crypto/aes.hpp>
 #include <fc/crypto/elliptic.hpp>
+#include <fc/reflect/reflect.hpp>
 
 namespace graphene { namespace net {
 
+/**
+ *  Wire format used after the key exchange.  Both ends of a connection must
+ *  be configured with the same mode; there is no in-band negotiation.
+ */
+enum stcp_transport_mode
+{
+  stcp_cbc_transport = 0, ///< AES-256-CBC stream encrypted in 16-byte multiples (original protocol)
+  stcp_gcm_transport = 1  ///< length-prefixed AES-256-GCM frames of up to GRAPHENE_NET_STCP_MAX_FRAME_SIZE bytes
+};
+
 /**
  *  Uses ECDH to negotiate a aes key for communicating
  *  with other nodes on the network.
@@ -40,6 +51,10 @@ class stcp_socket : public virtual fc::iostream
     fc::tcp_socket&  get_socket() { return _sock; }
     void             accept();
 
+    /** must be called before accept() or connect_to() */
+    void                set_transport_mode( stcp_transport_mode mode ) { _transport_mode = mode; }
+    stcp_transport_mode get_transport_mode() const { return _transport_mode; }
+
     void             connect_to( const fc::ip::endpoint& remote_endpoint );
     void             bind( const fc::ip::endpoint& local_endpoint );
 
@@ -57,7 +72,10 @@ class stcp_socket : public virtual fc::iostream
     void             get( char& c ) { read( &c, 1 ); }
     fc::sha512       get_shared_secret() const { return _shared_secret; }
   private:
-    void do_key_exchange();
+    void do_key_exchange( bool initiator );
+
+    size_t gcm_readsome( char* buffer, size_t len );
+    size_t gcm_writesome( const char* buffer, size_t len );
 
     fc::sha512           _shared_secret;
     fc::ecc::private_key _priv_key;
@@ -66,8 +84,15 @@ class stcp_socket : public virtual fc::iostream
     fc::tcp_socket       _sock;
     fc::aes_encoder      _send_aes;
     fc::aes_decoder      _recv_aes;
+    stcp_transport_mode  _transport_mode = stcp_cbc_transport;
+    fc::aes_gcm_encoder  _send_gcm;
+    fc::aes_gcm_decoder  _recv_gcm;
     std::shared_ptr<char> _read_buffer;
     std::shared_ptr<char> _write_buffer;
+    /** decrypted bytes of the last gcm frame not yet returned by readsome() */
+    std::shared_ptr<char> _read_plaintext;
+    size_t               _read_plaintext_pos = 0;
+    size_t               _read_plaintext_len = 0;
 #ifndef NDEBUG
     bool _read_buffer_in_use;
     bool _write_buffer_in_use;
@@ -77,3 +102,5 @@ class stcp_socket : public virtual fc::iostream
 typedef std::shared_ptr<stcp_socket> stcp_socket_ptr;
 
 } } // graphene::net
+
+FC_REFLECT_ENUM( graphene::net::stcp_transport_mode, (stcp_cbc_transport)(stcp_gcm_transport) )
@@ -71,6 +71,7 @@ namespace graphene { namespace net {
       void start_read_loop();
     public:
       fc::tcp_socket& get_socket();
+      void set_transport_mode(stcp_transport_mode mode);
       void accept();
       void connect_to(const fc::ip::endpoint& remote_endpoint);
       void bind(const fc::ip::endpoint& local_endpoint);
@@ -116,6 +117,13 @@ namespace graphene { namespace net {
       return _sock.get_socket();
     }
 
+    void message_oriented_connection_impl::set_transport_mode(stcp_transport_mode mode)
+    {
+      VERIFY_CORRECT_THREAD();
+      assert(!_read_loop_done.valid()); // the mode can't change once the key exchange is done
+      _sock.set_transport_mode(mode);
+    }
+
     void message_oriented_connection_impl::accept()
     {
       VERIFY_CORRECT_THREAD();
@@ -356,6 +364,11 @@ namespace graphene { namespace net {
     return my->get_socket();
   }
 
+  void message_oriented_connection::set_transport_mode(stcp_transport_mode mode)
+  {
+    my->set_transport_mode(mode);
+  }
+
   void message_oriented_connection::accept()
   {
     my->accept();
@@ -84,6 +84,7 @@
 #include <amalgam/plugins/statsd/utility.hpp>
 
 #include <fc/git_revision.hpp>
+#include <fc/metrics.hpp>
 
 //#define ENABLE_DEBUG_ULOGS
 
@@ -447,8 +448,10 @@ namespace graphene { namespace net {
       /// used by the task that advertises inventory during normal operation
       // @{
       fc::promise<void>::ptr        _retrigger_advertise_inventory_loop_promise;
+      fc::promise<void>::ptr        _transaction_inventory_batch_ready_promise; /// set while the loop holds back transactions to batch them
       fc::future<void>              _advertise_inventory_loop_done;
       std::unordered_set<item_id>   _new_inventory; /// list of items we have received but not yet advertised to our peers
+      fc::time_point                _last_transaction_inventory_advertised_time;
       // @}
 
       fc::future<void>     _terminate_inactive_connections_loop_done;
@@ -558,6 +561,9 @@ namespace graphene { namespace net {
 
       void advertise_inventory_loop();
       void trigger_advertise_inventory_loop();
+      bool is_transaction_inventory_batch_pending() const;
+      void wait_for_transaction_inventory_batch();
+      uint32_t get_max_items_to_fetch_from_peer(const peer_connection_ptr& peer, const item_id& item) const;
 
       void terminate_inactive_connections_loop();
 
@@ -608,6 +614,9 @@ namespace graphene { namespace net {
       void on_fetch_items_message( peer_connection* originating_peer,
                                    const fetch_items_message& fetch_items_message_received );
 
+      void on_trx_batch_message( peer_connection* originating_peer,
+                                 const trx_batch_message& trx_batch_message_received );
+
       void on_item_not_available_message( peer_connection* originating_peer,
                                           const item_not_available_message& item_not_available_message_received );
 
@@ -1176,7 +1185,7 @@ namespace graphene { namespace net {
             {
               const peer_connection_ptr& peer = peer_iter->peer;
               // if they have the item and we haven't already decided to ask them for too many other items
-              if (peer_iter->item_ids.size() < GRAPHENE_NET_MAX_ITEMS_PER_PEER_DURING_NORMAL_OPERATION &&
+              if (peer_iter->item_ids.size() < get_max_items_to_fetch_from_peer(peer, item_iter->item) &&
                   peer->inventory_peer_advertised_to_us.find(item_iter->item) != peer->inventory_peer_advertised_to_us.end())
               {
                 if (item_iter->item.item_type == graphene::net::trx_message_type && peer->is_transaction_fetching_inhibited())
@@ -1257,10 +1266,54 @@ namespace graphene { namespace net {
         _retrigger_fetch_item_loop_promise->set_value();
     }
 
+    uint32_t node_impl::get_max_items_to_fetch_from_peer(const peer_connection_ptr& peer, const item_id& item) const
+    {
+      if (item.item_type == graphene::net::trx_message_type &&
+          peer->core_protocol_version >= GRAPHENE_NET_TRX_BATCH_PROTOCOL_VERSION)
+        return std::max<uint32_t>(_node_configuration.maximum_transactions_per_batch, GRAPHENE_NET_MAX_ITEMS_PER_PEER_DURING_NORMAL_OPERATION);
+      return GRAPHENE_NET_MAX_ITEMS_PER_PEER_DURING_NORMAL_OPERATION;
+    }
+
+    bool node_impl::is_transaction_inventory_batch_pending() const
+    {
+      if (_new_inventory.size() >= _node_configuration.maximum_transactions_per_batch)
+        return false;
+      for (const item_id& item : _new_inventory)
+        if (item.item_type != graphene::net::trx_message_type)
+          return false;
+      return true;
+    }
+
+    void node_impl::wait_for_transaction_inventory_batch()
+    {
+      // Only hold transactions back while they are arriving faster than one advertisement per
+      // batch delay, so a lone transaction on a quiet network goes out immediately.  The wait is
+      // cut short as soon as a block shows up or the batch is full (see trigger_advertise_inventory_loop).
+      fc::microseconds batch_delay(_node_configuration.transaction_batch_delay_microseconds);
+      if (batch_delay <= fc::microseconds(0) || !is_transaction_inventory_batch_pending())
+        return;
+      fc::time_point batch_deadline = _last_transaction_inventory_advertised_time + batch_delay;
+      fc::time_point now = fc::time_point::now();
+      if (batch_deadline <= now)
+        return;
+
+      _transaction_inventory_batch_ready_promise = fc::promise<void>::ptr(new fc::promise<void>("graphene::net::transaction_inventory_batch_ready"));
+      try
+      {
+        _transaction_inventory_batch_ready_promise->wait(batch_deadline - now);
+      }
+      catch (const fc::timeout_exception&)
+      {
+      }
+      _transaction_inventory_batch_ready_promise.reset();
+    }
+
     void node_impl::advertise_inventory_loop()
     {
       while (!_advertise_inventory_loop_done.canceled())
       {
+        wait_for_transaction_inventory_batch();
+
         dlog("beginning an iteration of advertise inventory");
         // swap inventory into local variable, clearing the node's copy
         std::unordered_set<item_id> inventory_to_advertise;
@@ -1311,6 +1364,13 @@ namespace graphene { namespace net {
           peer->clear_old_inventory();
         }
 
+        for (const item_id& advertised_item : inventory_to_advertise)
+          if (advertised_item.item_type == trx_message_type)
+          {
+            _last_transaction_inventory_advertised_time = fc::time_point::now();
+            break;
+          }
+
         for (auto iter = inventory_messages_to_send.begin(); iter != inventory_messages_to_send.end(); ++iter)
           iter->first->send_message(iter->second);
         inventory_messages_to_send.clear();
@@ -1329,6 +1389,8 @@ namespace graphene { namespace net {
       VERIFY_CORRECT_THREAD();
       if( _retrigger_advertise_inventory_loop_promise )
         _retrigger_advertise_inventory_loop_promise->set_value();
+      if( _transaction_inventory_batch_ready_promise && !is_transaction_inventory_batch_pending() )
+        _transaction_inventory_batch_ready_promise->set_value();
     }
 
     void node_impl::terminate_inactive_connections_loop()
@@ -1822,6 +1884,9 @@ namespace graphene { namespace net {
       case core_message_type_enum::item_not_available_message_type:
         on_item_not_available_message(originating_peer, received_message.as<item_not_available_message>());
         break;
+      case core_message_type_enum::trx_batch_message_type:
+        on_trx_batch_message(originating_peer, received_message.as<trx_batch_message>());
+        break;
       case core_message_type_enum::item_ids_inventory_message_type:
         on_item_ids_inventory_message(originating_peer, received_message.as<item_ids_inventory_message>());
         break;
@@ -2849,13 +2914,64 @@ namespace graphene { namespace net {
         originating_peer->last_block_time_delegate_has_seen = _delegate->get_block_time(block.block_id);
       }
 
+      // peers that understand trx_batch_message get the transactions packed into as few messages as possible
+      bool batch_transactions = fetch_items_message_received.item_type == trx_message_type &&
+                                originating_peer->core_protocol_version >= GRAPHENE_NET_TRX_BATCH_PROTOCOL_VERSION;
+      trx_batch_message transaction_batch;
+      size_t transaction_batch_size = 0;
+
       for (const message& reply : reply_messages)
       {
         if (reply.msg_type == block_message_type)
           originating_peer->send_item(item_id(block_message_type, reply.as<graphene::net::block_message>().block_id));
+        else if (batch_transactions && reply.msg_type == trx_message_type)
+        {
+          if (transaction_batch_size + reply.size > GRAPHENE_NET_MAX_TRX_BATCH_SIZE_IN_BYTES &&
+              !transaction_batch.transactions.empty())
+          {
+            originating_peer->send_message(transaction_batch);
+            transaction_batch.transactions.clear();
+            transaction_batch_size = 0;
+          }
+          transaction_batch.transactions.push_back(reply.as<trx_message>().trx);
+          transaction_batch_size += reply.size;
+        }
         else
           originating_peer->send_message(reply);
       }
+      if (!transaction_batch.transactions.empty())
+        originating_peer->send_message(transaction_batch);
+    }
+
+    void node_impl::on_trx_batch_message(peer_connection* originating_peer, const trx_batch_message& trx_batch_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      dlog("received a batch of ${count} transactions from peer ${endpoint}",
+           ("count", trx_batch_message_received.transactions.size())
+           ("endpoint", originating_peer->get_remote_endpoint()));
+
+      // rebuild the trx_message each transaction was advertised as, so the message hashes
+      // match our inventory and message cache
+      std::vector<message> transaction_messages;
+      transaction_messages.reserve(trx_batch_message_received.transactions.size());
+      for (const signed_transaction& transaction : trx_batch_message_received.transactions)
+      {
+        transaction_messages.emplace_back(trx_message(transaction));
+        message_hash_type message_hash = transaction_messages.back().id();
+        if (originating_peer->items_requested_from_peer.find(item_id(trx_message_type, message_hash)) ==
+            originating_peer->items_requested_from_peer.end())
+        {
+          wlog("received a transaction batch containing an item I didn't ask for from peer ${endpoint}, disconnecting from peer",
+               ("endpoint", originating_peer->get_remote_endpoint()));
+          fc::exception detailed_error(FC_LOG_MESSAGE(error, "You sent me a message that I didn't ask for, message_hash: ${message_hash}",
+                                                      ("message_hash", message_hash)));
+          disconnect_from_peer(originating_peer, "You sent me a message that I didn't request", true, detailed_error);
+          return;
+        }
+      }
+
+      for (const message& transaction_message : transaction_messages)
+        process_ordinary_message(originating_peer, transaction_message, transaction_message.id());
     }
 
     void node_impl::on_item_not_available_message( peer_connection* originating_peer, const item_not_available_message& item_not_available_message_received )
@@ -4350,6 +4466,7 @@ namespace graphene { namespace net {
       while ( !_accept_loop_complete.canceled() )
       {
         peer_connection_ptr new_peer(peer_connection::make_shared(this));
+        new_peer->set_transport_mode(_node_configuration.transport_mode);
 
         try
         {
@@ -4749,6 +4866,7 @@ namespace graphene { namespace net {
     {
       new_peer->get_socket().open();
       new_peer->get_socket().set_reuse_address();
+      new_peer->set_transport_mode(_node_configuration.transport_mode);
       new_peer->connection_initiation_time = fc::time_point::now();
       _handshaking_connections.insert(new_peer);
       _rate_limiter.add_tcp_socket(&new_peer->get_socket());
@@ -5239,6 +5357,19 @@ namespace graphene { namespace net {
 
     void node_impl::send_message_timing_to_statsd( peer_connection* originating_peer, const message& received_message, const message_hash_type& message_hash )
     {
+      // Blocks and transactions are the items requested from peers
+      static fc::metrics::histogram& block_latency = fc::metrics::registry::global().get_histogram(
+        "amalgam_p2p_item_latency_seconds", "Time from requesting an item from a peer to receiving it", { { "type", "block" } } );
+      static fc::metrics::histogram& trx_latency = fc::metrics::registry::global().get_histogram(
+        "amalgam_p2p_item_latency_seconds", "Time from requesting an item from a peer to receiving it", { { "type", "trx" } } );
+
+      if( received_message.msg_type == block_message_type || received_message.msg_type == trx_message_type )
+      {
+        auto iter = originating_peer->items_requested_from_peer.find( item_id( received_message.msg_type, message_hash ) );
+        if( iter != originating_peer->items_requested_from_peer.end() )
+          ( received_message.msg_type == block_message_type ? block_latency : trx_latency ).record( ( fc::time_point::now() - iter->second ).count() );
+      }
+
       if( amalgam::plugins::statsd::util::statsd_enabled() )
       {
         auto iter = originating_peer->items_requested_from_peer.find( item_id( received_message.msg_type, message_hash ) );
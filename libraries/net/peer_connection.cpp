@@ -184,6 +184,12 @@ namespace graphene { namespace net
       return _message_connection.get_socket();
     }
 
+    void peer_connection::set_transport_mode(stcp_transport_mode mode)
+    {
+      VERIFY_CORRECT_THREAD();
+      _message_connection.set_transport_mode(mode);
+    }
+
     void peer_connection::accept_connection()
     {
       VERIFY_CORRECT_THREAD();
@@ -281,6 +287,57 @@ namespace graphene { namespace net
       _node->on_connection_closed( this );
     }
 
+    peer_connection::message_send_class peer_connection::get_item_send_class(const item_id& item_to_send) const
+    {
+      if (item_to_send.item_type == block_message_type)
+        return peer_needs_sync_items_from_us ? message_send_class::sync : message_send_class::block;
+      if (item_to_send.item_type == trx_message_type)
+        return message_send_class::transaction;
+      return message_send_class::control;
+    }
+
+    peer_connection::message_send_class peer_connection::get_message_send_class(const message& message_to_send) const
+    {
+      switch (message_to_send.msg_type)
+      {
+      case block_message_type:
+      case trx_message_type:
+        return get_item_send_class(item_id(message_to_send.msg_type, item_hash_t()));
+      case trx_batch_message_type:
+        return message_send_class::transaction;
+      case blockchain_item_ids_inventory_message_type:
+      case fetch_blockchain_item_ids_message_type:
+        return message_send_class::sync;
+      case item_ids_inventory_message_type:
+      {
+        // item_type is the first packed field, no need to unpack the list of hashes
+        uint32_t item_type = 0;
+        if (message_to_send.data.size() >= sizeof(item_type))
+        {
+          fc::datastream<const char*> ds(message_to_send.data.data(), sizeof(item_type));
+          fc::raw::unpack(ds, item_type);
+        }
+        return item_type == block_message_type ? message_send_class::block_inventory : message_send_class::transaction;
+      }
+      default:
+        return message_send_class::control;
+      }
+    }
+
+    peer_connection::send_queue* peer_connection::select_send_queue()
+    {
+      send_queue& control_queue = _send_queues[(size_t)message_send_class::control];
+      if (!control_queue.messages.empty())
+        return &control_queue;
+
+      send_queue* selected_queue = nullptr;
+      for (send_queue& queue : _send_queues)
+        if (!queue.messages.empty() &&
+            (!selected_queue || queue.virtual_start_time < selected_queue->virtual_start_time))
+          selected_queue = &queue;
+      return selected_queue;
+    }
+
     void peer_connection::send_queued_messages_task()
     {
       VERIFY_CORRECT_THREAD();
@@ -291,10 +348,21 @@ namespace graphene { namespace net
         ~counter() { assert(_send_message_queue_tasks_counter == 1); --_send_message_queue_tasks_counter; /* dlog("leaving peer_connection::send_queued_messages_task()"); */ }
       } concurrent_invocation_counter(_send_message_queue_tasks_running);
 #endif
-      while (!_queued_messages.empty())
+      static const std::array<uint64_t, (size_t)message_send_class::number_of_classes> send_class_weights = {{
+        1, // control messages bypass the weighting
+        GRAPHENE_NET_SEND_WEIGHT_BLOCK,
+        GRAPHENE_NET_SEND_WEIGHT_BLOCK_INVENTORY,
+        GRAPHENE_NET_SEND_WEIGHT_SYNC,
+        GRAPHENE_NET_SEND_WEIGHT_TRANSACTION
+      }};
+
+      while (send_queue* queue = select_send_queue())
       {
-        _queued_messages.front()->transmission_start_time = fc::time_point::now();
-        message message_to_send = _queued_messages.front()->get_message(_node);
+        // new messages can be queued while we yield in send_message(), but they go on the back,
+        // so the front of this queue is still the message we are sending once it returns
+        queued_message& message_to_dequeue = *queue->messages.front();
+        message_to_dequeue.transmission_start_time = fc::time_point::now();
+        message message_to_send = message_to_dequeue.get_message(_node);
         try
         {
           //dlog("peer_connection::send_queued_messages_task() calling message_oriented_connection::send_message() "
@@ -330,9 +398,15 @@ namespace graphene { namespace net
         {
           elog("message_oriented_exception::send_message() threw an unhandled exception");
         }
-        _queued_messages.front()->transmission_finish_time = fc::time_point::now();
-        _total_queued_messages_size -= _queued_messages.front()->get_size_in_queue();
-        _queued_messages.pop();
+        message_to_dequeue.transmission_finish_time = fc::time_point::now();
+        _total_queued_messages_size -= message_to_dequeue.get_size_in_queue();
+        if (message_to_dequeue.send_class != message_send_class::control)
+        {
+          _send_queues_virtual_time = queue->virtual_start_time;
+          queue->virtual_start_time += (sizeof(message_header) + message_to_send.size) *
+                                       GRAPHENE_NET_SEND_WEIGHT_BLOCK / send_class_weights[(size_t)message_to_dequeue.send_class];
+        }
+        queue->messages.pop();
       }
       //dlog("leaving peer_connection::send_queued_messages_task() due to queue exhaustion");
     }
@@ -341,7 +415,11 @@ namespace graphene { namespace net
     {
       VERIFY_CORRECT_THREAD();
       _total_queued_messages_size += message_to_send->get_size_in_queue();
-      _queued_messages.emplace(std::move(message_to_send));
+      send_queue& queue = _send_queues[(size_t)message_to_send->send_class];
+      if (queue.messages.empty())
+        // a queue that was idle doesn't get credit for the time it had nothing to send
+        queue.virtual_start_time = std::max(queue.virtual_start_time, _send_queues_virtual_time);
+      queue.messages.emplace(std::move(message_to_send));
       if (_total_queued_messages_size > GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES)
       {
         elog("send queue exceeded maximum size of ${max} bytes (current size ${current} bytes)",
@@ -375,6 +453,7 @@ namespace graphene { namespace net
       //dlog("peer_connection::send_message() enqueueing message of type ${type} for peer ${endpoint}",
       //     ("type", message_to_send.msg_type)("endpoint", get_remote_endpoint()));
       std::unique_ptr<queued_message> message_to_enqueue(new real_queued_message(message_to_send, message_send_time_field_offset));
+      message_to_enqueue->send_class = get_message_send_class(message_to_send);
       send_queueable_message(std::move(message_to_enqueue));
     }
 
@@ -384,6 +463,7 @@ namespace graphene { namespace net
       //dlog("peer_connection::send_item() enqueueing message of type ${type} for peer ${endpoint}",
       //     ("type", item_to_send.item_type)("endpoint", get_remote_endpoint()));
       std::unique_ptr<queued_message> message_to_enqueue(new virtual_queued_message(item_to_send));
+      message_to_enqueue->send_class = get_item_send_class(item_to_send);
       send_queueable_message(std::move(message_to_enqueue));
     }
 
@@ -33,6 +33,7 @@
 #include <fc/exception/exception.hpp>
 
 #include <graphene/net/stcp_socket.hpp>
+#include <graphene/net/config.hpp>
 
 namespace graphene { namespace net {
 
@@ -48,7 +49,7 @@ stcp_socket::~stcp_socket()
 {
 }
 
-void stcp_socket::do_key_exchange()
+void stcp_socket::do_key_exchange( bool initiator )
 {
   _priv_key = fc::ecc::private_key::generate();
   fc::ecc::public_key pub = _priv_key.get_public_key();
@@ -66,13 +67,28 @@ void stcp_socket::do_key_exchange()
                   fc::city_hash_crc_128((char*)&_shared_secret,sizeof(_shared_secret) ) );
   _recv_aes.init( fc::sha256::hash( (char*)&_shared_secret, sizeof(_shared_secret) ), 
                   fc::city_hash_crc_128((char*)&_shared_secret,sizeof(_shared_secret) ) );
+
+  if( _transport_mode == stcp_gcm_transport )
+  {
+    // GCM must never reuse a (key, nonce) pair, so each direction gets its own key
+    auto direction_key = []( const fc::sha512& secret, char direction ) {
+      fc::sha256::encoder enc;
+      enc.write( (char*)&secret, sizeof(secret) );
+      enc.write( &direction, 1 );
+      return enc.result();
+    };
+    fc::uint128 nonce_salt = fc::city_hash_crc_128( (char*)&_shared_secret, sizeof(_shared_secret) );
+    const char outbound = 'i', inbound = 'r';
+    _send_gcm.init( direction_key( _shared_secret, initiator ? outbound : inbound ), nonce_salt );
+    _recv_gcm.init( direction_key( _shared_secret, initiator ? inbound : outbound ), nonce_salt );
+  }
 }
 
 
 void stcp_socket::connect_to( const fc::ip::endpoint& remote_endpoint )
 {
   _sock.connect_to( remote_endpoint );
-  do_key_exchange();
+  do_key_exchange( true );
 }
 
 void stcp_socket::bind( const fc::ip::endpoint& local_endpoint )
@@ -87,6 +103,9 @@ void stcp_socket::bind( const fc::ip::endpoint& local_endpoint )
  */
 size_t stcp_socket::readsome( char* buffer, size_t len )
 { try {
+    if( _transport_mode == stcp_gcm_transport )
+      return gcm_readsome( buffer, len );
+
     assert( len > 0 && (len % 16) == 0 );
 
 #ifndef NDEBUG
@@ -128,6 +147,9 @@ bool stcp_socket::eof()const
 
 size_t stcp_socket::writesome( const char* buffer, size_t len )
 { try {
+    if( _transport_mode == stcp_gcm_transport )
+      return gcm_writesome( buffer, len );
+
     assert( len > 0 && (len % 16) == 0 );
 
 #ifndef NDEBUG
@@ -163,6 +185,70 @@ size_t stcp_socket::writesome( const std::shared_ptr<const char>& buf, size_t le
   return writesome(buf.get() + offset, len);
 }
 
+/**
+ *  Reads one whole frame ( 4-byte length | ciphertext | tag ) from the socket.
+ *  When the caller's buffer can hold the frame it is decrypted in place there,
+ *  otherwise it is decrypted into _read_plaintext and handed out over the
+ *  following calls.
+ */
+size_t stcp_socket::gcm_readsome( char* buffer, size_t len )
+{
+    assert( len > 0 );
+
+    if( _read_plaintext_pos == _read_plaintext_len )
+    {
+      const size_t frame_buffer_length = sizeof(uint32_t) + GRAPHENE_NET_STCP_MAX_FRAME_SIZE + fc::aes_gcm_decoder::tag_size;
+      if( !_read_buffer )
+        _read_buffer.reset( new char[frame_buffer_length], [](char* p){ delete[] p; } );
+
+      _sock.read( _read_buffer, sizeof(uint32_t), 0 );
+      uint32_t frame_length = 0;
+      memcpy( (char*)&frame_length, _read_buffer.get(), sizeof(frame_length) );
+      FC_ASSERT( frame_length > 0 && frame_length <= GRAPHENE_NET_STCP_MAX_FRAME_SIZE, "invalid stcp frame length",
+                 ("frame_length",frame_length) );
+
+      _sock.read( _read_buffer, frame_length + fc::aes_gcm_decoder::tag_size, sizeof(uint32_t) );
+      const char* ciphertext = _read_buffer.get() + sizeof(uint32_t);
+      const char* tag = ciphertext + frame_length;
+
+      if( len >= frame_length )
+        return _recv_gcm.decode( ciphertext, frame_length, tag, buffer, _read_buffer.get(), sizeof(uint32_t) );
+
+      if( !_read_plaintext )
+        _read_plaintext.reset( new char[GRAPHENE_NET_STCP_MAX_FRAME_SIZE], [](char* p){ delete[] p; } );
+      _read_plaintext_len = _recv_gcm.decode( ciphertext, frame_length, tag, _read_plaintext.get(),
+                                              _read_buffer.get(), sizeof(uint32_t) );
+      _read_plaintext_pos = 0;
+    }
+
+    size_t bytes_to_copy = std::min<size_t>( len, _read_plaintext_len - _read_plaintext_pos );
+    memcpy( buffer, _read_plaintext.get() + _read_plaintext_pos, bytes_to_copy );
+    _read_plaintext_pos += bytes_to_copy;
+    return bytes_to_copy;
+}
+
+/**
+ *  Seals up to GRAPHENE_NET_STCP_MAX_FRAME_SIZE bytes as one frame.  The length
+ *  header, ciphertext and tag are laid out in a single buffer so the frame goes
+ *  out in one socket write; the header is authenticated as additional data.
+ */
+size_t stcp_socket::gcm_writesome( const char* buffer, size_t len )
+{
+    assert( len > 0 );
+
+    const size_t frame_buffer_length = sizeof(uint32_t) + GRAPHENE_NET_STCP_MAX_FRAME_SIZE + fc::aes_gcm_encoder::tag_size;
+    if( !_write_buffer )
+      _write_buffer.reset( new char[frame_buffer_length], [](char* p){ delete[] p; } );
+
+    uint32_t frame_length = std::min<size_t>( GRAPHENE_NET_STCP_MAX_FRAME_SIZE, len );
+    char* header = _write_buffer.get();
+    char* ciphertext = header + sizeof(uint32_t);
+    memcpy( header, (char*)&frame_length, sizeof(frame_length) );
+    _send_gcm.encode( buffer, frame_length, ciphertext, ciphertext + frame_length, header, sizeof(uint32_t) );
+    _sock.write( _write_buffer, sizeof(uint32_t) + frame_length + fc::aes_gcm_encoder::tag_size );
+    return frame_length;
+}
+
 void stcp_socket::flush()
 {
   _sock.flush();
@@ -179,7 +265,7 @@ void stcp_socket::close()
 
 void stcp_socket::accept()
 {
-  do_key_exchange();
+  do_key_exchange( false );
 }
 
 
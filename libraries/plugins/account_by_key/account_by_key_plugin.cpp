@@ -5,10 +5,27 @@
 #include <amalgam/chain/database.hpp>
 #include <amalgam/chain/index.hpp>
 
+#include <fc/bloom_filter.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
 namespace amalgam { namespace plugins { namespace account_by_key {
 
 namespace detail {
 
+struct public_key_hash
+{
+   size_t operator()( const public_key_type& k )const
+   {
+      // The first byte only holds the parity of y, the rest is a curve coordinate
+      size_t h;
+      std::memcpy( &h, k.key_data.data + 1, sizeof( h ) );
+      return h;
+   }
+};
+
 class account_by_key_plugin_impl
 {
    public:
@@ -22,11 +39,31 @@ class account_by_key_plugin_impl
       void cache_auths( const account_authority_object& a );
       void update_key_lookup( const account_authority_object& a );
 
+      void on_post_apply_block( const block_notification& note );
+      void load_key_references();
+      void sync_key_references( const account_name_type& account );
+      void rebuild_key_filter();
+
       flat_set< public_key_type >   cached_keys;
       database&                     _db;
       account_by_key_plugin&        _self;
       boost::signals2::connection   _pre_apply_operation_conn;
       boost::signals2::connection   _post_apply_operation_conn;
+      boost::signals2::connection   _post_apply_block_conn;
+
+      /**
+       * In memory copy of the key lookups, only changed under the write lock.
+       * Every key ever added stays in the bloom filter, so it may give false
+       * positives but never misses a key in the index.
+       */
+      std::unordered_map< public_key_type, std::vector< account_name_type >, public_key_hash > _key_references;
+      std::map< account_name_type, flat_set< public_key_type > > _account_keys;
+      fc::bloom_filter              _key_filter;
+      bool                          _key_references_loaded = false;
+
+      /// accounts whose keys changed in each reversible block
+      std::map< uint32_t, flat_set< account_name_type > > _touched_accounts;
+      uint32_t                      _operation_block = 0;
 };
 
 struct pre_operation_visitor
@@ -107,6 +144,8 @@ void account_by_key_plugin_impl::cache_auths( const account_authority_object& a
 
 void account_by_key_plugin_impl::update_key_lookup( const account_authority_object& a )
 {
+   _touched_accounts[ _operation_block ].insert( a.account );
+
    flat_set< public_key_type > new_keys;
 
    // Construct the set of keys in the account's authority
@@ -162,9 +201,112 @@ void account_by_key_plugin_impl::on_pre_apply_operation( const operation_notific
 
 void account_by_key_plugin_impl::on_post_apply_operation( const operation_notification& note )
 {
+   _operation_block = note.block;
    note.op.visit( post_operation_visitor( *this ) );
 }
 
+void account_by_key_plugin_impl::on_post_apply_block( const block_notification& note )
+{
+   if( !_key_references_loaded )
+   {
+      _touched_accounts.clear();
+      return;
+   }
+
+   // Blocks above this one were popped, the keys of their accounts are back to the state before them
+   flat_set< account_name_type > accounts;
+   for( auto itr = _touched_accounts.lower_bound( note.block_num ); itr != _touched_accounts.end(); ++itr )
+      accounts.insert( itr->second.begin(), itr->second.end() );
+   _touched_accounts.erase( _touched_accounts.upper_bound( note.block_num ), _touched_accounts.end() );
+
+   for( const auto& account : accounts )
+      sync_key_references( account );
+
+   _touched_accounts.erase( _touched_accounts.begin(),
+      _touched_accounts.upper_bound( _db.get_dynamic_global_properties().last_irreversible_block_num ) );
+
+   if( _key_filter.element_count() > 2 * _key_references.size() + 10000 )
+      rebuild_key_filter();
+}
+
+void account_by_key_plugin_impl::load_key_references()
+{
+   _key_references.clear();
+   _account_keys.clear();
+
+   const auto& key_idx = _db.get_index< key_lookup_index, by_key >();
+   for( const auto& lookup : key_idx )
+   {
+      // The index is sorted by key and then account, so the accounts of a key stay sorted
+      _key_references[ lookup.key ].push_back( lookup.account );
+      _account_keys[ lookup.account ].insert( lookup.key );
+   }
+
+   rebuild_key_filter();
+   _touched_accounts.clear();
+   _key_references_loaded = true;
+}
+
+void account_by_key_plugin_impl::sync_key_references( const account_name_type& account )
+{
+   flat_set< public_key_type > new_keys;
+   const auto* auth = _db.find< account_authority_object, by_account >( account );
+   if( auth != nullptr )
+   {
+      for( const auto& item : auth->owner.key_auths )
+         new_keys.insert( item.first );
+      for( const auto& item : auth->active.key_auths )
+         new_keys.insert( item.first );
+      for( const auto& item : auth->posting.key_auths )
+         new_keys.insert( item.first );
+   }
+
+   auto& old_keys = _account_keys[ account ];
+
+   for( const auto& key : old_keys )
+   {
+      if( new_keys.find( key ) != new_keys.end() )
+         continue;
+
+      auto ref_itr = _key_references.find( key );
+      if( ref_itr == _key_references.end() )
+         continue;
+
+      auto& accounts = ref_itr->second;
+      accounts.erase( std::remove( accounts.begin(), accounts.end(), account ), accounts.end() );
+      if( accounts.empty() )
+         _key_references.erase( ref_itr );
+   }
+
+   for( const auto& key : new_keys )
+   {
+      if( old_keys.find( key ) != old_keys.end() )
+         continue;
+
+      auto& accounts = _key_references[ key ];
+      accounts.insert( std::upper_bound( accounts.begin(), accounts.end(), account ), account );
+      _key_filter.insert( key.key_data.data, key.key_data.size() );
+   }
+
+   if( new_keys.empty() )
+      _account_keys.erase( account );
+   else
+      old_keys = std::move( new_keys );
+}
+
+/** sized for twice the current keys, rebuilt once as many have been added */
+void account_by_key_plugin_impl::rebuild_key_filter()
+{
+   fc::bloom_parameters parameters;
+   parameters.projected_element_count = 2 * _key_references.size() + 10000;
+   parameters.false_positive_probability = 0.001;
+   parameters.compute_optimal_parameters();
+
+   _key_filter = fc::bloom_filter( parameters );
+   for( const auto& ref : _key_references )
+      _key_filter.insert( ref.first.key_data.data, ref.first.key_data.size() );
+}
+
 } // detail
 
 account_by_key_plugin::account_by_key_plugin() {}
@@ -182,18 +324,60 @@ void account_by_key_plugin::plugin_initialize( const boost::program_options::var
 
       my->_pre_apply_operation_conn = db.add_pre_apply_operation_handler( [&]( const operation_notification& note ){ my->on_pre_apply_operation( note ); }, *this, 0 );
       my->_post_apply_operation_conn = db.add_post_apply_operation_handler( [&]( const operation_notification& note ){ my->on_post_apply_operation( note ); }, *this, 0 );
+      my->_post_apply_block_conn = db.add_post_apply_block_handler( [&]( const block_notification& note ){ my->on_post_apply_block( note ); }, *this, 0 );
 
       add_plugin_index< key_lookup_index >(db);
    }
    FC_CAPTURE_AND_RETHROW()
 }
 
-void account_by_key_plugin::plugin_startup() {}
+void account_by_key_plugin::plugin_startup()
+{
+   // Replay is done, blocks applied from here on keep the index current
+   my->_db.with_read_lock( [&]()
+   {
+      my->load_key_references();
+   });
+
+   ilog( "account_by_key: loaded ${n} keys", ("n", my->_key_references.size()) );
+}
 
 void account_by_key_plugin::plugin_shutdown()
 {
    chain::util::disconnect_signal( my->_pre_apply_operation_conn );
    chain::util::disconnect_signal( my->_post_apply_operation_conn );
+   chain::util::disconnect_signal( my->_post_apply_block_conn );
+}
+
+std::vector< std::vector< account_name_type > > account_by_key_plugin::get_key_references( const std::vector< public_key_type >& keys )const
+{
+   std::vector< std::vector< account_name_type > > result;
+   result.reserve( keys.size() );
+
+   if( !my->_key_references_loaded )
+   {
+      const auto& key_idx = my->_db.get_index< key_lookup_index, by_key >();
+      for( const auto& key : keys )
+      {
+         result.emplace_back();
+         for( auto itr = key_idx.lower_bound( key ); itr != key_idx.end() && itr->key == key; ++itr )
+            result.back().push_back( itr->account );
+      }
+      return result;
+   }
+
+   for( const auto& key : keys )
+   {
+      result.emplace_back();
+      if( !my->_key_filter.contains( key.key_data.data, key.key_data.size() ) )
+         continue;
+
+      auto itr = my->_key_references.find( key );
+      if( itr != my->_key_references.end() )
+         result.back() = itr->second;
+   }
+
+   return result;
 }
 
 } } } // amalgam::plugins::account_by_key
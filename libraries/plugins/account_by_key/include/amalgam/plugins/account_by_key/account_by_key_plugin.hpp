@@ -26,6 +26,14 @@ class account_by_key_plugin : public appbase::plugin< account_by_key_plugin >
       virtual void plugin_startup() override;
       virtual void plugin_shutdown() override;
 
+      /**
+       * Accounts referencing each key, in the order of keys. Answered from an
+       * in-memory hash index once the plugin started, with a bloom filter in
+       * front of it so keys no account uses are rejected without a probe.
+       * Must be called while holding the chain read lock.
+       */
+      std::vector< std::vector< protocol::account_name_type > > get_key_references( const std::vector< protocol::public_key_type >& keys )const;
+
    private:
       std::unique_ptr< detail::account_by_key_plugin_impl > my;
 };
@@ -1,4 +1,5 @@
 #include <amalgam/plugins/account_history/account_history_plugin.hpp>
+#include <amalgam/plugins/account_history/history_log.hpp>
 
 #include <amalgam/chain/util/impacted.hpp>
 
@@ -8,11 +9,17 @@
 
 #include <amalgam/utilities/plugin_utilities.hpp>
 
+#include <amalgam/plugins/statsd/utility.hpp>
+
 #include <fc/io/json.hpp>
 #include <fc/smart_ref_impl.hpp>
 
 #include <boost/algorithm/string.hpp>
 
+#include <atomic>
+#include <future>
+#include <thread>
+
 
 #define AMALGAM_NAMESPACE_PREFIX "amalgam::protocol::"
 
@@ -23,6 +30,7 @@ using namespace amalgam::protocol;
 using chain::database;
 using chain::operation_notification;
 using chain::operation_object;
+using chain::account_history_object;
 
 namespace detail {
 
@@ -34,21 +42,49 @@ class account_history_plugin_impl
 
       virtual ~account_history_plugin_impl() {}
 
+      bool is_tracked( const account_name_type& item )const;
+      bool is_logged( const operation& op )const;
+
       void on_pre_apply_operation( const operation_notification& note );
+      void on_post_apply_block( const chain::block_notification& note );
+      void prune_history();
+      void migrate_irreversible_history( uint32_t last_irreversible );
+      void remove_logged_history( uint32_t block_num );
+
+      void backfill();
 
       flat_map< account_name_type, account_name_type > _tracked_accounts;
       bool                                             _filter_content = false;
       bool                                             _blacklist = false;
       flat_set< string >                               _op_list;
       bool                                             _prune = true;
+      uint32_t                                         _prune_interval = 100;
+      /// accounts that got new history since the last pruning
+      std::set< account_name_type >                    _prune_queue;
+      /// operations before this one are older than the retention period
+      chain::operation_id_type                         _prune_cutoff;
+      bool                                             _prune_cutoff_valid = false;
       database&                        _db;
       boost::signals2::connection      _pre_apply_operation_conn;
+      boost::signals2::connection      _post_apply_block_conn;
+      boost::signals2::connection      _pre_reindex_conn;
+      boost::signals2::connection      _chain_sync_conn;
+
+      /// set when irreversible history is moved out of the shared memory file
+      std::unique_ptr< history_log >   _log;
+      uint32_t                         _log_snapshot_interval = 1000;
+      /// first account_history_object not in the log yet
+      chain::account_history_id_type   _history_cursor;
+      bool                             _history_cursor_valid = false;
+
+      bool                             _backfill = false;
+      uint32_t                         _backfill_threads = 0;
 };
 
 struct operation_visitor
 {
-   operation_visitor( database& db, const operation_notification& note, const operation_object*& n, account_name_type i, bool prune )
-      :_db(db), _note(note), new_obj(n), item(i), _prune(prune) {}
+   operation_visitor( database& db, const operation_notification& note, const operation_object*& n, account_name_type i, std::set< account_name_type >* prune_queue, const history_log* log )
+      :_db(db), _note(note), new_obj(n), item(i), _prune_queue(prune_queue), _log(log) {}
 
    typedef void result_type;
 
@@ -56,7 +92,8 @@ struct operation_visitor
    const operation_notification& _note;
    const operation_object*& new_obj;
    account_name_type item;
-   bool _prune;
+   std::set< account_name_type >* _prune_queue;
+   const history_log* _log;
 
    template<typename Op>
    void operator()( Op&& )const
@@ -84,47 +121,26 @@ struct operation_visitor
       uint32_t sequence = 1;
       if( hist_itr != hist_idx.end() && hist_itr->account == item )
          sequence = hist_itr->sequence + 1;
+      else if( _log )
+         sequence = _log->next_sequence( item );
 
       _db.create< chain::account_history_object >( [&]( chain::account_history_object& ahist )
       {
          ahist.account  = item;
          ahist.sequence = sequence;
+         ahist.op_type  = _note.op.which();
          ahist.op       = new_obj->id;
       });
 
-      if( _prune )
-      {
-         // Clean up accounts to last 30 days or 30 items, whichever is more.
-         const auto& seq_idx = _db.get_index< chain::account_history_index, chain::by_account >();
-         auto seq_itr = seq_idx.lower_bound( boost::make_tuple( item, 0 ) );
-         vector< const chain::account_history_object* > to_remove;
-         auto now = _db.head_block_time();
-
-         if( seq_itr == seq_idx.begin() )
-            return;
-
-         --seq_itr;
-
-         while( seq_itr->account == item
-               && sequence - seq_itr->sequence > 30
-               && now - _db.get< chain::operation_object >( seq_itr->op ).timestamp > fc::days(30) )
-         {
-            to_remove.push_back( &(*seq_itr) );
-            --seq_itr;
-         }
-
-         for( const auto* seq_ptr : to_remove )
-         {
-            _db.remove( *seq_ptr );
-         }
-      }
+      if( _prune_queue )
+         _prune_queue->insert( item );
    }
 };
 
 struct operation_visitor_filter : operation_visitor
 {
-   operation_visitor_filter( database& db, const operation_notification& note, const operation_object*& n, account_name_type i, const flat_set< string >& filter, bool p, bool blacklist ):
-      operation_visitor( db, note, n, i, p ), _filter( filter ), _blacklist( blacklist ) {}
+   operation_visitor_filter( database& db, const operation_notification& note, const operation_object*& n, account_name_type i, const flat_set< string >& filter, std::set< account_name_type >* p, bool blacklist, const history_log* log ):
+      operation_visitor( db, note, n, i, p, log ), _filter( filter ), _blacklist( blacklist ) {}
 
    const flat_set< string >& _filter;
    bool _blacklist;
@@ -145,6 +161,54 @@ struct operation_visitor_filter : operation_visitor
    }
 };
 
+bool account_history_plugin_impl::is_tracked( const account_name_type& item )const
+{
+   auto itr = _tracked_accounts.lower_bound( item );
+
+   /*
+    * The map containing the ranges uses the key as the lower bound and the value as the upper bound.
+    * Because of this, if a value exists with the range (key, value], then calling lower_bound on
+    * the map will return the key of the next pair. Under normal circumstances of those ranges not
+    * intersecting, the value we are looking for will not be present in range that is returned via
+    * lower_bound.
+    *
+    * Consider the following example using ranges ["a","c"], ["g","i"]
+    * If we are looking for "bob", it should be tracked because it is in the lower bound.
+    * However, lower_bound( "bob" ) returns an iterator to ["g","i"]. So we need to decrement the iterator
+    * to get the correct range.
+    *
+    * If we are looking for "g", lower_bound( "g" ) will return ["g","i"], so we need to make sure we don't
+    * decrement.
+    *
+    * If the iterator points to the end, we should check the previous (equivalent to rbegin)
+    *
+    * And finally if the iterator is at the beginning, we should not decrement it for obvious reasons
+    */
+   if( itr != _tracked_accounts.begin() &&
+       ( ( itr != _tracked_accounts.end() && itr->first != item  ) || itr == _tracked_accounts.end() ) )
+   {
+      --itr;
+   }
+
+   return !_tracked_accounts.size() || (itr != _tracked_accounts.end() && itr->first <= item && item <= itr->second );
+}
+
+struct operation_name_visitor
+{
+   typedef string result_type;
+
+   template< typename T >
+   string operator()( const T& )const { return fc::get_typename< T >::name(); }
+};
+
+/** same as operation_visitor_filter, for operations that are not being applied */
+bool account_history_plugin_impl::is_logged( const operation& op )const
+{
+   if( !_filter_content )
+      return true;
+   return ( _op_list.find( op.visit( operation_name_visitor() ) ) != _op_list.end() ) != _blacklist;
+}
+
 void account_history_plugin_impl::on_pre_apply_operation( const operation_notification& note )
 {
    flat_set<account_name_type> impacted;
@@ -153,45 +217,417 @@ void account_history_plugin_impl::on_pre_apply_operation( const operation_notifi
    app::operation_get_impacted_accounts( note.op, impacted );
 
    for( const auto& item : impacted ) {
-      auto itr = _tracked_accounts.lower_bound( item );
-
-      /*
-       * The map containing the ranges uses the key as the lower bound and the value as the upper bound.
-       * Because of this, if a value exists with the range (key, value], then calling lower_bound on
-       * the map will return the key of the next pair. Under normal circumstances of those ranges not
-       * intersecting, the value we are looking for will not be present in range that is returned via
-       * lower_bound.
-       *
-       * Consider the following example using ranges ["a","c"], ["g","i"]
-       * If we are looking for "bob", it should be tracked because it is in the lower bound.
-       * However, lower_bound( "bob" ) returns an iterator to ["g","i"]. So we need to decrement the iterator
-       * to get the correct range.
-       *
-       * If we are looking for "g", lower_bound( "g" ) will return ["g","i"], so we need to make sure we don't
-       * decrement.
-       *
-       * If the iterator points to the end, we should check the previous (equivalent to rbegin)
-       *
-       * And finally if the iterator is at the beginning, we should not decrement it for obvious reasons
-       */
-      if( itr != _tracked_accounts.begin() &&
-          ( ( itr != _tracked_accounts.end() && itr->first != item  ) || itr == _tracked_accounts.end() ) )
+      if( is_tracked( item ) )
+      {
+         if(_filter_content)
+         {
+            note.op.visit( operation_visitor_filter( _db, note, new_obj, item, _op_list, _prune ? &_prune_queue : nullptr, _blacklist, _log.get() ) );
+         }
+         else
+         {
+            note.op.visit( operation_visitor( _db, note, new_obj, item, _prune ? &_prune_queue : nullptr, _log.get() ) );
+         }
+      }
+   }
+}
+
+void account_history_plugin_impl::on_post_apply_block( const chain::block_notification& note )
+{
+   if( _prune && note.block_num % _prune_interval == 0 )
+      prune_history();
+
+   if( !_log )
+      return;
+
+   migrate_irreversible_history( _db.get_dynamic_global_properties().last_irreversible_block_num );
+
+   if( _log->head_block() >= _log->snapshot_block() + _log_snapshot_interval )
+   {
+      _log->write_snapshot();
+      remove_logged_history( _log->snapshot_block() );
+   }
+}
+
+/**
+ * Clean up accounts to last 30 days or 30 items, whichever is more.
+ *
+ * Only accounts with new history since the last run can have anything to
+ * remove. Operation ids grow with time, so the age of an entry is checked
+ * against the first operation inside the retention period instead of
+ * loading the operation of every entry.
+ */
+void account_history_plugin_impl::prune_history()
+{
+   STATSD_START_TIMER( "account_history", "write_time", "prune", 1.0f )
+
+   const auto& op_idx = _db.get_index< chain::operation_index, chain::by_id >();
+   const auto cutoff_time = _db.head_block_time() - fc::days(30);
+
+   if( !_prune_cutoff_valid && op_idx.size() )
+   {
+      // Binary search on the ids, the cursor only moves forward afterwards
+      int64_t low = op_idx.begin()->id._id, high = op_idx.rbegin()->id._id + 1;
+      while( low < high )
       {
-         --itr;
+         int64_t mid = low + ( high - low ) / 2;
+         auto itr = op_idx.lower_bound( chain::operation_id_type( mid ) );
+         if( itr != op_idx.end() && itr->timestamp < cutoff_time )
+            low = itr->id._id + 1;
+         else
+            high = mid;
       }
+      _prune_cutoff = low;
+      _prune_cutoff_valid = true;
+   }
 
-      if( !_tracked_accounts.size() || (itr != _tracked_accounts.end() && itr->first <= item && item <= itr->second ) )
+   for( auto itr = op_idx.lower_bound( _prune_cutoff ); itr != op_idx.end() && itr->timestamp < cutoff_time; ++itr )
+      _prune_cutoff = itr->id._id + 1;
+
+   const auto& seq_idx = _db.get_index< chain::account_history_index, chain::by_account >();
+   vector< const account_history_object* > to_remove;
+
+   for( const auto& item : _prune_queue )
+   {
+      auto newest = seq_idx.lower_bound( boost::make_tuple( item, uint32_t(-1) ) );
+      if( newest == seq_idx.end() || newest->account != item )
+         continue;
+
+      // Entries of an account are ordered from the newest, start at its oldest
+      auto seq_itr = seq_idx.lower_bound( boost::make_tuple( item, 0 ) );
+      while( seq_itr != seq_idx.begin() )
       {
-         if(_filter_content)
+         --seq_itr;
+         if( seq_itr->account != item
+            || newest->sequence - seq_itr->sequence <= 30
+            || !( seq_itr->op < _prune_cutoff ) )
+            break;
+
+         to_remove.push_back( &(*seq_itr) );
+      }
+   }
+
+   for( const auto* seq_ptr : to_remove )
+   {
+      _db.remove( *seq_ptr );
+   }
+
+   STATSD_COUNT( "account_history", "prune", "accounts", _prune_queue.size(), 1.0f )
+   STATSD_COUNT( "account_history", "prune", "removed", to_remove.size(), 1.0f )
+
+   _prune_queue.clear();
+}
+
+/**
+ * Appends the history of blocks that became irreversible to the log. It stays
+ * in the chain state until the next log snapshot covers it.
+ */
+void account_history_plugin_impl::migrate_irreversible_history( uint32_t last_irreversible )
+{
+   const auto& op_idx = _db.get_index< chain::operation_index, chain::by_location >();
+   const auto& hist_idx = _db.get_index< chain::account_history_index, chain::by_id >();
+   uint32_t head = _log->head_block();
+
+   if( head >= last_irreversible )
+      return;
+
+   if( !_history_cursor_valid )
+   {
+      // History logged before the last restart may still be in the chain state
+      _history_cursor = chain::account_history_id_type();
+      for( auto itr = hist_idx.begin(); itr != hist_idx.end(); ++itr )
+      {
+         const auto* op = _db.find( itr->op );
+         if( op && op->block > head )
+            break;
+         _history_cursor = itr->id._id + 1;
+      }
+      _history_cursor_valid = true;
+   }
+
+   std::vector< history_log_operation > ops;
+   flat_map< chain::operation_id_type, size_t > positions;
+   uint32_t block = 0;
+
+   auto flush_block = [&]()
+   {
+      for( auto hist_itr = hist_idx.lower_bound( _history_cursor ); hist_itr != hist_idx.end(); ++hist_itr )
+      {
+         auto pos = positions.find( hist_itr->op );
+         if( pos != positions.end() )
          {
-            note.op.visit( operation_visitor_filter( _db, note, new_obj, item, _op_list, _prune, _blacklist ) );
+            ops[ pos->second ].entries.push_back( history_log_entry{ hist_itr->account, hist_itr->sequence } );
          }
          else
          {
-            note.op.visit( operation_visitor( _db, note, new_obj, item, _prune ) );
+            // Entries of later blocks wait for the next call, the others were logged already
+            const auto* op = _db.find( hist_itr->op );
+            if( op && op->block > head )
+               break;
          }
+         _history_cursor = hist_itr->id._id + 1;
+      }
+
+      _log->append_block( block, ops );
+      ops.clear();
+      positions.clear();
+   };
+
+   for( auto itr = op_idx.lower_bound( head + 1 ); itr != op_idx.end() && itr->block <= last_irreversible; ++itr )
+   {
+      if( itr->block != block && ops.size() )
+      {
+         head = block;
+         flush_block();
+      }
+      block = itr->block;
+
+      positions[ itr->id ] = ops.size();
+      ops.emplace_back();
+      auto& stored = ops.back().op;
+      stored.trx_id = itr->trx_id;
+      stored.block = itr->block;
+      stored.trx_in_block = itr->trx_in_block;
+      stored.op_in_trx = itr->op_in_trx;
+      stored.virtual_op = itr->virtual_op;
+      stored.timestamp = itr->timestamp;
+      stored.serialized_op.assign( itr->serialized_op.begin(), itr->serialized_op.end() );
+   }
+
+   if( ops.size() )
+   {
+      head = block;
+      flush_block();
+   }
+}
+
+/** drops history the log snapshot covers from the chain state */
+void account_history_plugin_impl::remove_logged_history( uint32_t block_num )
+{
+   const auto& hist_idx = _db.get_index< chain::account_history_index, chain::by_id >();
+   for( auto itr = hist_idx.begin(); itr != hist_idx.end(); )
+   {
+      const auto* op = _db.find( itr->op );
+      if( op && op->block > block_num )
+         break;
+      const auto& entry = *itr;
+      ++itr;
+      _db.remove( entry );
+   }
+
+   const auto& op_idx = _db.get_index< chain::operation_index, chain::by_location >();
+   for( auto itr = op_idx.begin(); itr != op_idx.end() && itr->block <= block_num; )
+   {
+      const auto& op = *itr;
+      ++itr;
+      _db.remove( op );
+   }
+}
+
+struct backfill_operation
+{
+   stored_operation                 op;
+   uint32_t                         op_type = 0;
+   flat_set< account_name_type >    accounts;
+};
+
+struct backfill_block
+{
+   uint32_t                         block_num = 0;
+   fc::time_point_sec               timestamp;
+   std::vector< backfill_operation > ops;
+};
+
+/**
+ * Builds the history of the transactions in the block log without applying
+ * the blocks. Blocks are decoded and their impacted accounts computed by
+ * worker threads, one batch ahead of the thread that stores the previous
+ * batch in account id order.
+ *
+ * Virtual operations only exist while blocks are applied, they are not in
+ * the block log and stay missing until the node is replayed.
+ *
+ * Runs when the chain plugin has opened the database and before it starts
+ * applying blocks and transactions, so no entry is created while sequences
+ * are assigned here. Opening rewinds the state to the block log head, which
+ * makes the head block the last one to backfill.
+ */
+void account_history_plugin_impl::backfill()
+{
+   const auto& blog = _db.get_block_log();
+   uint32_t head = 0, last_irreversible = 0;
+   bool empty = false;
+
+   _db.with_read_lock( [&]()
+   {
+      head = _db.head_block_num();
+      last_irreversible = _db.get_dynamic_global_properties().last_irreversible_block_num;
+      empty = _db.get_index< chain::operation_index >().indices().empty()
+         && _db.get_index< chain::account_history_index >().indices().empty()
+         && ( !_log || _log->head_block() == 0 );
+   });
+
+   if( !empty )
+   {
+      wlog( "Account History: skipping backfill, the node already has account history" );
+      return;
+   }
+
+   uint32_t blog_head = blog.head().valid() ? blog.head()->block_num() : 0;
+   FC_ASSERT( head <= blog_head, "Blocks ${b} to ${h} are missing from the block log", ("b", blog_head + 1)("h", head) );
+
+   uint32_t threads = _backfill_threads ? _backfill_threads : std::max( 1u, std::thread::hardware_concurrency() );
+   ilog( "Account History: backfilling ${n} blocks with ${t} threads", ("n", head)("t", threads) );
+
+   auto decode = [this, &blog, threads]( uint32_t first, uint32_t last )
+   {
+      std::vector< backfill_block > blocks( last - first + 1 );
+      std::atomic< uint32_t > next( first );
+      std::vector< std::exception_ptr > errors( threads );
+      std::vector< std::thread > workers;
+
+      for( uint32_t t = 0; t < threads; ++t )
+      {
+         workers.emplace_back( [&, t]()
+         {
+            try
+            {
+               for( uint32_t block_num = next++; block_num <= last; block_num = next++ )
+               {
+                  auto block = blog.read_block_by_num( block_num );
+                  FC_ASSERT( block.valid(), "Block ${b} is missing from the block log", ("b", block_num) );
+
+                  backfill_block& result = blocks[ block_num - first ];
+                  result.block_num = block_num;
+                  result.timestamp = block->timestamp;
+
+                  for( uint32_t trx_in_block = 0; trx_in_block < block->transactions.size(); ++trx_in_block )
+                  {
+                     const auto& trx = block->transactions[ trx_in_block ];
+                     auto trx_id = trx.id();
+
+                     for( uint32_t op_in_trx = 0; op_in_trx < trx.operations.size(); ++op_in_trx )
+                     {
+                        const auto& op = trx.operations[ op_in_trx ];
+                        if( !is_logged( op ) )
+                           continue;
+
+                        backfill_operation o;
+                        flat_set< account_name_type > impacted;
+                        app::operation_get_impacted_accounts( op, impacted );
+                        for( const auto& item : impacted )
+                        {
+                           if( is_tracked( item ) )
+                              o.accounts.insert( item );
+                        }
+                        if( o.accounts.empty() )
+                           continue;
+
+                        o.op.trx_id = trx_id;
+                        o.op.block = block_num;
+                        o.op.trx_in_block = trx_in_block;
+                        o.op.op_in_trx = op_in_trx;
+                        o.op.serialized_op = fc::raw::pack_to_vector( op );
+                        o.op_type = op.which();
+                        result.ops.push_back( std::move( o ) );
+                     }
+                  }
+               }
+            }
+            catch( ... )
+            {
+               errors[ t ] = std::current_exception();
+               next = last + 1;
+            }
+         });
+      }
+
+      for( auto& w : workers )
+         w.join();
+      for( auto& e : errors )
+      {
+         if( e )
+            std::rethrow_exception( e );
       }
+
+      return blocks;
+   };
+
+   const uint32_t batch_size = 1000;
+   std::map< account_name_type, uint32_t > sequences;
+   // Operations are applied before the block updates the head block time
+   fc::time_point_sec timestamp = AMALGAM_GENESIS_TIME;
+   uint64_t op_count = 0;
+
+   std::future< std::vector< backfill_block > > pending;
+   if( head )
+      pending = std::async( std::launch::async, decode, 1, std::min( head, batch_size ) );
+
+   for( uint32_t first = 1; first <= head; first += batch_size )
+   {
+      auto blocks = pending.get();
+      if( head - first >= batch_size )
+         pending = std::async( std::launch::async, decode, first + batch_size, std::min( head, first + 2 * batch_size - 1 ) );
+
+      _db.with_write_lock( [&]()
+      {
+         for( auto& block : blocks )
+         {
+            for( auto& o : block.ops )
+               o.op.timestamp = timestamp;
+            timestamp = block.timestamp;
+            op_count += block.ops.size();
+
+            if( _log && block.block_num <= last_irreversible )
+            {
+               std::vector< history_log_operation > ops( block.ops.size() );
+               for( size_t i = 0; i < block.ops.size(); ++i )
+               {
+                  ops[i].op = std::move( block.ops[i].op );
+                  for( const auto& item : block.ops[i].accounts )
+                     ops[i].entries.push_back( history_log_entry{ item, ++sequences[ item ] } );
+               }
+               if( ops.size() )
+                  _log->append_block( block.block_num, ops );
+               continue;
+            }
+
+            for( const auto& o : block.ops )
+            {
+               const auto& obj = _db.create< operation_object >( [&]( operation_object& obj )
+               {
+                  obj.trx_id       = o.op.trx_id;
+                  obj.block        = o.op.block;
+                  obj.trx_in_block = o.op.trx_in_block;
+                  obj.op_in_trx    = o.op.op_in_trx;
+                  obj.timestamp    = o.op.timestamp;
+                  obj.serialized_op.assign( o.op.serialized_op.begin(), o.op.serialized_op.end() );
+               });
+
+               for( const auto& item : o.accounts )
+               {
+                  _db.create< account_history_object >( [&]( account_history_object& ahist )
+                  {
+                     ahist.account  = item;
+                     ahist.sequence = ++sequences[ item ];
+                     ahist.op_type  = o.op_type;
+                     ahist.op       = obj.id;
+                  });
+
+                  if( _prune )
+                     _prune_queue.insert( item );
+               }
+            }
+         }
+      });
+
+      if( ( first / batch_size ) % 100 == 0 )
+         ilog( "Account History: backfilled ${b} of ${h} blocks", ("b", blocks.back().block_num)("h", head) );
    }
+
+   if( _log )
+      _log->write_snapshot();
+
+   ilog( "Account History: backfilled ${n} operations of ${a} accounts", ("n", op_count)("a", sequences.size()) );
 }
 
 } // detail
@@ -209,6 +645,11 @@ void account_history_plugin::set_program_options(
          ("account-history-whitelist-ops", boost::program_options::value< vector< string > >()->composing(), "Defines a list of operations which will be explicitly logged.")
          ("account-history-blacklist-ops", boost::program_options::value< vector< string > >()->composing(), "Defines a list of operations which will be explicitly ignored.")
          ("history-disable-pruning", boost::program_options::value< bool >()->default_value( false ), "Disables automatic account history trimming" )
+         ("account-history-prune-interval", boost::program_options::value< uint32_t >()->default_value( 100 ), "Blocks between account history trimming runs" )
+         ("account-history-backfill", boost::program_options::value< bool >()->default_value( false ), "Builds the history of the transactions in the block log at startup when the node has none, virtual operations require a replay" )
+         ("account-history-backfill-threads", boost::program_options::value< uint32_t >()->default_value( 0 ), "Threads decoding blocks for the backfill, 0 uses one per core" )
+         ("account-history-store", boost::program_options::value< string >()->default_value( "shm" ), "Where the history of irreversible blocks is kept: 'shm' keeps it in the shared memory file, 'log' moves it to an append-only log in the data directory" )
+         ("account-history-log-snapshot-interval", boost::program_options::value< uint32_t >()->default_value( 1000 ), "Blocks between history log snapshots, history is dropped from the shared memory file once a snapshot covers it" )
          ;
 }
 
@@ -265,6 +706,54 @@ void account_history_plugin::plugin_initialize( const boost::program_options::va
    {
       my->_prune = !options[ "history-disable-pruning" ].as< bool >();
    }
+
+   if( options.count( "account-history-backfill" ) )
+      my->_backfill = options.at( "account-history-backfill" ).as< bool >();
+   if( options.count( "account-history-backfill-threads" ) )
+      my->_backfill_threads = options.at( "account-history-backfill-threads" ).as< uint32_t >();
+
+   // The chain plugin starts processing writes right after on_sync returns
+   if( my->_backfill )
+      my->_chain_sync_conn = appbase::app().get_plugin< amalgam::plugins::chain::chain_plugin >().on_sync.connect( 0, [&](){ my->backfill(); } );
+
+   if( options.count( "account-history-prune-interval" ) )
+   {
+      my->_prune_interval = options.at( "account-history-prune-interval" ).as< uint32_t >();
+      FC_ASSERT( my->_prune_interval > 0, "account-history-prune-interval must be positive" );
+   }
+
+   const string store = options.count( "account-history-store" ) ? options.at( "account-history-store" ).as< string >() : "shm";
+   FC_ASSERT( store == "shm" || store == "log", "Unknown account-history-store ${s}", ("s", store) );
+
+   if( store == "log" )
+   {
+      if( options.count( "account-history-log-snapshot-interval" ) )
+         my->_log_snapshot_interval = options.at( "account-history-log-snapshot-interval" ).as< uint32_t >();
+      FC_ASSERT( my->_log_snapshot_interval > 0, "account-history-log-snapshot-interval must be positive" );
+
+      // The log keeps the full history, pruning would leave gaps in the sequences
+      my->_prune = false;
+
+      my->_log = std::make_unique< history_log >();
+      my->_log->open( appbase::app().data_dir() / "account_history" );
+
+      ilog( "Account History: keeping irreversible history in ${d}", ("d", ( appbase::app().data_dir() / "account_history" ).string()) );
+   }
+
+   if( my->_prune || my->_log )
+   {
+      my->_post_apply_block_conn = my->_db.add_post_apply_block_handler(
+         [&]( const chain::block_notification& note ){ my->on_post_apply_block( note ); }, *this, 0 );
+      my->_pre_reindex_conn = my->_db.add_pre_reindex_handler(
+         [&]( const chain::reindex_notification& )
+         {
+            if( my->_log )
+               my->_log->wipe();
+            my->_history_cursor_valid = false;
+            my->_prune_cutoff_valid = false;
+            my->_prune_queue.clear();
+         }, *this, 0 );
+   }
 }
 
 void account_history_plugin::plugin_startup() {}
@@ -272,6 +761,12 @@ void account_history_plugin::plugin_startup() {}
 void account_history_plugin::plugin_shutdown()
 {
    chain::util::disconnect_signal( my->_pre_apply_operation_conn );
+   chain::util::disconnect_signal( my->_post_apply_block_conn );
+   chain::util::disconnect_signal( my->_pre_reindex_conn );
+   chain::util::disconnect_signal( my->_chain_sync_conn );
+
+   if( my->_log )
+      my->_log->close();
 }
 
 flat_map< account_name_type, account_name_type > account_history_plugin::tracked_accounts() const
@@ -279,4 +774,9 @@ flat_map< account_name_type, account_name_type > account_history_plugin::tracked
    return my->_tracked_accounts;
 }
 
+const history_log* account_history_plugin::get_history_log()const
+{
+   return my->_log.get();
+}
+
 } } } // amalgam::plugins::account_history
@@ -0,0 +1,666 @@
+#include <amalgam/plugins/account_history/history_log.hpp>
+
+#include <fc/io/raw.hpp>
+#include <fc/crypto/city.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/log/logger.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace amalgam { namespace plugins { namespace account_history { namespace detail {
+
+   /// operation numbers of one account, 256 bytes on disk
+   struct history_page
+   {
+      static const uint32_t capacity = 30;
+
+      /// number of the previous page of the account plus one, 0 for the first page
+      uint64_t    prev = 0;
+      uint32_t    first_sequence = 0;
+      uint32_t    count = 0;
+      uint64_t    ops[ capacity ];
+   };
+
+   static_assert( sizeof( history_page ) == 256, "history_page must stay 256 bytes" );
+
+   /// the last page of an account
+   struct account_head
+   {
+      /// page number plus one
+      uint64_t    page = 0;
+      uint32_t    first_sequence = 0;
+      uint32_t    count = 0;
+   };
+
+   /**
+    * File sizes and last pages of the accounts. The journal written between
+    * full snapshots holds the same struct with only the heads that changed.
+    */
+   struct history_log_snapshot
+   {
+      uint32_t                                     head_block = 0;
+      uint64_t                                     op_count = 0;
+      uint64_t                                     log_size = 0;
+      uint64_t                                     page_count = 0;
+      std::map< account_name_type, account_head >  heads;
+   };
+
+} } } } // amalgam::plugins::account_history::detail
+
+FC_REFLECT( amalgam::plugins::account_history::detail::account_head, (page)(first_sequence)(count) )
+FC_REFLECT( amalgam::plugins::account_history::detail::history_log_snapshot, (head_block)(op_count)(log_size)(page_count)(heads) )
+
+namespace amalgam { namespace plugins { namespace account_history {
+
+namespace detail {
+
+   namespace bfs = boost::filesystem;
+
+   /**
+    * Read-only descriptors of the column files. Logged data only changes by
+    * appending, so readers copy the sizes and heads they need under the lock
+    * and read with these without holding it.
+    */
+   class history_log_reader
+   {
+      public:
+         history_log_reader( const fc::path& dir );
+         ~history_log_reader();
+
+         uint64_t read_u64( int fd, uint64_t pos )const;
+         history_page read_page( uint64_t page )const;
+         stored_operation read_operation( uint64_t op )const;
+
+         int   log_fd = -1;
+         int   index_fd = -1;
+         int   block_fd = -1;
+         int   page_fd = -1;
+
+      private:
+         void close_files();
+         void read( int fd, char* data, size_t size, uint64_t pos )const;
+   };
+
+   class history_log_impl
+   {
+      public:
+         void open_file( std::fstream& stream, const fc::path& file, uint64_t size );
+         void load_snapshot();
+         void load_journal();
+         void repair_pages();
+         void write_full_snapshot();
+         void append_journal();
+
+         void write_u64( std::fstream& stream, uint64_t pos, uint64_t value );
+         history_page read_page( uint64_t page );
+         void write_page( uint64_t page, const history_page& p );
+         void append_entry( const history_log_entry& entry, uint64_t op );
+
+         void flush();
+         /** makes everything appended so far visible to the reader, called with the lock held */
+         std::shared_ptr< const history_log_reader > begin_read();
+
+         fc::path                  dir;
+         bool                      is_open = false;
+         std::fstream              log_stream;
+         std::fstream              index_stream;
+         std::fstream              block_stream;
+         std::fstream              page_stream;
+         /// set when the streams buffer data the reader does not see yet
+         bool                      unflushed = false;
+         /// kept alive by readers still using it after the log is closed
+         std::shared_ptr< const history_log_reader > reader;
+
+         history_log_snapshot      state;
+         uint32_t                  snapshot_block = 0;
+
+         /// accounts whose last page changed since the last snapshot
+         std::set< account_name_type > changed_heads;
+         /// heads written to the journal since the last full snapshot
+         uint64_t                  journal_heads = 0;
+
+         mutable std::mutex        mtx;
+   };
+
+   /** opens the file for reading and writing, cut to size when it is longer */
+   void history_log_impl::open_file( std::fstream& stream, const fc::path& file, uint64_t size )
+   {
+      if( !fc::exists( file ) )
+         std::ofstream( file.generic_string().c_str(), std::ios::out | std::ios::binary );
+
+      uint64_t file_size = bfs::file_size( file );
+      FC_ASSERT( file_size >= size, "${f} is shorter than the history log snapshot, wipe the history log and replay", ("f", file) );
+      if( file_size > size )
+      {
+         wlog( "Dropping ${n} bytes written to ${f} after the last history log snapshot", ("n", file_size - size)("f", file) );
+         bfs::resize_file( file, size );
+      }
+
+      stream.open( file.generic_string().c_str(), std::ios::in | std::ios::out | std::ios::binary );
+      FC_ASSERT( stream.good(), "Could not open ${f}", ("f", file) );
+   }
+
+   /** flushes the data of the file or directory to the disk */
+   void sync_file( const fc::path& file )
+   {
+      int fd = ::open( file.generic_string().c_str(), O_RDONLY );
+      FC_ASSERT( fd >= 0, "Could not open ${f}", ("f", file) );
+      int r = ::fsync( fd );
+      ::close( fd );
+      FC_ASSERT( r == 0, "Syncing ${f} failed", ("f", file) );
+   }
+
+   /** a failed read leaves the stream failing every later write, so it is reset before reporting the error */
+   void check_read( std::fstream& stream )
+   {
+      bool ok = stream.good();
+      stream.clear();
+      FC_ASSERT( ok, "History log read failed" );
+   }
+
+   void history_log_impl::load_snapshot()
+   {
+      state = history_log_snapshot();
+      changed_heads.clear();
+      journal_heads = 0;
+
+      fc::path file = dir / "snapshot";
+      if( fc::exists( file ) )
+      {
+         std::ifstream in( file.generic_string().c_str(), std::ios::in | std::ios::binary );
+         std::vector< char > data( ( std::istreambuf_iterator< char >( in ) ), std::istreambuf_iterator< char >() );
+         state = fc::raw::unpack_from_vector< history_log_snapshot >( data );
+      }
+
+      load_journal();
+   }
+
+   /**
+    * Applies the journal frames written after the full snapshot. Every frame
+    * is a size, a checksum and the packed changes, a frame cut short by a
+    * crash is dropped together with everything after it. Frames of blocks the
+    * full snapshot already covers are left from before it was written.
+    */
+   void history_log_impl::load_journal()
+   {
+      fc::path file = dir / "snapshot.journal";
+      if( !fc::exists( file ) )
+         return;
+
+      std::ifstream in( file.generic_string().c_str(), std::ios::in | std::ios::binary );
+      std::vector< char > data( ( std::istreambuf_iterator< char >( in ) ), std::istreambuf_iterator< char >() );
+      in.close();
+
+      size_t pos = 0;
+      while( data.size() - pos >= sizeof( uint32_t ) + sizeof( uint64_t ) )
+      {
+         uint32_t size;
+         uint64_t checksum;
+         std::memcpy( &size, data.data() + pos, sizeof( size ) );
+         std::memcpy( &checksum, data.data() + pos + sizeof( size ), sizeof( checksum ) );
+
+         size_t begin = pos + sizeof( size ) + sizeof( checksum );
+         if( data.size() - begin < size || fc::city_hash64( data.data() + begin, size ) != checksum )
+            break;
+
+         auto frame = fc::raw::unpack_from_vector< history_log_snapshot >( std::vector< char >( data.begin() + begin, data.begin() + begin + size ) );
+         pos = begin + size;
+
+         if( frame.head_block <= state.head_block )
+            continue;
+
+         state.head_block = frame.head_block;
+         state.op_count = frame.op_count;
+         state.log_size = frame.log_size;
+         state.page_count = frame.page_count;
+         for( const auto& h : frame.heads )
+            state.heads[ h.first ] = h.second;
+         journal_heads += frame.heads.size();
+      }
+
+      if( pos < data.size() )
+      {
+         wlog( "Dropping ${n} bytes of an incomplete history log journal frame", ("n", data.size() - pos) );
+         bfs::resize_file( file, pos );
+      }
+   }
+
+   /**
+    * Last pages may have been filled further after the snapshot. Entries past
+    * the snapshot are dropped by writing back the counts it recorded.
+    */
+   void history_log_impl::repair_pages()
+   {
+      for( const auto& h : state.heads )
+      {
+         history_page p = read_page( h.second.page - 1 );
+         if( p.count != h.second.count || p.first_sequence != h.second.first_sequence )
+         {
+            p.count = h.second.count;
+            p.first_sequence = h.second.first_sequence;
+            write_page( h.second.page - 1, p );
+         }
+      }
+   }
+
+   void history_log_impl::write_u64( std::fstream& stream, uint64_t pos, uint64_t value )
+   {
+      stream.seekp( pos * sizeof( value ) );
+      stream.write( (const char*)&value, sizeof( value ) );
+   }
+
+   history_page history_log_impl::read_page( uint64_t page )
+   {
+      history_page p;
+      page_stream.seekg( page * sizeof( p ) );
+      page_stream.read( (char*)&p, sizeof( p ) );
+      check_read( page_stream );
+      return p;
+   }
+
+   void history_log_impl::write_page( uint64_t page, const history_page& p )
+   {
+      page_stream.seekp( page * sizeof( p ) );
+      page_stream.write( (const char*)&p, sizeof( p ) );
+   }
+
+   void history_log_impl::flush()
+   {
+      log_stream.flush();
+      index_stream.flush();
+      block_stream.flush();
+      page_stream.flush();
+      FC_ASSERT( log_stream.good() && index_stream.good() && block_stream.good() && page_stream.good(),
+         "Writing the history log failed" );
+      unflushed = false;
+   }
+
+   std::shared_ptr< const history_log_reader > history_log_impl::begin_read()
+   {
+      if( unflushed )
+         flush();
+      return reader;
+   }
+
+   history_log_reader::history_log_reader( const fc::path& dir )
+   {
+      auto open_read = [&]( const char* name )
+      {
+         fc::path file = dir / name;
+         int fd = ::open( file.generic_string().c_str(), O_RDONLY );
+         FC_ASSERT( fd >= 0, "Could not open ${f}", ("f", file) );
+         return fd;
+      };
+
+      try
+      {
+         log_fd = open_read( "operations.log" );
+         index_fd = open_read( "operations.index" );
+         block_fd = open_read( "blocks.index" );
+         page_fd = open_read( "accounts.pages" );
+      }
+      catch( ... )
+      {
+         close_files();
+         throw;
+      }
+   }
+
+   history_log_reader::~history_log_reader()
+   {
+      close_files();
+   }
+
+   void history_log_reader::close_files()
+   {
+      for( int* fd : { &log_fd, &index_fd, &block_fd, &page_fd } )
+      {
+         if( *fd >= 0 )
+            ::close( *fd );
+         *fd = -1;
+      }
+   }
+
+   void history_log_reader::read( int fd, char* data, size_t size, uint64_t pos )const
+   {
+      while( size )
+      {
+         ssize_t n = ::pread( fd, data, size, off_t( pos ) );
+         if( n < 0 && errno == EINTR )
+            continue;
+         FC_ASSERT( n > 0, "History log read failed" );
+         data += n;
+         size -= n;
+         pos += n;
+      }
+   }
+
+   uint64_t history_log_reader::read_u64( int fd, uint64_t pos )const
+   {
+      uint64_t value = 0;
+      read( fd, (char*)&value, sizeof( value ), pos * sizeof( value ) );
+      return value;
+   }
+
+   history_page history_log_reader::read_page( uint64_t page )const
+   {
+      history_page p;
+      read( page_fd, (char*)&p, sizeof( p ), page * sizeof( p ) );
+      return p;
+   }
+
+   stored_operation history_log_reader::read_operation( uint64_t op )const
+   {
+      uint64_t begin = op ? read_u64( index_fd, op - 1 ) : 0;
+      uint64_t end = read_u64( index_fd, op );
+
+      std::vector< char > data( end - begin );
+      read( log_fd, data.data(), data.size(), begin );
+      return fc::raw::unpack_from_vector< stored_operation >( data );
+   }
+
+   void history_log_impl::append_entry( const history_log_entry& entry, uint64_t op )
+   {
+      account_head& head = state.heads[ entry.account ];
+      changed_heads.insert( entry.account );
+
+      // A new page starts when the last one is full or the sequence does not follow it
+      if( !head.page || head.count == history_page::capacity || head.first_sequence + head.count != entry.sequence )
+      {
+         history_page p{};
+         p.prev = head.page;
+         p.first_sequence = entry.sequence;
+         p.count = 1;
+         p.ops[0] = op;
+         write_page( state.page_count, p );
+
+         head.page = ++state.page_count;
+         head.first_sequence = entry.sequence;
+         head.count = 1;
+         return;
+      }
+
+      uint64_t pos = ( head.page - 1 ) * sizeof( history_page );
+      page_stream.seekp( pos + offsetof( history_page, ops ) + head.count * sizeof( uint64_t ) );
+      page_stream.write( (const char*)&op, sizeof( op ) );
+
+      ++head.count;
+      page_stream.seekp( pos + offsetof( history_page, count ) );
+      page_stream.write( (const char*)&head.count, sizeof( head.count ) );
+   }
+
+   void history_log_impl::write_full_snapshot()
+   {
+      fc::path tmp = dir / "snapshot.tmp";
+      {
+         auto data = fc::raw::pack_to_vector( state );
+         std::ofstream out( tmp.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+         out.write( data.data(), data.size() );
+         out.flush();
+         FC_ASSERT( out.good(), "Writing ${f} failed", ("f", tmp) );
+      }
+      sync_file( tmp );
+      fc::rename( tmp, dir / "snapshot" );
+      sync_file( dir );
+
+      // Left over frames are skipped on load should the removal not make it to the disk
+      fc::remove_all( dir / "snapshot.journal" );
+      journal_heads = 0;
+   }
+
+   void history_log_impl::append_journal()
+   {
+      history_log_snapshot frame;
+      frame.head_block = state.head_block;
+      frame.op_count = state.op_count;
+      frame.log_size = state.log_size;
+      frame.page_count = state.page_count;
+      for( const auto& account : changed_heads )
+         frame.heads[ account ] = state.heads[ account ];
+
+      auto data = fc::raw::pack_to_vector( frame );
+      uint32_t size = data.size();
+      uint64_t checksum = fc::city_hash64( data.data(), data.size() );
+
+      std::vector< char > buffer( sizeof( size ) + sizeof( checksum ) );
+      std::memcpy( buffer.data(), &size, sizeof( size ) );
+      std::memcpy( buffer.data() + sizeof( size ), &checksum, sizeof( checksum ) );
+      buffer.insert( buffer.end(), data.begin(), data.end() );
+
+      fc::path file = dir / "snapshot.journal";
+      bool created = !fc::exists( file );
+      int fd = ::open( file.generic_string().c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644 );
+      FC_ASSERT( fd >= 0, "Could not open ${f}", ("f", file) );
+      bool ok = ::write( fd, buffer.data(), buffer.size() ) == ssize_t( buffer.size() ) && ::fsync( fd ) == 0;
+      ::close( fd );
+      FC_ASSERT( ok, "Writing ${f} failed", ("f", file) );
+      if( created )
+         sync_file( dir );
+
+      journal_heads += frame.heads.size();
+   }
+
+} // detail
+
+history_log::history_log() : my( new detail::history_log_impl() ) {}
+
+history_log::~history_log()
+{
+   close();
+}
+
+void history_log::open( const fc::path& dir )
+{
+   std::lock_guard< std::mutex > guard( my->mtx );
+   FC_ASSERT( !my->is_open, "History log is already open" );
+
+   my->dir = dir;
+   if( !fc::exists( dir ) )
+      fc::create_directories( dir );
+
+   my->load_snapshot();
+   my->snapshot_block = my->state.head_block;
+
+   my->open_file( my->log_stream, dir / "operations.log", my->state.log_size );
+   my->open_file( my->index_stream, dir / "operations.index", my->state.op_count * sizeof( uint64_t ) );
+   my->open_file( my->block_stream, dir / "blocks.index", uint64_t( my->state.head_block ) * sizeof( uint64_t ) );
+   my->open_file( my->page_stream, dir / "accounts.pages", my->state.page_count * sizeof( detail::history_page ) );
+
+   my->repair_pages();
+   my->flush();
+   my->reader = std::make_shared< detail::history_log_reader >( dir );
+
+   my->is_open = true;
+   ilog( "Opened history log at block ${b} with ${n} operations", ("b", my->state.head_block)("n", my->state.op_count) );
+}
+
+void history_log::close()
+{
+   if( !is_open() )
+      return;
+
+   write_snapshot();
+
+   std::lock_guard< std::mutex > guard( my->mtx );
+   my->log_stream.close();
+   my->index_stream.close();
+   my->block_stream.close();
+   my->page_stream.close();
+   my->reader.reset();
+   my->is_open = false;
+}
+
+void history_log::wipe()
+{
+   fc::path dir = my->dir;
+   close();
+
+   for( const char* name : { "operations.log", "operations.index", "blocks.index", "accounts.pages", "snapshot", "snapshot.journal" } )
+      fc::remove_all( dir / name );
+
+   open( dir );
+}
+
+bool history_log::is_open()const
+{
+   std::lock_guard< std::mutex > guard( my->mtx );
+   return my->is_open;
+}
+
+uint32_t history_log::head_block()const
+{
+   std::lock_guard< std::mutex > guard( my->mtx );
+   return my->state.head_block;
+}
+
+uint32_t history_log::snapshot_block()const
+{
+   std::lock_guard< std::mutex > guard( my->mtx );
+   return my->snapshot_block;
+}
+
+uint32_t history_log::next_sequence( const account_name_type& account )const
+{
+   std::lock_guard< std::mutex > guard( my->mtx );
+   auto itr = my->state.heads.find( account );
+   if( itr == my->state.heads.end() )
+      return 1;
+   return itr->second.first_sequence + itr->second.count;
+}
+
+void history_log::append_block( uint32_t block_num, const std::vector< history_log_operation >& ops )
+{
+   std::lock_guard< std::mutex > guard( my->mtx );
+   FC_ASSERT( my->is_open, "History log is not open" );
+   FC_ASSERT( block_num > my->state.head_block, "Block ${b} is already in the history log", ("b", block_num) );
+
+   // Blocks without tracked operations, or from before the log was started
+   while( my->state.head_block + 1 < block_num )
+      my->write_u64( my->block_stream, my->state.head_block++, my->state.op_count );
+
+   my->log_stream.seekp( my->state.log_size );
+   for( const auto& o : ops )
+   {
+      auto data = fc::raw::pack_to_vector( o.op );
+      my->log_stream.write( data.data(), data.size() );
+      my->state.log_size += data.size();
+
+      uint64_t op = my->state.op_count++;
+      my->write_u64( my->index_stream, op, my->state.log_size );
+
+      for( const auto& entry : o.entries )
+         my->append_entry( entry, op );
+   }
+
+   my->write_u64( my->block_stream, my->state.head_block++, my->state.op_count );
+   my->unflushed = true;
+}
+
+void history_log::write_snapshot()
+{
+   std::lock_guard< std::mutex > guard( my->mtx );
+   if( !my->is_open )
+      return;
+
+   my->flush();
+
+   // The snapshot may only point at data that is on the disk
+   for( const char* name : { "operations.log", "operations.index", "blocks.index", "accounts.pages" } )
+      detail::sync_file( my->dir / name );
+
+   // Only the changed heads are journaled, until the journal outgrows a full snapshot
+   if( my->journal_heads + my->changed_heads.size() > my->state.heads.size() )
+      my->write_full_snapshot();
+   else
+      my->append_journal();
+
+   my->changed_heads.clear();
+   my->snapshot_block = my->state.head_block;
+}
+
+std::vector< stored_operation > history_log::get_block_operations( uint32_t block_num )const
+{
+   std::vector< stored_operation > result;
+   std::shared_ptr< const detail::history_log_reader > reader;
+   {
+      std::lock_guard< std::mutex > guard( my->mtx );
+      if( !my->is_open || block_num == 0 || block_num > my->state.head_block )
+         return result;
+      reader = my->begin_read();
+   }
+
+   uint64_t begin = block_num > 1 ? reader->read_u64( reader->block_fd, block_num - 2 ) : 0;
+   uint64_t end = reader->read_u64( reader->block_fd, block_num - 1 );
+
+   result.reserve( end - begin );
+   for( uint64_t op = begin; op < end; ++op )
+      result.push_back( reader->read_operation( op ) );
+
+   return result;
+}
+
+/**
+ * Pages other than the head page of an account are never written again, and
+ * the head page only gets slots past the count copied here. The walk runs
+ * without the lock, so writers never wait behind a long scan.
+ */
+void history_log::get_account_history( const account_name_type& account, uint32_t start,
+   const std::function< bool(uint32_t sequence, stored_operation&& op) >& visit )const
+{
+   std::shared_ptr< const detail::history_log_reader > reader;
+   detail::account_head head;
+   {
+      std::lock_guard< std::mutex > guard( my->mtx );
+      if( !my->is_open )
+         return;
+
+      auto itr = my->state.heads.find( account );
+      if( itr == my->state.heads.end() )
+         return;
+
+      head = itr->second;
+      reader = my->begin_read();
+   }
+
+   uint64_t page = head.page;
+   while( page )
+   {
+      detail::history_page p = reader->read_page( page - 1 );
+      if( page == head.page )
+      {
+         p.first_sequence = head.first_sequence;
+         p.count = head.count;
+      }
+      page = p.prev;
+
+      if( !p.count || p.first_sequence > start )
+         continue;
+
+      int64_t last = std::min< int64_t >( start, int64_t( p.first_sequence ) + p.count - 1 );
+      for( int64_t seq = last; seq >= p.first_sequence; --seq )
+      {
+         if( !visit( uint32_t( seq ), reader->read_operation( p.ops[ seq - p.first_sequence ] ) ) )
+            return;
+      }
+   }
+}
+
+uint32_t history_log::operation_type( const stored_operation& op )
+{
+   fc::unsigned_int which;
+   fc::datastream< const char* > ds( op.serialized_op.data(), op.serialized_op.size() );
+   fc::raw::unpack( ds, which );
+   return which.value;
+}
+
+} } } // amalgam::plugins::account_history
@@ -7,6 +7,8 @@ namespace amalgam { namespace plugins { namespace account_history {
 
 namespace detail { class account_history_plugin_impl; }
 
+class history_log;
+
 using namespace appbase;
 using amalgam::protocol::account_name_type;
 
@@ -47,6 +49,9 @@ class account_history_plugin : public plugin< account_history_plugin >
 
       flat_map< account_name_type, account_name_type > tracked_accounts()const; /// map start_range to end_range
 
+      /// history of irreversible blocks moved out of the chain state, nullptr unless account-history-store is log
+      const history_log* get_history_log()const;
+
    private:
       std::unique_ptr< detail::account_history_plugin_impl > my;
 };
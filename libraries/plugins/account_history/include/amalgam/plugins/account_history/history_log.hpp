@@ -0,0 +1,121 @@
+#pragma once
+
+#include <amalgam/protocol/types.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/time.hpp>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace amalgam { namespace plugins { namespace account_history {
+
+using amalgam::protocol::account_name_type;
+using amalgam::protocol::transaction_id_type;
+
+namespace detail { class history_log_impl; }
+
+/** An operation_object as kept in the history log */
+struct stored_operation
+{
+   transaction_id_type  trx_id;
+   uint32_t             block = 0;
+   uint32_t             trx_in_block = 0;
+   uint32_t             op_in_trx = 0;
+   uint32_t             virtual_op = 0;
+   fc::time_point_sec   timestamp;
+   std::vector< char >  serialized_op;
+};
+
+/** One account_history_object pointing at the operation it is stored with */
+struct history_log_entry
+{
+   account_name_type    account;
+   uint32_t             sequence = 0;
+};
+
+struct history_log_operation
+{
+   stored_operation                 op;
+   std::vector< history_log_entry > entries;
+};
+
+/**
+ * Append-only store for the account history of irreversible blocks, kept
+ * outside of the shared memory file.
+ *
+ * The data is split in columns, each in its own file:
+ *
+ *  - operations.log:   the fc::raw packed operations in the order they were applied
+ *  - operations.index: end offset in operations.log of every operation
+ *  - blocks.index:     number of operations logged up to and including every block
+ *  - accounts.pages:   pages of operation numbers of one account, linked to the
+ *                      account's previous page, so the newest history of an
+ *                      account is read without touching the rest
+ *
+ * The last page of every account is kept in memory and saved with the file
+ * sizes in a snapshot. Between full snapshots only the pages that changed are
+ * appended to a journal. Both are written once the files are synced to the
+ * disk. Opening the log cuts the files back to the last
+ * snapshot, so everything appended after it must still be available from
+ * the chain state. The plugin only drops history from the chain state once
+ * a snapshot covers it.
+ *
+ * All methods may be called from any thread. Reads hold the lock only to
+ * look up where they start, so appends never wait for a long read.
+ */
+class history_log
+{
+   public:
+      history_log();
+      ~history_log();
+
+      void open( const fc::path& dir );
+      void close();
+
+      /** removes all logged history, used when the chain state is rebuilt */
+      void wipe();
+
+      bool is_open()const;
+
+      /** last block whose operations are in the log, 0 when it is empty */
+      uint32_t head_block()const;
+
+      /** last block covered by the snapshot */
+      uint32_t snapshot_block()const;
+
+      /** sequence following the account's last logged entry */
+      uint32_t next_sequence( const account_name_type& account )const;
+
+      /**
+       * Appends the operations of an irreversible block. Blocks must come in
+       * increasing order, blocks skipped are logged without operations.
+       */
+      void append_block( uint32_t block_num, const std::vector< history_log_operation >& ops );
+
+      /** syncs the files to the disk and makes everything appended so far survive a crash */
+      void write_snapshot();
+
+      std::vector< stored_operation > get_block_operations( uint32_t block_num )const;
+
+      /**
+       * Visits the entries of the account, starting at sequence start and
+       * going back in time, until visit returns false. Entries appended
+       * while it runs are not visited.
+       */
+      void get_account_history( const account_name_type& account, uint32_t start,
+         const std::function< bool(uint32_t sequence, stored_operation&& op) >& visit )const;
+
+      /** which() of the packed operation, without unpacking the rest of it */
+      static uint32_t operation_type( const stored_operation& op );
+
+   private:
+      std::unique_ptr< detail::history_log_impl > my;
+};
+
+} } } // amalgam::plugins::account_history
+
+FC_REFLECT( amalgam::plugins::account_history::stored_operation, (trx_id)(block)(trx_in_block)(op_in_trx)(virtual_op)(timestamp)(serialized_op) )
+FC_REFLECT( amalgam::plugins::account_history::history_log_entry, (account)(sequence) )
+FC_REFLECT( amalgam::plugins::account_history::history_log_operation, (op)(entries) )
@@ -1,7 +1,7 @@
 #include <amalgam/plugins/account_by_key_api/account_by_key_api_plugin.hpp>
 #include <amalgam/plugins/account_by_key_api/account_by_key_api.hpp>
 
-#include <amalgam/plugins/account_by_key/account_by_key_objects.hpp>
+#include <amalgam/plugins/account_by_key/account_by_key_plugin.hpp>
 
 namespace amalgam { namespace plugins { namespace account_by_key {
 
@@ -10,35 +10,19 @@ namespace detail {
 class account_by_key_api_impl
 {
    public:
-      account_by_key_api_impl() : _db( appbase::app().get_plugin< amalgam::plugins::chain::chain_plugin >().db() ) {}
+      account_by_key_api_impl() :
+         _db( appbase::app().get_plugin< amalgam::plugins::chain::chain_plugin >().db() ),
+         _plugin( appbase::app().get_plugin< amalgam::plugins::account_by_key::account_by_key_plugin >() ) {}
 
       get_key_references_return get_key_references( const get_key_references_args& args )const;
 
-      chain::database& _db;
+      chain::database&                 _db;
+      const account_by_key_plugin&     _plugin;
 };
 
 get_key_references_return account_by_key_api_impl::get_key_references( const get_key_references_args& args )const
 {
-   get_key_references_return final_result;
-   final_result.reserve( args.keys.size() );
-
-   const auto& key_idx = _db.get_index< account_by_key::key_lookup_index >().indices().get< account_by_key::by_key >();
-
-   for( auto& key : args.keys )
-   {
-      std::vector< amalgam::protocol::account_name_type > result;
-      auto lookup_itr = key_idx.lower_bound( key );
-
-      while( lookup_itr != key_idx.end() && lookup_itr->key == key )
-      {
-         result.push_back( lookup_itr->account );
-         ++lookup_itr;
-      }
-
-      final_result.emplace_back( std::move( result ) );
-   }
-
-   return final_result;
+   return _plugin.get_key_references( args.keys );
 }
 
 } // detail
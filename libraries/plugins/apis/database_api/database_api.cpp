@@ -7,9 +7,14 @@
 #include <amalgam/protocol/exceptions.hpp>
 #include <amalgam/protocol/transaction_util.hpp>
 
+#include <amalgam/chain/schema_types.hpp>
+
+#include <amalgam/plugins/account_history/history_log.hpp>
+
 #include <amalgam/utilities/git_revision.hpp>
 
 #include <fc/git_revision.hpp>
+#include <fc/io/json_writer.hpp>
 
 namespace amalgam { namespace plugins { namespace database_api {
 
@@ -71,6 +76,15 @@ class database_api_impl
          (find_decline_voting_rights_requests)
          (list_limit_orders)
          (find_limit_orders)
+         (export_accounts)
+         (export_witnesses)
+         (export_witness_votes)
+         (export_escrows)
+         (export_withdraw_vesting_routes)
+         (export_savings_withdrawals)
+         (export_vesting_delegations)
+         (export_abd_conversion_requests)
+         (export_limit_orders)
          (get_transaction_hex)
          (get_required_signatures)
          (get_potential_signatures)
@@ -96,7 +110,61 @@ class database_api_impl
          }
       }
 
+      template< typename IndexType, typename ResultType, typename OnPush >
+      export_objects_return< ResultType > export_objects( const export_objects_args& args, OnPush&& on_push )
+      {
+         FC_ASSERT( args.limit > 0, "limit must be greater than 0" );
+         FC_ASSERT( args.limit <= DATABASE_API_EXPORT_LIMIT, "limit must be at most ${l}", ("l", DATABASE_API_EXPORT_LIMIT) );
+         FC_ASSERT( args.cursor >= 0, "cursor must not be negative" );
+
+         const auto& idx = _db.get_index< IndexType, chain::by_id >();
+         auto itr = idx.lower_bound( typename IndexType::value_type::id_type( args.cursor ) );
+         auto end = idx.end();
+
+         export_objects_return< ResultType > result;
+         result.objects.reserve( std::min< size_t >( args.limit, idx.size() ) );
+
+         for( ; itr != end; ++itr )
+         {
+            int64_t id = itr->id._id;
+            if( args.end.valid() && id >= *args.end )
+               break;
+
+            if( result.objects.size() == args.limit )
+            {
+               result.next = id;
+               break;
+            }
+
+            result.objects.push_back( on_push( *itr ) );
+         }
+
+         return result;
+      }
+
+      /** Pre-serialized result of a getter that takes no arguments, rendered on the writer thread */
+      struct head_snapshot
+      {
+         string                                             method;
+         std::shared_ptr< json_rpc::api_snapshot >          snapshot;
+         std::function< string() >                          render;
+      };
+
+      template< typename Args, typename Ret >
+      void add_head_snapshot( const string& method, Ret (database_api_impl::*getter)( const Args& ) )
+      {
+         _head_snapshots.push_back( head_snapshot{ method, std::make_shared< json_rpc::api_snapshot >(),
+            [this,getter]() { return fc::json_writer::to_string( (this->*getter)( Args() ) ); } } );
+      }
+
+      void refresh_head_snapshots();
+
       chain::database& _db;
+
+      vector< head_snapshot > _head_snapshots;
+
+      boost::signals2::connection _post_apply_block_conn;
+      boost::signals2::connection _irreversible_block_conn;
 };
 
 //////////////////////////////////////////////////////////////////////
@@ -109,14 +177,79 @@ database_api::database_api()
    : my( new database_api_impl() )
 {
    JSON_RPC_REGISTER_API( AMALGAM_DATABASE_API_PLUGIN_NAME );
+
+   // Results for blocks that exist only change when a fork replaces the block
+   auto& json_rpc = appbase::app().get_plugin< amalgam::plugins::json_rpc::json_rpc_plugin >();
+   json_rpc.add_cacheable_method( AMALGAM_DATABASE_API_PLUGIN_NAME, "get_block_header" );
+   json_rpc.add_cacheable_method( AMALGAM_DATABASE_API_PLUGIN_NAME, "get_block" );
+   json_rpc.add_cacheable_method( AMALGAM_DATABASE_API_PLUGIN_NAME, "get_ops_in_block" );
+   json_rpc.add_cacheable_method( AMALGAM_DATABASE_API_PLUGIN_NAME, "get_transaction" );
+
+   for( const auto& s : my->_head_snapshots )
+      json_rpc.add_api_snapshot( AMALGAM_DATABASE_API_PLUGIN_NAME, s.method, s.snapshot );
 }
 
 database_api::~database_api() {}
 
 database_api_impl::database_api_impl()
-   : _db( appbase::app().get_plugin< amalgam::plugins::chain::chain_plugin >().db() ) {}
+   : _db( appbase::app().get_plugin< amalgam::plugins::chain::chain_plugin >().db() )
+{
+   auto& json_rpc = appbase::app().get_plugin< amalgam::plugins::json_rpc::json_rpc_plugin >();
+   const auto& plugin = appbase::app().get_plugin< amalgam::plugins::database_api::database_api_plugin >();
+
+   // Global getters change at most once per block and make up most of the api traffic
+   add_head_snapshot( "get_dynamic_global_properties", &database_api_impl::get_dynamic_global_properties );
+   add_head_snapshot( "get_witness_schedule", &database_api_impl::get_witness_schedule );
+   add_head_snapshot( "get_reserve_ratio", &database_api_impl::get_reserve_ratio );
+   add_head_snapshot( "get_current_price_feed", &database_api_impl::get_current_price_feed );
+   add_head_snapshot( "get_feed_history", &database_api_impl::get_feed_history );
+   add_head_snapshot( "get_active_witnesses", &database_api_impl::get_active_witnesses );
+
+   _post_apply_block_conn = _db.add_post_apply_block_handler(
+      [&json_rpc,this]( const chain::block_notification& note )
+      {
+         json_rpc.on_block_applied( note.block_num );
+         refresh_head_snapshots();
+      },
+      plugin, 0 );
+   _irreversible_block_conn = _db.add_irreversible_block_handler(
+      [&json_rpc]( uint32_t block_num ){ json_rpc.on_irreversible_block( block_num ); },
+      plugin, 0 );
+}
+
+database_api_impl::~database_api_impl()
+{
+   _post_apply_block_conn.disconnect();
+   _irreversible_block_conn.disconnect();
+}
 
-database_api_impl::~database_api_impl() {}
+/**
+ * Runs under the write lock right after a block is applied. Snapshots nobody
+ * asked for since the last block are dropped instead of rendered, which keeps
+ * replay and sync free of the serialization cost. Calls made while a snapshot
+ * is empty go through the read lock as usual.
+ */
+void database_api_impl::refresh_head_snapshots()
+{
+   for( auto& s : _head_snapshots )
+   {
+      if( !s.snapshot->take_requested() )
+      {
+         s.snapshot->clear();
+         continue;
+      }
+
+      try
+      {
+         s.snapshot->set( std::make_shared< const string >( s.render() ) );
+      }
+      catch( const fc::exception& e )
+      {
+         s.snapshot->clear();
+         wlog( "Could not refresh the ${m} snapshot: ${e}", ("m", s.method)("e", e.to_detail_string()) );
+      }
+   }
+}
 
 //////////////////////////////////////////////////////////////////////
 //                                                                  //
@@ -128,7 +261,10 @@ DEFINE_API_IMPL( database_api_impl, get_block_header )
 {
    auto result = _db.fetch_block_by_number( args.block_num );
    if( result )
+   {
+      json_rpc::json_rpc_plugin::cache_response( args.block_num );
       return *result;
+   }
    return {};
 }
 
@@ -136,7 +272,10 @@ DEFINE_API_IMPL( database_api_impl, get_block )
 {
    auto result = _db.fetch_block_by_number( args.block_num );
    if( result )
+   {
+      json_rpc::json_rpc_plugin::cache_response( args.block_num );
       return *result;
+   }
    return {};
 }
 
@@ -159,6 +298,22 @@ DEFINE_API_IMPL( database_api_impl, get_ops_in_block )
          ++itr;
       }
 
+      // Irreversible blocks may have been moved to the history log
+      const auto* log = appbase::app().get_plugin< amalgam::plugins::account_history::account_history_plugin >().get_history_log();
+      if( result.empty() && log && args.block_num <= log->head_block() )
+      {
+         for( const auto& stored : log->get_block_operations( args.block_num ) )
+         {
+            api_operation_object temp = stored;
+            if( !args.only_virtual || is_virtual_operation( temp.op ) )
+               result.emplace( std::move( temp ) );
+         }
+      }
+
+      // Operations of a block are all indexed when the block is applied
+      if( args.block_num <= _db.head_block_num() )
+         json_rpc::json_rpc_plugin::cache_response( args.block_num );
+
       return result;
    });
 }
@@ -186,6 +341,7 @@ DEFINE_API_IMPL( database_api_impl, get_transaction )
          result = blk->transactions[itr->trx_in_block];
          result.block_num       = itr->block;
          result.transaction_num = itr->trx_in_block;
+         json_rpc::json_rpc_plugin::cache_response( itr->block );
       }
       else
       {
@@ -523,30 +679,134 @@ DEFINE_API_IMPL( database_api_impl, get_account_history )
    FC_ASSERT( appbase::app().find_plugin< amalgam::plugins::account_history::account_history_plugin >() != nullptr,
       "This function works only if account_history plugin is enabled" );
    FC_ASSERT( args.limit <= 10000, "limit of ${l} is greater than maximum allowed", ("l",args.limit) );
-   FC_ASSERT( args.start >= args.limit, "start must be greater than limit" );
 
-   return _db.with_read_lock( [&]()
+   std::vector< uint32_t > op_types;
+   for( uint32_t i = 0; i < 64; ++i )
+   {
+      if( ( args.operation_filter_low >> i ) & 1 )
+         op_types.push_back( i );
+   }
+   for( uint32_t i = 0; i < 64; ++i )
+   {
+      if( ( args.operation_filter_high >> i ) & 1 )
+         op_types.push_back( 64 + i );
+   }
+   bool filtered = op_types.size() || args.from_time || args.to_time;
+
+   // Without a filter start and limit address a range of sequences
+   FC_ASSERT( filtered || args.start >= args.limit, "start must be greater than limit" );
+
+   auto selected = [&]( uint32_t op_type )
+   {
+      return op_types.empty() || std::binary_search( op_types.begin(), op_types.end(), op_type );
+   };
+
+   get_account_history_return result;
+   uint64_t start = args.start;
+   uint32_t n = 0;
+   bool done = false;
+
+   auto add = [&]( uint32_t sequence, api_operation_object&& op )
+   {
+      if( args.from_time && op.timestamp < *args.from_time )
+      {
+         done = true;
+         return;
+      }
+      result[ sequence ] = std::move( op );
+      done = ++n >= args.limit;
+   };
+
+   _db.with_read_lock( [&]()
    {
       const auto& idx = _db.get_index< chain::account_history_index, chain::by_account >();
-      auto itr = idx.lower_bound( boost::make_tuple( args.account, args.start ) );
-      uint32_t n = 0;
 
-      get_account_history_return result;
-      while( true )
+      // Sequences grow with time, the last entry up to to_time is found by bisection
+      if( args.to_time )
       {
-         if( itr == idx.end() )
-            break;
-         if( itr->account != args.account )
-            break;
-         if( n >= args.limit )
-            break;
-         result[ itr->sequence ] = _db.get( itr->op );
-         ++itr;
-         ++n;
+         auto newest = idx.lower_bound( boost::make_tuple( args.account, uint32_t(-1) ) );
+         if( newest != idx.end() && newest->account == args.account && _db.get( newest->op ).timestamp > *args.to_time )
+         {
+            auto oldest = idx.lower_bound( boost::make_tuple( args.account, 0 ) );
+            --oldest;
+
+            uint64_t low = oldest->sequence - 1, high = std::min< uint64_t >( start, newest->sequence );
+            while( low < high )
+            {
+               uint64_t mid = high - ( high - low ) / 2;
+               auto itr = idx.lower_bound( boost::make_tuple( args.account, uint32_t( mid ) ) );
+               if( _db.get( itr->op ).timestamp <= *args.to_time )
+                  low = mid;
+               else
+                  high = mid - 1;
+            }
+            // A start below the oldest entry in the chain state is kept for the history log
+            start = std::min< uint64_t >( start, low );
+         }
       }
 
-      return result;
+      if( op_types.empty() )
+      {
+         for( auto itr = idx.lower_bound( boost::make_tuple( args.account, start ) );
+              !done && itr != idx.end() && itr->account == args.account; ++itr )
+            add( itr->sequence, _db.get( itr->op ) );
+      }
+      else
+      {
+         // Merges the newest entries of every selected type
+         const auto& type_idx = _db.get_index< chain::account_history_index, chain::by_account_op_type >();
+         typedef decltype( type_idx.begin() ) type_iterator;
+         std::vector< type_iterator > heads;
+
+         for( uint32_t op_type : op_types )
+         {
+            auto itr = type_idx.lower_bound( boost::make_tuple( args.account, op_type, start ) );
+            if( itr != type_idx.end() && itr->account == args.account && itr->op_type == op_type )
+               heads.push_back( itr );
+         }
+
+         while( !done && heads.size() )
+         {
+            auto next = std::max_element( heads.begin(), heads.end(),
+               []( const type_iterator& a, const type_iterator& b ){ return a->sequence < b->sequence; } );
+
+            add( (*next)->sequence, _db.get( (*next)->op ) );
+
+            uint32_t op_type = (*next)->op_type;
+            if( ++(*next) == type_idx.end() || (*next)->account != args.account || (*next)->op_type != op_type )
+               heads.erase( next );
+         }
+      }
+
+      // Older entries continue in the history log
+      auto oldest = idx.lower_bound( boost::make_tuple( args.account, 0 ) );
+      if( oldest != idx.begin() && (--oldest)->account == args.account )
+         start = std::min< uint64_t >( start, oldest->sequence - 1 );
    });
+
+   /*
+    * Entries only leave the chain state once the log holds them, so the log
+    * continues right below start. The log reads its files without holding
+    * its lock, so neither it nor the database read lock is held while a
+    * filtered or time bounded query walks the account's logged history,
+    * which takes time proportional to the entries skipped.
+    */
+   const auto* log = appbase::app().get_plugin< amalgam::plugins::account_history::account_history_plugin >().get_history_log();
+   if( log && !done && start > 0 )
+   {
+      log->get_account_history( args.account, uint32_t( std::min< uint64_t >( start, std::numeric_limits< uint32_t >::max() ) ),
+         [&]( uint32_t sequence, amalgam::plugins::account_history::stored_operation&& op )
+         {
+            if( !selected( amalgam::plugins::account_history::history_log::operation_type( op ) )
+               || ( args.to_time && op.timestamp > *args.to_time ) )
+               return true;
+
+            add( sequence, op );
+            return !done;
+         });
+   }
+
+   return result;
 }
 
 DEFINE_API_IMPL( database_api_impl, get_account_bandwidth )
@@ -1321,6 +1581,66 @@ DEFINE_API_IMPL( database_api_impl, verify_signatures )
    return result;
 }
 
+//////////////////////////////////////////////////////////////////////
+//                                                                  //
+// Bulk export                                                      //
+//                                                                  //
+//////////////////////////////////////////////////////////////////////
+
+DEFINE_API_IMPL( database_api_impl, export_accounts )
+{
+   return export_objects< chain::account_index, api_account_object >( args,
+      [&]( const account_object& a ){ return api_account_object( a, _db ); } );
+}
+
+DEFINE_API_IMPL( database_api_impl, export_witnesses )
+{
+   return export_objects< chain::witness_index, api_witness_object >( args,
+      [&]( const witness_object& w ){ return api_witness_object( w ); } );
+}
+
+DEFINE_API_IMPL( database_api_impl, export_witness_votes )
+{
+   return export_objects< chain::witness_vote_index, api_witness_vote_object >( args,
+      &database_api_impl::on_push_default< api_witness_vote_object > );
+}
+
+DEFINE_API_IMPL( database_api_impl, export_escrows )
+{
+   return export_objects< chain::escrow_index, api_escrow_object >( args,
+      &database_api_impl::on_push_default< api_escrow_object > );
+}
+
+DEFINE_API_IMPL( database_api_impl, export_withdraw_vesting_routes )
+{
+   return export_objects< chain::withdraw_vesting_route_index, api_withdraw_vesting_route_object >( args,
+      &database_api_impl::on_push_default< api_withdraw_vesting_route_object > );
+}
+
+DEFINE_API_IMPL( database_api_impl, export_savings_withdrawals )
+{
+   return export_objects< chain::savings_withdraw_index, api_savings_withdraw_object >( args,
+      [&]( const savings_withdraw_object& w ){ return api_savings_withdraw_object( w ); } );
+}
+
+DEFINE_API_IMPL( database_api_impl, export_vesting_delegations )
+{
+   return export_objects< chain::vesting_delegation_index, api_vesting_delegation_object >( args,
+      &database_api_impl::on_push_default< api_vesting_delegation_object > );
+}
+
+DEFINE_API_IMPL( database_api_impl, export_abd_conversion_requests )
+{
+   return export_objects< chain::convert_request_index, api_convert_request_object >( args,
+      &database_api_impl::on_push_default< api_convert_request_object > );
+}
+
+DEFINE_API_IMPL( database_api_impl, export_limit_orders )
+{
+   return export_objects< chain::limit_order_index, api_limit_order_object >( args,
+      &database_api_impl::on_push_default< api_limit_order_object > );
+}
+
 DEFINE_LOCKLESS_APIS( database_api,
    (get_ops_in_block)
    (get_transaction)
@@ -1375,6 +1695,15 @@ DEFINE_READ_APIS( database_api,
    (find_decline_voting_rights_requests)
    (list_limit_orders)
    (find_limit_orders)
+   (export_accounts)
+   (export_witnesses)
+   (export_witness_votes)
+   (export_escrows)
+   (export_withdraw_vesting_routes)
+   (export_savings_withdrawals)
+   (export_vesting_delegations)
+   (export_abd_conversion_requests)
+   (export_limit_orders)
    (get_transaction_hex)
    (get_required_signatures)
    (get_potential_signatures)
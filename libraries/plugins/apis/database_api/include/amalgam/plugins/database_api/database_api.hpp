@@ -114,6 +114,9 @@ class database_api
           *
           *  @param from - the absolute sequence number, -1 means most recent, limit is the number of operations before from.
           *  @param limit - the maximum number of items that can be queried (0 to 1000], must be less than from
+          *
+          *  With operation_filter_low/high set only operations of the selected types are returned and limit counts
+          *  matches, from_time and to_time restrict the range by operation timestamp. Both only cost the entries returned.
           */
          (get_account_history)
 
@@ -148,6 +151,29 @@ class database_api
          (list_limit_orders)
          (find_limit_orders)
 
+         /////////////////
+         // Bulk export //
+         /////////////////
+
+         /**
+          * @brief Return up to DATABASE_API_EXPORT_LIMIT objects of an index in id order
+          * @param cursor Id to start from, the next cursor is returned with each chunk
+          * @param limit Maximum number of objects returned
+          * @param end Optional id where the exported range stops
+          *
+          * Each chunk is read under one read lock. Requested with
+          * "Accept: application/x-fc-raw" the objects come back fc::raw packed.
+          */
+         (export_accounts)
+         (export_witnesses)
+         (export_witness_votes)
+         (export_escrows)
+         (export_withdraw_vesting_routes)
+         (export_savings_withdrawals)
+         (export_vesting_delegations)
+         (export_abd_conversion_requests)
+         (export_limit_orders)
+
          ////////////////////////////
          // Authority / validation //
          ////////////////////////////
@@ -8,6 +8,8 @@
 #include <amalgam/plugins/json_rpc/utility.hpp>
 #include <amalgam/plugins/witness/witness_objects.hpp>
 
+#define DATABASE_API_EXPORT_LIMIT 10000
+
 namespace amalgam { namespace plugins { namespace database_api {
 
 using protocol::account_name_type;
@@ -244,6 +246,13 @@ struct get_account_history_args
    account_name_type   account;
    uint64_t            start = -1;
    uint32_t            limit = 1000;
+
+   /// bit N selects operations with which() == N, bit N of high selects which() == 64 + N, none set means all
+   uint64_t                      operation_filter_low = 0;
+   uint64_t                      operation_filter_high = 0;
+   /// only operations in [from_time, to_time]
+   optional< time_point_sec >    from_time;
+   optional< time_point_sec >    to_time;
 };
 
 typedef std::map< uint32_t, api_operation_object > get_account_history_return;
@@ -495,6 +504,57 @@ struct find_limit_orders_args
 typedef vector< api_limit_order_object > find_limit_orders_return;
 
 
+/* Bulk export */
+
+/**
+ * Walks an index in object id order. Ids only grow, so a cursor stays valid
+ * while objects are added and removed between calls.
+ */
+struct export_objects_args
+{
+   /// id of the first object to return, 0 starts at the beginning of the index
+   int64_t              cursor = 0;
+   uint32_t             limit = DATABASE_API_EXPORT_LIMIT;
+   /// objects from this id on are left out, to export one range of the index
+   optional< int64_t >  end;
+};
+
+template< typename T >
+struct export_objects_return
+{
+   vector< T >          objects;
+   /// cursor of the next chunk, null once the range is exhausted
+   optional< int64_t >  next;
+};
+
+typedef export_objects_args                             export_accounts_args;
+typedef export_objects_return< api_account_object > export_accounts_return;
+
+typedef export_objects_args                             export_witnesses_args;
+typedef export_objects_return< api_witness_object > export_witnesses_return;
+
+typedef export_objects_args                             export_witness_votes_args;
+typedef export_objects_return< api_witness_vote_object > export_witness_votes_return;
+
+typedef export_objects_args                             export_escrows_args;
+typedef export_objects_return< api_escrow_object > export_escrows_return;
+
+typedef export_objects_args                             export_withdraw_vesting_routes_args;
+typedef export_objects_return< api_withdraw_vesting_route_object > export_withdraw_vesting_routes_return;
+
+typedef export_objects_args                             export_savings_withdrawals_args;
+typedef export_objects_return< api_savings_withdraw_object > export_savings_withdrawals_return;
+
+typedef export_objects_args                             export_vesting_delegations_args;
+typedef export_objects_return< api_vesting_delegation_object > export_vesting_delegations_return;
+
+typedef export_objects_args                             export_abd_conversion_requests_args;
+typedef export_objects_return< api_convert_request_object > export_abd_conversion_requests_return;
+
+typedef export_objects_args                             export_limit_orders_args;
+typedef export_objects_return< api_limit_order_object > export_limit_orders_return;
+
+
 struct get_transaction_hex_args
 {
    signed_transaction trx;
@@ -631,7 +691,7 @@ FC_REFLECT( amalgam::plugins::database_api::find_accounts_args,
    (accounts) )
 
 FC_REFLECT( amalgam::plugins::database_api::get_account_history_args,
-   (account)(start)(limit) )
+   (account)(start)(limit)(operation_filter_low)(operation_filter_high)(from_time)(to_time) )
 
 FC_REFLECT( amalgam::plugins::database_api::get_account_bandwidth_args,
             (account)(type) )
@@ -708,6 +768,12 @@ FC_REFLECT( amalgam::plugins::database_api::list_limit_orders_args,
 FC_REFLECT( amalgam::plugins::database_api::find_limit_orders_args,
    (account) )
 
+FC_REFLECT( amalgam::plugins::database_api::export_objects_args,
+   (cursor)(limit)(end) )
+
+FC_REFLECT_TEMPLATE( (typename T), amalgam::plugins::database_api::export_objects_return< T >,
+   (objects)(next) )
+
 FC_REFLECT( amalgam::plugins::database_api::get_transaction_hex_args,
    (trx) )
 
@@ -1,6 +1,7 @@
 #pragma once
 #include <amalgam/plugins/json_rpc/utility.hpp>
 #include <amalgam/plugins/market_history/market_history_plugin.hpp>
+#include <amalgam/plugins/market_history/order_book_cache.hpp>
 
 #include <amalgam/protocol/types.hpp>
 
@@ -60,6 +61,19 @@ struct get_order_book_args
 
 typedef order_book get_order_book_return;
 
+struct get_order_book_depth_args
+{
+   uint32_t limit = 500;
+};
+
+/** Volume per price level, best price first */
+struct get_order_book_depth_return
+{
+   uint32_t                   block_num = 0;
+   vector< order_book_level > bids;
+   vector< order_book_level > asks;
+};
+
 struct market_trade
 {
    time_point_sec date;
@@ -110,6 +124,7 @@ class market_history_api
          (get_ticker)
          (get_volume)
          (get_order_book)
+         (get_order_book_depth)
          (get_trade_history)
          (get_recent_trades)
          (get_market_history)
@@ -137,6 +152,12 @@ FC_REFLECT( amalgam::plugins::market_history::order_book,
 FC_REFLECT( amalgam::plugins::market_history::get_order_book_args,
             (limit) )
 
+FC_REFLECT( amalgam::plugins::market_history::get_order_book_depth_args,
+            (limit) )
+
+FC_REFLECT( amalgam::plugins::market_history::get_order_book_depth_return,
+            (block_num)(bids)(asks) )
+
 FC_REFLECT( amalgam::plugins::market_history::market_trade,
             (date)(current_pays)(open_pays) )
 
@@ -2,6 +2,7 @@
 #include <amalgam/plugins/market_history_api/market_history_api.hpp>
 
 #include <amalgam/chain/amalgam_objects.hpp>
+#include <amalgam/chain/schema_types.hpp>
 
 #define ASSET_TO_REAL( asset ) (double)( asset.amount.value )
 
@@ -14,19 +15,23 @@ using namespace amalgam::plugins::market_history;
 class market_history_api_impl
 {
    public:
-      market_history_api_impl() : _db( appbase::app().get_plugin< amalgam::plugins::chain::chain_plugin >().db() ) {}
+      market_history_api_impl() :
+         _db( appbase::app().get_plugin< amalgam::plugins::chain::chain_plugin >().db() ),
+         _order_book( appbase::app().get_plugin< amalgam::plugins::market_history::market_history_plugin >().get_order_book_cache() ) {}
 
       DECLARE_API_IMPL(
          (get_ticker)
          (get_volume)
          (get_order_book)
+         (get_order_book_depth)
          (get_trade_history)
          (get_recent_trades)
          (get_market_history)
          (get_market_history_buckets)
       )
 
-      chain::database& _db;
+      chain::database&  _db;
+      order_book_cache& _order_book;
 };
 
 DEFINE_API_IMPL( market_history_api_impl, get_ticker )
@@ -44,11 +49,11 @@ DEFINE_API_IMPL( market_history_api_impl, get_ticker )
       result.percent_change = ( (result.latest - open ) / open ) * 100;
    }
 
-   auto orders = get_order_book( get_order_book_args{ 1 } );
-   if( orders.bids.empty() == false)
-      result.highest_bid = orders.bids[0].real_price;
-   if( orders.asks.empty() == false)
-      result.lowest_ask = orders.asks[0].real_price;
+   auto book = _order_book.snapshot();
+   if( book && book->bid_levels.empty() == false )
+      result.highest_bid = book->bid_levels[0].real_price;
+   if( book && book->ask_levels.empty() == false )
+      result.lowest_ask = book->ask_levels[0].real_price;
 
    auto volume = get_volume( get_volume_args() );
    result.amalgam_volume = volume.amalgam_volume;
@@ -80,38 +85,37 @@ DEFINE_API_IMPL( market_history_api_impl, get_volume )
 
 DEFINE_API_IMPL( market_history_api_impl, get_order_book )
 {
-   FC_ASSERT( args.limit <= 500 );
+   FC_ASSERT( args.limit <= order_book_cache::max_depth );
 
-   const auto& order_idx = _db.get_index< chain::limit_order_index, chain::by_price >();
-   auto itr = order_idx.lower_bound( price::max( ABD_SYMBOL, AMALGAM_SYMBOL ) );
+   auto book = _order_book.snapshot();
+   FC_ASSERT( book, "The order book is not loaded yet" );
 
    get_order_book_return result;
 
-   while( itr != order_idx.end() && itr->sell_price.base.symbol == ABD_SYMBOL && result.bids.size() < args.limit )
+   auto copy = [&]( const vector< order_book_order >& from, vector< order >& to )
    {
-      order cur;
-      cur.order_price = itr->sell_price;
-      cur.real_price = ASSET_TO_REAL( itr->sell_price.base ) / ASSET_TO_REAL( itr->sell_price.quote );
-      cur.amalgam = ( asset( itr->for_sale, ABD_SYMBOL ) * itr->sell_price ).amount;
-      cur.abd = itr->for_sale;
-      cur.created = itr->created;
-      result.bids.push_back( cur );
-      ++itr;
-   }
+      to.reserve( std::min< size_t >( from.size(), args.limit ) );
+      for( auto itr = from.begin(); itr != from.end() && to.size() < args.limit; ++itr )
+         to.push_back( order{ itr->order_price, itr->real_price, itr->amalgam, itr->abd, itr->created } );
+   };
 
-   itr = order_idx.lower_bound( price::max( AMALGAM_SYMBOL, ABD_SYMBOL ) );
+   copy( book->bids, result.bids );
+   copy( book->asks, result.asks );
 
-   while( itr != order_idx.end() && itr->sell_price.base.symbol == AMALGAM_SYMBOL && result.asks.size() < args.limit )
-   {
-      order cur;
-      cur.order_price = itr->sell_price;
-      cur.real_price = ASSET_TO_REAL( itr->sell_price.quote ) / ASSET_TO_REAL( itr->sell_price.base );
-      cur.amalgam = itr->for_sale;
-      cur.abd = ( asset( itr->for_sale, AMALGAM_SYMBOL ) * itr->sell_price ).amount;
-      cur.created = itr->created;
-      result.asks.push_back( cur );
-      ++itr;
-   }
+   return result;
+}
+
+DEFINE_API_IMPL( market_history_api_impl, get_order_book_depth )
+{
+   FC_ASSERT( args.limit <= order_book_cache::max_depth );
+
+   auto book = _order_book.snapshot();
+   FC_ASSERT( book, "The order book is not loaded yet" );
+
+   get_order_book_depth_return result;
+   result.block_num = book->block_num;
+   result.bids.assign( book->bid_levels.begin(), book->bid_levels.begin() + std::min< size_t >( book->bid_levels.size(), args.limit ) );
+   result.asks.assign( book->ask_levels.begin(), book->ask_levels.begin() + std::min< size_t >( book->ask_levels.size(), args.limit ) );
 
    return result;
 }
@@ -172,6 +176,11 @@ DEFINE_API_IMPL( market_history_api_impl, get_market_history )
       ++itr;
    }
 
+   // Larger buckets are only stored once they close
+   auto open = appbase::app().get_plugin< amalgam::plugins::market_history::market_history_plugin >().get_open_bucket( args.bucket_seconds );
+   if( open.valid() && open->open >= args.start && open->open < args.end && ( result.empty() || result.back().open < open->open ) )
+      result.push_back( *open );
+
    return result;
 }
 
@@ -191,10 +200,14 @@ market_history_api::market_history_api(): my( new detail::market_history_api_imp
 
 market_history_api::~market_history_api() {}
 
+DEFINE_LOCKLESS_APIS( market_history_api,
+   (get_order_book)
+   (get_order_book_depth)
+)
+
 DEFINE_READ_APIS( market_history_api,
    (get_ticker)
    (get_volume)
-   (get_order_book)
    (get_trade_history)
    (get_recent_trades)
    (get_market_history)
@@ -1,6 +1,26 @@
 #include <amalgam/plugins/market_history_api/market_history_api_plugin.hpp>
 #include <amalgam/plugins/market_history_api/market_history_api.hpp>
 
+#include <fc/io/json_writer.hpp>
+
+namespace amalgam { namespace plugins { namespace market_history {
+
+namespace detail {
+
+   /** params of the subscription_api.notice pushed for the "order_book" topic */
+   struct order_book_notice
+   {
+      std::string                      type = "order_book";
+      uint32_t                         block_num = 0;
+      std::vector< order_book_level >  bids;
+      std::vector< order_book_level >  asks;
+   };
+
+} // detail
+
+} } } // amalgam::plugins::market_history
+
+FC_REFLECT( amalgam::plugins::market_history::detail::order_book_notice, (type)(block_num)(bids)(asks) )
 
 namespace amalgam { namespace plugins { namespace market_history {
 
@@ -12,6 +32,17 @@ void market_history_api_plugin::set_program_options( options_description& cli, o
 void market_history_api_plugin::plugin_initialize( const variables_map& options )
 {
    api = std::make_shared< market_history_api >();
+
+   // Levels changed by a block are pushed to websocket subscribers of the topic
+   auto& rpc = appbase::app().get_plugin< amalgam::plugins::json_rpc::json_rpc_plugin >();
+   appbase::app().get_plugin< market_history_plugin >().get_order_book_cache().add_update_handler(
+      [&rpc]( const std::shared_ptr< const order_book_update >& update )
+      {
+         rpc.publish_notice( "order_book", update->block_num, [update]()
+         {
+            return fc::json_writer::to_string( detail::order_book_notice{ "order_book", update->block_num, update->bids, update->asks } );
+         });
+      });
 }
 
 void market_history_api_plugin::plugin_startup() {}
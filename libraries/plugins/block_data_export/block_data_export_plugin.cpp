@@ -3,6 +3,7 @@
 #define BOOST_THREAD_PROVIDES_FUTURE
 
 #include <amalgam/plugins/block_data_export/block_data_export_plugin.hpp>
+#include <amalgam/plugins/block_data_export/columnar_export.hpp>
 #include <amalgam/plugins/block_data_export/exportable_block_data.hpp>
 
 #include <amalgam/chain/account_object.hpp>
@@ -14,6 +15,7 @@
 #include <boost/thread/sync_bounded_queue.hpp>
 
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <queue>
 #include <sstream>
@@ -48,11 +50,66 @@ FC_REFLECT( amalgam::plugins::block_data_export::detail::api_export_data_object,
 
 namespace amalgam { namespace plugins { namespace block_data_export { namespace detail {
 
+enum export_format
+{
+   json_export_format,
+   columnar_export_format
+};
+
+/** Block data converted by the conversion threads, only the member for the output format is set */
+struct converted_export_data
+{
+   uint32_t                                           block_num = 0;
+   std::string                                        json;
+   fc::variant                                        row;
+};
+
 struct work_item
 {
    std::shared_ptr< api_export_data_object >          edo;
-   boost::promise< std::shared_ptr< std::string > >   edo_json_promise;
-   boost::future< std::shared_ptr< std::string > >    edo_json_future = edo_json_promise.get_future();
+   boost::promise< std::shared_ptr< converted_export_data > >  converted_promise;
+   boost::future< std::shared_ptr< converted_export_data > >   converted_future = converted_promise.get_future();
+};
+
+class export_sink
+{
+   public:
+      virtual ~export_sink() {}
+
+      virtual void write( converted_export_data& data ) = 0;
+};
+
+class json_export_sink : public export_sink
+{
+   public:
+      json_export_sink( const std::string& file_name ) : _out( file_name, std::ios::binary )
+      {
+         FC_ASSERT( _out, "Could not open ${f}", ("f", file_name) );
+      }
+
+      virtual void write( converted_export_data& data ) override
+      {
+         _out.write( data.json.c_str(), data.json.length() );
+         _out.put( '\n' );
+         _out.flush();
+      }
+
+   private:
+      std::ofstream                 _out;
+};
+
+class columnar_export_sink : public export_sink
+{
+   public:
+      columnar_export_sink( const std::string& file_name, uint32_t rows_per_group ) : _writer( file_name, rows_per_group ) {}
+
+      virtual void write( converted_export_data& data ) override
+      {
+         _writer.append( data.block_num, std::move( data.row ) );
+      }
+
+   private:
+      columnar_export_writer        _writer;
 };
 
 class block_data_export_plugin_impl
@@ -74,8 +131,9 @@ class block_data_export_plugin_impl
 
       void start_threads();
       void stop_threads();
-      void convert_to_json_thread_main();
+      void convert_thread_main();
       void output_thread_main();
+      std::unique_ptr< export_sink > open_sink( uint32_t file_index )const;
 
       database&                     _db;
       block_data_export_plugin&     _self;
@@ -88,6 +146,10 @@ class block_data_export_plugin_impl
          std::function< std::shared_ptr< exportable_block_data >() >
          > >                        _factory_list;
       std::string                   _output_name;
+      export_format                 _format = json_export_format;
+      /// Blocks per output file, 0 writes everything to one file
+      uint32_t                      _rotate_blocks = 0;
+      uint32_t                      _rows_per_group = 1000;
       bool                          _enabled = false;
 
       size_t                        _max_queue_size = 100;
@@ -97,7 +159,7 @@ class block_data_export_plugin_impl
       size_t                        _thread_stack_size = 4096*1024;
       std::shared_ptr< boost::thread >                      _output_thread;
 
-      std::vector< boost::thread >  _json_conversion_threads;
+      std::vector< boost::thread >  _conversion_threads;
 };
 
 void block_data_export_plugin_impl::start_threads()
@@ -108,7 +170,7 @@ void block_data_export_plugin_impl::start_threads()
    size_t num_threads = boost::thread::hardware_concurrency()+1;
    for( size_t i=0; i<num_threads; i++ )
    {
-      _json_conversion_threads.emplace_back( attrs, [this]() { convert_to_json_thread_main(); } );
+      _conversion_threads.emplace_back( attrs, [this]() { convert_thread_main(); } );
    }
 
    _output_thread = std::make_shared< boost::thread >( attrs, [this]() { output_thread_main(); } );
@@ -129,12 +191,12 @@ void block_data_export_plugin_impl::stop_threads()
    _output_thread.reset();
 
    _data_queue.close();
-   for( boost::thread& t : _json_conversion_threads )
+   for( boost::thread& t : _conversion_threads )
       t.join();
-   _json_conversion_threads.clear();
+   _conversion_threads.clear();
 }
 
-void block_data_export_plugin_impl::convert_to_json_thread_main()
+void block_data_export_plugin_impl::convert_thread_main()
 {
    while( true )
    {
@@ -149,14 +211,36 @@ void block_data_export_plugin_impl::convert_to_json_thread_main()
       }
 
       // TODO exception handling
-      std::shared_ptr< std::string > edo_json = std::make_shared< std::string >( fc::json::to_string( work->edo ) );
-      work->edo_json_promise.set_value( edo_json );
+      std::shared_ptr< converted_export_data > converted = std::make_shared< converted_export_data >();
+      converted->block_num = protocol::block_header::num_from_id( work->edo->block_id );
+      if( _format == columnar_export_format )
+         fc::to_variant( *work->edo, converted->row );
+      else
+         converted->json = fc::json::to_string( work->edo );
+      work->converted_promise.set_value( converted );
    }
 }
 
+std::unique_ptr< export_sink > block_data_export_plugin_impl::open_sink( uint32_t file_index )const
+{
+   std::string file_name = _output_name;
+   if( _rotate_blocks )
+   {
+      // Zero padded first block number, so the files sort in block order
+      std::ostringstream oss;
+      oss << _output_name << '.' << std::setw( 10 ) << std::setfill( '0' ) << uint64_t( file_index ) * _rotate_blocks;
+      file_name = oss.str();
+   }
+
+   if( _format == columnar_export_format )
+      return std::make_unique< columnar_export_sink >( file_name, _rows_per_group );
+   return std::make_unique< json_export_sink >( file_name );
+}
+
 void block_data_export_plugin_impl::output_thread_main()
 {
-   std::ofstream output_file( _output_name, std::ios::binary );
+   std::unique_ptr< export_sink > sink;
+   uint32_t file_index = 0;
    while( true )
    {
       std::shared_ptr< work_item > work;
@@ -169,11 +253,18 @@ void block_data_export_plugin_impl::output_thread_main()
          break;
       }
 
-      std::shared_ptr< std::string > edo_json = work->edo_json_future.get();
+      std::shared_ptr< converted_export_data > converted = work->converted_future.get();
 
-      output_file.write( edo_json->c_str(), edo_json->length() );
-      output_file.put( '\n' );
-      output_file.flush();
+      // Blocks reapplied after a fork stay in the current file instead of truncating an earlier one
+      uint32_t index = _rotate_blocks ? converted->block_num / _rotate_blocks : 0;
+      if( !sink || index > file_index )
+      {
+         sink.reset();
+         sink = open_sink( index );
+         file_index = index;
+      }
+
+      sink->write( *converted );
    }
 }
 
@@ -263,6 +354,8 @@ void block_data_export_plugin::set_program_options( options_description& cli, op
 {
    cfg.add_options()
          ("block-data-export-file", boost::program_options::value< string >()->default_value("NONE"), "Where to export data (NONE to discard)")
+         ("block-data-export-format", boost::program_options::value< string >()->default_value("json"), "Format of exported data: json (one line per block) or columnar (binary row groups of flattened columns)")
+         ("block-data-export-rotate-blocks", boost::program_options::value< uint32_t >()->default_value(0), "Start a new export file every this many blocks, suffixed with its first block number (0 to write one file)")
          ;
 }
 
@@ -278,6 +371,11 @@ void block_data_export_plugin::plugin_initialize( const boost::program_options::
       if( !my->_enabled )
          return;
 
+      const auto& format = options.at( "block-data-export-format" ).as< string >();
+      FC_ASSERT( format == "json" || format == "columnar", "Unknown block-data-export-format ${f}", ("f", format) );
+      my->_format = format == "columnar" ? detail::columnar_export_format : detail::json_export_format;
+      my->_rotate_blocks = options.at( "block-data-export-rotate-blocks" ).as< uint32_t >();
+
       my->_pre_apply_block_conn = my->_db.add_pre_apply_block_handler(
          [&]( const block_notification& note ){ my->on_pre_apply_block( note ); }, *this, -9300 );
       my->_post_apply_block_conn = my->_db.add_post_apply_block_handler(
@@ -0,0 +1,424 @@
+#include <amalgam/plugins/block_data_export/columnar_export.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/io/json.hpp>
+#include <fc/io/raw.hpp>
+
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <set>
+
+namespace amalgam { namespace plugins { namespace block_data_export {
+
+namespace {
+
+const fc::variant null_variant;
+
+void put_varint( std::vector< char >& out, uint64_t v )
+{
+   while( v >= 0x80 )
+   {
+      out.push_back( char( v | 0x80 ) );
+      v >>= 7;
+   }
+   out.push_back( char( v ) );
+}
+
+void put_string( std::vector< char >& out, const std::string& s )
+{
+   put_varint( out, s.size() );
+   out.insert( out.end(), s.begin(), s.end() );
+}
+
+/** column type holding a value of type t, JSON for arrays, objects and blobs */
+export_column_type column_type( fc::variant::type_id t )
+{
+   switch( t )
+   {
+      case fc::variant::null_type:     return export_null_column;
+      case fc::variant::int64_type:    return export_int64_column;
+      case fc::variant::uint64_type:   return export_uint64_column;
+      case fc::variant::double_type:   return export_double_column;
+      case fc::variant::bool_type:     return export_bool_column;
+      case fc::variant::string_type:   return export_string_column;
+      default:                         return export_json_column;
+   }
+}
+
+export_column encode_column( const std::string& name, const std::vector< const fc::variant* >& values, bool force_json )
+{
+   export_column col;
+   col.name = name;
+   col.rows = values.size();
+
+   // A column has the type shared by all of its rows, anything else is kept as JSON
+   export_column_type type = force_json ? export_json_column
+      : values.empty() ? export_null_column : column_type( values.front()->get_type() );
+   for( const auto* v : values )
+   {
+      if( type == export_json_column )
+         break;
+      if( column_type( v->get_type() ) != type )
+         type = export_json_column;
+   }
+   col.type = uint8_t( type );
+
+   uint64_t prev = 0;
+   for( const auto* v : values )
+   {
+      switch( type )
+      {
+         case export_int64_column:
+         case export_uint64_column:
+         {
+            uint64_t x = type == export_int64_column ? uint64_t( v->as_int64() ) : v->as_uint64();
+            int64_t delta = int64_t( x - prev );
+            put_varint( col.data, ( uint64_t( delta ) << 1 ) ^ uint64_t( delta >> 63 ) );
+            prev = x;
+            break;
+         }
+         case export_double_column:
+         {
+            double d = v->as_double();
+            char buf[ sizeof( d ) ];
+            std::memcpy( buf, &d, sizeof( d ) );
+            col.data.insert( col.data.end(), buf, buf + sizeof( d ) );
+            break;
+         }
+         case export_bool_column:
+            col.data.push_back( v->as_bool() ? 1 : 0 );
+            break;
+         case export_string_column:
+            put_string( col.data, v->get_string() );
+            break;
+         case export_json_column:
+            put_string( col.data, fc::json::to_string( *v, fc::json::legacy_generator ) );
+            break;
+         default:
+            break;
+      }
+   }
+
+   return col;
+}
+
+uint64_t get_varint( const export_column& col, size_t& pos )
+{
+   uint64_t v = 0;
+   for( int shift = 0; ; shift += 7 )
+   {
+      FC_ASSERT( pos < col.data.size() && shift < 64, "Truncated column ${c}", ("c", col.name) );
+      uint8_t b = uint8_t( col.data[ pos++ ] );
+      v |= uint64_t( b & 0x7f ) << shift;
+      if( !( b & 0x80 ) )
+         return v;
+   }
+}
+
+std::string get_string( const export_column& col, size_t& pos )
+{
+   uint64_t size = get_varint( col, pos );
+   FC_ASSERT( size <= col.data.size() - pos, "Truncated column ${c}", ("c", col.name) );
+   std::string s( col.data.data() + pos, size );
+   pos += size;
+   return s;
+}
+
+std::vector< fc::variant > decode_column( const export_column& col )
+{
+   std::vector< fc::variant > values;
+   values.reserve( col.rows );
+
+   uint64_t prev = 0;
+   size_t pos = 0;
+   for( uint32_t i = 0; i < col.rows; ++i )
+   {
+      switch( col.type )
+      {
+         case export_null_column:
+            values.emplace_back();
+            break;
+         case export_int64_column:
+         case export_uint64_column:
+         {
+            uint64_t z = get_varint( col, pos );
+            prev += ( z >> 1 ) ^ ( 0 - ( z & 1 ) );
+            if( col.type == export_int64_column )
+               values.emplace_back( int64_t( prev ) );
+            else
+               values.emplace_back( prev );
+            break;
+         }
+         case export_double_column:
+         {
+            double d;
+            FC_ASSERT( sizeof( d ) <= col.data.size() - pos, "Truncated column ${c}", ("c", col.name) );
+            std::memcpy( &d, col.data.data() + pos, sizeof( d ) );
+            pos += sizeof( d );
+            values.emplace_back( d );
+            break;
+         }
+         case export_bool_column:
+            FC_ASSERT( pos < col.data.size(), "Truncated column ${c}", ("c", col.name) );
+            values.emplace_back( col.data[ pos++ ] != 0 );
+            break;
+         case export_string_column:
+            values.emplace_back( get_string( col, pos ) );
+            break;
+         case export_json_column:
+            values.push_back( fc::json::from_string( get_string( col, pos ) ) );
+            break;
+         default:
+            FC_THROW( "Unknown type ${t} of column ${c}", ("t", col.type)("c", col.name) );
+      }
+   }
+
+   FC_ASSERT( pos == col.data.size(), "Column ${c} has data past its rows", ("c", col.name) );
+   return values;
+}
+
+/** rebuilds the rows of the value at path from the columns starting at next, in the order the writer added them */
+std::vector< fc::variant > decode_rows( const export_row_group& group, size_t& next, const std::string& path, uint32_t rows )
+{
+   const auto& columns = group.columns;
+   if( next < columns.size() && columns[ next ].name == path )
+   {
+      const auto& col = columns[ next++ ];
+      FC_ASSERT( col.rows == rows, "Column ${c} has ${n} rows instead of ${r}", ("c", col.name)("n", col.rows)("r", rows) );
+      return decode_column( col );
+   }
+
+   if( next < columns.size() && columns[ next ].name == path + "#" )
+   {
+      const auto& col = columns[ next++ ];
+      FC_ASSERT( col.rows == rows, "Column ${c} has ${n} rows instead of ${r}", ("c", col.name)("n", col.rows)("r", rows) );
+      auto counts = decode_column( col );
+
+      uint64_t total = 0;
+      for( const auto& c : counts )
+         total += c.as_uint64() ? c.as_uint64() - 1 : 0;
+      FC_ASSERT( total <= std::numeric_limits< uint32_t >::max(), "Column ${c} counts too many elements", ("c", col.name) );
+
+      std::vector< fc::variant > elements;
+      if( total )
+         elements = decode_rows( group, next, path + "[]", uint32_t( total ) );
+
+      std::vector< fc::variant > values;
+      values.reserve( rows );
+      auto e = elements.begin();
+      for( const auto& c : counts )
+      {
+         if( !c.as_uint64() )
+         {
+            values.emplace_back();
+            continue;
+         }
+         auto end = e + ( c.as_uint64() - 1 );
+         values.emplace_back( fc::variants( std::make_move_iterator( e ), std::make_move_iterator( end ) ) );
+         e = end;
+      }
+      return values;
+   }
+
+   std::string prefix = path.empty() ? path : path + ".";
+   std::vector< fc::mutable_variant_object > objects( rows );
+   while( next < columns.size() && columns[ next ].name.compare( 0, prefix.size(), prefix ) == 0 )
+   {
+      const auto& name = columns[ next ].name;
+      std::string key = name.substr( prefix.size(), name.find_first_of( ".#", prefix.size() ) - prefix.size() );
+      size_t first = next;
+
+      auto values = decode_rows( group, next, prefix + key, rows );
+      FC_ASSERT( next > first, "Unexpected column ${c}", ("c", name) );
+      for( uint32_t i = 0; i < rows; ++i )
+         if( !values[i].is_null() )
+            objects[i]( key, std::move( values[i] ) );
+   }
+
+   std::vector< fc::variant > values;
+   values.reserve( rows );
+   for( auto& o : objects )
+   {
+      // Only the rows themselves stay objects when they have no fields, nested ones are left out
+      if( o.size() || path.empty() )
+         values.emplace_back( std::move( o ) );
+      else
+         values.emplace_back();
+   }
+   return values;
+}
+
+} // anonymous
+
+columnar_export_writer::columnar_export_writer( const std::string& file_name, uint32_t rows_per_group )
+   : _out( file_name, std::ios::binary | std::ios::trunc ), _rows_per_group( rows_per_group )
+{
+   FC_ASSERT( _out, "Could not open ${f}", ("f", file_name) );
+   _out.write( "AMLEXC01", 8 );
+   _rows.reserve( rows_per_group );
+}
+
+columnar_export_writer::~columnar_export_writer()
+{
+   try
+   {
+      flush();
+   }
+   FC_CAPTURE_AND_LOG( (_first_block)(_last_block) )
+}
+
+void columnar_export_writer::append( uint32_t block_num, fc::variant&& row )
+{
+   if( _rows.empty() )
+      _first_block = block_num;
+   _last_block = block_num;
+
+   _rows.push_back( std::move( row ) );
+   if( _rows.size() >= _rows_per_group )
+      flush();
+}
+
+void columnar_export_writer::flush()
+{
+   if( _rows.empty() )
+      return;
+
+   export_row_group group;
+   group.first_block = _first_block;
+   group.last_block = _last_block;
+   group.rows = _rows.size();
+
+   std::vector< const fc::variant* > values;
+   values.reserve( _rows.size() );
+   for( const auto& row : _rows )
+      values.push_back( &row );
+   add_columns( std::string(), values, group );
+
+   auto data = fc::raw::pack_to_vector( group );
+   uint32_t size = data.size();
+   _out.write( (const char*) &size, sizeof( size ) );
+   _out.write( data.data(), data.size() );
+   _out.flush();
+
+   _rows.clear();
+}
+
+/** values holds the rows of the column at path, recursing into objects and arrays */
+void columnar_export_writer::add_columns( const std::string& path, const std::vector< const fc::variant* >& values, export_row_group& group )const
+{
+   bool has_array = false, has_object = false, has_scalar = false;
+   for( const auto* v : values )
+   {
+      if( v->is_array() )
+         has_array = true;
+      else if( v->is_object() )
+         has_object = true;
+      else if( !v->is_null() )
+         has_scalar = true;
+   }
+
+   if( int( has_array ) + int( has_object ) + int( has_scalar ) > 1 )
+   {
+      group.columns.push_back( encode_column( path, values, true ) );
+   }
+   else if( has_object )
+   {
+      // Rows may lack fields others have, every field gets a row in each of them
+      std::vector< std::string > keys;
+      std::set< std::string > seen;
+      for( const auto* v : values )
+      {
+         if( !v->is_object() )
+            continue;
+         for( const auto& entry : v->get_object() )
+            if( seen.insert( entry.key() ).second )
+               keys.push_back( entry.key() );
+      }
+
+      std::vector< const fc::variant* > children( values.size() );
+      for( const auto& key : keys )
+      {
+         for( size_t i = 0; i < values.size(); ++i )
+         {
+            const fc::variant* child = &null_variant;
+            if( values[i]->is_object() )
+            {
+               const auto& obj = values[i]->get_object();
+               auto itr = obj.find( key );
+               if( itr != obj.end() )
+                  child = &itr->value();
+            }
+            children[i] = child;
+         }
+         add_columns( path.empty() ? key : path + "." + key, children, group );
+      }
+   }
+   else if( has_array )
+   {
+      std::vector< fc::variant > counts;
+      std::vector< const fc::variant* > elements;
+      counts.reserve( values.size() );
+      for( const auto* v : values )
+      {
+         if( v->is_array() )
+         {
+            const auto& arr = v->get_array();
+            counts.emplace_back( uint64_t( arr.size() ) + 1 );
+            for( const auto& e : arr )
+               elements.push_back( &e );
+         }
+         else
+         {
+            counts.emplace_back( uint64_t( 0 ) );
+         }
+      }
+
+      std::vector< const fc::variant* > count_ptrs;
+      count_ptrs.reserve( counts.size() );
+      for( const auto& c : counts )
+         count_ptrs.push_back( &c );
+      group.columns.push_back( encode_column( path + "#", count_ptrs, false ) );
+
+      if( elements.size() )
+         add_columns( path + "[]", elements, group );
+   }
+   else
+   {
+      group.columns.push_back( encode_column( path, values, false ) );
+   }
+}
+
+columnar_export_reader::columnar_export_reader( const std::string& file_name )
+   : _in( file_name, std::ios::binary )
+{
+   FC_ASSERT( _in, "Could not open ${f}", ("f", file_name) );
+   char magic[8];
+   _in.read( magic, sizeof( magic ) );
+   FC_ASSERT( _in && std::memcmp( magic, "AMLEXC01", sizeof( magic ) ) == 0, "${f} is not a columnar export", ("f", file_name) );
+}
+
+bool columnar_export_reader::read( export_row_group& group )
+{
+   uint32_t size = 0;
+   _in.read( (char*) &size, sizeof( size ) );
+   if( _in.gcount() == 0 && _in.eof() )
+      return false;
+   FC_ASSERT( _in, "Truncated row group size" );
+
+   std::vector< char > data( size );
+   _in.read( data.data(), data.size() );
+   FC_ASSERT( _in, "Truncated row group" );
+   fc::raw::unpack_from_vector( data, group );
+   return true;
+}
+
+std::vector< fc::variant > columnar_export_reader::decode( const export_row_group& group )
+{
+   size_t next = 0;
+   auto rows = decode_rows( group, next, std::string(), group.rows );
+   FC_ASSERT( next == group.columns.size(), "Unexpected column ${c}", ("c", group.columns[ next ].name) );
+   return rows;
+}
+
+} } } // amalgam::plugins::block_data_export
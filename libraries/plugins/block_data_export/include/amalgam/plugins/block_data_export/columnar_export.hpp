@@ -0,0 +1,99 @@
+#pragma once
+
+#include <fc/reflect/reflect.hpp>
+#include <fc/variant.hpp>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace amalgam { namespace plugins { namespace block_data_export {
+
+/**
+ * Binary columnar layout of the exported block data.
+ *
+ * A file starts with the 8 bytes "AMLEXC01" followed by row groups, one row
+ * per exported block. Each row group is a little endian uint32 byte count
+ * and the fc::raw packed export_row_group, so readers can skip whole groups.
+ *
+ * Rows are flattened into columns named by their path in the JSON export,
+ * such as "export_data.stats_export.global_properties.head_block_number".
+ * An array at path p stores one more than its element count in column "p#",
+ * or 0 for rows without an array, and the elements as the rows of the
+ * columns under "p[]", which have as many rows as the arrays hold.
+ * Objects are stored as the columns of their fields, and a row lacking a
+ * field others have holds null in that column.
+ */
+enum export_column_type
+{
+   export_null_column    = 0,  ///< every row is null, no data
+   export_int64_column   = 1,  ///< zigzag varint of the difference to the previous row
+   export_uint64_column  = 2,  ///< same as int64, the difference wraps around
+   export_double_column  = 3,  ///< little endian doubles
+   export_bool_column    = 4,  ///< one byte per row
+   export_string_column  = 5,  ///< fc::raw packed strings
+   export_json_column    = 6   ///< fc::raw packed JSON of every row, for columns mixing types
+};
+
+struct export_column
+{
+   std::string          name;
+   uint8_t              type = export_null_column;
+   uint32_t             rows = 0;
+   std::vector< char >  data;
+};
+
+struct export_row_group
+{
+   uint32_t                      first_block = 0;
+   uint32_t                      last_block = 0;
+   uint32_t                      rows = 0;
+   std::vector< export_column >  columns;
+};
+
+/** Collects rows and writes them as a row group once enough are buffered */
+class columnar_export_writer
+{
+   public:
+      columnar_export_writer( const std::string& file_name, uint32_t rows_per_group );
+      ~columnar_export_writer();
+
+      void append( uint32_t block_num, fc::variant&& row );
+      void flush();
+
+   private:
+      void add_columns( const std::string& path, const std::vector< const fc::variant* >& values, export_row_group& group )const;
+
+      std::ofstream                 _out;
+      uint32_t                      _rows_per_group;
+      std::vector< fc::variant >    _rows;
+      uint32_t                      _first_block = 0;
+      uint32_t                      _last_block = 0;
+};
+
+/**
+ * Reads the row groups of a columnar export and rebuilds their rows.
+ *
+ * Rows come back as appended up to what the layout keeps: fields that are
+ * null or hold an object without fields are left out, array elements that
+ * are objects without fields are null, and numbers in JSON columns lose
+ * their signedness. Field names are taken to contain neither '.' nor '#'.
+ */
+class columnar_export_reader
+{
+   public:
+      columnar_export_reader( const std::string& file_name );
+
+      /** reads the next row group, false at the end of the file */
+      bool read( export_row_group& group );
+
+      static std::vector< fc::variant > decode( const export_row_group& group );
+
+   private:
+      std::ifstream                 _in;
+};
+
+} } } // amalgam::plugins::block_data_export
+
+FC_REFLECT( amalgam::plugins::block_data_export::export_column, (name)(type)(rows)(data) )
+FC_REFLECT( amalgam::plugins::block_data_export::export_row_group, (first_block)(last_block)(rows)(columns) )
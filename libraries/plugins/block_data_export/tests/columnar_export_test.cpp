@@ -0,0 +1,141 @@
+#define BOOST_TEST_MODULE ColumnarExportTest
+#include <boost/test/unit_test.hpp>
+
+#include <amalgam/plugins/block_data_export/columnar_export.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace amalgam::plugins::block_data_export;
+
+namespace {
+
+/** compares like JSON does, ignoring the order of object fields */
+bool same_value( const fc::variant& a, const fc::variant& b )
+{
+   if( a.is_object() && b.is_object() )
+   {
+      const auto& oa = a.get_object();
+      const auto& ob = b.get_object();
+      if( oa.size() != ob.size() )
+         return false;
+      for( const auto& entry : oa )
+      {
+         auto itr = ob.find( entry.key() );
+         if( itr == ob.end() || !same_value( entry.value(), itr->value() ) )
+            return false;
+      }
+      return true;
+   }
+   if( a.is_array() && b.is_array() )
+   {
+      const auto& va = a.get_array();
+      const auto& vb = b.get_array();
+      if( va.size() != vb.size() )
+         return false;
+      for( size_t i = 0; i < va.size(); ++i )
+         if( !same_value( va[i], vb[i] ) )
+            return false;
+      return true;
+   }
+   return fc::json::to_string( a ) == fc::json::to_string( b );
+}
+
+std::vector< export_row_group > write_and_read( const fc::path& file, const std::vector< fc::variant >& rows, uint32_t rows_per_group )
+{
+   {
+      columnar_export_writer writer( file.string(), rows_per_group );
+      for( size_t i = 0; i < rows.size(); ++i )
+         writer.append( 100 + i, fc::variant( rows[i] ) );
+   }
+
+   std::vector< export_row_group > groups;
+   columnar_export_reader reader( file.string() );
+   export_row_group group;
+   while( reader.read( group ) )
+      groups.push_back( group );
+   return groups;
+}
+
+} // anonymous
+
+BOOST_AUTO_TEST_SUITE(columnar_export_tests)
+
+BOOST_AUTO_TEST_CASE(round_trip)
+{
+   const std::vector< std::string > rows = {
+      R"({"num":-5,"big":18446744073709551615,"ratio":0.5,"flag":true,"name":"first","mixed":1,
+          "tags":["a","b"],"ops":[{"id":1,"memo":"x"},{"id":2}],"nested":{"inner":{"deep":[[1,2],[]]}}})",
+      R"({"num":-7,"big":3,"ratio":-2.25,"flag":false,"name":"","mixed":"two",
+          "tags":null,"ops":[],"nested":{"other":"only here"}})",
+      R"({"num":-9000000000,"ratio":1e100,"mixed":{"three":[3]},"tags":[],"ops":null,"late":[null,4]})",
+      R"({"num":0,"big":0,"flag":true,"name":"last","mixed":[4.5,"x",null],"tags":["c"],
+          "ops":[{"memo":"\u00e9\n"}],"nested":{"inner":{"deep":null},"other":"x"},"gone":null})",
+      R"({})"
+   };
+
+   // Null fields are not told apart from missing ones, so they come back left out
+   const std::vector< std::string > expected = {
+      rows[0],
+      R"({"num":-7,"big":3,"ratio":-2.25,"flag":false,"name":"","mixed":"two",
+          "ops":[],"nested":{"other":"only here"}})",
+      R"({"num":-9000000000,"ratio":1e100,"mixed":{"three":[3]},"tags":[],"late":[null,4]})",
+      R"({"num":0,"big":0,"flag":true,"name":"last","mixed":[4.5,"x",null],"tags":["c"],
+          "ops":[{"memo":"\u00e9\n"}],"nested":{"other":"x"}})",
+      rows[4]
+   };
+
+   std::vector< fc::variant > values;
+   for( const auto& r : rows )
+      values.push_back( fc::json::from_string( r ) );
+
+   fc::temp_file file;
+   auto groups = write_and_read( file.path(), values, 2 );
+
+   BOOST_REQUIRE_EQUAL( groups.size(), 3u );
+   BOOST_CHECK_EQUAL( groups[0].first_block, 100u );
+   BOOST_CHECK_EQUAL( groups[0].last_block, 101u );
+   BOOST_CHECK_EQUAL( groups[2].first_block, 104u );
+   BOOST_CHECK_EQUAL( groups[2].last_block, 104u );
+
+   size_t row = 0;
+   for( const auto& group : groups )
+   {
+      for( const auto& decoded : columnar_export_reader::decode( group ) )
+      {
+         BOOST_REQUIRE( row < expected.size() );
+         BOOST_CHECK_MESSAGE( same_value( decoded, fc::json::from_string( expected[ row ] ) ),
+            "row " << row << " decoded as " << fc::json::to_string( decoded ) );
+         ++row;
+      }
+   }
+   BOOST_CHECK_EQUAL( row, rows.size() );
+
+   std::map< std::string, uint8_t > types;
+   for( const auto& col : groups[0].columns )
+      types[ col.name ] = col.type;
+   BOOST_CHECK_EQUAL( types[ "num" ], export_int64_column );
+   BOOST_CHECK_EQUAL( types[ "big" ], export_uint64_column );
+   BOOST_CHECK_EQUAL( types[ "ratio" ], export_double_column );
+   BOOST_CHECK_EQUAL( types[ "flag" ], export_bool_column );
+   BOOST_CHECK_EQUAL( types[ "mixed" ], export_json_column );
+   BOOST_CHECK_EQUAL( types[ "tags#" ], export_uint64_column );
+   BOOST_CHECK_EQUAL( types[ "tags[]" ], export_string_column );
+   BOOST_CHECK_EQUAL( types[ "ops[].id" ], export_uint64_column );
+   BOOST_CHECK_EQUAL( types[ "ops[].memo" ], export_json_column );
+   BOOST_CHECK_EQUAL( types[ "nested.inner.deep[]#" ], export_uint64_column );
+}
+
+BOOST_AUTO_TEST_CASE(not_an_export)
+{
+   fc::temp_file file( fc::temp_directory_path(), true );
+   BOOST_CHECK_THROW( columnar_export_reader( file.path().string() ), fc::exception );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -1,19 +1,38 @@
 #include <amalgam/plugins/block_log_info/block_log_info_plugin.hpp>
 #include <amalgam/plugins/block_log_info/block_log_info_objects.hpp>
 
-#include <amalgam/chain/account_object.hpp>
+#include <amalgam/chain/block_log.hpp>
 #include <amalgam/chain/database.hpp>
 #include <amalgam/chain/global_property_object.hpp>
-#include <amalgam/chain/index.hpp>
 
+#include <fc/filesystem.hpp>
+#include <fc/io/raw.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <mutex>
 #include <sstream>
+#include <thread>
 
 namespace amalgam { namespace plugins { namespace block_log_info {
 
 namespace detail {
 
+using amalgam::chain::block_log;
+using amalgam::chain::database;
+
+/// bytes of the block_log between two checkpoints of the hash
+static const uint64_t checkpoint_size = uint64_t(1) << 30;
+
+/// blocks read from the block_log at once by the hashing thread
+static const uint32_t hash_batch_blocks = 1000;
+
+/// the state file is rewritten at least this often
+static const uint32_t save_interval_blocks = 10000;
+
 class block_log_info_plugin_impl
 {
    public:
@@ -21,87 +40,318 @@ class block_log_info_plugin_impl
          _db( appbase::app().get_plugin< amalgam::plugins::chain::chain_plugin >().db() ),
          _self( _plugin ) {}
 
-      void on_post_apply_block( const block_notification& note );
+      ~block_log_info_plugin_impl() { stop(); }
+
+      void on_irreversible_block( uint32_t block_num );
+
+      void load_state();
+      void save_state();
+      void verify( uint32_t threads )const;
+
+      void start();
+      void stop();
+      void hash_blocks();
+      bool hash_batch( std::ifstream& in, std::vector< char >& buf, uint32_t last );
+      void hash_bytes( const char* data, size_t size );
+
       void print_message( const block_log_message_data& data );
 
       database&                     _db;
       block_log_info_plugin&        _self;
-      boost::signals2::connection   _post_apply_block_conn;
+      boost::signals2::connection   _irreversible_block_conn;
       int32_t                       print_interval_seconds = 0;
-      bool                          print_irreversible = true;
       std::string                   output_name;
+      uint32_t                      verify_threads = 0;
+
+      fc::path                      _block_log_file;
+      fc::path                      _state_file;
+
+      /// only used by the hashing thread once it runs
+      block_log_hash_state          _state;
+      uint32_t                      _saved_block = 0;
+
+      std::mutex                    _mtx;
+      std::condition_variable       _cv;
+      uint32_t                      _irreversible_block = 0;
+      std::atomic< bool >           _running{ false };
+      std::thread                   _thread;
 };
 
-void block_log_info_plugin_impl::on_post_apply_block( const block_notification& note )
+void block_log_info_plugin_impl::on_irreversible_block( uint32_t block_num )
 {
-   const signed_block& b = note.block;
-   uint32_t block_num = b.block_num();
-   bool is_genesis = (block_num == 1);
+   {
+      std::lock_guard< std::mutex > guard( _mtx );
+      _irreversible_block = std::max( _irreversible_block, block_num );
+   }
+   _cv.notify_one();
+}
+
+void block_log_info_plugin_impl::load_state()
+{
+   _state = block_log_hash_state();
 
-   if( is_genesis )
+   if( fc::exists( _state_file ) )
    {
-      _db.create< block_log_hash_state_object >( []( block_log_hash_state_object& bso )
+      std::ifstream in( _state_file.generic_string(), std::ios::binary );
+      std::vector< char > data( ( std::istreambuf_iterator< char >( in ) ), std::istreambuf_iterator< char >() );
+      try
       {
-      } );
+         fc::raw::unpack_from_vector( data, _state );
+      }
+      catch( const fc::exception& e )
+      {
+         wlog( "block_log_info: could not read ${f}, hashing the block_log again: ${e}", ("f", _state_file.string())("e", e.to_string()) );
+         _state = block_log_hash_state();
+      }
    }
 
-   const block_log_hash_state_object& state = _db.get< block_log_hash_state_object, by_id >( block_log_hash_state_id_type(0) );
-   uint64_t current_interval = state.last_interval;
+   // The block_log may have been replaced since the state was saved
+   if( _state.block_num > 0 )
+   {
+      const auto& log = _db.get_block_log();
+      uint64_t next_pos = log.get_block_pos( _state.block_num + 1 );
+      if( log.get_block_pos( _state.block_num ) == block_log::npos
+         || ( next_pos != block_log::npos && next_pos != _state.total_size ) )
+      {
+         wlog( "block_log_info: block_log does not match the saved hash state, hashing it again" );
+         _state = block_log_hash_state();
+      }
+   }
 
-   if( (print_interval_seconds > 0) && !is_genesis )
+   _saved_block = _state.block_num;
+}
+
+void block_log_info_plugin_impl::save_state()
+{
+   fc::path tmp = _state_file.string() + ".tmp";
    {
-      current_interval = b.timestamp.sec_since_epoch() / print_interval_seconds;
-      if( current_interval != state.last_interval )
+      std::ofstream out( tmp.generic_string(), std::ios::binary | std::ios::trunc );
+      auto data = fc::raw::pack_to_vector( _state );
+      out.write( data.data(), data.size() );
+   }
+   fc::rename( tmp, _state_file );
+   _saved_block = _state.block_num;
+}
+
+/**
+ * Hashes the block_log again from every checkpoint to the next on its own
+ * thread and compares the results with the saved state.
+ */
+void block_log_info_plugin_impl::verify( uint32_t threads )const
+{
+   if( _state.total_size == 0 )
+      return;
+
+   FC_ASSERT( fc::exists( _block_log_file ) && fc::file_size( _block_log_file ) >= _state.total_size,
+      "block_log is shorter than the ${n} bytes hashed before", ("n", _state.total_size) );
+
+   ilog( "block_log_info: verifying ${n} bytes of the block_log with ${t} threads", ("n", _state.total_size)("t", threads) );
+   auto start = fc::time_point::now();
+
+   size_t segments = _state.checkpoints.size() + 1;
+   std::atomic< size_t > next_segment{ 0 };
+   std::atomic< bool > failed{ false };
+   std::mutex error_mtx;
+   std::string error;
+
+   auto work = [&]()
+   {
+      std::ifstream in( _block_log_file.generic_string(), std::ios::binary );
+      std::vector< char > buf( 4 << 20 );
+
+      for( size_t i = next_segment++; i < segments && !failed; i = next_segment++ )
       {
-         block_log_message_data data;
-         data.block_num = block_num;
-         data.total_size = state.total_size;
-         data.current_interval = current_interval;
-         data.rsha256 = state.rsha256;
+         fc::restartable_sha256 hash;
+         if( i > 0 )
+         {
+            hash._h = _state.checkpoints[ i - 1 ];
+            hash._length = i * checkpoint_size;
+         }
 
-         if( !print_irreversible )
+         uint64_t pos = i * checkpoint_size;
+         uint64_t end = std::min( pos + checkpoint_size, _state.total_size );
+         in.seekg( pos );
+         while( pos < end && in )
          {
-            print_message( data );
+            size_t n = std::min< uint64_t >( buf.size(), end - pos );
+            in.read( buf.data(), n );
+            hash.update( buf.data(), in.gcount() );
+            pos += in.gcount();
          }
-         else
+
+         bool match = pos == end && ( i < _state.checkpoints.size()
+            ? hash._h == _state.checkpoints[ i ]
+            : hash.hexdigest() == _state.rsha256.hexdigest() );
+
+         if( !match )
          {
-            _db.create< block_log_pending_message_object >( [&data]( block_log_pending_message_object& msg )
-            {
-               msg.data = data;
-            } );
+            std::lock_guard< std::mutex > guard( error_mtx );
+            failed = true;
+            error = "block_log bytes " + std::to_string( i * checkpoint_size ) + " to " + std::to_string( end ) + " do not match their hash";
          }
       }
+   };
 
-      const dynamic_global_property_object& dgpo = _db.get_dynamic_global_properties();
+   std::vector< std::thread > workers;
+   for( uint32_t i = 1; i < std::min< size_t >( threads, segments ); ++i )
+      workers.emplace_back( work );
+   work();
+   for( auto& w : workers )
+      w.join();
+
+   FC_ASSERT( !failed, "${e}", ("e", error) );
+
+   ilog( "block_log_info: block_log verified in ${s} seconds, hash=${h}",
+      ("s", ( fc::time_point::now() - start ).count() / 1000000)("h", _state.rsha256.hexdigest()) );
+}
+
+void block_log_info_plugin_impl::start()
+{
+   uint32_t last_irreversible = _db.with_read_lock( [&](){ return _db.get_dynamic_global_properties().last_irreversible_block_num; } );
+   {
+      std::lock_guard< std::mutex > guard( _mtx );
+      _irreversible_block = std::max( _irreversible_block, last_irreversible );
+   }
+
+   _running = true;
+   _thread = std::thread( [this](){ hash_blocks(); } );
+}
 
-      const auto& idx = _db.get_index< block_log_pending_message_index, by_id >();
-      while( true )
+void block_log_info_plugin_impl::stop()
+{
+   {
+      std::lock_guard< std::mutex > guard( _mtx );
+      _running = false;
+   }
+   _cv.notify_one();
+
+   if( _thread.joinable() )
+      _thread.join();
+}
+
+void block_log_info_plugin_impl::hash_blocks()
+{
+   std::ifstream in( _block_log_file.generic_string(), std::ios::binary );
+   std::vector< char > buf;
+
+   try
+   {
+      while( _running )
       {
-         auto it = idx.begin();
-         if( it == idx.end() )
-            break;
-         if( it->data.block_num > dgpo.last_irreversible_block_num )
-            break;
-         print_message( it->data );
-         _db.remove( *it );
+         uint32_t target;
+         {
+            std::unique_lock< std::mutex > lock( _mtx );
+            _cv.wait( lock, [&](){ return !_running || _irreversible_block > _state.block_num; } );
+            target = _irreversible_block;
+         }
+
+         while( _running && _state.block_num < target )
+         {
+            if( !hash_batch( in, buf, std::min( target, _state.block_num + hash_batch_blocks ) ) )
+            {
+               // Irreversible blocks reach the block_log shortly after they are reported
+               std::unique_lock< std::mutex > lock( _mtx );
+               _cv.wait_for( lock, std::chrono::milliseconds( 100 ), [&](){ return !_running.load(); } );
+            }
+
+            if( _state.block_num >= _saved_block + save_interval_blocks )
+               save_state();
+         }
       }
+
+      save_state();
+   }
+   catch( const fc::exception& e )
+   {
+      elog( "block_log_info: hashing stopped at block ${b}: ${e}", ("b", _state.block_num)("e", e.to_detail_string()) );
+   }
+   catch( const std::exception& e )
+   {
+      elog( "block_log_info: hashing stopped at block ${b}: ${e}", ("b", _state.block_num)("e", e.what()) );
+   }
+}
+
+/**
+ * Hashes the blocks following the state up to last, reading them from the
+ * block_log file as they are stored. A block is only complete once the
+ * position of the next one is known, so the head of the block_log waits
+ * for the next block. Returns false when no block could be hashed.
+ */
+bool block_log_info_plugin_impl::hash_batch( std::ifstream& in, std::vector< char >& buf, uint32_t last )
+{
+   const auto& log = _db.get_block_log();
+
+   std::vector< uint64_t > positions;
+   positions.reserve( last - _state.block_num + 1 );
+   for( uint32_t n = _state.block_num + 1; n <= last + 1; ++n )
+   {
+      uint64_t pos = log.get_block_pos( n );
+      if( pos == block_log::npos )
+         break;
+      positions.push_back( pos );
    }
 
+   if( positions.size() < 2 )
+      return false;
+
+   FC_ASSERT( positions.front() == _state.total_size, "block_log changed while it was hashed, block ${b} is at ${p} instead of ${s}",
+      ("b", _state.block_num + 1)("p", positions.front())("s", _state.total_size) );
+
+   uint64_t begin = positions.front();
+   buf.resize( positions.back() - begin );
+   in.clear();
+   in.seekg( begin );
+   in.read( buf.data(), buf.size() );
+   if( size_t( in.gcount() ) < buf.size() )
+      return false; // not flushed yet
 
-   uint64_t offset = state.total_size;
-   std::vector< char > data = fc::raw::pack_to_vector( b );
-   for( int i=0; i<8; i++ )
+   for( size_t i = 0; i + 1 < positions.size(); ++i )
    {
-      data.push_back( (char) (offset & 0xFF) );
-      offset >>= 8;
+      uint32_t block_num = _state.block_num + 1;
+      const char* block = buf.data() + ( positions[i] - begin );
+
+      if( print_interval_seconds > 0 && block_num > 1 )
+      {
+         // The timestamp follows the previous block id in the packed header
+         uint32_t timestamp;
+         std::memcpy( &timestamp, block + sizeof( protocol::block_id_type ), sizeof( timestamp ) );
+
+         uint64_t current_interval = timestamp / print_interval_seconds;
+         if( current_interval != _state.last_interval )
+         {
+            block_log_message_data data;
+            data.block_num = block_num;
+            data.total_size = _state.total_size;
+            data.current_interval = current_interval;
+            data.rsha256 = _state.rsha256;
+            print_message( data );
+
+            _state.last_interval = current_interval;
+         }
+      }
+
+      hash_bytes( block, positions[i+1] - positions[i] );
+      _state.block_num = block_num;
    }
 
-   _db.modify( state, [&]( block_log_hash_state_object& bso )
+   return true;
+}
+
+void block_log_info_plugin_impl::hash_bytes( const char* data, size_t size )
+{
+   while( size > 0 )
    {
-      bso.total_size += data.size();
-      bso.rsha256.update( data.data(), data.size() );
-      bso.last_interval = current_interval;
-   } );
+      uint64_t next_checkpoint = ( _state.total_size / checkpoint_size + 1 ) * checkpoint_size;
+      size_t n = std::min< uint64_t >( size, next_checkpoint - _state.total_size );
+
+      _state.rsha256.update( data, n );
+      _state.total_size += n;
+      data += n;
+      size -= n;
+
+      if( _state.total_size == next_checkpoint )
+         _state.checkpoints.push_back( _state.rsha256._h );
+   }
 }
 
 void block_log_info_plugin_impl::print_message( const block_log_message_data& data )
@@ -136,8 +386,9 @@ void block_log_info_plugin::set_program_options( options_description& cli, optio
 {
    cfg.add_options()
          ("block-log-info-print-interval-seconds", boost::program_options::value< int32_t >()->default_value(60*60*24), "How often to print out block_log_info (default 1 day)")
-         ("block-log-info-print-irreversible", boost::program_options::value< bool >()->default_value(true), "Whether to defer printing until block is irreversible")
+         ("block-log-info-print-irreversible", boost::program_options::value< bool >()->default_value(true), "Deprecated, only irreversible blocks are hashed")
          ("block-log-info-print-file", boost::program_options::value< string >()->default_value("ILOG"), "Where to print (filename or special sink ILOG, STDOUT, STDERR)")
+         ("block-log-info-verify-threads", boost::program_options::value< uint32_t >()->default_value(0), "Threads checking the block_log against its saved hash at startup, 0 to skip the check")
          ;
 }
 
@@ -149,29 +400,42 @@ void block_log_info_plugin::plugin_initialize( const boost::program_options::var
       ilog( "Initializing block_log_info plugin" );
       chain::database& db = appbase::app().get_plugin< amalgam::plugins::chain::chain_plugin >().db();
 
-      my->_post_apply_block_conn = db.add_post_apply_block_handler(
-         [&]( const block_notification& note ){ my->on_post_apply_block( note ); }, *this );
-
-      add_plugin_index< block_log_hash_state_index >(db);
-      add_plugin_index< block_log_pending_message_index >(db);
+      my->_irreversible_block_conn = db.add_irreversible_block_handler(
+         [&]( uint32_t block_num ){ my->on_irreversible_block( block_num ); }, *this );
 
       my->print_interval_seconds = options.at( "block-log-info-print-interval-seconds" ).as< int32_t >();
-      my->print_irreversible = options.at( "block-log-info-print-irreversible" ).as< bool >();
       my->output_name = options.at( "block-log-info-print-file" ).as< string >();
+      my->verify_threads = options.at( "block-log-info-verify-threads" ).as< uint32_t >();
+
+      if( !options.at( "block-log-info-print-irreversible" ).as< bool >() )
+         wlog( "block-log-info-print-irreversible is ignored, blocks are hashed once they are irreversible" );
 
       if( my->print_interval_seconds <= 0 )
       {
          wlog( "print_interval_seconds set to value <= 0, if you don't need printing, consider disabling block_log_info_plugin entirely to improve performance" );
       }
+
+      my->_block_log_file = appbase::app().data_dir() / "blockchain" / "block_log";
+      fc::create_directories( appbase::app().data_dir() / "block_log_info" );
+      my->_state_file = appbase::app().data_dir() / "block_log_info" / "hash_state";
    }
    FC_CAPTURE_AND_RETHROW()
 }
 
-void block_log_info_plugin::plugin_startup() {}
+void block_log_info_plugin::plugin_startup()
+{
+   my->load_state();
+
+   if( my->verify_threads > 0 )
+      my->verify( my->verify_threads );
+
+   my->start();
+}
 
 void block_log_info_plugin::plugin_shutdown()
 {
-   chain::util::disconnect_signal( my->_post_apply_block_conn );
+   chain::util::disconnect_signal( my->_irreversible_block_conn );
+   my->stop();
 }
 
 } } } // amalgam::plugins::block_log_info
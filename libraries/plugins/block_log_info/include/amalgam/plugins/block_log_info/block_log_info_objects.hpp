@@ -1,39 +1,21 @@
 #pragma once
-#include <amalgam/chain/amalgam_object_types.hpp>
-
-#include <boost/multi_index/composite_key.hpp>
+#include <amalgam/protocol/types.hpp>
 
 #include <fc/crypto/restartable_sha256.hpp>
 
-namespace amalgam { namespace plugins { namespace block_log_info {
-
-using namespace std;
-using namespace amalgam::chain;
+#include <vector>
 
-#ifndef AMALGAM_BLOCK_LOG_INFO_SPACE_ID
-#define AMALGAM_BLOCK_LOG_INFO_SPACE_ID 14
-#endif
-
-enum block_log_info_object_types
-{
-   block_log_hash_state_object_type      = ( AMALGAM_BLOCK_LOG_INFO_SPACE_ID << 8 )    ,
-   block_log_pending_message_object_type = ( AMALGAM_BLOCK_LOG_INFO_SPACE_ID << 8 ) + 1,
-};
+namespace amalgam { namespace plugins { namespace block_log_info {
 
-class block_log_hash_state_object : public object< block_log_hash_state_object_type, block_log_hash_state_object >
+/** Hash of the block_log file up to and including block_num */
+struct block_log_hash_state
 {
-   public:
-      template< typename Constructor, typename Allocator >
-      block_log_hash_state_object( Constructor&& c, allocator< Allocator > a )
-      {
-         c( *this );
-      }
-
-      id_type                  id;
-
-      uint64_t                 total_size = 0;
-      fc::restartable_sha256   rsha256;
-      uint64_t                 last_interval = 0;
+   uint32_t                                  block_num = 0;
+   uint64_t                                  total_size = 0;
+   fc::restartable_sha256                    rsha256;
+   uint64_t                                  last_interval = 0;
+   /// rsha256._h at every multiple of checkpoint_size bytes, lets the file be checked in parallel
+   std::vector< fc::array< uint32_t, 8 > >   checkpoints;
 };
 
 struct block_log_message_data
@@ -44,48 +26,8 @@ struct block_log_message_data
    fc::restartable_sha256 rsha256;
 };
 
-class block_log_pending_message_object : public object< block_log_pending_message_object_type, block_log_pending_message_object >
-{
-   public:
-      template< typename Constructor, typename Allocator >
-      block_log_pending_message_object( Constructor&& c, allocator< Allocator > a )
-      {
-         c( *this );
-      }
-
-      id_type                  id;
-
-      block_log_message_data   data;
-};
-
-typedef block_log_hash_state_object::id_type block_log_hash_state_id_type;
-typedef block_log_pending_message_object::id_type block_log_pending_message_id_type;
-
-using namespace boost::multi_index;
-
-typedef multi_index_container<
-   block_log_hash_state_object,
-   indexed_by<
-      ordered_unique< tag< by_id >, member< block_log_hash_state_object, block_log_hash_state_id_type, &block_log_hash_state_object::id > >
-   >,
-   allocator< block_log_hash_state_object >
-> block_log_hash_state_index;
-
-typedef multi_index_container<
-   block_log_pending_message_object,
-   indexed_by<
-      ordered_unique< tag< by_id >, member< block_log_pending_message_object, block_log_pending_message_id_type, &block_log_pending_message_object::id > >
-   >,
-   allocator< block_log_pending_message_object >
-> block_log_pending_message_index;
-
 } } } // amalgam::plugins::block_log_info
 
-
-FC_REFLECT( amalgam::plugins::block_log_info::block_log_hash_state_object, (id)(total_size)(rsha256)(last_interval) )
-CHAINBASE_SET_INDEX_TYPE( amalgam::plugins::block_log_info::block_log_hash_state_object, amalgam::plugins::block_log_info::block_log_hash_state_index )
+FC_REFLECT( amalgam::plugins::block_log_info::block_log_hash_state, (block_num)(total_size)(rsha256)(last_interval)(checkpoints) )
 
 FC_REFLECT( amalgam::plugins::block_log_info::block_log_message_data, (block_num)(total_size)(current_interval)(rsha256) )
-
-FC_REFLECT( amalgam::plugins::block_log_info::block_log_pending_message_object, (id)(data) )
-CHAINBASE_SET_INDEX_TYPE( amalgam::plugins::block_log_info::block_log_pending_message_object, amalgam::plugins::block_log_info::block_log_pending_message_index )
@@ -5,6 +5,7 @@
 
 #include <amalgam/utilities/benchmark_dumper.hpp>
 
+#include <fc/metrics.hpp>
 #include <fc/string.hpp>
 
 #include <boost/asio.hpp>
@@ -49,6 +50,7 @@ struct write_context
 {
    write_request_ptr             req_ptr;
    uint32_t                      skip = 0;
+   const block_prevalidation*    prevalidation = nullptr;
    bool                          success = true;
    fc::optional< fc::exception > except;
    promise_ptr                   prom_ptr;
@@ -64,6 +66,7 @@ class chain_plugin_impl
 
       void start_write_processing();
       void stop_write_processing();
+      void add_lock_metrics();
 
       uint64_t                         shared_memory_size = 0;
       uint16_t                         shared_file_full_threshold = 0;
@@ -92,12 +95,41 @@ class chain_plugin_impl
       database  db;
 };
 
+/** Metrics of the write thread, registered on first use */
+struct chain_metrics
+{
+   fc::metrics::histogram& push_block = fc::metrics::registry::global().get_histogram(
+      "amalgam_chain_push_block_seconds", "Time to push a block, including fork switches" );
+   fc::metrics::histogram& push_transaction = fc::metrics::registry::global().get_histogram(
+      "amalgam_chain_push_transaction_seconds", "Time to push a transaction" );
+   fc::metrics::histogram& generate_block = fc::metrics::registry::global().get_histogram(
+      "amalgam_chain_generate_block_seconds", "Time to generate a block" );
+   fc::metrics::histogram& write_lock_hold = fc::metrics::registry::global().get_histogram(
+      "amalgam_chain_write_lock_hold_seconds", "Time the write thread holds the write lock for one batch of requests" );
+   fc::metrics::counter& blocks_pushed = fc::metrics::registry::global().get_counter(
+      "amalgam_chain_blocks_pushed_total", "Blocks pushed to the database" );
+   fc::metrics::counter& transactions_pushed = fc::metrics::registry::global().get_counter(
+      "amalgam_chain_transactions_total", "Transactions pushed to the database", { { "result", "accepted" } } );
+   fc::metrics::counter& transactions_rejected = fc::metrics::registry::global().get_counter(
+      "amalgam_chain_transactions_total", "Transactions pushed to the database", { { "result", "rejected" } } );
+   fc::metrics::gauge& head_block = fc::metrics::registry::global().get_gauge(
+      "amalgam_chain_head_block_number", "Number of the head block" );
+
+   static chain_metrics& get()
+   {
+      static chain_metrics m;
+      return m;
+   }
+};
+
 struct write_request_visitor
 {
    write_request_visitor() {}
 
+   chain_metrics& metrics = chain_metrics::get();
    database* db;
    uint32_t  skip = 0;
+   const block_prevalidation* prevalidation = nullptr;
    fc::optional< fc::exception >* except;
 
    typedef bool result_type;
@@ -109,8 +141,13 @@ struct write_request_visitor
       try
       {
          STATSD_START_TIMER( "chain", "write_time", "push_block", 1.0f )
-         result = db->push_block( *block, skip );
+         fc::metrics::scoped_timer timer( metrics.push_block );
+         result = db->push_block( *block, skip, prevalidation );
+         timer.stop();
          STATSD_STOP_TIMER( "chain", "write_time", "push_block" )
+
+         metrics.blocks_pushed.add();
+         metrics.head_block.set( db->head_block_num() );
       }
       catch( fc::exception& e )
       {
@@ -132,13 +169,17 @@ struct write_request_visitor
       try
       {
          STATSD_START_TIMER( "chain", "write_time", "push_transaction", 1.0f )
+         fc::metrics::scoped_timer timer( metrics.push_transaction );
          db->push_transaction( *trx );
+         timer.stop();
          STATSD_STOP_TIMER( "chain", "write_time", "push_transaction" )
 
+         metrics.transactions_pushed.add();
          result = true;
       }
       catch( fc::exception& e )
       {
+         metrics.transactions_rejected.add();
          *except = e;
       }
       catch( ... )
@@ -157,14 +198,18 @@ struct write_request_visitor
       try
       {
          STATSD_START_TIMER( "chain", "write_time", "generate_block", 1.0f )
+         fc::metrics::scoped_timer timer( metrics.generate_block );
          req->block = db->generate_block(
             req->when,
             req->witness_owner,
             req->block_signing_private_key,
             req->skip
             );
+         timer.stop();
          STATSD_STOP_TIMER( "chain", "write_time", "generate_block" )
 
+         metrics.head_block.set( db->head_block_num() );
+
          result = true;
       }
       catch( fc::exception& e )
@@ -235,9 +280,11 @@ void chain_plugin_impl::start_write_processing()
             db.with_write_lock( [&]()
             {
                STATSD_START_TIMER( "chain", "lock_time", "write_lock", 1.0f )
+               fc::metrics::scoped_timer lock_timer( req_visitor.metrics.write_lock_hold );
                while( true )
                {
                   req_visitor.skip = cxt->skip;
+                  req_visitor.prevalidation = cxt->prevalidation;
                   req_visitor.except = &(cxt->except);
                   cxt->success = cxt->req_ptr.visit( req_visitor );
                   cxt->prom_ptr.visit( prom_visitor );
@@ -277,6 +324,23 @@ void chain_plugin_impl::stop_write_processing()
    write_processor_thread.reset();
 }
 
+/** Exports the chainbase lock waits, which chainbase keeps without depending on fc */
+void chain_plugin_impl::add_lock_metrics()
+{
+   const auto& stats = db.get_lock_statistics();
+   auto& registry = fc::metrics::registry::global();
+   auto value = []( const std::atomic< uint64_t >& v ){ return double( v.load( std::memory_order_relaxed ) ); };
+
+   registry.add_callback( "amalgam_chainbase_lock_waits_total", "Database locks that waited for another thread",
+      fc::metrics::metric_type::counter, [&stats, value](){ return value( stats.read_waits ); }, { { "lock", "read" } } );
+   registry.add_callback( "amalgam_chainbase_lock_waits_total", "Database locks that waited for another thread",
+      fc::metrics::metric_type::counter, [&stats, value](){ return value( stats.write_waits ); }, { { "lock", "write" } } );
+   registry.add_callback( "amalgam_chainbase_lock_wait_seconds_total", "Time spent waiting for database locks",
+      fc::metrics::metric_type::counter, [&stats, value](){ return value( stats.read_wait_micros ) / 1000000; }, { { "lock", "read" } } );
+   registry.add_callback( "amalgam_chainbase_lock_wait_seconds_total", "Time spent waiting for database locks",
+      fc::metrics::metric_type::counter, [&stats, value](){ return value( stats.write_wait_micros ) / 1000000; }, { { "lock", "write" } } );
+}
+
 } // detail
 
 
@@ -525,6 +589,7 @@ void chain_plugin::plugin_startup()
    ilog( "Started on blockchain with ${n} blocks", ("n", my->db.head_block_num()) );
    on_sync();
 
+   my->add_lock_metrics();
    my->start_write_processing();
 }
 
@@ -536,7 +601,8 @@ void chain_plugin::plugin_shutdown()
    ilog("database closed successfully");
 }
 
-bool chain_plugin::accept_block( const amalgam::chain::signed_block& block, bool currently_syncing, uint32_t skip )
+bool chain_plugin::accept_block( const amalgam::chain::signed_block& block, bool currently_syncing, uint32_t skip,
+   const amalgam::chain::block_prevalidation* prevalidation )
 {
    if (currently_syncing && block.block_num() % 10000 == 0) {
       ilog("Syncing Blockchain --- Got block: #${n} time: ${t} producer: ${p}",
@@ -551,6 +617,7 @@ bool chain_plugin::accept_block( const amalgam::chain::signed_block& block, bool
    write_context cxt;
    cxt.req_ptr = &block;
    cxt.skip = skip;
+   cxt.prevalidation = prevalidation;
    cxt.prom_ptr = &prom;
 
    my->write_queue.push( &cxt );
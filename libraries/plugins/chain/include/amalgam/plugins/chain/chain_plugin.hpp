@@ -33,7 +33,12 @@ public:
    virtual void plugin_startup() override;
    virtual void plugin_shutdown() override;
 
-   bool accept_block( const amalgam::chain::signed_block& block, bool currently_syncing, uint32_t skip );
+   /**
+    * prevalidation, if given, must be the result of prevalidate_block( block ) and
+    * outlive the call. It lets the write thread skip the checks already done.
+    */
+   bool accept_block( const amalgam::chain::signed_block& block, bool currently_syncing, uint32_t skip,
+      const amalgam::chain::block_prevalidation* prevalidation = nullptr );
    void accept_transaction( const amalgam::chain::signed_transaction& trx );
    amalgam::chain::signed_block generate_block(
       const fc::time_point_sec when,
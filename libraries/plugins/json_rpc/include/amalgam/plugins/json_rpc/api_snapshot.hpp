@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace amalgam { namespace plugins { namespace json_rpc {
+
+/**
+ * @brief Pre-serialized result of an api method that takes no arguments.
+ *
+ * The owner replaces the JSON whenever the underlying state changes, and
+ * json_rpc serves calls from the latest copy without taking any lock.
+ * While no copy is set, calls go to the api method as usual.
+ */
+class api_snapshot
+{
+   public:
+      std::shared_ptr< const std::string > get()const
+      {
+         return std::atomic_load( &_json );
+      }
+
+      void set( std::shared_ptr< const std::string > json )
+      {
+         std::atomic_store( &_json, std::move( json ) );
+      }
+
+      void clear() { set( std::shared_ptr< const std::string >() ); }
+
+      /** Whether anyone asked for the snapshot since the last call, lets the owner skip unused refreshes */
+      bool take_requested() { return _requested.exchange( false ); }
+      void mark_requested() { if( !_requested.load( std::memory_order_relaxed ) ) _requested.store( true ); }
+
+   private:
+      std::shared_ptr< const std::string >   _json;
+      std::atomic< bool >                    _requested{ false };
+};
+
+} } } // amalgam::plugins::json_rpc
@@ -2,10 +2,19 @@
 
 #include <appbase/application.hpp>
 
+#include <amalgam/plugins/json_rpc/utility.hpp>
+#include <amalgam/plugins/json_rpc/api_snapshot.hpp>
+
+#include <amalgam/schema/schema.hpp>
+
 #include <fc/variant.hpp>
 #include <fc/io/json.hpp>
+#include <fc/io/json_reader.hpp>
+#include <fc/io/json_writer.hpp>
 #include <fc/reflect/variant.hpp>
 #include <fc/exception/exception.hpp>
+#include <fc/crypto/sha256.hpp>
+#include <fc/io/raw.hpp>
 
 #include <boost/config.hpp>
 #include <boost/any.hpp>
@@ -61,9 +70,62 @@ using namespace appbase;
  * @brief Internal type used to bind api methods
  * to names.
  *
- * Arguments: Variant object of propert arg type
+ * Arguments: JSON text of the params, decoded straight into the arg type
+ * Returns: The result, already serialized to JSON
+ */
+typedef std::function< std::string(const fc::json_span&, bool lock) > api_method;
+
+/**
+ * @brief Binary binding of an api method, used when the client asks
+ * for results in fc::raw form.
+ *
+ * Arguments: JSON text of the params, as for api_method
+ * Returns: The result packed with fc::raw
+ */
+typedef std::function< std::string(const fc::json_span&, bool lock) > api_binary_method;
+
+/**
+ * @brief Layout of the packed result of a method, as generated by
+ * libraries/schema.
+ *
+ * The id is a digest of the definitions, so it only changes with the
+ * result type and clients can keep decoders by id.
+ */
+struct api_result_schema
+{
+   string            id;
+   /// JSON schema of the result type followed by every type it depends on
+   vector< string >  definitions;
+};
+
+/**
+ * @brief Runs a task asynchronously, used to spread a batch request
+ * over the caller's thread pool.
+ */
+typedef std::function< void(std::function< void() >) > api_task_executor;
+
+/**
+ * @brief Runs the callback while holding the chainbase read lock, so
+ * read only calls in a batch share a single lock acquisition.
+ */
+typedef std::function< void(const std::function< void() >&) > api_read_lock;
+
+/**
+ * @brief Receives the response of json_rpc_plugin::call_async(), possibly
+ * on another thread.
  */
-typedef std::function< fc::variant(const fc::variant&) > api_method;
+typedef std::function< void(const std::string&) > api_response_handler;
+
+/**
+ * @brief Renders the params of a notification, only called when somebody
+ * subscribed to its topic and possibly on another thread.
+ */
+typedef std::function< std::string() > api_notice_renderer;
+
+/**
+ * @brief Delivers notifications of a topic to the subscribers of one transport.
+ */
+typedef std::function< void(const std::string& topic, uint32_t block_num, const api_notice_renderer& render) > api_notice_sink;
 
 /**
  * @brief An API, containing APIs and Methods
@@ -100,8 +162,57 @@ class json_rpc_plugin : public appbase::plugin< json_rpc_plugin >
       virtual void plugin_startup() override;
       virtual void plugin_shutdown() override;
 
-      void add_api_method( const string& api_name, const string& method_name, const api_method& api, const api_method_signature& sig );
-      string call( const string& body );
+      void add_api_method( const string& api_name, const string& method_name, const api_method& api, const api_method_signature& sig, bool read_only = false,
+         const api_binary_method& binary_api = api_binary_method(), const api_result_schema& schema = api_result_schema() );
+
+      /**
+       * Runs the JSON-RPC request or batch in body. With binary the response
+       * is fc::raw packed instead of JSON: id (variant), schema id (string),
+       * result (bytes) and error (optional), or a vector of those for a
+       * batch. jsonrpc.get_schema describes the result bytes of a method.
+       */
+      string call( const string& body, bool binary = false );
+
+      /**
+       * Like call(), but read only requests are queued until the read lock is
+       * free and run together with other queued calls, so the calling thread
+       * never waits for the lock. Other requests run before returning.
+       * Queueing needs set_batch_read_lock().
+       */
+      void call_async( const string& body, const api_response_handler& handler, bool binary = false );
+
+      void set_batch_executor( const api_task_executor& executor );
+      void set_batch_read_lock( const api_read_lock& read_lock );
+
+      /**
+       * Lets the response cache hold results of api_name.method_name. A call
+       * is only cached when the method reports it with cache_response().
+       */
+      void add_cacheable_method( const string& api_name, const string& method_name );
+
+      /**
+       * Serves calls to api_name.method_name without arguments from the snapshot
+       * while it holds a value. Must be called before startup.
+       */
+      void add_api_snapshot( const string& api_name, const string& method_name, const std::shared_ptr< api_snapshot >& snapshot );
+
+      /**
+       * Called from inside a cacheable api method when its result can not change
+       * unless block_num is replaced by a fork.
+       */
+      static void cache_response( uint32_t block_num );
+
+      /**
+       * Pushes a notification about topic to the subscribers of every transport
+       * that registered a sink. APIs publish from chain handlers, so sinks must
+       * not render or send anything before returning.
+       */
+      void publish_notice( const string& topic, uint32_t block_num, const api_notice_renderer& render );
+      void add_notice_sink( const api_notice_sink& sink );
+
+      /** Chain events that keep cached responses consistent across forks */
+      void on_block_applied( uint32_t block_num );
+      void on_irreversible_block( uint32_t block_num );
 
    private:
       std::unique_ptr< detail::json_rpc_plugin_impl > my;
@@ -109,6 +220,34 @@ class json_rpc_plugin : public appbase::plugin< json_rpc_plugin >
 
 namespace detail {
 
+   template< typename T >
+   api_result_schema make_result_schema()
+   {
+      std::vector< std::shared_ptr< amalgam::schema::abstract_schema > > schemas;
+      schemas.push_back( amalgam::schema::get_schema_for_type< T >() );
+      amalgam::schema::add_dependent_schemas( schemas );
+
+      api_result_schema result;
+      fc::sha256::encoder enc;
+      for( const auto& s : schemas )
+      {
+         result.definitions.emplace_back();
+         s->get_str_schema( result.definitions.back() );
+         enc.write( result.definitions.back().c_str(), result.definitions.back().size() + 1 );
+      }
+      result.id = enc.result().str().substr( 0, 16 );
+      return result;
+   }
+
+   template< typename T >
+   std::string pack_result( const T& result )
+   {
+      std::string out( fc::raw::pack_size( result ), '\0' );
+      fc::datastream< char* > ds( &out[0], out.size() );
+      fc::raw::pack( ds, result );
+      return out;
+   }
+
    class register_api_method_visitor
    {
       public:
@@ -126,11 +265,21 @@ namespace detail {
             Ret* ret )
          {
             _json_rpc_plugin.add_api_method( _api_name, method_name,
-               [&plugin,method]( const fc::variant& args ) -> fc::variant
+               [&plugin,method]( const fc::json_span& args, bool lock ) -> std::string
+               {
+                  Args a;
+                  fc::json_reader::decode( args, a );
+                  return fc::json_writer::to_string( (plugin.*method)( a, lock ) );
+               },
+               api_method_signature{ fc::variant( Args() ), fc::variant( Ret() ) },
+               read_api_registry::instance().contains( typeid( Plugin ), method_name ),
+               [&plugin,method]( const fc::json_span& args, bool lock ) -> std::string
                {
-                  return fc::variant( (plugin.*method)( args.as< Args >(), true ) );
+                  Args a;
+                  fc::json_reader::decode( args, a );
+                  return pack_result( (plugin.*method)( a, lock ) );
                },
-               api_method_signature{ fc::variant( Args() ), fc::variant( Ret() ) } );
+               make_result_schema< Ret >() );
          }
 
       private:
@@ -143,3 +292,4 @@ namespace detail {
 } } } // amalgam::plugins::json_rpc
 
 FC_REFLECT( amalgam::plugins::json_rpc::api_method_signature, (args)(ret) )
+FC_REFLECT( amalgam::plugins::json_rpc::api_result_schema, (id)(definitions) )
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace amalgam { namespace plugins { namespace json_rpc {
+
+/**
+ * @brief LRU cache of serialized api results, bounded by bytes.
+ *
+ * Every entry is tagged with the block it was read from. Entries at or
+ * below the last irreversible block never go stale. Entries above it are
+ * dropped when a block at or below their height is applied again, which
+ * only happens when the node switches forks.
+ *
+ * An insert is skipped if any block was applied after the lookup that
+ * missed. This keeps a call that races with a fork switch from caching
+ * a result read from the old fork.
+ */
+class response_cache
+{
+   public:
+      response_cache( uint64_t max_bytes ) : _max_bytes( max_bytes ) {}
+
+      /** copies the cached JSON to json and returns true on a hit, else returns the generation for put() */
+      bool get( const std::string& key, std::string& json, uint64_t& generation );
+      void put( const std::string& key, const std::string& json, uint32_t block_num, uint64_t generation );
+
+      void on_block_applied( uint32_t block_num );
+      void on_irreversible_block( uint32_t block_num );
+
+      uint64_t size_bytes()const;
+      size_t   size()const;
+
+   private:
+      struct entry
+      {
+         std::string    key;
+         std::string    json;
+         uint32_t       block_num = 0;
+         bool           reversible = false;
+      };
+
+      typedef std::list< entry >                               lru_list;
+      typedef std::multimap< uint32_t, lru_list::iterator >    reversible_index;
+
+      static uint64_t entry_bytes( const entry& e ) { return e.key.size() + e.json.size() + sizeof( entry ); }
+      void erase( lru_list::iterator itr );
+
+      mutable std::mutex                                       _mtx;
+      uint64_t                                                 _max_bytes;
+      uint64_t                                                 _bytes = 0;
+      uint64_t                                                 _generation = 0;
+      uint32_t                                                 _last_irreversible = 0;
+      lru_list                                                 _lru;
+      std::unordered_map< std::string, lru_list::iterator >    _entries;
+      reversible_index                                         _reversible;
+};
+
+} } } // amalgam::plugins::json_rpc
@@ -1,6 +1,12 @@
 #pragma once
 
+#include <initializer_list>
+#include <set>
+#include <string>
 #include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#include <utility>
 
 #include <fc/reflect/reflect.hpp>
 #include <fc/macros.hpp>
@@ -75,8 +81,12 @@ BOOST_PP_CAT( method, _return ) class :: method ( const BOOST_PP_CAT( method, _a
    return my->method( args );                                                                            \
 }
 
+#define READ_API_NAME_HELPER( r, data, method ) BOOST_PP_STRINGIZE( method ),
+
 #define DEFINE_READ_APIS( class, METHODS ) \
-   BOOST_PP_SEQ_FOR_EACH( DEFINE_READ_API_HELPER, class, METHODS )
+   BOOST_PP_SEQ_FOR_EACH( DEFINE_READ_API_HELPER, class, METHODS ) \
+   static const amalgam::plugins::json_rpc::detail::read_api_registrar BOOST_PP_CAT( _read_api_registrar_, class )( \
+      typeid( class ), { BOOST_PP_SEQ_FOR_EACH( READ_API_NAME_HELPER, _, METHODS ) } );
 
 #define DEFINE_WRITE_APIS( class, METHODS ) \
    BOOST_PP_SEQ_FOR_EACH( DEFINE_WRITE_API_HELPER, class, METHODS )
@@ -88,6 +98,48 @@ namespace amalgam { namespace plugins { namespace json_rpc {
 
 struct void_type {};
 
+namespace detail {
+
+   /**
+    * Methods defined with DEFINE_READ_APIS only need the chainbase read lock,
+    * so the JSON-RPC plugin may run several of them from one batch under a
+    * single lock acquisition. The registry is filled during static
+    * initialization and is read only afterwards.
+    */
+   class read_api_registry
+   {
+      public:
+         static read_api_registry& instance()
+         {
+            static read_api_registry registry;
+            return registry;
+         }
+
+         void add( const std::type_info& api, const std::string& method )
+         {
+            _methods.emplace( std::type_index( api ), method );
+         }
+
+         bool contains( const std::type_info& api, const std::string& method )const
+         {
+            return _methods.find( std::make_pair( std::type_index( api ), method ) ) != _methods.end();
+         }
+
+      private:
+         std::set< std::pair< std::type_index, std::string > > _methods;
+   };
+
+   struct read_api_registrar
+   {
+      read_api_registrar( const std::type_info& api, std::initializer_list< const char* > methods )
+      {
+         for( const char* method : methods )
+            read_api_registry::instance().add( api, method );
+      }
+   };
+
+} // detail
+
 } } } // amalgam::plugins::json_rpc
 
 FC_REFLECT( amalgam::plugins::json_rpc::void_type, )
@@ -1,5 +1,7 @@
 #include <amalgam/plugins/json_rpc/json_rpc_plugin.hpp>
 #include <amalgam/plugins/json_rpc/utility.hpp>
+#include <amalgam/plugins/json_rpc/response_cache.hpp>
+#include <amalgam/plugins/json_rpc/api_snapshot.hpp>
 
 #include <amalgam/plugins/statsd/utility.hpp>
 
@@ -9,15 +11,27 @@
 #include <fc/exception/exception.hpp>
 #include <fc/macros.hpp>
 #include <fc/io/fstream.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/metrics.hpp>
 
 #include <chainbase/chainbase.hpp>
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
 #define ENABLE_JSON_RPC_LOG
 
 namespace amalgam { namespace plugins { namespace json_rpc {
 
 namespace detail
 {
+   /// set by json_rpc_plugin::cache_response() during the api call running on this thread
+   thread_local bool       response_cacheable = false;
+   thread_local uint32_t   response_block_num = 0;
+
    struct json_rpc_error
    {
       json_rpc_error()
@@ -31,14 +45,141 @@ namespace detail
       fc::optional< fc::variant >      data;
    };
 
+   /**
+    * Members of one request, located without building a variant for
+    * "params", which is decoded straight into the method's args later.
+    */
+   struct json_rpc_request
+   {
+      fc::json_span                    text;
+      fc::optional< fc::variant >      jsonrpc;
+      fc::optional< fc::variant >      method;
+      fc::optional< fc::variant >      id;
+      fc::json_span                    params;
+      /// set when the request is not an object
+      fc::optional< fc::variant >      non_object;
+      /// the result is wanted in fc::raw form
+      bool                             binary = false;
+   };
+
    struct json_rpc_response
    {
       std::string                      jsonrpc = "2.0";
-      fc::optional< fc::variant >      result;
+      /// JSON text of the result, spliced into the response as is
+      fc::optional< std::string >      result;
       fc::optional< json_rpc_error >   error;
       fc::variant                      id;
+      /// id of the result schema when result holds fc::raw bytes
+      fc::optional< std::string >      schema;
+   };
+
+   /**
+    * Response sent to binary clients. The request itself is JSON, only the
+    * result changes form: result holds the fc::raw packed return value,
+    * laid out as described by jsonrpc.get_schema for the schema id.
+    */
+   struct json_rpc_binary_response
+   {
+      fc::variant                      id;
+      std::string                      schema;
+      std::vector< char >              result;
+      fc::optional< json_rpc_error >   error;
    };
 
+   struct api_binary_binding
+   {
+      api_binary_method                method;
+      api_result_schema                schema;
+   };
+
+   /** A message body and the requests parsed from it, which point into the body */
+   struct json_rpc_call
+   {
+      string                           body;
+      /// the body rewritten as strict JSON when only the legacy parser accepts it
+      string                           normalized;
+      vector< json_rpc_request >       requests;
+      bool                             batch = false;
+      bool                             parsed = false;
+      bool                             binary = false;
+      api_response_handler             handler;
+      fc::time_point                   queued;
+   };
+
+} } } } // amalgam::plugins::json_rpc::detail
+
+FC_REFLECT( amalgam::plugins::json_rpc::detail::json_rpc_error, (code)(message)(data) )
+FC_REFLECT( amalgam::plugins::json_rpc::detail::json_rpc_binary_response, (id)(schema)(result)(error) )
+
+namespace amalgam { namespace plugins { namespace json_rpc { namespace detail {
+
+   void write_response( const json_rpc_response& response, std::string& out )
+   {
+      fc::json_writer writer( out );
+      out += "{\"jsonrpc\":";
+      writer.write( response.jsonrpc );
+      if( response.result.valid() )
+      {
+         out += ",\"result\":";
+         out += *response.result;
+      }
+      if( response.error.valid() )
+      {
+         out += ",\"error\":";
+         writer.write( *response.error );
+      }
+      out += ",\"id\":";
+      writer.write( response.id );
+      out += '}';
+   }
+
+   string response_to_json( const json_rpc_response& response )
+   {
+      string out;
+      write_response( response, out );
+      return out;
+   }
+
+   string responses_to_json( const vector< json_rpc_response >& responses )
+   {
+      string out;
+      out += '[';
+      for( size_t i = 0; i < responses.size(); ++i )
+      {
+         if( i )
+            out += ',';
+         write_response( responses[i], out );
+      }
+      out += ']';
+      return out;
+   }
+
+   json_rpc_binary_response to_binary_response( const json_rpc_response& response )
+   {
+      json_rpc_binary_response binary;
+      binary.id = response.id;
+      binary.error = response.error;
+      if( response.schema.valid() )
+         binary.schema = *response.schema;
+      if( response.result.valid() )
+         binary.result.assign( response.result->begin(), response.result->end() );
+      return binary;
+   }
+
+   string response_to_binary( const json_rpc_response& response )
+   {
+      return pack_result( to_binary_response( response ) );
+   }
+
+   string responses_to_binary( const vector< json_rpc_response >& responses )
+   {
+      vector< json_rpc_binary_response > binary;
+      binary.reserve( responses.size() );
+      for( const auto& r : responses )
+         binary.push_back( to_binary_response( r ) );
+      return pack_result( binary );
+   }
+
    typedef void_type             get_methods_args;
    typedef vector< string >      get_methods_return;
 
@@ -49,6 +190,9 @@ namespace detail
 
    typedef api_method_signature  get_signature_return;
 
+   typedef get_signature_args    get_schema_args;
+   typedef api_result_schema     get_schema_return;
+
    class json_rpc_logger
    {
    public:
@@ -97,6 +241,7 @@ namespace detail
 
       void log(const fc::variant_object& request, json_rpc_response& response)
       {
+         std::lock_guard< std::mutex > guard( mtx );
          fc::path file(dir_name);
          bool error = response.error.valid();
          std::string counter_str;
@@ -115,7 +260,7 @@ namespace detail
          if (error)
             fc::json::save_to_file(response.error, file);
          else
-            fc::json::save_to_file(response.result, file);
+            fc::json::save_to_file(fc::json::from_string(*response.result), file);
       }
 
    private:
@@ -125,6 +270,32 @@ namespace detail
        */
       uint32_t counter = 0;
       uint32_t errors = 0;
+      /// batch entries are logged from several threads
+      std::mutex mtx;
+   };
+
+   struct json_rpc_metrics
+   {
+      fc::metrics::counter& requests = fc::metrics::registry::global().get_counter(
+         "amalgam_jsonrpc_requests_total", "JSON-RPC requests, each entry of a batch counts" );
+      fc::metrics::counter& errors = fc::metrics::registry::global().get_counter(
+         "amalgam_jsonrpc_errors_total", "JSON-RPC requests answered with an error" );
+      fc::metrics::histogram& request_time = fc::metrics::registry::global().get_histogram(
+         "amalgam_jsonrpc_request_seconds", "Time to parse, run and answer a JSON-RPC request" );
+      fc::metrics::counter& snapshot_hits = fc::metrics::registry::global().get_counter(
+         "amalgam_jsonrpc_cache_total", "Calls answered from snapshots and the response cache", { { "result", "snapshot" } } );
+      fc::metrics::counter& cache_hits = fc::metrics::registry::global().get_counter(
+         "amalgam_jsonrpc_cache_total", "Calls answered from snapshots and the response cache", { { "result", "hit" } } );
+      fc::metrics::counter& cache_misses = fc::metrics::registry::global().get_counter(
+         "amalgam_jsonrpc_cache_total", "Calls answered from snapshots and the response cache", { { "result", "miss" } } );
+      fc::metrics::gauge& cache_bytes = fc::metrics::registry::global().get_gauge(
+         "amalgam_jsonrpc_cache_bytes", "Bytes held by the response cache" );
+      fc::metrics::gauge& read_queue_depth = fc::metrics::registry::global().get_gauge(
+         "amalgam_jsonrpc_read_queue_depth", "Read calls waiting for the read lock" );
+      fc::metrics::histogram& read_queue_wait = fc::metrics::registry::global().get_histogram(
+         "amalgam_jsonrpc_read_queue_wait_seconds", "Time a queued read call waits for the read lock" );
+      fc::metrics::counter& read_queue_timeouts = fc::metrics::registry::global().get_counter(
+         "amalgam_jsonrpc_read_queue_lock_timeouts_total", "Read lock acquisitions of the read queue that timed out" );
    };
 
    class json_rpc_plugin_impl
@@ -133,36 +304,82 @@ namespace detail
          json_rpc_plugin_impl();
          ~json_rpc_plugin_impl();
 
-         void add_api_method( const string& api_name, const string& method_name, const api_method& api, const api_method_signature& sig );
+         void add_api_method( const string& api_name, const string& method_name, const api_method& api, const api_method_signature& sig, bool read_only,
+            const api_binary_method& binary_api, const api_result_schema& schema );
+
+         json_rpc_request parse_request( fc::json_reader& reader );
+         bool parse_requests( const string& body, vector< json_rpc_request >& requests );
+         void parse_call( json_rpc_call& c );
+         string call( json_rpc_call& c, bool lock );
 
          api_method* find_api_method( std::string api, std::string method );
-         api_method* process_params( string method, const fc::variant_object& request, fc::variant& func_args, string* method_name );
-         void rpc_id( const fc::variant_object& request, json_rpc_response& response );
-         void rpc_jsonrpc( const fc::variant_object& request, json_rpc_response& response );
-         json_rpc_response rpc( const fc::variant& message );
+         api_method* process_params( string method, const json_rpc_request& request, fc::json_span& func_args, string* method_name );
+         void rpc_id( const json_rpc_request& request, json_rpc_response& response );
+         void rpc_jsonrpc( const json_rpc_request& request, json_rpc_response& response, bool lock );
+         json_rpc_response rpc( const json_rpc_request& request, bool lock = true );
+         string call_api( const api_method& call, const string& method_name, const fc::json_span& args, bool lock );
+         string call_binary_api( const string& method_name, const fc::json_span& args, bool lock, fc::optional< string >& schema );
+         bool call_snapshot( const string& method_name, const fc::json_span& args, string& json );
+
+         bool is_read_only_call( const json_rpc_request& request );
+         bool is_read_only_call( const json_rpc_call& c );
+         void run_parallel( size_t count, const std::function< void(size_t) >& task );
+         void rpc_batch_entries( const vector< json_rpc_request >& requests, const vector< size_t >& entries, vector< json_rpc_response >& responses, bool lock );
+         vector< json_rpc_response > rpc_batch( const vector< json_rpc_request >& requests );
 
          void initialize();
 
-         void log(const fc::variant_object& request, json_rpc_response& response)
+         bool queue_read_call( const std::shared_ptr< json_rpc_call >& c );
+         void run_read_queue();
+         void start_read_queue();
+         void stop_read_queue();
+
+         void log(const json_rpc_request& request, json_rpc_response& response)
          {
-            if (_logger)
-               _logger->log(request, response);
+            // The logger replays results as JSON
+            if (_logger && !request.binary)
+               _logger->log(fc::json::from_string(request.text.str()).get_object(), response);
          }
 
          DECLARE_API(
             (get_methods)
-            (get_signature) )
+            (get_signature)
+            (get_schema) )
 
          map< string, api_description >                     _registered_apis;
          vector< string >                                   _methods;
          map< string, map< string, api_method_signature > > _method_sigs;
+         map< string, api_binary_binding >                  _binary_methods;
+         std::set< string >                                 _read_only_methods;
+         std::set< string >                                 _cacheable_methods;
+         std::unique_ptr< response_cache >                  _response_cache;
+         map< string, std::shared_ptr< api_snapshot > >     _snapshots;
          std::unique_ptr< json_rpc_logger >                 _logger;
+
+         api_task_executor                                  _batch_executor;
+         api_read_lock                                      _batch_read_lock;
+         uint32_t                                           _batch_threads = 4;
+
+         std::mutex                                         _read_queue_mtx;
+         std::condition_variable                            _read_queue_cv;
+         std::deque< std::shared_ptr< json_rpc_call > >     _read_queue;
+         std::thread                                        _read_queue_thread;
+         uint32_t                                           _read_queue_size = 0;
+         bool                                               _read_queue_running = false;
+
+         std::mutex                                         _notice_sinks_mtx;
+         vector< api_notice_sink >                          _notice_sinks;
+
+         json_rpc_metrics                                   _metrics;
+         /// per method latency, filled while registering, read only afterwards
+         map< string, fc::metrics::histogram* >             _call_time;
    };
 
    json_rpc_plugin_impl::json_rpc_plugin_impl() {}
    json_rpc_plugin_impl::~json_rpc_plugin_impl() {}
 
-   void json_rpc_plugin_impl::add_api_method( const string& api_name, const string& method_name, const api_method& api, const api_method_signature& sig )
+   void json_rpc_plugin_impl::add_api_method( const string& api_name, const string& method_name, const api_method& api, const api_method_signature& sig, bool read_only,
+      const api_binary_method& binary_api, const api_result_schema& schema )
    {
       _registered_apis[ api_name ][ method_name ] = api;
       _method_sigs[ api_name ][ method_name ] = sig;
@@ -170,6 +387,15 @@ namespace detail
       std::stringstream canonical_name;
       canonical_name << api_name << '.' << method_name;
       _methods.push_back( canonical_name.str() );
+
+      if( read_only )
+         _read_only_methods.insert( canonical_name.str() );
+
+      _call_time[ canonical_name.str() ] = &fc::metrics::registry::global().get_histogram(
+         "amalgam_jsonrpc_call_seconds", "Time to run an API method", { { "method", canonical_name.str() } } );
+
+      if( binary_api )
+         _binary_methods[ canonical_name.str() ] = api_binary_binding{ binary_api, schema };
    }
 
    void json_rpc_plugin_impl::initialize()
@@ -199,6 +425,189 @@ namespace detail
       return method_itr->second;
    }
 
+   get_schema_return json_rpc_plugin_impl::get_schema( const get_schema_args& args, bool lock )
+   {
+      FC_UNUSED( lock )
+      auto itr = _binary_methods.find( args.method );
+      FC_ASSERT( itr != _binary_methods.end(), "Method ${method} does not exist or has no binary form", ("method", args.method) );
+      return itr->second.schema;
+   }
+
+   /** Params used when a request has none, decoded like an empty object */
+   const fc::json_span& empty_params()
+   {
+      static const char text[] = "{}";
+      static const fc::json_span span( text, text + 2 );
+      return span;
+   }
+
+   /**
+    * Reads the [ "api", "method", args ] params of a "call" request. Returns the
+    * number of elements, 0 when params is not an array.
+    */
+   size_t read_call_params( const fc::json_span& params, fc::variant& api, fc::variant& method, fc::json_span& args )
+   {
+      fc::json_reader reader( params );
+      if( reader.peek() != '[' )
+         return 0;
+
+      size_t count = 0;
+      reader.begin_array();
+      for( bool first = true; reader.next_element( first ); first = false, ++count )
+      {
+         switch( count )
+         {
+            case 0:  api = reader.read_variant(); break;
+            case 1:  method = reader.read_variant(); break;
+            case 2:  args = reader.skip_value(); break;
+            default: reader.skip_value();
+         }
+      }
+      return count;
+   }
+
+   json_rpc_request json_rpc_plugin_impl::parse_request( fc::json_reader& reader )
+   {
+      json_rpc_request request;
+      bool is_object = reader.peek() == '{';
+      const char* start = reader.position();
+
+      if( !is_object )
+      {
+         request.non_object = reader.read_variant();
+         request.text = fc::json_span( start, reader.position() );
+         return request;
+      }
+
+      // Repeated members keep their first value, as in fc::variant_object
+      string key;
+      reader.begin_object();
+      for( bool first = true; reader.next_member( key, first ); first = false )
+      {
+         if( key == "jsonrpc" && !request.jsonrpc.valid() )
+            request.jsonrpc = reader.read_variant();
+         else if( key == "method" && !request.method.valid() )
+            request.method = reader.read_variant();
+         else if( key == "id" && !request.id.valid() )
+            request.id = reader.read_variant();
+         else if( key == "params" && !request.params.valid() )
+            request.params = reader.skip_value();
+         else
+            reader.skip_value();
+      }
+
+      request.text = fc::json_span( start, reader.position() );
+      return request;
+   }
+
+   /** Splits the body into requests, returns true for a batch */
+   bool json_rpc_plugin_impl::parse_requests( const string& body, vector< json_rpc_request >& requests )
+   {
+      STATSD_START_TIMER( "jsonrpc", "overhead", "parse_requests", 1.0f );
+      fc::json_reader reader( ( fc::json_span( body ) ) );
+      bool batch = reader.peek() == '[';
+
+      if( batch )
+      {
+         reader.begin_array();
+         for( bool first = true; reader.next_element( first ); first = false )
+            requests.push_back( parse_request( reader ) );
+      }
+      else
+      {
+         requests.push_back( parse_request( reader ) );
+      }
+
+      reader.expect_end();
+      return batch;
+   }
+
+   void json_rpc_plugin_impl::parse_call( json_rpc_call& c )
+   {
+      c.requests.clear();
+      c.parsed = false;
+
+      try
+      {
+         c.batch = parse_requests( c.body, c.requests );
+      }
+      catch( fc::parse_error_exception& )
+      {
+         // Not strict JSON. The legacy parser accepts more, so let it rewrite the body and parse that.
+         c.normalized = fc::json::to_string( fc::json::from_string( c.body ), fc::json::legacy_generator );
+         c.requests.clear();
+         c.batch = parse_requests( c.normalized, c.requests );
+      }
+
+      for( auto& request : c.requests )
+         request.binary = c.binary;
+
+      c.parsed = true;
+   }
+
+   /**
+    * Parses the call unless that was done already and returns the response.
+    * With lock false the caller holds the read lock, which is only valid when
+    * every request is read only.
+    */
+   string json_rpc_plugin_impl::call( json_rpc_call& c, bool lock )
+   {
+      STATSD_START_TIMER( "jsonrpc", "overhead", "call", 1.0f );
+      try
+      {
+         if( !c.parsed )
+            parse_call( c );
+
+         if( c.batch )
+         {
+            vector< json_rpc_response > responses;
+
+            if( c.requests.size() )
+            {
+               if( lock )
+               {
+                  responses = rpc_batch( c.requests );
+               }
+               else
+               {
+                  responses.resize( c.requests.size() );
+                  vector< size_t > entries( c.requests.size() );
+                  for( size_t i = 0; i < entries.size(); ++i )
+                     entries[i] = i;
+                  rpc_batch_entries( c.requests, entries, responses, false );
+               }
+
+               return c.binary ? responses_to_binary( responses ) : responses_to_json( responses );
+            }
+            else
+            {
+               //For example: message == "[]"
+               json_rpc_response response;
+               response.error = json_rpc_error( JSON_RPC_SERVER_ERROR, "Array is invalid" );
+               return c.binary ? response_to_binary( response ) : response_to_json( response );
+            }
+         }
+         else
+         {
+            json_rpc_response response = rpc( c.requests.front(), lock );
+            return c.binary ? response_to_binary( response ) : response_to_json( response );
+         }
+      }
+      catch( fc::exception& e )
+      {
+         json_rpc_response response;
+         response.error = json_rpc_error( JSON_RPC_SERVER_ERROR, e.to_string(), fc::variant( *(e.dynamic_copy_exception()) ) );
+         return c.binary ? response_to_binary( response ) : response_to_json( response );
+      }
+      catch( ... )
+      {
+         json_rpc_response response;
+         response.error = json_rpc_error( JSON_RPC_SERVER_ERROR, "Unknown exception", fc::variant(
+            fc::unhandled_exception( FC_LOG_MESSAGE( warn, "Unknown Exception" ), std::current_exception() ).to_detail_string() ) );
+         return c.binary ? response_to_binary( response ) : response_to_json( response );
+      }
+   }
+
    api_method* json_rpc_plugin_impl::find_api_method( std::string api, std::string method )
    {
       STATSD_START_TIMER( "jsonrpc", "overhead", "find_api_method", 1.0f );
@@ -211,30 +620,30 @@ namespace detail
       return &(method_itr->second);
    }
 
-   api_method* json_rpc_plugin_impl::process_params( string method, const fc::variant_object& request, fc::variant& func_args, string* method_name )
+   api_method* json_rpc_plugin_impl::process_params( string method, const json_rpc_request& request, fc::json_span& func_args, string* method_name )
    {
       STATSD_START_TIMER( "jsonrpc", "overhead", "process_params", 1.0f );
       api_method* ret = nullptr;
 
       if( method == "call" )
       {
-         FC_ASSERT( request.contains( "params" ) );
-
-         std::vector< fc::variant > v;
+         FC_ASSERT( request.params.valid() );
 
-         if( request[ "params" ].is_array() )
-            v = request[ "params" ].as< std::vector< fc::variant > >();
+         fc::variant api_name;
+         fc::variant api_method_name;
+         fc::json_span args;
+         size_t count = read_call_params( request.params, api_name, api_method_name, args );
 
-         FC_ASSERT( v.size() == 2 || v.size() == 3, "params should be {\"api\", \"method\", \"args\"" );
+         FC_ASSERT( count == 2 || count == 3, "params should be {\"api\", \"method\", \"args\"" );
 
-         auto api = v[0].as_string();
-         auto method = v[1].as_string();
+         auto api = api_name.as_string();
+         auto method = api_method_name.as_string();
 
          ret = find_api_method( api, method );
 
          *method_name = api + "." + method;
 
-         func_args = ( v.size() == 3 ) ? v[2] : fc::json::from_string( "{}" );
+         func_args = ( count == 3 ) ? args : empty_params();
       }
       else
       {
@@ -247,25 +656,25 @@ namespace detail
 
          *method_name = method;
 
-         func_args = request.contains( "params" ) ? request[ "params" ] : fc::json::from_string( "{}" );
+         func_args = request.params.valid() ? request.params : empty_params();
       }
 
       return ret;
    }
 
-   void json_rpc_plugin_impl::rpc_id( const fc::variant_object& request, json_rpc_response& response )
+   void json_rpc_plugin_impl::rpc_id( const json_rpc_request& request, json_rpc_response& response )
    {
       STATSD_START_TIMER( "jsonrpc", "overhead", "rpc_id", 1.0f );
-      if( request.contains( "id" ) )
+      if( request.id.valid() )
       {
-         const fc::variant& _id = request[ "id" ];
+         const fc::variant& _id = *request.id;
          int _type = _id.get_type();
          switch( _type )
          {
             case fc::variant::int64_type:
             case fc::variant::uint64_type:
             case fc::variant::string_type:
-               response.id = request[ "id" ];
+               response.id = _id;
             break;
 
             default:
@@ -274,21 +683,21 @@ namespace detail
       }
    }
 
-   void json_rpc_plugin_impl::rpc_jsonrpc( const fc::variant_object& request, json_rpc_response& response )
+   void json_rpc_plugin_impl::rpc_jsonrpc( const json_rpc_request& request, json_rpc_response& response, bool lock )
    {
       STATSD_START_TIMER( "jsonrpc", "overhead", "rpc_jsonrpc", 1.0f );
-      if( request.contains( "jsonrpc" ) && request[ "jsonrpc" ].is_string() && request[ "jsonrpc" ].as_string() == "2.0" )
+      if( request.jsonrpc.valid() && request.jsonrpc->is_string() && request.jsonrpc->as_string() == "2.0" )
       {
-         if( request.contains( "method" ) && request[ "method" ].is_string() )
+         if( request.method.valid() && request.method->is_string() )
          {
             try
             {
-               string method = request[ "method" ].as_string();
+               string method = request.method->as_string();
 
                // This is to maintain backwards compatibility with existing call structure.
-               if( ( method == "call" && request.contains( "params" ) ) || method != "call" )
+               if( ( method == "call" && request.params.valid() ) || method != "call" )
                {
-                  fc::variant func_args;
+                  fc::json_span func_args;
                   api_method* call = nullptr;
                   string method_name;
 
@@ -306,7 +715,12 @@ namespace detail
                      if( call )
                      {
                         STATSD_START_TIMER( "jsonrpc", "api", method_name, 1.0f );
-                        response.result = (*call)( func_args );
+                        auto call_time = _call_time.find( method_name );
+                        fc::metrics::scoped_timer metrics_timer( call_time != _call_time.end() ? call_time->second : nullptr );
+                        if( request.binary )
+                           response.result = call_binary_api( method_name, func_args, lock, response.schema );
+                        else
+                           response.result = call_api( *call, method_name, func_args, lock );
                      }
                   }
                   catch( chainbase::lock_exception& e )
@@ -341,17 +755,21 @@ namespace detail
    log(request, response);
    }
 
-   json_rpc_response json_rpc_plugin_impl::rpc( const fc::variant& message )
+   json_rpc_response json_rpc_plugin_impl::rpc( const json_rpc_request& request, bool lock )
    {
       json_rpc_response response;
 
-      ddump( (message) );
+      dlog( "message: ${message}", ("message", request.text.str()) );
 
       STATSD_START_TIMER( "jsonrpc", "overhead", "total", 1.0f );
+      fc::metrics::scoped_timer metrics_timer( _metrics.request_time );
+      _metrics.requests.add();
 
       try
       {
-         const auto& request = message.get_object();
+         // Throws the same bad_cast the variant based parsing used to report
+         if( request.non_object.valid() )
+            request.non_object->get_object();
 
          rpc_id( request, response );
 
@@ -359,7 +777,7 @@ namespace detail
          try
          {
             if( !response.error.valid() )
-               rpc_jsonrpc( request, response );
+               rpc_jsonrpc( request, response, lock );
          }
          catch( fc::exception& e )
          {
@@ -395,8 +813,346 @@ namespace detail
          response.error = json_rpc_error( JSON_RPC_SERVER_ERROR, "Unknown error - parsing rpc message failed" );
       }
 
+      if( response.error.valid() )
+         _metrics.errors.add();
+
       return response;
    }
+
+   /** serves the call from its snapshot, only when the method has one and args holds no members */
+   bool json_rpc_plugin_impl::call_snapshot( const string& method_name, const fc::json_span& args, string& json )
+   {
+      auto itr = _snapshots.find( method_name );
+      if( itr == _snapshots.end() )
+         return false;
+
+      itr->second->mark_requested();
+      auto snapshot = itr->second->get();
+      if( !snapshot )
+         return false;
+
+      try
+      {
+         fc::json_reader reader( args );
+         if( reader.peek() != '{' )
+            return false;
+         string key;
+         reader.begin_object();
+         if( reader.next_member( key, true ) )
+            return false;
+         reader.expect_end();
+      }
+      catch( const fc::exception& )
+      {
+         return false;
+      }
+
+      STATSD_INCREMENT( "jsonrpc", "snapshot_hit", method_name, 1.0f );
+      _metrics.snapshot_hits.add();
+      json = *snapshot;
+      return true;
+   }
+
+   string json_rpc_plugin_impl::call_api( const api_method& call, const string& method_name, const fc::json_span& args, bool lock )
+   {
+      string snapshot_json;
+      if( call_snapshot( method_name, args, snapshot_json ) )
+         return snapshot_json;
+
+      if( !_response_cache || _cacheable_methods.find( method_name ) == _cacheable_methods.end() )
+         return call( args, lock );
+
+      string key = method_name;
+      key += '\n';
+      key.append( args.begin, args.size() );
+
+      string json;
+      uint64_t generation = 0;
+      if( _response_cache->get( key, json, generation ) )
+      {
+         STATSD_INCREMENT( "jsonrpc", "cache_hit", method_name, 1.0f );
+         _metrics.cache_hits.add();
+         return json;
+      }
+      STATSD_INCREMENT( "jsonrpc", "cache_miss", method_name, 1.0f );
+      _metrics.cache_misses.add();
+
+      response_cacheable = false;
+      json = call( args, lock );
+      if( response_cacheable )
+         _response_cache->put( key, json, response_block_num, generation );
+
+      return json;
+   }
+
+   /** Binary results bypass the snapshots and the response cache, which hold JSON */
+   string json_rpc_plugin_impl::call_binary_api( const string& method_name, const fc::json_span& args, bool lock, fc::optional< string >& schema )
+   {
+      auto itr = _binary_methods.find( method_name );
+      FC_ASSERT( itr != _binary_methods.end(), "Method ${method} has no binary form", ("method", method_name) );
+
+      STATSD_INCREMENT( "jsonrpc", "binary", method_name, 1.0f );
+      schema = itr->second.schema.id;
+      return itr->second.method( args, lock );
+   }
+
+   bool json_rpc_plugin_impl::is_read_only_call( const json_rpc_request& request )
+   {
+      try
+      {
+         if( !request.method.valid() || !request.method->is_string() )
+            return false;
+
+         string method = request.method->as_string();
+         if( method == "call" )
+         {
+            if( !request.params.valid() )
+               return false;
+
+            fc::variant api;
+            fc::variant api_method_name;
+            fc::json_span args;
+            if( read_call_params( request.params, api, api_method_name, args ) < 2 || !api.is_string() || !api_method_name.is_string() )
+               return false;
+
+            method = api.as_string() + "." + api_method_name.as_string();
+         }
+
+         return _read_only_methods.find( method ) != _read_only_methods.end();
+      }
+      catch( ... )
+      {
+         // Malformed entries run on their own so rpc() reports the error
+         return false;
+      }
+   }
+
+   bool json_rpc_plugin_impl::is_read_only_call( const json_rpc_call& c )
+   {
+      if( !c.parsed || c.requests.empty() )
+         return false;
+
+      for( const auto& request : c.requests )
+         if( !is_read_only_call( request ) )
+            return false;
+
+      return true;
+   }
+
+   /**
+    * Runs task( 0 ) ... task( count - 1 ) on the calling thread and on up to
+    * _batch_threads - 1 tasks handed to _batch_executor. Indices are claimed
+    * one at a time, so the caller never waits on a task that has not started
+    * and a busy thread pool only slows the work down.
+    */
+   void json_rpc_plugin_impl::run_parallel( size_t count, const std::function< void(size_t) >& task )
+   {
+      if( count == 0 )
+         return;
+
+      struct parallel_state
+      {
+         size_t                  count = 0;
+         std::atomic< size_t >   next{ 0 };
+         size_t                  completed = 0;
+         std::mutex              mtx;
+         std::condition_variable cv;
+      };
+
+      auto state = std::make_shared< parallel_state >();
+      state->count = count;
+
+      // Helpers that start after the work is done only touch the shared state
+      auto work = [state, &task]()
+      {
+         size_t i;
+         while( ( i = state->next.fetch_add( 1 ) ) < state->count )
+         {
+            task( i );
+
+            std::lock_guard< std::mutex > guard( state->mtx );
+            if( ++state->completed == state->count )
+               state->cv.notify_all();
+         }
+      };
+
+      if( _batch_executor )
+      {
+         size_t helpers = std::min< size_t >( count, _batch_threads ) - 1;
+         for( size_t i = 0; i < helpers; ++i )
+            _batch_executor( work );
+      }
+
+      work();
+
+      std::unique_lock< std::mutex > guard( state->mtx );
+      state->cv.wait( guard, [&state](){ return state->completed == state->count; } );
+   }
+
+   void json_rpc_plugin_impl::rpc_batch_entries( const vector< json_rpc_request >& requests, const vector< size_t >& entries, vector< json_rpc_response >& responses, bool lock )
+   {
+      run_parallel( entries.size(), [&]( size_t i )
+      {
+         responses[ entries[i] ] = rpc( requests[ entries[i] ], lock );
+      });
+   }
+
+   vector< json_rpc_response > json_rpc_plugin_impl::rpc_batch( const vector< json_rpc_request >& requests )
+   {
+      STATSD_START_TIMER( "jsonrpc", "overhead", "batch", 1.0f );
+      vector< json_rpc_response > responses( requests.size() );
+      vector< size_t > read_only_entries;
+      vector< size_t > other_entries;
+
+      for( size_t i = 0; i < requests.size(); ++i )
+      {
+         if( _batch_read_lock && is_read_only_call( requests[i] ) )
+            read_only_entries.push_back( i );
+         else
+            other_entries.push_back( i );
+      }
+
+      if( !read_only_entries.empty() )
+      {
+         bool done = false;
+
+         try
+         {
+            _batch_read_lock( [&]()
+            {
+               rpc_batch_entries( requests, read_only_entries, responses, false );
+               done = true;
+            });
+         }
+         catch( chainbase::lock_exception& e )
+         {
+            // Could not get the shared lock in time, let each call try on its own
+         }
+
+         if( !done )
+            rpc_batch_entries( requests, read_only_entries, responses, true );
+      }
+
+      // Everything else may take its own locks and must not run under the shared read lock
+      rpc_batch_entries( requests, other_entries, responses, true );
+
+      return responses;
+   }
+
+   /** returns false when the queue is full or not running, the caller then runs the call itself */
+   bool json_rpc_plugin_impl::queue_read_call( const std::shared_ptr< json_rpc_call >& c )
+   {
+      size_t depth = 0;
+      {
+         std::lock_guard< std::mutex > guard( _read_queue_mtx );
+         if( !_read_queue_running || _read_queue.size() >= _read_queue_size )
+            return false;
+
+         c->queued = fc::time_point::now();
+         _read_queue.push_back( c );
+         depth = _read_queue.size();
+      }
+
+      _read_queue_cv.notify_one();
+      _metrics.read_queue_depth.set( depth );
+      STATSD_GAUGE( "jsonrpc", "read_queue", "depth", depth, 1.0f );
+      return true;
+   }
+
+   /**
+    * Waits for queued read calls, takes all of them and runs them together
+    * under one read lock acquisition, spread over the batch executor. Only
+    * this thread ever waits for the lock, so the webserver threads stay free
+    * while the writer holds it. Responses are handed out after the lock is
+    * released.
+    */
+   void json_rpc_plugin_impl::run_read_queue()
+   {
+      while( true )
+      {
+         vector< std::shared_ptr< json_rpc_call > > calls;
+         {
+            std::unique_lock< std::mutex > guard( _read_queue_mtx );
+            _read_queue_cv.wait( guard, [this](){ return !_read_queue_running || !_read_queue.empty(); } );
+            if( !_read_queue_running )
+               return;
+
+            calls.assign( _read_queue.begin(), _read_queue.end() );
+            _read_queue.clear();
+         }
+         _metrics.read_queue_depth.set( 0 );
+
+         vector< string > results( calls.size() );
+         bool done = false;
+
+         while( !done )
+         {
+            try
+            {
+               _batch_read_lock( [&]()
+               {
+                  fc::time_point now = fc::time_point::now();
+                  for( const auto& c : calls )
+                  {
+                     _metrics.read_queue_wait.record( ( now - c->queued ).count() );
+                     STATSD_TIMER( "jsonrpc", "read_queue", "lock_wait", now - c->queued, 1.0f );
+                  }
+                  STATSD_COUNT( "jsonrpc", "read_queue", "calls_per_lock", calls.size(), 1.0f );
+
+                  run_parallel( calls.size(), [&]( size_t i )
+                  {
+                     results[i] = call( *calls[i], false );
+                  });
+                  done = true;
+               });
+            }
+            catch( chainbase::lock_exception& )
+            {
+               // The writer is busy, keep waiting here instead of failing the calls
+               STATSD_INCREMENT( "jsonrpc", "read_queue", "lock_timeout", 1.0f );
+               _metrics.read_queue_timeouts.add();
+
+               std::lock_guard< std::mutex > guard( _read_queue_mtx );
+               if( !_read_queue_running )
+                  return;
+            }
+         }
+
+         for( size_t i = 0; i < calls.size(); ++i )
+         {
+            try
+            {
+               calls[i]->handler( results[i] );
+            }
+            catch( ... )
+            {
+               wlog( "Exception thrown while sending a queued api response" );
+            }
+         }
+      }
+   }
+
+   void json_rpc_plugin_impl::start_read_queue()
+   {
+      if( !_read_queue_size )
+         return;
+
+      _read_queue_running = true;
+      _read_queue_thread = std::thread( [this](){ run_read_queue(); } );
+   }
+
+   void json_rpc_plugin_impl::stop_read_queue()
+   {
+      {
+         std::lock_guard< std::mutex > guard( _read_queue_mtx );
+         _read_queue_running = false;
+         _read_queue.clear();
+      }
+      _read_queue_cv.notify_all();
+
+      if( _read_queue_thread.joinable() )
+         _read_queue_thread.join();
+   }
 }
 
 using detail::json_rpc_error;
@@ -410,6 +1166,9 @@ void json_rpc_plugin::set_program_options( options_description& , options_descri
 {
    cfg.add_options()
       ("log-json-rpc", bpo::value< string >(), "json-rpc log directory name.")
+      ("json-rpc-batch-threads", bpo::value< uint32_t >()->default_value( 4 ), "Maximum number of threads working on the entries of one batch request.")
+      ("json-rpc-response-cache-size", bpo::value< uint32_t >()->default_value( 64 ), "Size in MiB of the cache for immutable api results such as old blocks. 0 disables it.")
+      ("json-rpc-read-queue-size", bpo::value< uint32_t >()->default_value( 4096 ), "Maximum number of read only calls waiting for the database read lock. Calls beyond it wait on their own thread. 0 disables the queue.")
       ;
 }
 
@@ -417,6 +1176,15 @@ void json_rpc_plugin::plugin_initialize( const variables_map& options )
 {
    my->initialize();
 
+   my->_batch_threads = options.at( "json-rpc-batch-threads" ).as< uint32_t >();
+   FC_ASSERT( my->_batch_threads > 0, "json-rpc-batch-threads must be greater than 0" );
+
+   my->_read_queue_size = options.at( "json-rpc-read-queue-size" ).as< uint32_t >();
+
+   uint64_t cache_size = uint64_t( options.at( "json-rpc-response-cache-size" ).as< uint32_t >() ) * 1024 * 1024;
+   if( cache_size )
+      my->_response_cache.reset( new response_cache( cache_size ) );
+
    if( options.count( "log-json-rpc" ) )
    {
       auto dir_name = options.at( "log-json-rpc" ).as< string >();
@@ -433,68 +1201,110 @@ void json_rpc_plugin::plugin_initialize( const variables_map& options )
 void json_rpc_plugin::plugin_startup()
 {
    std::sort( my->_methods.begin(), my->_methods.end() );
+   my->start_read_queue();
 }
 
-void json_rpc_plugin::plugin_shutdown() {}
+void json_rpc_plugin::plugin_shutdown()
+{
+   my->stop_read_queue();
+}
 
-void json_rpc_plugin::add_api_method( const string& api_name, const string& method_name, const api_method& api, const api_method_signature& sig )
+void json_rpc_plugin::add_api_method( const string& api_name, const string& method_name, const api_method& api, const api_method_signature& sig, bool read_only,
+   const api_binary_method& binary_api, const api_result_schema& schema )
 {
-   my->add_api_method( api_name, method_name, api, sig );
+   my->add_api_method( api_name, method_name, api, sig, read_only, binary_api, schema );
 }
 
-string json_rpc_plugin::call( const string& message )
+void json_rpc_plugin::set_batch_executor( const api_task_executor& executor )
 {
-   STATSD_START_TIMER( "jsonrpc", "overhead", "call", 1.0f );
-   try
-   {
-      fc::variant v = fc::json::from_string( message );
+   my->_batch_executor = executor;
+}
 
-      if( v.is_array() )
-      {
-         vector< fc::variant > messages = v.as< vector< fc::variant > >();
-         vector< json_rpc_response > responses;
+void json_rpc_plugin::set_batch_read_lock( const api_read_lock& read_lock )
+{
+   my->_batch_read_lock = read_lock;
+}
 
-         if( messages.size() )
-         {
-            responses.reserve( messages.size() );
+void json_rpc_plugin::add_cacheable_method( const string& api_name, const string& method_name )
+{
+   my->_cacheable_methods.insert( api_name + "." + method_name );
+}
 
-            for( auto& m : messages )
-               responses.push_back( my->rpc( m ) );
+void json_rpc_plugin::add_api_snapshot( const string& api_name, const string& method_name, const std::shared_ptr< api_snapshot >& snapshot )
+{
+   my->_snapshots[ api_name + "." + method_name ] = snapshot;
+}
 
-            return fc::json::to_string( responses );
-         }
-         else
-         {
-            //For example: message == "[]"
-            json_rpc_response response;
-            response.error = json_rpc_error( JSON_RPC_SERVER_ERROR, "Array is invalid" );
-            return fc::json::to_string( response );
-         }
+void json_rpc_plugin::cache_response( uint32_t block_num )
+{
+   detail::response_cacheable = true;
+   detail::response_block_num = block_num;
+}
+
+void json_rpc_plugin::on_block_applied( uint32_t block_num )
+{
+   if( my->_response_cache )
+      my->_response_cache->on_block_applied( block_num );
+}
+
+void json_rpc_plugin::on_irreversible_block( uint32_t block_num )
+{
+   if( !my->_response_cache )
+      return;
+
+   my->_response_cache->on_irreversible_block( block_num );
+   my->_metrics.cache_bytes.set( my->_response_cache->size_bytes() );
+   STATSD_GAUGE( "jsonrpc", "cache", "bytes", my->_response_cache->size_bytes(), 1.0f );
+   STATSD_GAUGE( "jsonrpc", "cache", "entries", my->_response_cache->size(), 1.0f );
+}
+
+void json_rpc_plugin::publish_notice( const string& topic, uint32_t block_num, const api_notice_renderer& render )
+{
+   std::lock_guard< std::mutex > guard( my->_notice_sinks_mtx );
+   for( const auto& sink : my->_notice_sinks )
+      sink( topic, block_num, render );
+}
+
+void json_rpc_plugin::add_notice_sink( const api_notice_sink& sink )
+{
+   std::lock_guard< std::mutex > guard( my->_notice_sinks_mtx );
+   my->_notice_sinks.push_back( sink );
+}
+
+string json_rpc_plugin::call( const string& message, bool binary )
+{
+   detail::json_rpc_call c;
+   c.body = message;
+   c.binary = binary;
+   return my->call( c, true );
+}
+
+void json_rpc_plugin::call_async( const string& message, const api_response_handler& handler, bool binary )
+{
+   auto c = std::make_shared< detail::json_rpc_call >();
+   c->body = message;
+   c->binary = binary;
+   c->handler = handler;
+
+   if( my->_batch_read_lock && my->_read_queue_size )
+   {
+      try
+      {
+         my->parse_call( *c );
       }
-      else
+      catch( ... )
       {
-         return fc::json::to_string( my->rpc( v ) );
+         // call() parses again and reports the error
       }
-   }
-   catch( fc::exception& e )
-   {
-      json_rpc_response response;
-      response.error = json_rpc_error( JSON_RPC_SERVER_ERROR, e.to_string(), fc::variant( *(e.dynamic_copy_exception()) ) );
-      return fc::json::to_string( response );
-   }
-   catch( ... )
-   {
-      json_rpc_response response;
-      response.error = json_rpc_error( JSON_RPC_SERVER_ERROR, "Unknown exception", fc::variant(
-         fc::unhandled_exception( FC_LOG_MESSAGE( warn, "Unknown Exception" ), std::current_exception() ).to_detail_string() ) );
-      return fc::json::to_string( response );
+
+      if( my->is_read_only_call( *c ) && my->queue_read_call( c ) )
+         return;
    }
 
+   handler( my->call( *c, true ) );
 }
 
 } } } // amalgam::plugins::json_rpc
 
-FC_REFLECT( amalgam::plugins::json_rpc::detail::json_rpc_error, (code)(message)(data) )
-FC_REFLECT( amalgam::plugins::json_rpc::detail::json_rpc_response, (jsonrpc)(result)(error)(id) )
 
 FC_REFLECT( amalgam::plugins::json_rpc::detail::get_signature_args, (method) )
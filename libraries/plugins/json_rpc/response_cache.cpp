@@ -0,0 +1,103 @@
+#include <amalgam/plugins/json_rpc/response_cache.hpp>
+
+namespace amalgam { namespace plugins { namespace json_rpc {
+
+bool response_cache::get( const std::string& key, std::string& json, uint64_t& generation )
+{
+   std::lock_guard< std::mutex > guard( _mtx );
+   auto itr = _entries.find( key );
+   if( itr == _entries.end() )
+   {
+      generation = _generation;
+      return false;
+   }
+
+   _lru.splice( _lru.begin(), _lru, itr->second );
+   json = itr->second->json;
+   return true;
+}
+
+void response_cache::put( const std::string& key, const std::string& json, uint32_t block_num, uint64_t generation )
+{
+   std::lock_guard< std::mutex > guard( _mtx );
+   if( generation != _generation || _entries.find( key ) != _entries.end() )
+      return;
+
+   entry e;
+   e.key = key;
+   e.json = json;
+   e.block_num = block_num;
+   e.reversible = block_num > _last_irreversible;
+
+   uint64_t bytes = entry_bytes( e );
+   if( bytes > _max_bytes )
+      return;
+
+   while( _bytes + bytes > _max_bytes && !_lru.empty() )
+      erase( std::prev( _lru.end() ) );
+
+   _lru.push_front( std::move( e ) );
+   _entries.emplace( key, _lru.begin() );
+   if( _lru.front().reversible )
+      _reversible.emplace( block_num, _lru.begin() );
+   _bytes += bytes;
+}
+
+void response_cache::on_block_applied( uint32_t block_num )
+{
+   std::lock_guard< std::mutex > guard( _mtx );
+   ++_generation;
+
+   auto itr = _reversible.lower_bound( block_num );
+   while( itr != _reversible.end() )
+   {
+      auto entry_itr = itr->second;
+      ++itr;
+      erase( entry_itr );
+   }
+}
+
+void response_cache::on_irreversible_block( uint32_t block_num )
+{
+   std::lock_guard< std::mutex > guard( _mtx );
+   _last_irreversible = block_num;
+
+   auto end = _reversible.upper_bound( block_num );
+   for( auto itr = _reversible.begin(); itr != end; ++itr )
+      itr->second->reversible = false;
+   _reversible.erase( _reversible.begin(), end );
+}
+
+uint64_t response_cache::size_bytes()const
+{
+   std::lock_guard< std::mutex > guard( _mtx );
+   return _bytes;
+}
+
+size_t response_cache::size()const
+{
+   std::lock_guard< std::mutex > guard( _mtx );
+   return _entries.size();
+}
+
+void response_cache::erase( lru_list::iterator itr )
+{
+   if( itr->reversible )
+   {
+      auto range = _reversible.equal_range( itr->block_num );
+      for( auto r = range.first; r != range.second; ++r )
+      {
+         if( r->second == itr )
+         {
+            _reversible.erase( r );
+            break;
+         }
+      }
+   }
+
+   _bytes -= entry_bytes( *itr );
+   _entries.erase( itr->key );
+   _lru.erase( itr );
+}
+
+} } } // amalgam::plugins::json_rpc
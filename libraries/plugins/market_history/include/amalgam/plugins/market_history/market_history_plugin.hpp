@@ -37,6 +37,9 @@ enum market_history_object_types
 
 namespace detail { class market_history_plugin_impl; }
 
+struct bucket_object;
+class order_book_cache;
+
 class market_history_plugin : public plugin< market_history_plugin >
 {
    public:
@@ -50,6 +53,16 @@ class market_history_plugin : public plugin< market_history_plugin >
       flat_set< uint32_t > get_tracked_buckets() const;
       uint32_t get_max_history_per_bucket() const;
 
+      /**
+       * The bucket of the given size holding the head block time. Only the
+       * smallest bucket size is updated by every fill, larger buckets are
+       * stored when they close, so the open one is merged from smaller ones.
+       */
+      fc::optional< bucket_object > get_open_bucket( uint32_t seconds ) const;
+
+      /** follows the chain once the plugin started */
+      order_book_cache& get_order_book_cache();
+
       virtual void set_program_options(
          options_description& cli,
          options_description& cfg ) override;
@@ -106,6 +119,35 @@ struct bucket_object : public object< bucket_object_type, bucket_object >
 
 typedef oid< bucket_object > bucket_id_type;
 
+inline fc::time_point_sec bucket_open( const fc::time_point_sec& time, uint32_t seconds )
+{
+   return fc::time_point_sec( ( time.sec_since_epoch() / seconds ) * seconds );
+}
+
+/** adds the trades of a later bucket, or a bucket of one trade, to b */
+inline void merge_bucket( bucket_object& b, const bucket_object& later )
+{
+   b.amalgam.volume += later.amalgam.volume;
+   b.amalgam.close = later.amalgam.close;
+
+   b.non_amalgam.volume += later.non_amalgam.volume;
+   b.non_amalgam.close = later.non_amalgam.close;
+
+   if( b.high() < later.high() )
+   {
+      b.amalgam.high = later.amalgam.high;
+
+      b.non_amalgam.high = later.non_amalgam.high;
+   }
+
+   if( b.low() > later.low() )
+   {
+      b.amalgam.low = later.amalgam.low;
+
+      b.non_amalgam.low = later.non_amalgam.low;
+   }
+}
+
 
 struct order_history_object : public object< order_history_object_type, order_history_object >
 {
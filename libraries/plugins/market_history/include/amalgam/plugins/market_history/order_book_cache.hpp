@@ -0,0 +1,93 @@
+#pragma once
+#include <amalgam/chain/database.hpp>
+
+#include <fc/reflect/reflect.hpp>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace amalgam { namespace plugins { namespace market_history {
+
+using amalgam::protocol::price;
+using amalgam::protocol::share_type;
+
+namespace detail { class order_book_cache_impl; }
+
+/** All orders of one side of the book at the same price */
+struct order_book_level
+{
+   price          order_price;
+   double         real_price = 0;
+   share_type     amalgam;
+   share_type     abd;
+   uint32_t       orders = 0;
+};
+
+struct order_book_order
+{
+   price             order_price;
+   double            real_price = 0;
+   share_type        amalgam;
+   share_type        abd;
+   fc::time_point_sec created;
+};
+
+/** The book as of the end of a block, never modified once published */
+struct order_book_snapshot
+{
+   uint32_t                         block_num = 0;
+   std::vector< order_book_order >  bids;
+   std::vector< order_book_order >  asks;
+   std::vector< order_book_level >  bid_levels;
+   std::vector< order_book_level >  ask_levels;
+};
+
+/** Levels changed by a block, a level with no orders left has been removed */
+struct order_book_update
+{
+   uint32_t                         block_num = 0;
+   std::vector< order_book_level >  bids;
+   std::vector< order_book_level >  asks;
+};
+
+/**
+ * Aggregated depth of the internal market, kept in memory.
+ *
+ * The orders touched by the limit order and fill operations of a block,
+ * or expiring with it, are compared with the chain state when the block is
+ * applied and only their price levels are updated. The keys touched by the
+ * last reversible blocks are remembered, so orders changed by blocks that
+ * get popped are corrected when the fork is applied.
+ *
+ * After every block that changes the book a new snapshot is published, and
+ * readers take it without the chain lock.
+ */
+class order_book_cache
+{
+   public:
+      /// levels and orders per side kept in snapshots
+      static const uint32_t max_depth = 500;
+
+      order_book_cache( chain::database& db );
+      ~order_book_cache();
+
+      /** loads the book from the chain state and registers the chain handlers */
+      void connect( const appbase::abstract_plugin& plugin );
+      void disconnect();
+
+      std::shared_ptr< const order_book_snapshot > snapshot()const;
+
+      /** called from the thread applying blocks, with the write lock held */
+      void add_update_handler( const std::function< void(const std::shared_ptr< const order_book_update >&) >& handler );
+
+   private:
+      std::unique_ptr< detail::order_book_cache_impl > my;
+};
+
+} } } // amalgam::plugins::market_history
+
+FC_REFLECT( amalgam::plugins::market_history::order_book_level, (order_price)(real_price)(amalgam)(abd)(orders) )
+FC_REFLECT( amalgam::plugins::market_history::order_book_order, (order_price)(real_price)(amalgam)(abd)(created) )
+FC_REFLECT( amalgam::plugins::market_history::order_book_snapshot, (block_num)(bids)(asks)(bid_levels)(ask_levels) )
+FC_REFLECT( amalgam::plugins::market_history::order_book_update, (block_num)(bids)(asks) )
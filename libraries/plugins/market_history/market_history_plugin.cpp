@@ -1,4 +1,5 @@
 #include <amalgam/plugins/market_history/market_history_plugin.hpp>
+#include <amalgam/plugins/market_history/order_book_cache.hpp>
 
 #include <amalgam/chain/database.hpp>
 #include <amalgam/chain/index.hpp>
@@ -15,7 +16,8 @@ class market_history_plugin_impl
 {
    public:
       market_history_plugin_impl() :
-         _db( appbase::app().get_plugin< amalgam::plugins::chain::chain_plugin >().db() ) {}
+         _db( appbase::app().get_plugin< amalgam::plugins::chain::chain_plugin >().db() ),
+         _order_book( _db ) {}
       virtual ~market_history_plugin_impl() {}
 
       /**
@@ -24,10 +26,19 @@ class market_history_plugin_impl
        */
       void on_post_apply_operation( const operation_notification& note );
 
+      /** stores the larger buckets that closed with the block */
+      void on_post_apply_block( const block_notification& note );
+
+      void roll_up( uint32_t seconds, uint32_t finer, const fc::time_point_sec& boundary );
+      void store_bucket( const bucket_object& b );
+      fc::optional< bucket_object > get_open_bucket( uint32_t seconds )const;
+
       chain::database&     _db;
       flat_set<uint32_t>            _tracked_buckets = flat_set<uint32_t>  { 15, 60, 300, 3600, 86400 };
       int32_t                       _maximum_history_per_bucket_size = 1000;
       boost::signals2::connection   _post_apply_operation_conn;
+      boost::signals2::connection   _post_apply_block_conn;
+      order_book_cache              _order_book;
 };
 
 void market_history_plugin_impl::on_post_apply_operation( const operation_notification& o )
@@ -36,8 +47,6 @@ void market_history_plugin_impl::on_post_apply_operation( const operation_notifi
    {
       fill_order_operation op = o.op.get< fill_order_operation >();
 
-      const auto& bucket_idx = _db.get_index< bucket_index >().indices().get< by_bucket >();
-
       _db.create< order_history_object >( [&]( order_history_object& ho )
       {
          ho.time = _db.head_block_time();
@@ -47,90 +56,156 @@ void market_history_plugin_impl::on_post_apply_operation( const operation_notifi
       if( !_maximum_history_per_bucket_size ) return;
       if( !_tracked_buckets.size() ) return;
 
-      for( const auto& bucket : _tracked_buckets )
+      bucket_object trade;
+      trade.seconds = *_tracked_buckets.begin();
+      trade.open = bucket_open( _db.head_block_time(), trade.seconds );
+      trade.amalgam.fill( ( op.open_pays.symbol == AMALGAM_SYMBOL ) ? op.open_pays.amount : op.current_pays.amount );
+      trade.non_amalgam.fill( ( op.open_pays.symbol == AMALGAM_SYMBOL ) ? op.current_pays.amount : op.open_pays.amount );
+
+      const auto& bucket_idx = _db.get_index< bucket_index >().indices().get< by_bucket >();
+      auto itr = bucket_idx.find( boost::make_tuple( trade.seconds, trade.open ) );
+      if( itr == bucket_idx.end() )
+      {
+         store_bucket( trade );
+      }
+      else
       {
-         auto cutoff = _db.head_block_time() - fc::seconds( bucket * _maximum_history_per_bucket_size );
+         _db.modify( *itr, [&]( bucket_object& b )
+         {
+            merge_bucket( b, trade );
+         });
+      }
+   }
+}
 
-         auto open = fc::time_point_sec( ( _db.head_block_time().sec_since_epoch() / bucket ) * bucket );
-         auto seconds = bucket;
+void market_history_plugin_impl::on_post_apply_block( const block_notification& note )
+{
+   if( !_maximum_history_per_bucket_size ) return;
+   if( _tracked_buckets.size() < 2 ) return;
 
-         auto itr = bucket_idx.find( boost::make_tuple( seconds, open ) );
-         if( itr == bucket_idx.end() )
-         {
-            _db.create< bucket_object >( [&]( bucket_object& b )
-            {
-               b.open = open;
-               b.seconds = bucket;
-
-               b.amalgam.fill( ( op.open_pays.symbol == AMALGAM_SYMBOL ) ? op.open_pays.amount : op.current_pays.amount );
-               b.non_amalgam.fill( ( op.open_pays.symbol == AMALGAM_SYMBOL ) ? op.current_pays.amount : op.open_pays.amount );
-            });
-         }
-         else
-         {
-            _db.modify( *itr, [&]( bucket_object& b )
-            {
-               if( op.open_pays.symbol == AMALGAM_SYMBOL )
-               {
-                  b.amalgam.volume += op.open_pays.amount;
-                  b.amalgam.close = op.open_pays.amount;
-
-                  b.non_amalgam.volume += op.current_pays.amount;
-                  b.non_amalgam.close = op.current_pays.amount;
-
-                  if( b.high() < price( op.current_pays, op.open_pays ) )
-                  {
-                     b.amalgam.high = op.open_pays.amount;
-
-                     b.non_amalgam.high = op.current_pays.amount;
-                  }
-
-                  if( b.low() > price( op.current_pays, op.open_pays ) )
-                  {
-                     b.amalgam.low = op.open_pays.amount;
-
-                     b.non_amalgam.low = op.current_pays.amount;
-                  }
-               }
-               else
-               {
-                  b.amalgam.volume += op.current_pays.amount;
-                  b.amalgam.close = op.current_pays.amount;
-
-                  b.non_amalgam.volume += op.open_pays.amount;
-                  b.non_amalgam.close = op.open_pays.amount;
-
-                  if( b.high() < price( op.open_pays, op.current_pays ) )
-                  {
-                     b.amalgam.high = op.current_pays.amount;
-
-                     b.non_amalgam.high = op.open_pays.amount;
-                  }
-
-                  if( b.low() > price( op.open_pays, op.current_pays ) )
-                  {
-                     b.amalgam.low = op.current_pays.amount;
-
-                     b.non_amalgam.low = op.open_pays.amount;
-                  }
-               }
-            });
-
-            if( _maximum_history_per_bucket_size > 0 )
-            {
-               open = fc::time_point_sec();
-               itr = bucket_idx.lower_bound( boost::make_tuple( seconds, open ) );
-
-               while( itr->seconds == seconds && itr->open < cutoff )
-               {
-                  auto old_itr = itr;
-                  ++itr;
-                  _db.remove( *old_itr );
-               }
-            }
-         }
+   auto now = _db.head_block_time();
+   auto finer = _tracked_buckets.begin();
+   for( auto itr = std::next( finer ); itr != _tracked_buckets.end(); finer = itr++ )
+      roll_up( *itr, *finer, bucket_open( now, *itr ) );
+}
+
+/**
+ * Merges the buckets of the next smaller size into the buckets of the given
+ * size that closed before boundary and are not stored yet. Sizes are checked
+ * in increasing order, so the smaller buckets are complete by then.
+ */
+void market_history_plugin_impl::roll_up( uint32_t seconds, uint32_t finer, const fc::time_point_sec& boundary )
+{
+   const auto& bucket_idx = _db.get_index< bucket_index >().indices().get< by_bucket >();
+
+   fc::time_point_sec from;
+   auto newest = bucket_idx.lower_bound( boost::make_tuple( seconds, boundary ) );
+   if( newest != bucket_idx.begin() && (--newest)->seconds == seconds )
+      from = newest->open + seconds;
+
+   if( from >= boundary )
+      return;
+
+   fc::optional< bucket_object > b;
+   for( auto itr = bucket_idx.lower_bound( boost::make_tuple( finer, from ) );
+        itr != bucket_idx.end() && itr->seconds == finer && itr->open < boundary; ++itr )
+   {
+      auto open = bucket_open( itr->open, seconds );
+      if( b.valid() && b->open != open )
+      {
+         store_bucket( *b );
+         b.reset();
+      }
+
+      if( b.valid() )
+      {
+         merge_bucket( *b, *itr );
+      }
+      else
+      {
+         b = *itr;
+         b->open = open;
+         b->seconds = seconds;
       }
    }
+
+   if( b.valid() )
+      store_bucket( *b );
+}
+
+/** buckets of each size form a ring, a new bucket reuses the oldest one once it falls out of the history */
+void market_history_plugin_impl::store_bucket( const bucket_object& b )
+{
+   const auto& bucket_idx = _db.get_index< bucket_index >().indices().get< by_bucket >();
+   auto cutoff = b.open - fc::seconds( int64_t( b.seconds ) * _maximum_history_per_bucket_size );
+
+   auto oldest = bucket_idx.lower_bound( boost::make_tuple( b.seconds, fc::time_point_sec() ) );
+   if( oldest != bucket_idx.end() && oldest->seconds == b.seconds && oldest->open < cutoff )
+   {
+      _db.modify( *oldest, [&]( bucket_object& o )
+      {
+         o.open = b.open;
+         o.amalgam = b.amalgam;
+         o.non_amalgam = b.non_amalgam;
+      });
+   }
+   else
+   {
+      _db.create< bucket_object >( [&]( bucket_object& o )
+      {
+         o.open = b.open;
+         o.seconds = b.seconds;
+         o.amalgam = b.amalgam;
+         o.non_amalgam = b.non_amalgam;
+      });
+   }
+}
+
+fc::optional< bucket_object > market_history_plugin_impl::get_open_bucket( uint32_t seconds )const
+{
+   fc::optional< bucket_object > b;
+   auto size = _tracked_buckets.find( seconds );
+   if( size == _tracked_buckets.end() )
+      return b;
+
+   const auto& bucket_idx = _db.get_index< bucket_index >().indices().get< by_bucket >();
+   auto now = _db.head_block_time();
+   auto open = bucket_open( now, seconds );
+
+   if( size == _tracked_buckets.begin() )
+   {
+      auto itr = bucket_idx.find( boost::make_tuple( seconds, open ) );
+      if( itr != bucket_idx.end() )
+         b = *itr;
+      return b;
+   }
+
+   // Closed buckets of the next smaller size, then its open bucket
+   uint32_t finer = *std::prev( size );
+   for( auto itr = bucket_idx.lower_bound( boost::make_tuple( finer, open ) );
+        itr != bucket_idx.end() && itr->seconds == finer && itr->open < bucket_open( now, finer ); ++itr )
+   {
+      if( b.valid() )
+         merge_bucket( *b, *itr );
+      else
+         b = *itr;
+   }
+
+   auto last = get_open_bucket( finer );
+   if( last.valid() )
+   {
+      if( b.valid() )
+         merge_bucket( *b, *last );
+      else
+         b = last;
+   }
+
+   if( b.valid() )
+   {
+      b->open = open;
+      b->seconds = seconds;
+   }
+   return b;
 }
 
 } // detail
@@ -159,16 +234,32 @@ void market_history_plugin::plugin_initialize( const boost::program_options::var
       my = std::make_unique< detail::market_history_plugin_impl >();
 
       my->_post_apply_operation_conn = my->_db.add_post_apply_operation_handler( [&]( const operation_notification& note ){ my->on_post_apply_operation( note ); }, *this, 0 );
+      my->_post_apply_block_conn = my->_db.add_post_apply_block_handler( [&]( const block_notification& note ){ my->on_post_apply_block( note ); }, *this, 0 );
       add_plugin_index< bucket_index        >( my->_db );
       add_plugin_index< order_history_index >( my->_db );
 
-      if( options.count("bucket-size" ) )
+      if( options.count("market-history-bucket-size" ) )
       {
-         std::string buckets = options["bucket-size"].as< string >();
+         std::string buckets = options["market-history-bucket-size"].as< string >();
          my->_tracked_buckets = fc::json::from_string( buckets ).as< flat_set< uint32_t > >();
       }
-      if( options.count("history-per-size" ) )
-         my->_maximum_history_per_bucket_size = options["history-per-size"].as< uint32_t >();
+      if( options.count("market-history-buckets-per-size" ) )
+         my->_maximum_history_per_bucket_size = options["market-history-buckets-per-size"].as< uint32_t >();
+
+      // Larger buckets are merged from the next smaller ones, which must still hold the whole larger bucket.
+      // No buckets are kept when buckets-per-size is 0, so there is nothing to cover then.
+      for( auto itr = my->_tracked_buckets.begin(); itr != my->_tracked_buckets.end(); ++itr )
+      {
+         FC_ASSERT( *itr > 0, "Bucket sizes must be positive" );
+         if( itr != my->_tracked_buckets.begin() )
+         {
+            uint32_t prev = *std::prev( itr );
+            FC_ASSERT( *itr % prev == 0, "Bucket size ${b} is not a multiple of ${p}", ("b", *itr)("p", prev) );
+            FC_ASSERT( !my->_maximum_history_per_bucket_size || uint64_t( prev ) * my->_maximum_history_per_bucket_size >= *itr,
+               "${n} buckets of size ${p} do not cover a bucket of size ${b}, increase market-history-buckets-per-size",
+               ("n", my->_maximum_history_per_bucket_size)("p", prev)("b", *itr) );
+         }
+      }
 
       wlog( "bucket-size ${b}", ("b", my->_tracked_buckets) );
       wlog( "history-per-size ${h}", ("h", my->_maximum_history_per_bucket_size) );
@@ -177,11 +268,16 @@ void market_history_plugin::plugin_initialize( const boost::program_options::var
    } FC_CAPTURE_AND_RETHROW()
 }
 
-void market_history_plugin::plugin_startup() {}
+void market_history_plugin::plugin_startup()
+{
+   my->_order_book.connect( *this );
+}
 
 void market_history_plugin::plugin_shutdown()
 {
    chain::util::disconnect_signal( my->_post_apply_operation_conn );
+   chain::util::disconnect_signal( my->_post_apply_block_conn );
+   my->_order_book.disconnect();
 }
 
 flat_set< uint32_t > market_history_plugin::get_tracked_buckets() const
@@ -194,4 +290,14 @@ uint32_t market_history_plugin::get_max_history_per_bucket() const
    return my->_maximum_history_per_bucket_size;
 }
 
+fc::optional< bucket_object > market_history_plugin::get_open_bucket( uint32_t seconds ) const
+{
+   return my->get_open_bucket( seconds );
+}
+
+order_book_cache& market_history_plugin::get_order_book_cache()
+{
+   return my->_order_book;
+}
+
 } } } // amalgam::plugins::market_history
@@ -0,0 +1,323 @@
+#include <amalgam/plugins/market_history/order_book_cache.hpp>
+
+#include <amalgam/chain/amalgam_objects.hpp>
+#include <amalgam/chain/util/signal.hpp>
+
+#include <map>
+#include <set>
+
+namespace amalgam { namespace plugins { namespace market_history { namespace detail {
+
+using amalgam::protocol::account_name_type;
+using amalgam::protocol::asset;
+using amalgam::protocol::operation;
+
+class order_book_cache_impl
+{
+   public:
+      typedef std::pair< account_name_type, uint32_t > order_key;
+
+      struct cached_order
+      {
+         price                sell_price;
+         share_type           amalgam;
+         share_type           abd;
+         /// key of the order's entry in _expirations
+         fc::time_point_sec   expiration;
+      };
+
+      struct level_total
+      {
+         share_type           amalgam;
+         share_type           abd;
+         uint32_t             orders = 0;
+      };
+
+      typedef std::map< price, level_total, std::greater< price > > book_side;
+
+      order_book_cache_impl( chain::database& db ) : _db( db ) {}
+
+      void load();
+      void on_post_apply_operation( const chain::operation_notification& note );
+      void on_post_apply_block( const chain::block_notification& note );
+
+      void sync( const order_key& key );
+      void add( const order_key& key, const chain::limit_order_object& o );
+      void remove( std::map< order_key, cached_order >::iterator itr );
+      void publish( uint32_t block_num );
+
+      static bool is_bid( const price& p ) { return p.base.symbol == ABD_SYMBOL; }
+      static double real_price( const price& p );
+      order_book_level make_level( const price& p )const;
+
+      chain::database&                          _db;
+
+      std::map< order_key, cached_order >       _orders;
+      /// one entry per cached order, expired orders are checked against the chain state
+      std::multimap< fc::time_point_sec, order_key > _expirations;
+      book_side                                 _bids;
+      book_side                                 _asks;
+
+      /// orders touched by each reversible block
+      std::map< uint32_t, std::set< order_key > > _touched;
+      std::set< price >                         _changed;
+
+      std::shared_ptr< const order_book_snapshot > _snapshot;
+
+      std::vector< std::function< void(const std::shared_ptr< const order_book_update >&) > > _update_handlers;
+      std::vector< boost::signals2::connection > _chain_connections;
+};
+
+double order_book_cache_impl::real_price( const price& p )
+{
+   return is_bid( p ) ? double( p.base.amount.value ) / double( p.quote.amount.value )
+                      : double( p.quote.amount.value ) / double( p.base.amount.value );
+}
+
+void order_book_cache_impl::load()
+{
+   const auto& idx = _db.get_index< chain::limit_order_index, chain::by_id >();
+   for( const auto& o : idx )
+      add( order_key( o.seller, o.orderid ), o );
+
+   _changed.clear();
+   publish( _db.head_block_num() );
+}
+
+void order_book_cache_impl::on_post_apply_operation( const chain::operation_notification& note )
+{
+   auto touch = [&]( const account_name_type& owner, uint32_t orderid )
+   {
+      _touched[ note.block ].insert( order_key( owner, orderid ) );
+   };
+
+   switch( note.op.which() )
+   {
+      case operation::tag< protocol::limit_order_create_operation >::value:
+      {
+         const auto& op = note.op.get< protocol::limit_order_create_operation >();
+         touch( op.owner, op.orderid );
+         break;
+      }
+      case operation::tag< protocol::limit_order_create2_operation >::value:
+      {
+         const auto& op = note.op.get< protocol::limit_order_create2_operation >();
+         touch( op.owner, op.orderid );
+         break;
+      }
+      case operation::tag< protocol::limit_order_cancel_operation >::value:
+      {
+         const auto& op = note.op.get< protocol::limit_order_cancel_operation >();
+         touch( op.owner, op.orderid );
+         break;
+      }
+      case operation::tag< protocol::fill_order_operation >::value:
+      {
+         const auto& op = note.op.get< protocol::fill_order_operation >();
+         touch( op.current_owner, op.current_orderid );
+         touch( op.open_owner, op.open_orderid );
+         break;
+      }
+      default:
+         break;
+   }
+}
+
+void order_book_cache_impl::on_post_apply_block( const chain::block_notification& note )
+{
+   // Expired orders are removed without an operation
+   auto& touched = _touched[ note.block_num ];
+   auto now = _db.head_block_time();
+   for( auto itr = _expirations.begin(); itr != _expirations.end() && itr->first < now; itr = _expirations.erase( itr ) )
+      touched.insert( itr->second );
+
+   // Blocks above this one were popped, their orders are back to the state before them
+   std::set< order_key > keys;
+   for( auto itr = _touched.lower_bound( note.block_num ); itr != _touched.end(); ++itr )
+      keys.insert( itr->second.begin(), itr->second.end() );
+   _touched.erase( _touched.upper_bound( note.block_num ), _touched.end() );
+
+   for( const auto& key : keys )
+      sync( key );
+
+   _touched.erase( _touched.begin(), _touched.upper_bound( _db.get_dynamic_global_properties().last_irreversible_block_num ) );
+
+   if( _changed.empty() )
+      return;
+
+   auto update = std::make_shared< order_book_update >();
+   update->block_num = note.block_num;
+   for( const auto& p : _changed )
+      ( is_bid( p ) ? update->bids : update->asks ).push_back( make_level( p ) );
+   _changed.clear();
+
+   publish( note.block_num );
+
+   for( const auto& handler : _update_handlers )
+      handler( update );
+}
+
+void order_book_cache_impl::sync( const order_key& key )
+{
+   auto itr = _orders.find( key );
+   if( itr != _orders.end() )
+      remove( itr );
+
+   const auto* o = _db.find< chain::limit_order_object, chain::by_account >( boost::make_tuple( key.first, key.second ) );
+   if( o != nullptr )
+      add( key, *o );
+}
+
+void order_book_cache_impl::add( const order_key& key, const chain::limit_order_object& o )
+{
+   cached_order c;
+   c.sell_price = o.sell_price;
+   c.expiration = o.expiration;
+   if( is_bid( o.sell_price ) )
+   {
+      c.abd = o.for_sale;
+      c.amalgam = ( asset( o.for_sale, ABD_SYMBOL ) * o.sell_price ).amount;
+   }
+   else
+   {
+      c.amalgam = o.for_sale;
+      c.abd = ( asset( o.for_sale, AMALGAM_SYMBOL ) * o.sell_price ).amount;
+   }
+
+   auto& level = ( is_bid( c.sell_price ) ? _bids : _asks )[ c.sell_price ];
+   level.amalgam += c.amalgam;
+   level.abd += c.abd;
+   ++level.orders;
+
+   _orders[ key ] = c;
+   _expirations.emplace( c.expiration, key );
+   _changed.insert( c.sell_price );
+}
+
+void order_book_cache_impl::remove( std::map< order_key, cached_order >::iterator itr )
+{
+   const auto& c = itr->second;
+   auto& side = is_bid( c.sell_price ) ? _bids : _asks;
+   auto level = side.find( c.sell_price );
+
+   level->second.amalgam -= c.amalgam;
+   level->second.abd -= c.abd;
+   if( --level->second.orders == 0 )
+      side.erase( level );
+
+   // The entry is gone already when the order was synced because it expired
+   auto range = _expirations.equal_range( c.expiration );
+   for( auto e = range.first; e != range.second; ++e )
+   {
+      if( e->second == itr->first )
+      {
+         _expirations.erase( e );
+         break;
+      }
+   }
+
+   _changed.insert( c.sell_price );
+   _orders.erase( itr );
+}
+
+order_book_level order_book_cache_impl::make_level( const price& p )const
+{
+   order_book_level result;
+   result.order_price = p;
+   result.real_price = real_price( p );
+
+   const auto& side = is_bid( p ) ? _bids : _asks;
+   auto itr = side.find( p );
+   if( itr != side.end() )
+   {
+      result.amalgam = itr->second.amalgam;
+      result.abd = itr->second.abd;
+      result.orders = itr->second.orders;
+   }
+   return result;
+}
+
+void order_book_cache_impl::publish( uint32_t block_num )
+{
+   auto s = std::make_shared< order_book_snapshot >();
+   s->block_num = block_num;
+
+   for( const auto* side : { &_bids, &_asks } )
+   {
+      auto& levels = side == &_bids ? s->bid_levels : s->ask_levels;
+      levels.reserve( std::min< size_t >( side->size(), order_book_cache::max_depth ) );
+      for( auto itr = side->begin(); itr != side->end() && levels.size() < order_book_cache::max_depth; ++itr )
+         levels.push_back( order_book_level{ itr->first, real_price( itr->first ), itr->second.amalgam, itr->second.abd, itr->second.orders } );
+   }
+
+   // Single orders come from the chain index, which orders them by price and then age
+   const auto& order_idx = _db.get_index< chain::limit_order_index, chain::by_price >();
+   for( const auto& base : { ABD_SYMBOL, AMALGAM_SYMBOL } )
+   {
+      auto quote = base == ABD_SYMBOL ? AMALGAM_SYMBOL : ABD_SYMBOL;
+      auto& orders = base == ABD_SYMBOL ? s->bids : s->asks;
+      for( auto itr = order_idx.lower_bound( price::max( base, quote ) );
+           itr != order_idx.end() && itr->sell_price.base.symbol == base && orders.size() < order_book_cache::max_depth; ++itr )
+      {
+         order_book_order o;
+         o.order_price = itr->sell_price;
+         o.real_price = real_price( itr->sell_price );
+         o.created = itr->created;
+         if( base == ABD_SYMBOL )
+         {
+            o.abd = itr->for_sale;
+            o.amalgam = ( asset( itr->for_sale, ABD_SYMBOL ) * itr->sell_price ).amount;
+         }
+         else
+         {
+            o.amalgam = itr->for_sale;
+            o.abd = ( asset( itr->for_sale, AMALGAM_SYMBOL ) * itr->sell_price ).amount;
+         }
+         orders.push_back( o );
+      }
+   }
+
+   std::atomic_store( &_snapshot, std::shared_ptr< const order_book_snapshot >( s ) );
+}
+
+} // detail
+
+order_book_cache::order_book_cache( chain::database& db ) : my( new detail::order_book_cache_impl( db ) ) {}
+
+order_book_cache::~order_book_cache()
+{
+   disconnect();
+}
+
+void order_book_cache::connect( const appbase::abstract_plugin& plugin )
+{
+   // No block may be applied between loading the book and following it
+   my->_db.with_read_lock( [&]()
+   {
+      my->load();
+
+      my->_chain_connections.push_back( my->_db.add_post_apply_operation_handler(
+         [this]( const chain::operation_notification& note ){ my->on_post_apply_operation( note ); }, plugin, 0 ) );
+      my->_chain_connections.push_back( my->_db.add_post_apply_block_handler(
+         [this]( const chain::block_notification& note ){ my->on_post_apply_block( note ); }, plugin, 0 ) );
+   });
+}
+
+void order_book_cache::disconnect()
+{
+   for( auto& c : my->_chain_connections )
+      chain::util::disconnect_signal( c );
+   my->_chain_connections.clear();
+}
+
+std::shared_ptr< const order_book_snapshot > order_book_cache::snapshot()const
+{
+   return std::atomic_load( &my->_snapshot );
+}
+
+void order_book_cache::add_update_handler( const std::function< void(const std::shared_ptr< const order_book_update >&) >& handler )
+{
+   my->_update_handlers.push_back( handler );
+}
+
+} } } // amalgam::plugins::market_history
@@ -4,18 +4,21 @@
 #include <graphene/net/node.hpp>
 #include <graphene/net/exceptions.hpp>
 
+#include <amalgam/chain/block_prevalidation.hpp>
 #include <amalgam/chain/database_exceptions.hpp>
 
 #include <fc/network/ip.hpp>
 #include <fc/network/resolve.hpp>
 #include <fc/thread/thread.hpp>
 #include <fc/io/json.hpp>
+#include <fc/metrics.hpp>
 
 #include <boost/range/algorithm/reverse.hpp>
 #include <boost/range/adaptor/reversed.hpp>
 #include <boost/algorithm/string.hpp>
 
 #include <boost/any.hpp>
+#include <boost/scope_exit.hpp>
 
 #include <atomic>
 #include <chrono>
@@ -125,6 +128,14 @@ public:
 
    fc::thread p2p_thread;
 
+   /// Blocks are pre-validated round robin on these threads; none disables pre-validation
+   std::vector< std::unique_ptr< fc::thread > > prevalidation_threads;
+   uint32_t next_prevalidation_thread = 0;
+   /// Completed once the most recently received block has been handed to the chain
+   fc::promise< void >::ptr last_block_accepted;
+
+   fc::optional< chain::block_prevalidation > prevalidate_block( const signed_block& block );
+
 private:
    class shutdown_helper final
    {
@@ -175,6 +186,21 @@ bool p2p_plugin_impl::handle_block( const graphene::net::block_message& blk_msg,
    {
       shutdown_helper helper(*this, activeHandleBlock, handleBlockFinished);
 
+      // Several blocks may be pre-validating at once, but they must reach the
+      // chain in the order the node handed them to us.
+      fc::promise< void >::ptr previous_block_accepted = last_block_accepted;
+      fc::promise< void >::ptr block_accepted( new fc::promise< void >( "p2p block accepted" ) );
+      last_block_accepted = block_accepted;
+      BOOST_SCOPE_EXIT( &block_accepted )
+      {
+         block_accepted->set_value();
+      } BOOST_SCOPE_EXIT_END
+
+      fc::optional< chain::block_prevalidation > prevalidation = prevalidate_block( blk_msg.block );
+
+      if( previous_block_accepted )
+         previous_block_accepted->wait();
+
       uint32_t head_block_num;
       chain.db().with_read_lock( [&]()
       {
@@ -198,11 +224,22 @@ bool p2p_plugin_impl::handle_block( const graphene::net::block_message& blk_msg,
          // you can help the network code out by throwing a block_older_than_undo_history exception.
          // when the net code sees that, it will stop trying to push blocks from that chain, but
          // leave that peer connected so that they can get sync blocks from us
-         bool result = chain.accept_block( blk_msg.block, sync_mode, ( block_producer | force_validate ) ? chain::database::skip_nothing : chain::database::skip_transaction_signatures );
+         bool result = chain.accept_block( blk_msg.block, sync_mode, ( block_producer | force_validate ) ? chain::database::skip_nothing : chain::database::skip_transaction_signatures,
+            prevalidation.valid() ? &(*prevalidation) : nullptr );
+
+         static fc::metrics::counter& sync_blocks = fc::metrics::registry::global().get_counter(
+            "amalgam_p2p_blocks_total", "Blocks received from peers and accepted by the chain", { { "mode", "sync" } } );
+         static fc::metrics::counter& live_blocks = fc::metrics::registry::global().get_counter(
+            "amalgam_p2p_blocks_total", "Blocks received from peers and accepted by the chain", { { "mode", "live" } } );
+         static fc::metrics::histogram& arrival_offset = fc::metrics::registry::global().get_histogram(
+            "amalgam_p2p_block_arrival_offset_seconds", "Time from the timestamp of a live block to its arrival" );
+
+         ( sync_mode ? sync_blocks : live_blocks ).add();
 
          if( !sync_mode )
          {
             fc::microseconds offset = fc::time_point::now() - blk_msg.block.timestamp;
+            arrival_offset.record( std::max< int64_t >( offset.count(), 0 ) );
             STATSD_TIMER( "p2p", "offset", "block_arrival", offset, 1.0f )
             ilog( "Got ${t} transactions on block ${b} by ${w} -- Block Time Offset: ${l} ms",
                ("t", blk_msg.block.transactions.size())
@@ -239,6 +276,41 @@ bool p2p_plugin_impl::handle_block( const graphene::net::block_message& blk_msg,
    return false;
 } FC_CAPTURE_AND_RETHROW( (blk_msg)(sync_mode) ) }
 
+fc::optional< chain::block_prevalidation > p2p_plugin_impl::prevalidate_block( const signed_block& block )
+{
+   fc::optional< chain::block_prevalidation > result;
+
+   if( prevalidation_threads.empty() )
+      return result;
+
+   fc::thread& worker = *prevalidation_threads[ next_prevalidation_thread ];
+   next_prevalidation_thread = ( next_prevalidation_thread + 1 ) % prevalidation_threads.size();
+
+   try
+   {
+      fc::time_point start = fc::time_point::now();
+      // Waiting yields this fiber, so the p2p thread keeps feeding other blocks to the pool.
+      // The task owns a copy, it may still run after a cancelled wait returned and the caller freed the block.
+      auto copy = std::make_shared< const signed_block >( block );
+      result = worker.async( [copy]() { return chain::prevalidate_block( *copy ); }, "prevalidate_block" ).wait();
+
+      static fc::metrics::histogram& prevalidation_time = fc::metrics::registry::global().get_histogram(
+         "amalgam_p2p_block_prevalidation_seconds", "Time to prevalidate a block on the prevalidation threads, including the wait for a thread" );
+      prevalidation_time.record( ( fc::time_point::now() - start ).count() );
+      STATSD_TIMER( "p2p", "prevalidation", "block", fc::time_point::now() - start, 1.0f )
+   }
+   catch( const fc::canceled_exception& )
+   {
+      throw;
+   }
+   catch( const fc::exception& e )
+   {
+      wlog( "Block pre-validation failed, block will be fully validated by the chain: ${e}", ("e", e.to_detail_string()) );
+   }
+
+   return result;
+}
+
 void p2p_plugin_impl::handle_transaction( const graphene::net::trx_message& trx_msg )
 {
    if(running.load())
@@ -247,6 +319,10 @@ void p2p_plugin_impl::handle_transaction( const graphene::net::trx_message& trx_
       {
          shutdown_helper helper(*this, activeHandleTx, handleTxFinished);
 
+         static fc::metrics::counter& transactions = fc::metrics::registry::global().get_counter(
+            "amalgam_p2p_transactions_total", "Transactions received from peers" );
+         transactions.add();
+
          chain.accept_transaction( trx_msg.trx );
 
       } FC_CAPTURE_AND_RETHROW( (trx_msg) )
@@ -479,6 +555,9 @@ void p2p_plugin_impl::sync_status( uint32_t item_type, uint32_t item_count )
 void p2p_plugin_impl::connection_count_changed( uint32_t c )
 {
    // any status reports to GUI go here
+   static fc::metrics::gauge& connections = fc::metrics::registry::global().get_gauge(
+      "amalgam_p2p_connections", "Peers connected" );
+   connections.set( c );
 }
 
 uint32_t p2p_plugin_impl::get_block_number( const graphene::net::item_hash_t& block_id )
@@ -550,6 +629,7 @@ void p2p_plugin::set_program_options( bpo::options_description& cli, bpo::option
       ("p2p-max-connections", bpo::value<uint32_t>(), "Maximum number of incoming connections on P2P endpoint.")
       ("p2p-seed-node", bpo::value<vector<string>>()->composing(), "The IP address and port of a remote peer to sync with.")
       ("p2p-parameters", bpo::value<string>(), ("P2P network parameters. (Default: " + fc::json::to_string(graphene::net::node_configuration()) + " )").c_str() )
+      ("p2p-prevalidation-threads", bpo::value<uint32_t>()->default_value(2), "Number of threads checking block merkle roots, signatures and transactions before they reach the write queue. 0 disables pre-validation.")
       ;
    cli.add_options()
       ("p2p-force-validate", bpo::bool_switch()->default_value(false), "Force validation of all transactions." )
@@ -597,6 +677,10 @@ void p2p_plugin::plugin_initialize(const boost::program_options::variables_map&
 
    my->force_validate = options.at( "p2p-force-validate" ).as< bool >();
 
+   uint32_t prevalidation_threads = options.at( "p2p-prevalidation-threads" ).as< uint32_t >();
+   for( uint32_t i = 0; i < prevalidation_threads; ++i )
+      my->prevalidation_threads.emplace_back( new fc::thread( "p2p prevalidation " + std::to_string( i ) ) );
+
    if( options.count("p2p-parameters") )
    {
       fc::variant var = fc::json::from_string( options.at("p2p-parameters").as<string>(), fc::json::strict_parser );
@@ -718,6 +802,7 @@ void p2p_plugin::plugin_shutdown() {
    ilog("Waiting for p2p_thread quit");
    quitDone->wait();
    ilog("p2p_thread quit done");
+   my->prevalidation_threads.clear();
    my->node.reset();
 }
 
@@ -1,10 +1,15 @@
 #include <amalgam/plugins/statsd/statsd_plugin.hpp>
 
+#include <fc/metrics.hpp>
 #include <fc/network/resolve.hpp>
 
 #include <boost/algorithm/string.hpp>
 
+#include <condition_variable>
+#include <limits>
+#include <mutex>
 #include <sstream>
+#include <thread>
 
 #include "StatsdClient.hpp"
 
@@ -30,6 +35,10 @@ namespace detail
          void start();
          void shutdown();
 
+         void start_metrics_export();
+         void stop_metrics_export();
+         void export_metrics();
+
          bool filter_by_namespace( const std::string& ns, const std::string& stat ) const;
 
          void increment( const std::string& ns, const std::string& stat, const std::string& key,                       const float frequency ) const noexcept;
@@ -50,6 +59,15 @@ namespace detail
          uint32_t                                           _statsd_batchsize = 1;
 
          std::unique_ptr< StatsdClient >                    _statsd;
+
+         /// seconds between exports of the metrics registry, 0 disables them
+         uint32_t                                           _metrics_interval = 0;
+         std::thread                                        _metrics_thread;
+         std::mutex                                         _metrics_mtx;
+         std::condition_variable                            _metrics_cv;
+         bool                                               _metrics_running = false;
+         /// counters are sent as the change since the previous export
+         std::map< std::string, uint64_t >                  _exported_counts;
    };
 
    void statsd_plugin_impl::start()
@@ -74,9 +92,99 @@ namespace detail
 
    void statsd_plugin_impl::shutdown()
    {
+      stop_metrics_export();
       _statsd.reset();
    }
 
+   void statsd_plugin_impl::start_metrics_export()
+   {
+      if( !_metrics_interval || _metrics_running )
+         return;
+
+      _metrics_running = true;
+      _metrics_thread = std::thread( [this]()
+      {
+         std::unique_lock< std::mutex > lock( _metrics_mtx );
+         while( !_metrics_cv.wait_for( lock, std::chrono::seconds( _metrics_interval ), [this](){ return !_metrics_running; } ) )
+         {
+            try
+            {
+               export_metrics();
+            }
+            catch( const fc::exception& e )
+            {
+               elog( "Error exporting metrics to statsd: ${e}", ("e", e.to_detail_string()) );
+            }
+         }
+      });
+   }
+
+   void statsd_plugin_impl::stop_metrics_export()
+   {
+      {
+         std::lock_guard< std::mutex > guard( _metrics_mtx );
+         _metrics_running = false;
+      }
+      _metrics_cv.notify_all();
+
+      if( _metrics_thread.joinable() )
+         _metrics_thread.join();
+   }
+
+   /**
+    * Sends the metrics registry as statsd stats named metrics.<name> followed
+    * by the label values. Histograms are sent as the count of new values and
+    * gauges of their median, 99th percentile and mean in microseconds.
+    */
+   void statsd_plugin_impl::export_metrics()
+   {
+      auto count = [this]( const std::string& key, uint64_t value )
+      {
+         auto& last = _exported_counts[ key ];
+         // Counters only grow, a smaller value means the metric was recreated
+         uint64_t delta = value >= last ? value - last : value;
+         last = value;
+         if( delta )
+            _statsd->count( key, int( std::min< uint64_t >( delta, std::numeric_limits< int >::max() ) ), 1.0f );
+      };
+      auto gauge = [this]( const std::string& key, double value )
+      {
+         _statsd->gauge( key, unsigned( std::min< double >( std::max( value, 0.0 ), std::numeric_limits< unsigned >::max() ) ), 1.0f );
+      };
+
+      fc::metrics::registry::global().visit( [&]( const fc::metrics::metric_sample& m )
+      {
+         if( !filter_by_namespace( "metrics", m.name ) )
+            return;
+
+         std::string key = "metrics." + m.name;
+         for( const auto& l : m.labels )
+         {
+            key += '.';
+            key += l.second;
+         }
+
+         switch( m.type )
+         {
+            case fc::metrics::metric_type::counter:
+               count( key, uint64_t( m.value ) );
+               break;
+            case fc::metrics::metric_type::gauge:
+               gauge( key, m.value );
+               break;
+            case fc::metrics::metric_type::histogram:
+            {
+               uint64_t n = m.hist->count();
+               count( key + ".count", n );
+               gauge( key + ".p50_us", m.hist->percentile( 0.5 ) );
+               gauge( key + ".p99_us", m.hist->percentile( 0.99 ) );
+               gauge( key + ".mean_us", n ? double( m.hist->sum() ) / n : 0 );
+               break;
+            }
+         }
+      });
+   }
+
    bool statsd_plugin_impl::filter_by_namespace( const std::string& ns, const std::string& stat ) const
    {
       if( !_filter_stats )
@@ -148,12 +256,16 @@ void statsd_plugin::set_program_options( options_description& cli, options_descr
    cfg.add_options()
       ("statsd-endpoint", bpo::value< std::string >(), "Endpoint to send statsd messages to.")
       ("statsd-batchsize", bpo::value< uint32_t >()->default_value( 1 ), "Size to batch statsd messages." )
+      ("statsd-metrics-interval", bpo::value< uint32_t >()->default_value( 0 ),
+         "Seconds between sends of the node metrics, the ones served on the webserver metrics path, as statsd stats under the metrics namespace. 0 to not send them.")
       ("statsd-whitelist", bpo::value< vector< std::string > >()->composing(), "Whitelist of statistics to capture.")
       ("statsd-blacklist", bpo::value< vector< std::string > >()->composing(), "Blacklist of statistics to capture.");
 }
 
 void statsd_plugin::plugin_initialize( const boost::program_options::variables_map& options )
 {
+   my->_metrics_interval = options.at( "statsd-metrics-interval" ).as< uint32_t >();
+
    if( options.count( "statsd-endpoint" ) )
    {
       auto statsd_endpoint = options.at( "statsd-endpoint" ).as< string >();
@@ -223,6 +335,7 @@ void statsd_plugin::plugin_initialize( const boost::program_options::variables_m
 void statsd_plugin::plugin_startup()
 {
    start_logging();
+   my->start_metrics_export();
 }
 
 void statsd_plugin::plugin_shutdown()
@@ -0,0 +1,719 @@
+#include <amalgam/plugins/webserver/http_server.hpp>
+
+#include <fc/compress/zlib.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/log/logger.hpp>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/asio.hpp>
+
+#include <deque>
+#include <map>
+#include <thread>
+#include <vector>
+
+namespace amalgam { namespace plugins { namespace webserver {
+
+namespace asio = boost::asio;
+
+using boost::asio::ip::tcp;
+using std::string;
+
+const char* const binary_content_type = "application/x-fc-raw";
+
+bool accepts_binary_response( const string& accept )
+{
+   std::vector< string > types;
+   boost::split( types, accept, boost::is_any_of( "," ) );
+   for( const auto& type : types )
+   {
+      string name = boost::algorithm::trim_copy( type.substr( 0, type.find( ';' ) ) );
+      if( boost::iequals( name, binary_content_type ) )
+         return true;
+   }
+   return false;
+}
+
+string compress_http_body( const string& accept_encoding, string& body, uint32_t threshold )
+{
+   if( !threshold || body.size() < threshold || accept_encoding.empty() )
+      return string();
+
+   bool gzip = false;
+   bool deflate = false;
+
+   std::vector< string > codings;
+   boost::split( codings, accept_encoding, boost::is_any_of( "," ) );
+   for( auto& coding : codings )
+   {
+      std::vector< string > params;
+      boost::split( params, coding, boost::is_any_of( ";" ) );
+      string name = boost::algorithm::to_lower_copy( boost::algorithm::trim_copy( params[0] ) );
+
+      bool refused = false;
+      for( size_t i = 1; i < params.size(); ++i )
+      {
+         string param = boost::algorithm::trim_copy( params[i] );
+         if( param.size() > 2 && ( param[0] == 'q' || param[0] == 'Q' ) && param[1] == '=' )
+            refused = std::strtod( param.c_str() + 2, nullptr ) <= 0;
+      }
+      if( refused )
+         continue;
+
+      if( name == "gzip" || name == "x-gzip" || name == "*" )
+         gzip = true;
+      else if( name == "deflate" )
+         deflate = true;
+   }
+
+   // The fastest level already shrinks JSON several times, higher levels cost far more time than they save on the wire
+   if( gzip )
+   {
+      body = fc::gzip_compress( body, 1 );
+      return "gzip";
+   }
+   if( deflate )
+   {
+      body = fc::zlib_compress( body, 1 );
+      return "deflate";
+   }
+   return string();
+}
+
+namespace detail {
+
+   const char* status_text( uint16_t status )
+   {
+      switch( status )
+      {
+         case 100: return "Continue";
+         case 200: return "OK";
+         case 400: return "Bad Request";
+         case 404: return "Not Found";
+         case 413: return "Payload Too Large";
+         case 431: return "Request Header Fields Too Large";
+         case 500: return "Internal Server Error";
+         case 501: return "Not Implemented";
+         default:  return "Unknown";
+      }
+   }
+
+   string format_response( uint16_t status, const string& body, const string& content_encoding, bool keep_alive, const char* content_type = "application/json" )
+   {
+      string out;
+      out.reserve( body.size() + 192 );
+      out += "HTTP/1.1 ";
+      out += std::to_string( status );
+      out += ' ';
+      out += status_text( status );
+      out += "\r\nContent-Type: ";
+      out += content_type;
+      out += "\r\nContent-Length: ";
+      out += std::to_string( body.size() );
+      if( content_encoding.size() )
+      {
+         out += "\r\nContent-Encoding: ";
+         out += content_encoding;
+      }
+      out += "\r\nVary: Accept-Encoding\r\nConnection: ";
+      out += keep_alive ? "keep-alive" : "close";
+      out += "\r\n\r\n";
+      out += body;
+      return out;
+   }
+
+   struct http_resource
+   {
+      string                  content_type;
+      http_resource_renderer  render;
+   };
+
+   typedef std::map< string, http_resource > http_resource_map;
+
+   struct http_request
+   {
+      string   method;
+      string   target;
+      bool     keep_alive = true;
+      bool     expect_continue = false;
+      size_t   content_length = 0;
+      string   accept_encoding;
+      bool     binary = false;
+   };
+
+   /**
+    * One client connection. Every member is only touched from the thread
+    * running the io_service it was accepted on, responses computed on other
+    * threads are posted there.
+    */
+   class http_connection : public std::enable_shared_from_this< http_connection >
+   {
+      public:
+         http_connection( asio::io_service& ios, const http_server_options& options, const http_request_handler& handler,
+            const std::shared_ptr< const http_resource_map >& resources )
+            : _ios( ios ), _socket( ios ), _buffer( 64 * 1024 ), _idle_timer( ios ), _options( options ), _handler( handler ), _resources( resources ) {}
+
+         tcp::socket& socket() { return _socket; }
+
+         void start() { read_request(); }
+
+      private:
+         struct pending_response
+         {
+            bool     ready = false;
+            bool     close = false;
+            string   data;
+         };
+
+         typedef std::shared_ptr< pending_response > pending_response_ptr;
+
+         void read_request();
+         void on_headers( const boost::system::error_code& ec, size_t bytes );
+         bool parse_headers( const string& text, http_request& request );
+         void read_body( const http_request& request, const std::shared_ptr< string >& body );
+         void dispatch( const http_request& request, std::shared_ptr< string > body );
+         bool serve_resource( const http_request& request, const pending_response_ptr& slot );
+         pending_response_ptr push_response();
+         void fail( uint16_t status, const string& message );
+         void write_responses();
+         void arm_idle_timer();
+         void arm_body_timer();
+         void close();
+
+         asio::io_service&                   _ios;
+         tcp::socket                         _socket;
+         asio::streambuf                     _buffer;
+         asio::deadline_timer                _idle_timer;
+         http_server_options                 _options;
+         http_request_handler                _handler;
+         std::shared_ptr< const http_resource_map > _resources;
+
+         std::deque< pending_response_ptr >  _responses;
+         string                              _write_buffer;
+         bool                                _reading = false;
+         /// the read in progress is for the body of a request
+         bool                                _reading_body = false;
+         bool                                _writing = false;
+         /// no more requests are read, the connection closes once the responses are out
+         bool                                _draining = false;
+         bool                                _closed = false;
+   };
+
+   void http_connection::read_request()
+   {
+      if( _reading || _draining || _closed || _responses.size() >= _options.max_pipelined_requests )
+         return;
+
+      _reading = true;
+      if( _responses.empty() )
+         arm_idle_timer();
+
+      auto self = shared_from_this();
+      asio::async_read_until( _socket, _buffer, "\r\n\r\n", [self]( const boost::system::error_code& ec, size_t bytes )
+      {
+         self->on_headers( ec, bytes );
+      });
+   }
+
+   void http_connection::arm_idle_timer()
+   {
+      if( !_options.keep_alive_timeout )
+         return;
+
+      std::weak_ptr< http_connection > weak = shared_from_this();
+      _idle_timer.expires_from_now( boost::posix_time::seconds( _options.keep_alive_timeout ) );
+      _idle_timer.async_wait( [weak]( const boost::system::error_code& ec )
+      {
+         auto self = weak.lock();
+         if( !ec && self && self->_reading && self->_responses.empty() )
+            self->close();
+      });
+   }
+
+   void http_connection::arm_body_timer()
+   {
+      if( !_options.body_timeout )
+         return;
+
+      std::weak_ptr< http_connection > weak = shared_from_this();
+      _idle_timer.expires_from_now( boost::posix_time::seconds( _options.body_timeout ) );
+      _idle_timer.async_wait( [weak]( const boost::system::error_code& ec )
+      {
+         auto self = weak.lock();
+         if( !ec && self && self->_reading_body )
+            self->close();
+      });
+   }
+
+   void http_connection::on_headers( const boost::system::error_code& ec, size_t bytes )
+   {
+      _reading = false;
+      boost::system::error_code ignored;
+      _idle_timer.cancel( ignored );
+
+      if( ec == asio::error::not_found )
+      {
+         fail( 431, "Request headers too large" );
+         return;
+      }
+      if( ec )
+      {
+         // The client is gone or done sending, answer what was read already
+         _draining = true;
+         if( _responses.empty() )
+            close();
+         return;
+      }
+
+      string text( asio::buffers_begin( _buffer.data() ), asio::buffers_begin( _buffer.data() ) + bytes );
+      _buffer.consume( bytes );
+
+      http_request request;
+      if( !parse_headers( text, request ) )
+         return;
+
+      if( request.expect_continue )
+      {
+         auto interim = push_response();
+         interim->data = "HTTP/1.1 100 Continue\r\n\r\n";
+         interim->ready = true;
+         write_responses();
+      }
+
+      auto body = std::make_shared< string >();
+      body->reserve( std::min< size_t >( request.content_length, _buffer.max_size() ) );
+      read_body( request, body );
+   }
+
+   /** fills request from the header block, answers and returns false when it is invalid */
+   bool http_connection::parse_headers( const string& text, http_request& request )
+   {
+      std::vector< string > lines;
+      boost::split( lines, text, boost::is_any_of( "\n" ) );
+
+      // Request line: METHOD target HTTP/1.x
+      std::vector< string > request_line;
+      string first = boost::algorithm::trim_copy( lines[0] );
+      boost::split( request_line, first, boost::is_any_of( " " ), boost::token_compress_on );
+      if( request_line.size() != 3 || !boost::algorithm::starts_with( request_line[2], "HTTP/1." ) )
+      {
+         fail( 400, "Malformed request line" );
+         return false;
+      }
+      request.method = request_line[0];
+      request.target = request_line[1];
+      request.keep_alive = request_line[2] != "HTTP/1.0";
+
+      for( size_t i = 1; i < lines.size(); ++i )
+      {
+         string line = boost::algorithm::trim_right_copy( lines[i] );
+         if( line.empty() )
+            continue;
+
+         size_t colon = line.find( ':' );
+         if( colon == string::npos )
+         {
+            fail( 400, "Malformed header" );
+            return false;
+         }
+
+         string name = boost::algorithm::trim_copy( line.substr( 0, colon ) );
+         string value = boost::algorithm::trim_copy( line.substr( colon + 1 ) );
+
+         if( boost::iequals( name, "Content-Length" ) )
+         {
+            if( value.empty() || value.find_first_not_of( "0123456789" ) != string::npos || value.size() > 12 )
+            {
+               fail( 400, "Invalid Content-Length" );
+               return false;
+            }
+            request.content_length = std::stoull( value );
+         }
+         else if( boost::iequals( name, "Transfer-Encoding" ) && !boost::iequals( value, "identity" ) )
+         {
+            fail( 501, "Transfer-Encoding is not supported, send Content-Length" );
+            return false;
+         }
+         else if( boost::iequals( name, "Connection" ) )
+         {
+            std::vector< string > tokens;
+            boost::split( tokens, value, boost::is_any_of( "," ) );
+            for( auto& token : tokens )
+            {
+               boost::algorithm::trim( token );
+               if( boost::iequals( token, "close" ) )
+                  request.keep_alive = false;
+               else if( boost::iequals( token, "keep-alive" ) )
+                  request.keep_alive = true;
+            }
+         }
+         else if( boost::iequals( name, "Accept-Encoding" ) )
+         {
+            request.accept_encoding = value;
+         }
+         else if( boost::iequals( name, "Accept" ) )
+         {
+            request.binary = accepts_binary_response( value );
+         }
+         else if( boost::iequals( name, "Expect" ) && boost::iequals( value, "100-continue" ) )
+         {
+            request.expect_continue = true;
+         }
+      }
+
+      if( request.content_length > _options.max_body_size )
+      {
+         fail( 413, "Request body too large" );
+         return false;
+      }
+
+      return true;
+   }
+
+   /**
+    * Appends the body as it arrives, so a connection only holds the bytes its
+    * client sent. The connection is closed when no data comes for
+    * body_timeout seconds.
+    */
+   void http_connection::read_body( const http_request& request, const std::shared_ptr< string >& body )
+   {
+      // Part or all of the body, and maybe the next pipelined request, was read with the headers
+      size_t buffered = std::min( _buffer.size(), request.content_length - body->size() );
+      body->append( asio::buffers_begin( _buffer.data() ), asio::buffers_begin( _buffer.data() ) + buffered );
+      _buffer.consume( buffered );
+
+      if( body->size() == request.content_length )
+      {
+         if( _reading_body )
+         {
+            _reading = false;
+            _reading_body = false;
+            boost::system::error_code ignored;
+            _idle_timer.cancel( ignored );
+         }
+         dispatch( request, body );
+         return;
+      }
+
+      _reading = true;
+      _reading_body = true;
+      arm_body_timer();
+
+      // The buffer is empty here, a chunk never exceeds its limit
+      size_t chunk = std::min( request.content_length - body->size(), _buffer.max_size() );
+      auto self = shared_from_this();
+      _socket.async_read_some( _buffer.prepare( chunk ), [self, request, body]( const boost::system::error_code& ec, size_t bytes )
+      {
+         if( ec )
+         {
+            self->_reading = false;
+            self->_reading_body = false;
+            boost::system::error_code ignored;
+            self->_idle_timer.cancel( ignored );
+
+            self->_draining = true;
+            if( self->_responses.empty() )
+               self->close();
+            return;
+         }
+
+         self->_buffer.commit( bytes );
+         self->read_body( request, body );
+      });
+   }
+
+   http_connection::pending_response_ptr http_connection::push_response()
+   {
+      _responses.push_back( std::make_shared< pending_response >() );
+      return _responses.back();
+   }
+
+   void http_connection::dispatch( const http_request& request, std::shared_ptr< string > body )
+   {
+      auto slot = push_response();
+      slot->close = !request.keep_alive;
+      if( !request.keep_alive )
+         _draining = true;
+
+      if( serve_resource( request, slot ) )
+      {
+         read_request();
+         return;
+      }
+
+      auto self = shared_from_this();
+      http_responder respond = [self, slot, request]( uint16_t status, const string& result )
+      {
+         // Compression runs on the responding thread, the io thread only writes
+         string content = result;
+         string encoding = compress_http_body( request.accept_encoding, content, self->_options.compression_threshold );
+         // Errors raised outside json_rpc are plain text whatever the client accepts
+         const char* content_type = request.binary && status == 200 ? binary_content_type : "application/json";
+         auto data = std::make_shared< string >( format_response( status, content, encoding, request.keep_alive, content_type ) );
+
+         self->_ios.post( [self, slot, data]()
+         {
+            slot->data = std::move( *data );
+            slot->ready = true;
+            self->write_responses();
+         });
+      };
+
+      try
+      {
+         _handler( *body, request.binary, respond );
+      }
+      catch( const fc::exception& e )
+      {
+         respond( 500, e.to_string() );
+      }
+      catch( const std::exception& e )
+      {
+         respond( 500, e.what() );
+      }
+
+      read_request();
+   }
+
+   /** answers a GET for an added resource right here, returns false for every other request */
+   bool http_connection::serve_resource( const http_request& request, const pending_response_ptr& slot )
+   {
+      if( request.method != "GET" )
+         return false;
+
+      auto itr = _resources->find( request.target.substr( 0, request.target.find( '?' ) ) );
+      if( itr == _resources->end() )
+         return false;
+
+      uint16_t status = 200;
+      string content;
+      try
+      {
+         content = itr->second.render();
+      }
+      catch( const fc::exception& e )
+      {
+         status = 500;
+         content = e.to_string();
+      }
+      catch( const std::exception& e )
+      {
+         status = 500;
+         content = e.what();
+      }
+
+      string encoding = compress_http_body( request.accept_encoding, content, _options.compression_threshold );
+      slot->data = format_response( status, content, encoding, request.keep_alive, itr->second.content_type.c_str() );
+      slot->ready = true;
+      write_responses();
+      return true;
+   }
+
+   /** answers with an error and closes the connection, requests queued before it are answered first */
+   void http_connection::fail( uint16_t status, const string& message )
+   {
+      _draining = true;
+      auto slot = push_response();
+      slot->data = format_response( status, message, string(), false );
+      slot->ready = true;
+      slot->close = true;
+      write_responses();
+   }
+
+   /** writes the responses that are ready, in request order */
+   void http_connection::write_responses()
+   {
+      if( _writing || _closed )
+         return;
+
+      bool close_after = false;
+      _write_buffer.clear();
+      while( !_responses.empty() && _responses.front()->ready && !close_after )
+      {
+         _write_buffer += _responses.front()->data;
+         close_after = _responses.front()->close;
+         _responses.pop_front();
+      }
+
+      if( _write_buffer.empty() )
+      {
+         if( _draining && _responses.empty() )
+            close();
+         return;
+      }
+
+      _writing = true;
+      auto self = shared_from_this();
+      asio::async_write( _socket, asio::buffer( _write_buffer ), [self, close_after]( const boost::system::error_code& ec, size_t )
+      {
+         self->_writing = false;
+         if( ec || close_after )
+         {
+            self->close();
+            return;
+         }
+
+         self->write_responses();
+         if( self->_reading )
+         {
+            // The read for the next request started while this one was answered
+            if( self->_responses.empty() && !self->_reading_body )
+               self->arm_idle_timer();
+         }
+         else
+         {
+            self->read_request();
+         }
+      });
+   }
+
+   void http_connection::close()
+   {
+      if( _closed )
+         return;
+
+      _closed = true;
+      _responses.clear();
+
+      boost::system::error_code ec;
+      _idle_timer.cancel( ec );
+      _socket.shutdown( tcp::socket::shutdown_both, ec );
+      _socket.close( ec );
+   }
+
+   struct http_listener
+   {
+      http_listener() : acceptor( ios ) {}
+
+      asio::io_service     ios;
+      tcp::acceptor        acceptor;
+      std::thread          thread;
+   };
+
+   class http_server_impl
+   {
+      public:
+         http_server_impl( const http_server_options& options, const http_request_handler& handler )
+            : _options( options ), _handler( handler ) {}
+
+         void accept( http_listener& listener );
+
+         http_server_options                             _options;
+         http_request_handler                            _handler;
+         std::shared_ptr< http_resource_map >            _resources = std::make_shared< http_resource_map >();
+         std::vector< std::unique_ptr< http_listener > > _listeners;
+         tcp::endpoint                                   _endpoint;
+   };
+
+   void http_server_impl::accept( http_listener& listener )
+   {
+      auto connection = std::make_shared< http_connection >( listener.ios, _options, _handler, _resources );
+      listener.acceptor.async_accept( connection->socket(), [this, &listener, connection]( const boost::system::error_code& ec )
+      {
+         if( !listener.acceptor.is_open() )
+            return;
+
+         if( !ec )
+         {
+            boost::system::error_code ignored;
+            connection->socket().set_option( tcp::no_delay( true ), ignored );
+            connection->start();
+         }
+         accept( listener );
+      });
+   }
+
+} // detail
+
+http_server::http_server( const http_server_options& options, const http_request_handler& handler )
+   : my( new detail::http_server_impl( options, handler ) ) {}
+
+http_server::~http_server()
+{
+   stop();
+}
+
+void http_server::add_resource( const string& path, const string& content_type, const http_resource_renderer& render )
+{
+   FC_ASSERT( my->_listeners.empty(), "Resources must be added before the http server listens" );
+   (*my->_resources)[ path ] = detail::http_resource{ content_type, render };
+}
+
+void http_server::listen( const tcp::endpoint& endpoint )
+{
+   FC_ASSERT( my->_listeners.empty(), "The http server is already listening" );
+
+   uint32_t threads = std::max< uint32_t >( my->_options.threads, 1 );
+#ifndef SO_REUSEPORT
+   if( threads > 1 )
+   {
+      wlog( "SO_REUSEPORT is not available, accepting http connections on one thread" );
+      threads = 1;
+   }
+#endif
+
+   tcp::endpoint bind_to = endpoint;
+   for( uint32_t i = 0; i < threads; ++i )
+   {
+      std::unique_ptr< detail::http_listener > listener( new detail::http_listener() );
+      listener->acceptor.open( bind_to.protocol() );
+      listener->acceptor.set_option( tcp::acceptor::reuse_address( true ) );
+#ifdef SO_REUSEPORT
+      if( threads > 1 )
+         listener->acceptor.set_option( asio::detail::socket_option::boolean< SOL_SOCKET, SO_REUSEPORT >( true ) );
+#endif
+      listener->acceptor.bind( bind_to );
+      listener->acceptor.listen();
+
+      // With port 0 the other acceptors join the port picked for the first one
+      if( i == 0 )
+         bind_to = listener->acceptor.local_endpoint();
+
+      my->accept( *listener );
+      my->_listeners.push_back( std::move( listener ) );
+   }
+   my->_endpoint = bind_to;
+
+   for( auto& listener : my->_listeners )
+   {
+      auto* l = listener.get();
+      l->thread = std::thread( [l]()
+      {
+         try
+         {
+            l->ios.run();
+         }
+         catch( const fc::exception& e )
+         {
+            elog( "error thrown from http io service: ${e}", ("e", e.to_detail_string()) );
+         }
+         catch( const std::exception& e )
+         {
+            elog( "error thrown from http io service: ${e}", ("e", e.what()) );
+         }
+      });
+   }
+}
+
+void http_server::stop()
+{
+   for( auto& listener : my->_listeners )
+      listener->ios.stop();
+
+   // The io_services are kept, so responses finishing late post into a stopped service
+   for( auto& listener : my->_listeners )
+   {
+      if( listener->thread.joinable() )
+         listener->thread.join();
+
+      boost::system::error_code ec;
+      listener->acceptor.close( ec );
+   }
+}
+
+tcp::endpoint http_server::local_endpoint()const
+{
+   return my->_endpoint;
+}
+
+} } } // amalgam::plugins::webserver
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <boost/asio/ip/tcp.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace amalgam { namespace plugins { namespace webserver {
+
+namespace detail { class http_server_impl; }
+
+/**
+ * Sends the response to one request. May be called from any thread, but
+ * only once per request.
+ */
+typedef std::function< void(uint16_t status, const std::string& body) > http_responder;
+
+/**
+ * Receives the body of one request. binary is set when the client accepts
+ * fc::raw responses, which are then sent as binary_content_type.
+ */
+typedef std::function< void(const std::string& body, bool binary, const http_responder& respond) > http_request_handler;
+
+/**
+ * Renders the body of a resource served to GET requests. Runs on the io
+ * thread of the connection, so it has to be quick.
+ */
+typedef std::function< std::string() > http_resource_renderer;
+
+/** Media type of fc::raw encoded JSON-RPC responses */
+extern const char* const binary_content_type;
+
+struct http_server_options
+{
+   /// io threads, each with its own acceptor on the port when SO_REUSEPORT is available
+   uint32_t threads = 1;
+   /// smallest response body that is compressed, 0 disables compression
+   uint32_t compression_threshold = 1024;
+   /// seconds an idle persistent connection stays open
+   uint32_t keep_alive_timeout = 60;
+   /// seconds a request body may go without data before the connection is closed, 0 waits forever
+   uint32_t body_timeout = 30;
+   /// requests read ahead of their responses on one connection
+   uint32_t max_pipelined_requests = 32;
+   uint32_t max_body_size = 32 * 1024 * 1024;
+};
+
+/**
+ * Compresses body in place with the best encoding listed in an
+ * Accept-Encoding header, gzip before deflate. Returns the value for
+ * Content-Encoding, or an empty string when the body is left as is.
+ */
+std::string compress_http_body( const std::string& accept_encoding, std::string& body, uint32_t threshold );
+
+/** Whether an Accept header lists binary_content_type */
+bool accepts_binary_response( const std::string& accept );
+
+/**
+ * HTTP/1.1 server for JSON-RPC requests.
+ *
+ * Connections are persistent unless the client asks otherwise, and
+ * pipelined requests are answered in order while they run concurrently.
+ * Every io thread accepts on its own socket bound with SO_REUSEPORT, so the
+ * kernel spreads new connections over the threads. A connection stays on
+ * the thread that accepted it.
+ *
+ * Only Content-Length framed requests are read, chunked bodies are refused.
+ */
+class http_server
+{
+   public:
+      http_server( const http_server_options& options, const http_request_handler& handler );
+      ~http_server();
+
+      /**
+       * Answers GET requests for path, ignoring any query string, with the
+       * rendered body instead of passing them to the request handler. Must
+       * be called before listen().
+       */
+      void add_resource( const std::string& path, const std::string& content_type, const http_resource_renderer& render );
+
+      void listen( const boost::asio::ip::tcp::endpoint& endpoint );
+
+      /** stops the io threads, responses still in flight are dropped */
+      void stop();
+
+      /** the endpoint bound by listen(), useful after listening on port 0 */
+      boost::asio::ip::tcp::endpoint local_endpoint()const;
+
+   private:
+      std::unique_ptr< detail::http_server_impl > my;
+};
+
+} } } // amalgam::plugins::webserver
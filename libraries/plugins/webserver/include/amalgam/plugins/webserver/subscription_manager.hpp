@@ -0,0 +1,97 @@
+#pragma once
+
+#include <amalgam/chain/database.hpp>
+
+#include <fc/reflect/reflect.hpp>
+
+#include <boost/asio/io_service.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace amalgam { namespace plugins { namespace webserver {
+
+namespace detail { class subscription_manager_impl; }
+
+/** What a connection is notified about, everything by default */
+struct subscribe_args
+{
+   bool blocks = true;
+   bool virtual_ops = true;
+   bool irreversible = true;
+   /// notices published by APIs, such as "order_book", none by default
+   std::vector< std::string > topics;
+};
+
+/** The connection of one subscriber, as seen by the manager */
+struct subscriber_channel
+{
+   /// queues a text message on the connection, may be called from any thread
+   std::function< void(const std::string&) >  send;
+   /// bytes handed to send() that are not written to the socket yet
+   std::function< size_t() >                  buffered_bytes;
+};
+
+struct subscription_options
+{
+   /// notifications held for a subscriber that does not keep up, the subscription is dropped past that
+   uint32_t max_queue = 64;
+   /// notifications wait in the queue while the connection has this many bytes unwritten
+   size_t   max_buffered_bytes = 4 * 1024 * 1024;
+};
+
+/**
+ * Pushes chain events to websocket subscribers.
+ *
+ * Notifications are JSON-RPC notifications with the method
+ * "subscription_api.notice" and one of these params:
+ *
+ *   {"type":"block","block_num":N,"block_id":"...","block":{...}}
+ *   {"type":"virtual_ops","block_num":N,"ops":[{"trx_id":...,"op":{...}},...]}
+ *   {"type":"irreversible","block_num":N}
+ *   {"type":"overflow","block_num":N}
+ *
+ * and the params rendered by the API publishing a topic, which carry the
+ * topic as their type.
+ *
+ * The chain handlers only copy what they need, the JSON is written once per
+ * event on the io_service given to the manager, in block order, and shared
+ * by every subscriber. Each subscriber has a bounded queue in front of its
+ * connection. A subscriber whose queue fills up gets an overflow notice and
+ * loses its subscription, and is expected to catch up with get_block before
+ * subscribing again.
+ */
+class subscription_manager
+{
+   public:
+      subscription_manager( boost::asio::io_service& ios, const subscription_options& options );
+      ~subscription_manager();
+
+      /** registers the chain handlers, must be called from plugin_startup */
+      void connect( chain::database& db, const appbase::abstract_plugin& plugin );
+      void disconnect();
+
+      /**
+       * Queues a notice about topic for its subscribers. Returns at once when
+       * nobody subscribed to topics, otherwise render is called on the
+       * io_service.
+       */
+      void publish( const std::string& topic, uint32_t block_num, const std::function< std::string() >& render );
+
+      /** subscribes the connection identified by key, replacing its earlier subscription */
+      void subscribe( const void* key, const subscriber_channel& channel, const subscribe_args& args );
+
+      /** returns false when the connection had no subscription */
+      bool unsubscribe( const void* key );
+
+      size_t size()const;
+
+   private:
+      std::unique_ptr< detail::subscription_manager_impl > my;
+};
+
+} } } // amalgam::plugins::webserver
+
+FC_REFLECT( amalgam::plugins::webserver::subscribe_args, (blocks)(virtual_ops)(irreversible)(topics) )
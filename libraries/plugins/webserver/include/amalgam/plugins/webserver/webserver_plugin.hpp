@@ -23,9 +23,19 @@ using namespace appbase;
   * thread.  The callback can be called from any thread and will
   * automatically propagate the call to the http thread.
   *
-  * The HTTP service will run in its own thread with its own io_service to
-  * make sure that HTTP request processing does not interfer with other
-  * plugins.
+  * The HTTP and websocket services run on their own io threads to make
+  * sure that request processing does not interfer with other plugins. A
+  * dedicated HTTP endpoint keeps connections alive and accepts pipelined
+  * requests, and large responses are compressed when the client accepts
+  * gzip or deflate.
+  *
+  * Clients sending "Accept: application/x-fc-raw", or sending requests in
+  * binary websocket frames, get results packed with fc::raw instead of
+  * JSON, see json_rpc_plugin::call().
+  *
+  * Websocket clients can call subscription_api.subscribe to be sent new
+  * blocks, virtual operations and irreversibility notices as they happen
+  * instead of polling, see subscription_manager.
   */
 class webserver_plugin : public appbase::plugin< webserver_plugin >
 {
@@ -0,0 +1,366 @@
+#include <amalgam/plugins/webserver/subscription_manager.hpp>
+
+#include <amalgam/chain/notifications.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/io/json_writer.hpp>
+#include <fc/log/logger.hpp>
+
+#include <boost/asio.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
+
+namespace amalgam { namespace plugins { namespace webserver { namespace detail {
+
+   struct block_notice
+   {
+      std::string                   type = "block";
+      uint32_t                      block_num = 0;
+      protocol::block_id_type       block_id;
+      protocol::signed_block        block;
+   };
+
+   struct virtual_op_notice
+   {
+      protocol::transaction_id_type trx_id;
+      uint32_t                      trx_in_block = 0;
+      uint32_t                      op_in_trx = 0;
+      uint32_t                      virtual_op = 0;
+      protocol::operation           op;
+   };
+
+   struct virtual_ops_notice
+   {
+      std::string                         type = "virtual_ops";
+      uint32_t                            block_num = 0;
+      std::vector< virtual_op_notice >    ops;
+   };
+
+   struct block_num_notice
+   {
+      std::string                   type;
+      uint32_t                      block_num = 0;
+   };
+
+} } } } // amalgam::plugins::webserver::detail
+
+FC_REFLECT( amalgam::plugins::webserver::detail::block_notice, (type)(block_num)(block_id)(block) )
+FC_REFLECT( amalgam::plugins::webserver::detail::virtual_op_notice, (trx_id)(trx_in_block)(op_in_trx)(virtual_op)(op) )
+FC_REFLECT( amalgam::plugins::webserver::detail::virtual_ops_notice, (type)(block_num)(ops) )
+FC_REFLECT( amalgam::plugins::webserver::detail::block_num_notice, (type)(block_num) )
+
+namespace amalgam { namespace plugins { namespace webserver {
+
+namespace detail {
+
+   namespace asio = boost::asio;
+
+   typedef std::shared_ptr< const std::string > message_ptr;
+
+   enum notice_kind { block_kind, virtual_ops_kind, irreversible_kind, topic_kind };
+
+   message_ptr wrap_notice( const std::string& params )
+   {
+      auto out = std::make_shared< std::string >( "{\"jsonrpc\":\"2.0\",\"method\":\"subscription_api.notice\",\"params\":" );
+      *out += params;
+      *out += '}';
+      return out;
+   }
+
+   template< typename T >
+   message_ptr render_notice( const T& params )
+   {
+      return wrap_notice( fc::json_writer::to_string( params ) );
+   }
+
+   struct subscriber
+   {
+      subscriber_channel               channel;
+      subscribe_args                   args;
+      std::deque< message_ptr >        queue;
+
+      bool wants( notice_kind kind, const std::string& topic )const
+      {
+         switch( kind )
+         {
+            case block_kind:        return args.blocks;
+            case virtual_ops_kind:  return args.virtual_ops;
+            case topic_kind:        return std::find( args.topics.begin(), args.topics.end(), topic ) != args.topics.end();
+            default:                return args.irreversible;
+         }
+      }
+   };
+
+   class subscription_manager_impl
+   {
+      public:
+         subscription_manager_impl( asio::io_service& ios, const subscription_options& options )
+            : _strand( ios ), _flush_timer( ios ), _options( options ) {}
+
+         void on_pre_apply_block();
+         void on_post_apply_operation( const chain::operation_notification& note );
+         void on_post_apply_block( const chain::block_notification& note );
+         void on_irreversible_block( uint32_t block_num );
+
+         void publish( notice_kind kind, uint32_t block_num, const message_ptr& message, const std::string& topic = std::string() );
+         bool flush( subscriber& s );
+         void flush_all();
+         void arm_flush_timer();
+         void update_counts();
+
+         asio::io_service::strand                  _strand;
+         asio::deadline_timer                      _flush_timer;
+         bool                                      _flush_timer_armed = false;
+         subscription_options                      _options;
+
+         mutable std::mutex                        _mtx;
+         std::map< const void*, subscriber >       _subscribers;
+
+         /// read by the chain handlers without the mutex, so they cost nothing while nobody listens
+         std::atomic< uint32_t >                   _block_subscribers{ 0 };
+         std::atomic< uint32_t >                   _virtual_op_subscribers{ 0 };
+         std::atomic< uint32_t >                   _irreversible_subscribers{ 0 };
+         std::atomic< uint32_t >                   _topic_subscribers{ 0 };
+
+         /// virtual operations of the block being applied, only touched under the write lock
+         std::vector< virtual_op_notice >          _virtual_ops;
+         uint32_t                                  _virtual_ops_block = 0;
+
+         /// highest irreversible block announced, the chain repeats the previous one with every update, only touched under the write lock
+         uint32_t                                  _last_irreversible = 0;
+
+         std::vector< boost::signals2::connection > _chain_connections;
+   };
+
+   void subscription_manager_impl::on_pre_apply_block()
+   {
+      // Also drops operations of pending transactions applied since the last block
+      _virtual_ops.clear();
+   }
+
+   void subscription_manager_impl::on_post_apply_operation( const chain::operation_notification& note )
+   {
+      if( !_virtual_op_subscribers.load( std::memory_order_relaxed ) || !protocol::is_virtual_operation( note.op ) )
+         return;
+
+      if( _virtual_ops_block != note.block )
+      {
+         _virtual_ops.clear();
+         _virtual_ops_block = note.block;
+      }
+
+      _virtual_ops.push_back( virtual_op_notice{ note.trx_id, note.trx_in_block, note.op_in_trx, note.virtual_op, note.op } );
+   }
+
+   void subscription_manager_impl::on_post_apply_block( const chain::block_notification& note )
+   {
+      if( _block_subscribers.load( std::memory_order_relaxed ) )
+      {
+         auto notice = std::make_shared< block_notice >();
+         notice->block_num = note.block_num;
+         notice->block_id = note.block_id;
+         notice->block = note.block;
+
+         // Rendering runs off the write lock, the strand keeps blocks in order
+         _strand.post( [this, notice]()
+         {
+            publish( block_kind, notice->block_num, render_notice( *notice ) );
+         });
+      }
+
+      if( _virtual_op_subscribers.load( std::memory_order_relaxed ) )
+      {
+         auto notice = std::make_shared< virtual_ops_notice >();
+         notice->block_num = note.block_num;
+         if( _virtual_ops_block == note.block_num )
+            notice->ops.swap( _virtual_ops );
+
+         _strand.post( [this, notice]()
+         {
+            publish( virtual_ops_kind, notice->block_num, render_notice( *notice ) );
+         });
+      }
+
+      _virtual_ops.clear();
+   }
+
+   void subscription_manager_impl::on_irreversible_block( uint32_t block_num )
+   {
+      if( block_num <= _last_irreversible )
+         return;
+      _last_irreversible = block_num;
+
+      if( !_irreversible_subscribers.load( std::memory_order_relaxed ) )
+         return;
+
+      _strand.post( [this, block_num]()
+      {
+         publish( irreversible_kind, block_num, render_notice( block_num_notice{ "irreversible", block_num } ) );
+      });
+   }
+
+   void subscription_manager_impl::publish( notice_kind kind, uint32_t block_num, const message_ptr& message, const std::string& topic )
+   {
+      std::lock_guard< std::mutex > guard( _mtx );
+      bool backlog = false;
+
+      for( auto itr = _subscribers.begin(); itr != _subscribers.end(); )
+      {
+         subscriber& s = itr->second;
+         if( !s.wants( kind, topic ) )
+         {
+            ++itr;
+            continue;
+         }
+
+         if( s.queue.size() >= _options.max_queue )
+         {
+            ilog( "Dropping subscriber that fell ${n} notifications behind", ("n", s.queue.size()) );
+            try
+            {
+               s.channel.send( *render_notice( block_num_notice{ "overflow", block_num } ) );
+            }
+            catch( ... ) {}
+            itr = _subscribers.erase( itr );
+            continue;
+         }
+
+         s.queue.push_back( message );
+         backlog |= !flush( s );
+         ++itr;
+      }
+
+      update_counts();
+      if( backlog )
+         arm_flush_timer();
+   }
+
+   /** hands queued messages to the connection while it has room, returns true when the queue is empty */
+   bool subscription_manager_impl::flush( subscriber& s )
+   {
+      while( s.queue.size() && s.channel.buffered_bytes() < _options.max_buffered_bytes )
+      {
+         s.channel.send( *s.queue.front() );
+         s.queue.pop_front();
+      }
+      return s.queue.empty();
+   }
+
+   void subscription_manager_impl::flush_all()
+   {
+      std::lock_guard< std::mutex > guard( _mtx );
+      _flush_timer_armed = false;
+
+      bool backlog = false;
+      for( auto& s : _subscribers )
+         backlog |= !flush( s.second );
+
+      if( backlog )
+         arm_flush_timer();
+   }
+
+   /** slow connections are retried until their queue drains, called with the mutex held */
+   void subscription_manager_impl::arm_flush_timer()
+   {
+      if( _flush_timer_armed )
+         return;
+
+      _flush_timer_armed = true;
+      _flush_timer.expires_from_now( boost::posix_time::milliseconds( 100 ) );
+      _flush_timer.async_wait( _strand.wrap( [this]( const boost::system::error_code& ec )
+      {
+         if( ec != asio::error::operation_aborted )
+            flush_all();
+      }));
+   }
+
+   void subscription_manager_impl::update_counts()
+   {
+      uint32_t blocks = 0, virtual_ops = 0, irreversible = 0, topics = 0;
+      for( const auto& s : _subscribers )
+      {
+         blocks += s.second.args.blocks;
+         virtual_ops += s.second.args.virtual_ops;
+         irreversible += s.second.args.irreversible;
+         topics += !s.second.args.topics.empty();
+      }
+      _block_subscribers = blocks;
+      _virtual_op_subscribers = virtual_ops;
+      _irreversible_subscribers = irreversible;
+      _topic_subscribers = topics;
+   }
+
+} // detail
+
+subscription_manager::subscription_manager( boost::asio::io_service& ios, const subscription_options& options )
+   : my( new detail::subscription_manager_impl( ios, options ) ) {}
+
+subscription_manager::~subscription_manager()
+{
+   disconnect();
+}
+
+void subscription_manager::connect( chain::database& db, const appbase::abstract_plugin& plugin )
+{
+   my->_chain_connections.push_back( db.add_pre_apply_block_handler(
+      [this]( const chain::block_notification& ){ my->on_pre_apply_block(); }, plugin, 0 ) );
+   my->_chain_connections.push_back( db.add_post_apply_operation_handler(
+      [this]( const chain::operation_notification& note ){ my->on_post_apply_operation( note ); }, plugin, 0 ) );
+   my->_chain_connections.push_back( db.add_post_apply_block_handler(
+      [this]( const chain::block_notification& note ){ my->on_post_apply_block( note ); }, plugin, 0 ) );
+   my->_chain_connections.push_back( db.add_irreversible_block_handler(
+      [this]( uint32_t block_num ){ my->on_irreversible_block( block_num ); }, plugin, 0 ) );
+}
+
+void subscription_manager::disconnect()
+{
+   for( auto& c : my->_chain_connections )
+      c.disconnect();
+   my->_chain_connections.clear();
+
+   std::lock_guard< std::mutex > guard( my->_mtx );
+   boost::system::error_code ec;
+   my->_flush_timer.cancel( ec );
+   my->_subscribers.clear();
+   my->update_counts();
+}
+
+void subscription_manager::publish( const std::string& topic, uint32_t block_num, const std::function< std::string() >& render )
+{
+   if( !my->_topic_subscribers.load( std::memory_order_relaxed ) )
+      return;
+
+   my->_strand.post( [this, topic, block_num, render]()
+   {
+      my->publish( detail::topic_kind, block_num, detail::wrap_notice( render() ), topic );
+   });
+}
+
+void subscription_manager::subscribe( const void* key, const subscriber_channel& channel, const subscribe_args& args )
+{
+   std::lock_guard< std::mutex > guard( my->_mtx );
+   auto& s = my->_subscribers[ key ];
+   s.channel = channel;
+   s.args = args;
+   my->update_counts();
+}
+
+bool subscription_manager::unsubscribe( const void* key )
+{
+   std::lock_guard< std::mutex > guard( my->_mtx );
+   bool removed = my->_subscribers.erase( key ) > 0;
+   my->update_counts();
+   return removed;
+}
+
+size_t subscription_manager::size()const
+{
+   std::lock_guard< std::mutex > guard( my->_mtx );
+   return my->_subscribers.size();
+}
+
+} } } // amalgam::plugins::webserver
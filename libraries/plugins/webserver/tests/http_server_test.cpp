@@ -0,0 +1,202 @@
+#define BOOST_TEST_MODULE HttpServerTest
+#include <boost/test/unit_test.hpp>
+
+#include <amalgam/plugins/webserver/http_server.hpp>
+
+#include <boost/asio.hpp>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+using namespace amalgam::plugins::webserver;
+
+namespace asio = boost::asio;
+using boost::asio::ip::tcp;
+
+namespace {
+
+/** Server answering every request with its body */
+struct echo_server
+{
+   echo_server( const http_server_options& options = http_server_options() )
+      : server( options, [this]( const std::string& body, bool, const http_responder& respond )
+        {
+           ++requests;
+           respond( 200, body );
+        })
+   {
+      server.listen( tcp::endpoint( asio::ip::address_v4::loopback(), 0 ) );
+   }
+
+   std::atomic< uint32_t > requests{ 0 };
+   http_server             server;
+};
+
+/** Blocking client connection, reads give up after a few seconds */
+struct client
+{
+   client( const tcp::endpoint& endpoint ) : socket( ios )
+   {
+      socket.connect( endpoint );
+      timeval timeout{ 5, 0 };
+      ::setsockopt( socket.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+   }
+
+   void send( const std::string& data )
+   {
+      asio::write( socket, asio::buffer( data ) );
+   }
+
+   void shutdown_send()
+   {
+      socket.shutdown( tcp::socket::shutdown_send );
+   }
+
+   /** reads until the server closes the connection */
+   std::string read_all()
+   {
+      std::string result;
+      char buf[4096];
+      boost::system::error_code ec;
+      for( ;; )
+      {
+         size_t n = socket.read_some( asio::buffer( buf ), ec );
+         if( ec )
+            break;
+         result.append( buf, n );
+      }
+      return result;
+   }
+
+   /** reads until the end of a header block */
+   std::string read_headers()
+   {
+      std::string result;
+      char c;
+      while( result.size() < 4 || result.compare( result.size() - 4, 4, "\r\n\r\n" ) )
+      {
+         boost::system::error_code ec;
+         if( socket.read_some( asio::buffer( &c, 1 ), ec ) != 1 )
+            break;
+         result += c;
+      }
+      return result;
+   }
+
+   asio::io_service  ios;
+   tcp::socket       socket;
+};
+
+std::string post( const std::string& body, const std::string& extra_headers = std::string() )
+{
+   return "POST / HTTP/1.1\r\nHost: test\r\nContent-Length: " + std::to_string( body.size() ) + "\r\n" + extra_headers + "\r\n" + body;
+}
+
+size_t count( const std::string& text, const std::string& part )
+{
+   size_t n = 0;
+   for( size_t pos = text.find( part ); pos != std::string::npos; pos = text.find( part, pos + 1 ) )
+      ++n;
+   return n;
+}
+
+} // anonymous
+
+BOOST_AUTO_TEST_SUITE(http_server_tests)
+
+BOOST_AUTO_TEST_CASE(pipelined_requests)
+{
+   echo_server s;
+   client c( s.server.local_endpoint() );
+
+   // Both requests in one write, answered in order on the same connection
+   c.send( post( "{\"first\":1}" ) + post( "{\"second\":2}", "Connection: close\r\n" ) );
+   std::string response = c.read_all();
+
+   BOOST_CHECK_EQUAL( count( response, "HTTP/1.1 200 OK" ), 2u );
+   BOOST_CHECK( response.find( "{\"first\":1}" ) < response.find( "{\"second\":2}" ) );
+   BOOST_CHECK( response.find( "{\"second\":2}" ) != std::string::npos );
+   BOOST_CHECK_EQUAL( s.requests.load(), 2u );
+}
+
+BOOST_AUTO_TEST_CASE(expect_continue)
+{
+   echo_server s;
+   client c( s.server.local_endpoint() );
+
+   std::string body = "{\"x\":1}";
+   c.send( "POST / HTTP/1.1\r\nContent-Length: " + std::to_string( body.size() ) + "\r\nExpect: 100-continue\r\nConnection: close\r\n\r\n" );
+   BOOST_CHECK_EQUAL( c.read_headers(), "HTTP/1.1 100 Continue\r\n\r\n" );
+
+   c.send( body );
+   std::string response = c.read_all();
+   BOOST_CHECK( response.find( "HTTP/1.1 200 OK" ) == 0 );
+   BOOST_CHECK( response.find( body ) != std::string::npos );
+}
+
+BOOST_AUTO_TEST_CASE(body_in_pieces)
+{
+   echo_server s;
+   client c( s.server.local_endpoint() );
+
+   c.send( "POST / HTTP/1.1\r\nContent-Length: 10\r\nConnection: close\r\n\r\n01234" );
+   std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+   c.send( "56789" );
+
+   std::string response = c.read_all();
+   BOOST_CHECK( response.find( "HTTP/1.1 200 OK" ) == 0 );
+   BOOST_CHECK( response.find( "\r\n\r\n0123456789" ) != std::string::npos );
+}
+
+BOOST_AUTO_TEST_CASE(oversized_body)
+{
+   http_server_options options;
+   options.max_body_size = 16;
+   echo_server s( options );
+   client c( s.server.local_endpoint() );
+
+   c.send( post( std::string( 17, 'x' ) ) );
+   std::string response = c.read_all();
+   BOOST_CHECK( response.find( "HTTP/1.1 413 " ) == 0 );
+   BOOST_CHECK( response.find( "Connection: close" ) != std::string::npos );
+   BOOST_CHECK_EQUAL( s.requests.load(), 0u );
+}
+
+BOOST_AUTO_TEST_CASE(truncated_body)
+{
+   echo_server s;
+   client c( s.server.local_endpoint() );
+
+   // The client stops sending before the body is complete
+   c.send( "POST / HTTP/1.1\r\nContent-Length: 10\r\n\r\n012" );
+   c.shutdown_send();
+
+   BOOST_CHECK_EQUAL( c.read_all(), "" );
+   BOOST_CHECK_EQUAL( s.requests.load(), 0u );
+}
+
+BOOST_AUTO_TEST_CASE(stalled_body)
+{
+   http_server_options options;
+   options.body_timeout = 1;
+   echo_server s( options );
+   client c( s.server.local_endpoint() );
+
+   // Headers only, the connection is closed once the body timeout passes
+   auto start = std::chrono::steady_clock::now();
+   c.send( "POST / HTTP/1.1\r\nContent-Length: 1000000\r\n\r\n" );
+   BOOST_CHECK_EQUAL( c.read_all(), "" );
+
+   auto waited = std::chrono::steady_clock::now() - start;
+   BOOST_CHECK( waited >= std::chrono::milliseconds( 900 ) );
+   BOOST_CHECK( waited < std::chrono::seconds( 4 ) );
+   BOOST_CHECK_EQUAL( s.requests.load(), 0u );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
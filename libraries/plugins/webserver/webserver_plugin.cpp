@@ -1,10 +1,13 @@
 #include <amalgam/plugins/webserver/webserver_plugin.hpp>
+#include <amalgam/plugins/webserver/http_server.hpp>
+#include <amalgam/plugins/webserver/subscription_manager.hpp>
 
 #include <amalgam/plugins/chain/chain_plugin.hpp>
 
 #include <fc/network/ip.hpp>
 #include <fc/log/logger_config.hpp>
 #include <fc/io/json.hpp>
+#include <fc/metrics.hpp>
 #include <fc/network/resolve.hpp>
 
 #include <boost/asio.hpp>
@@ -37,6 +40,9 @@ using websocketpp::connection_hdl;
 
 typedef uint32_t thread_pool_size_t;
 
+/// Prometheus text exposition format
+const char* const metrics_content_type = "text/plain; version=0.0.4";
+
 namespace detail {
 
    struct asio_with_stub_log : public websocketpp::config::asio
@@ -94,13 +100,16 @@ class webserver_plugin_impl
 
       void handle_ws_message( websocket_server_type*, connection_hdl, detail::websocket_server_type::message_ptr );
       void handle_http_message( websocket_server_type*, connection_hdl );
+      void handle_http_request( const string& body, bool binary, const http_responder& respond );
+      bool handle_subscription_call( const websocket_server_type::connection_ptr& con, const string& payload );
 
-      shared_ptr< std::thread >  http_thread;
-      asio::io_service           http_ios;
+      http_server_options        http_options;
       optional< tcp::endpoint >  http_endpoint;
-      websocket_server_type      http_server;
+      /// path of the metrics scrape endpoint, empty when it is disabled
+      string                     metrics_path;
+      std::unique_ptr< http_server > http_api_server;
 
-      shared_ptr< std::thread >  ws_thread;
+      std::vector< std::thread > ws_threads;
       asio::io_service           ws_ios;
       optional< tcp::endpoint >  ws_endpoint;
       websocket_server_type      ws_server;
@@ -109,6 +118,9 @@ class webserver_plugin_impl
       asio::io_service           thread_pool_ios;
       asio::io_service::work     thread_pool_work;
 
+      subscription_options                    subscriptions_options;
+      std::unique_ptr< subscription_manager > subscriptions;
+
       plugins::json_rpc::json_rpc_plugin* api;
       boost::signals2::connection         chain_sync_con;
 };
@@ -117,91 +129,82 @@ void webserver_plugin_impl::start_webserver()
 {
    if( ws_endpoint )
    {
-      ws_thread = std::make_shared<std::thread>( [&]()
+      ws_server.clear_access_channels( websocketpp::log::alevel::all );
+      ws_server.clear_error_channels( websocketpp::log::elevel::all );
+      ws_server.init_asio( &ws_ios );
+      ws_server.set_reuse_addr( true );
+
+      ws_server.set_message_handler( boost::bind( &webserver_plugin_impl::handle_ws_message, this, &ws_server, _1, _2 ) );
+
+      if( subscriptions )
       {
-         ilog( "start processing ws thread" );
-         try
+         ws_server.set_close_handler( [this]( connection_hdl hdl )
          {
-            ws_server.clear_access_channels( websocketpp::log::alevel::all );
-            ws_server.clear_error_channels( websocketpp::log::elevel::all );
-            ws_server.init_asio( &ws_ios );
-            ws_server.set_reuse_addr( true );
-
-            ws_server.set_message_handler( boost::bind( &webserver_plugin_impl::handle_ws_message, this, &ws_server, _1, _2 ) );
+            subscriptions->unsubscribe( ws_server.get_con_from_hdl( hdl ).get() );
+         });
+      }
 
-            if( http_endpoint && http_endpoint == ws_endpoint )
-            {
-               ws_server.set_http_handler( boost::bind( &webserver_plugin_impl::handle_http_message, this, &ws_server, _1 ) );
-               ilog( "start listening for http requests" );
-            }
+      if( http_endpoint && http_endpoint == ws_endpoint )
+      {
+         ws_server.set_http_handler( boost::bind( &webserver_plugin_impl::handle_http_message, this, &ws_server, _1 ) );
+         ilog( "start listening for http requests" );
+      }
 
-            ilog( "start listening for ws requests" );
-            ws_server.listen( *ws_endpoint );
-            ws_server.start_accept();
+      ilog( "start listening for ws requests" );
+      ws_server.listen( *ws_endpoint );
+      ws_server.start_accept();
 
-            ws_ios.run();
-            ilog( "ws io service exit" );
-         }
-         catch( ... )
+      // websocketpp serializes the handlers of each connection, so the io service can run on several threads
+      for( uint32_t i = 0; i < std::max< uint32_t >( http_options.threads, 1 ); ++i )
+      {
+         ws_threads.emplace_back( [&]()
          {
-            elog( "error thrown from http io service" );
-         }
-      });
+            ilog( "start processing ws thread" );
+            try
+            {
+               ws_ios.run();
+               ilog( "ws io service exit" );
+            }
+            catch( ... )
+            {
+               elog( "error thrown from ws io service" );
+            }
+         });
+      }
    }
 
    if( http_endpoint && ( ( ws_endpoint && ws_endpoint != http_endpoint ) || !ws_endpoint ) )
    {
-      http_thread = std::make_shared<std::thread>( [&]()
+      http_api_server.reset( new http_server( http_options, [this]( const string& body, bool binary, const http_responder& respond )
       {
-         ilog( "start processing http thread" );
-         try
-         {
-            http_server.clear_access_channels( websocketpp::log::alevel::all );
-            http_server.clear_error_channels( websocketpp::log::elevel::all );
-            http_server.init_asio( &http_ios );
-            http_server.set_reuse_addr( true );
-
-            http_server.set_http_handler( boost::bind( &webserver_plugin_impl::handle_http_message, this, &http_server, _1 ) );
-
-            ilog( "start listening for http requests" );
-            http_server.listen( *http_endpoint );
-            http_server.start_accept();
+         handle_http_request( body, binary, respond );
+      }));
+      if( metrics_path.size() )
+         http_api_server->add_resource( metrics_path, metrics_content_type, [](){ return fc::metrics::registry::global().render_prometheus(); } );
 
-            http_ios.run();
-            ilog( "http io service exit" );
-         }
-         catch( ... )
-         {
-            elog( "error thrown from http io service" );
-         }
-      });
+      ilog( "start listening for http requests on ${n} threads", ("n", http_options.threads) );
+      http_api_server->listen( *http_endpoint );
    }
 }
 
 void webserver_plugin_impl::stop_webserver()
 {
+   if( subscriptions )
+      subscriptions->disconnect();
+
    if( ws_server.is_listening() )
-   ws_server.stop_listening();
+      ws_server.stop_listening();
 
-   if( http_server.is_listening() )
-      http_server.stop_listening();
+   if( http_api_server )
+      http_api_server->stop();
 
    thread_pool_ios.stop();
    thread_pool.join_all();
 
-   if( ws_thread )
-   {
-      ws_ios.stop();
-      ws_thread->join();
-      ws_thread.reset();
-   }
-
-   if( http_thread )
-   {
-      http_ios.stop();
-      http_thread->join();
-      http_thread.reset();
-   }
+   ws_ios.stop();
+   for( auto& t : ws_threads )
+      t.join();
+   ws_threads.clear();
 }
 
 void webserver_plugin_impl::handle_ws_message( websocket_server_type* server, connection_hdl hdl, detail::websocket_server_type::message_ptr msg )
@@ -212,8 +215,14 @@ void webserver_plugin_impl::handle_ws_message( websocket_server_type* server, co
    {
       try
       {
+         // A request in a binary frame is still JSON, it asks for the fc::raw response in a binary frame
          if( msg->get_opcode() == websocketpp::frame::opcode::text )
-            con->send( api->call( msg->get_payload() ) );
+         {
+            if( !handle_subscription_call( con, msg->get_payload() ) )
+               api->call_async( msg->get_payload(), [con]( const string& response ){ con->send( response ); } );
+         }
+         else if( msg->get_opcode() == websocketpp::frame::opcode::binary )
+            api->call_async( msg->get_payload(), [con]( const string& response ){ con->send( response, websocketpp::frame::opcode::binary ); }, true );
          else
             con->send( "error: string payload expected" );
       }
@@ -242,26 +251,122 @@ void webserver_plugin_impl::handle_ws_message( websocket_server_type* server, co
    });
 }
 
+/**
+ * Answers subscription_api.subscribe and subscription_api.unsubscribe, which
+ * need the connection and so are not json_rpc methods. Returns false for any
+ * other message. Batches are left to json_rpc, which reports the method as
+ * unknown.
+ */
+bool webserver_plugin_impl::handle_subscription_call( const websocket_server_type::connection_ptr& con, const string& payload )
+{
+   if( payload.find( "subscription_api." ) == string::npos )
+      return false;
+
+   fc::variant request;
+   try
+   {
+      request = fc::json::from_string( payload );
+   }
+   catch( const fc::exception& )
+   {
+      return false;
+   }
+
+   if( !request.is_object() || !request.get_object().contains( "method" ) || !request[ "method" ].is_string() )
+      return false;
+
+   string method = request[ "method" ].as_string();
+   if( method != "subscription_api.subscribe" && method != "subscription_api.unsubscribe" )
+      return false;
+
+   fc::mutable_variant_object response;
+   response( "jsonrpc", "2.0" );
+
+   try
+   {
+      FC_ASSERT( subscriptions, "Subscriptions need the chain plugin" );
+
+      if( method == "subscription_api.subscribe" )
+      {
+         subscribe_args args;
+         if( request.get_object().contains( "params" ) )
+            fc::from_variant( request[ "params" ], args );
+
+         subscriber_channel channel;
+         channel.send = [con]( const string& message ){ con->send( message ); };
+         channel.buffered_bytes = [con](){ return con->get_buffered_amount(); };
+
+         subscriptions->subscribe( con.get(), channel, args );
+         response( "result", args );
+      }
+      else
+      {
+         response( "result", subscriptions->unsubscribe( con.get() ) );
+      }
+   }
+   catch( const fc::exception& e )
+   {
+      response( "error", fc::mutable_variant_object( "code", JSON_RPC_SERVER_ERROR )( "message", e.to_string() ) );
+   }
+
+   response( "id", request.get_object().contains( "id" ) ? request[ "id" ] : fc::variant() );
+   con->send( fc::json::to_string( response ) );
+   return true;
+}
+
 void webserver_plugin_impl::handle_http_message( websocket_server_type* server, connection_hdl hdl )
 {
    auto con = server->get_con_from_hdl( hdl );
+
+   string accept_encoding = con->get_request_header( "Accept-Encoding" );
+   uint32_t threshold = http_options.compression_threshold;
+
+   const string& resource = con->get_resource();
+   if( metrics_path.size() && con->get_request().get_method() == "GET" && resource.substr( 0, resource.find( '?' ) ) == metrics_path )
+   {
+      string content = fc::metrics::registry::global().render_prometheus();
+      string encoding = compress_http_body( accept_encoding, content, threshold );
+
+      con->set_body( content );
+      con->append_header( "Content-Type", metrics_content_type );
+      if( encoding.size() )
+         con->append_header( "Content-Encoding", encoding );
+      con->append_header( "Vary", "Accept-Encoding" );
+      con->set_status( websocketpp::http::status_code::ok );
+      return;
+   }
+
    con->defer_http_response();
+   bool binary = accepts_binary_response( con->get_request_header( "Accept" ) );
 
-   thread_pool_ios.post( [con, this]()
+   handle_http_request( con->get_request_body(), binary, [con, accept_encoding, threshold, binary]( uint16_t status, const string& body )
    {
-      auto body = con->get_request_body();
+      string content = body;
+      string encoding = compress_http_body( accept_encoding, content, threshold );
+
+      con->set_body( content );
+      con->append_header( "Content-Type", binary && status == 200 ? binary_content_type : "application/json" );
+      if( encoding.size() )
+         con->append_header( "Content-Encoding", encoding );
+      con->append_header( "Vary", "Accept-Encoding" );
+      con->set_status( websocketpp::http::status_code::value( status ) );
+      con->send_http_response();
+   });
+}
 
+void webserver_plugin_impl::handle_http_request( const string& body, bool binary, const http_responder& respond )
+{
+   thread_pool_ios.post( [body, binary, respond, this]()
+   {
       try
       {
-         con->set_body( api->call( body ) );
-         con->append_header( "Content-Type", "application/json" );
-         con->set_status( websocketpp::http::status_code::ok );
+         // Read calls may be answered later from the json_rpc read queue
+         api->call_async( body, [respond]( const string& response ){ respond( 200, response ); }, binary );
       }
       catch( fc::exception& e )
       {
          edump( (e) );
-         con->set_body( "Could not call API" );
-         con->set_status( websocketpp::http::status_code::not_found );
+         respond( 404, "Could not call API" );
       }
       catch( ... )
       {
@@ -272,19 +377,15 @@ void webserver_plugin_impl::handle_http_message( websocket_server_type* server,
             if( eptr )
                std::rethrow_exception( eptr );
 
-            con->set_body( "unknown error occurred" );
-            con->set_status( websocketpp::http::status_code::internal_server_error );
+            respond( 500, "unknown error occurred" );
          }
          catch( const std::exception& e )
          {
             std::stringstream s;
             s << "unknown exception: " << e.what();
-            con->set_body( s.str() );
-            con->set_status( websocketpp::http::status_code::internal_server_error );
+            respond( 500, s.str() );
          }
       }
-
-      con->send_http_response();
    });
 }
 
@@ -300,6 +401,18 @@ void webserver_plugin::set_program_options( options_description&, options_descri
       ("webserver-ws-endpoint", bpo::value< string >()->default_value("127.0.0.1:8090"), "Local websocket endpoint for webserver requests.")
       ("webserver-thread-pool-size", bpo::value<thread_pool_size_t>()->default_value(32),
        "Number of threads used to handle queries. Default: 32.")
+      ("webserver-io-threads", bpo::value< uint32_t >()->default_value( 2 ),
+       "Number of threads reading and writing connections. Each one accepts http connections on its own socket with SO_REUSEPORT. Default: 2.")
+      ("webserver-compression-threshold", bpo::value< uint32_t >()->default_value( 1024 ),
+       "Responses of at least this many bytes are sent gzip or deflate compressed when the client accepts it. 0 disables compression.")
+      ("webserver-keep-alive-timeout", bpo::value< uint32_t >()->default_value( 60 ),
+       "Seconds an idle persistent http connection is kept open. Default: 60.")
+      ("webserver-body-timeout", bpo::value< uint32_t >()->default_value( 30 ),
+       "Seconds an http request body may go without data before the connection is closed. 0 waits forever. Default: 30.")
+      ("webserver-subscription-queue-size", bpo::value< uint32_t >()->default_value( 64 ),
+       "Notifications queued for a websocket subscriber that can not keep up before its subscription is dropped. Default: 64.")
+      ("webserver-metrics-path", bpo::value< string >()->default_value( "" ),
+       "Path on the http endpoint answering GET requests with the node metrics in the Prometheus text format, such as /metrics. Disabled when empty. Default: empty.")
       ;
 }
 
@@ -310,6 +423,16 @@ void webserver_plugin::plugin_initialize( const variables_map& options )
    ilog("configured with ${tps} thread pool size", ("tps", thread_pool_size));
    my.reset(new detail::webserver_plugin_impl(thread_pool_size));
 
+   my->http_options.threads = options.at( "webserver-io-threads" ).as< uint32_t >();
+   FC_ASSERT( my->http_options.threads > 0, "webserver-io-threads must be greater than 0" );
+   my->http_options.compression_threshold = options.at( "webserver-compression-threshold" ).as< uint32_t >();
+   my->http_options.keep_alive_timeout = options.at( "webserver-keep-alive-timeout" ).as< uint32_t >();
+   my->http_options.body_timeout = options.at( "webserver-body-timeout" ).as< uint32_t >();
+   my->subscriptions_options.max_queue = options.at( "webserver-subscription-queue-size" ).as< uint32_t >();
+   FC_ASSERT( my->subscriptions_options.max_queue > 0, "webserver-subscription-queue-size must be greater than 0" );
+   my->metrics_path = options.at( "webserver-metrics-path" ).as< string >();
+   FC_ASSERT( my->metrics_path.empty() || my->metrics_path[0] == '/', "webserver-metrics-path must start with /" );
+
    if( options.count( "webserver-http-endpoint" ) )
    {
       auto http_endpoint = options.at( "webserver-http-endpoint" ).as< string >();
@@ -334,7 +457,28 @@ void webserver_plugin::plugin_startup()
    my->api = appbase::app().find_plugin< plugins::json_rpc::json_rpc_plugin >();
    FC_ASSERT( my->api != nullptr, "Could not find API Register Plugin" );
 
+   my->api->set_batch_executor( [this]( std::function< void() > task )
+   {
+      my->thread_pool_ios.post( task );
+   });
+
    plugins::chain::chain_plugin* chain = appbase::app().find_plugin< plugins::chain::chain_plugin >();
+   if( chain != nullptr )
+   {
+      // Notifications are rendered on the thread pool, off the write lock
+      my->subscriptions.reset( new subscription_manager( my->thread_pool_ios, my->subscriptions_options ) );
+      my->subscriptions->connect( chain->db(), *this );
+      my->api->add_notice_sink( [this]( const string& topic, uint32_t block_num, const plugins::json_rpc::api_notice_renderer& render )
+      {
+         my->subscriptions->publish( topic, block_num, render );
+      });
+
+      my->api->set_batch_read_lock( [chain]( const std::function< void() >& callback )
+      {
+         chain->db().with_read_lock( [&callback](){ callback(); } );
+      });
+   }
+
    if( chain != nullptr && chain->get_state() != appbase::abstract_plugin::started )
    {
       ilog( "Waiting for chain plugin to start" );
@@ -6,6 +6,8 @@
 
 #define AMALGAM_BLOCKCHAIN_VERSION              ( version(0, 1, 0) )
 #define AMALGAM_BLOCKCHAIN_HARDFORK_VERSION     ( hardfork_version( AMALGAM_BLOCKCHAIN_VERSION ) )
+/// Layout of the objects in the shared memory file, a file of another version must be replayed
+#define AMALGAM_SHARED_MEMORY_VERSION           2
 
 #ifdef IS_TEST_NET
 
@@ -0,0 +1,253 @@
+/**
+ *  Local load generator for the webserver plugin's http server.
+ *
+ *  Starts an http_server on a loopback port with a handler that answers
+ *  every request with a fixed JSON payload, the size of a large get_block
+ *  or list_* response, then drives it from client threads in four modes:
+ *
+ *   - close:      a new connection per request, as websocketpp serves http
+ *   - keep-alive: one persistent connection per client, one request at a time
+ *   - pipelined:  one persistent connection per client, several requests in flight
+ *   - gzip:       keep-alive with Accept-Encoding: gzip
+ *
+ *  Reports requests per second, latency percentiles and bytes on the wire.
+ */
+#include <amalgam/plugins/webserver/http_server.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/time.hpp>
+
+#include <boost/asio.hpp>
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace asio = boost::asio;
+namespace bpo = boost::program_options;
+
+using amalgam::plugins::webserver::http_server;
+using amalgam::plugins::webserver::http_server_options;
+using amalgam::plugins::webserver::http_responder;
+using boost::asio::ip::tcp;
+
+namespace {
+
+const std::string request_body = "{\"jsonrpc\":\"2.0\",\"method\":\"database_api.get_block\",\"params\":{\"block_num\":1},\"id\":1}";
+
+enum class bench_mode { close, keep_alive, pipelined, gzip };
+
+struct client_result
+{
+   std::vector< int64_t >  latencies;
+   uint64_t                bytes = 0;
+};
+
+std::string make_payload( uint32_t size )
+{
+   std::string payload = "{\"id\":1,\"jsonrpc\":\"2.0\",\"result\":{\"transactions\":[";
+   for( uint32_t i = 0; payload.size() < size; ++i )
+   {
+      if( i )
+         payload += ',';
+      payload += "{\"ref_block_num\":" + std::to_string( i % 65536 ) + ",\"operations\":[{\"type\":\"transfer_operation\",\"value\":"
+                 "{\"from\":\"bench\",\"to\":\"bench" + std::to_string( i % 16 ) + "\",\"amount\":{\"amount\":\"" + std::to_string( 1000 + i ) +
+                 "\",\"precision\":3,\"nai\":\"@@000000021\"},\"memo\":\"synthetic transfer\"}}]}";
+   }
+   payload += "]}}";
+   return payload;
+}
+
+std::string make_request( bool keep_alive, bool gzip )
+{
+   std::string request = "POST / HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Type: application/json\r\n";
+   if( gzip )
+      request += "Accept-Encoding: gzip\r\n";
+   if( !keep_alive )
+      request += "Connection: close\r\n";
+   request += "Content-Length: " + std::to_string( request_body.size() ) + "\r\n\r\n" + request_body;
+   return request;
+}
+
+/** reads one response and returns its size on the wire */
+uint64_t read_response( tcp::socket& socket, asio::streambuf& buffer )
+{
+   size_t header_size = asio::read_until( socket, buffer, "\r\n\r\n" );
+   std::string headers( asio::buffers_begin( buffer.data() ), asio::buffers_begin( buffer.data() ) + header_size );
+   buffer.consume( header_size );
+
+   FC_ASSERT( headers.compare( 0, 12, "HTTP/1.1 200" ) == 0, "Unexpected response: ${h}", ("h", headers.substr( 0, 64 )) );
+   size_t pos = headers.find( "Content-Length: " );
+   FC_ASSERT( pos != std::string::npos, "Response without Content-Length" );
+   size_t length = std::stoull( headers.substr( pos + 16 ) );
+
+   if( buffer.size() < length )
+      asio::read( socket, buffer, asio::transfer_exactly( length - buffer.size() ) );
+   buffer.consume( length );
+   return header_size + length;
+}
+
+void run_client( const tcp::endpoint& endpoint, bench_mode mode, uint32_t requests, uint32_t depth, client_result& result )
+{
+   asio::io_service ios;
+   asio::streambuf buffer;
+   result.latencies.reserve( requests );
+
+   if( mode == bench_mode::close )
+   {
+      std::string request = make_request( false, false );
+      for( uint32_t i = 0; i < requests; ++i )
+      {
+         fc::time_point start = fc::time_point::now();
+         tcp::socket socket( ios );
+         socket.connect( endpoint );
+         socket.set_option( tcp::no_delay( true ) );
+         asio::write( socket, asio::buffer( request ) );
+         result.bytes += read_response( socket, buffer );
+         result.latencies.push_back( ( fc::time_point::now() - start ).count() );
+         buffer.consume( buffer.size() );
+      }
+      return;
+   }
+
+   tcp::socket socket( ios );
+   socket.connect( endpoint );
+   socket.set_option( tcp::no_delay( true ) );
+
+   std::string request = make_request( true, mode == bench_mode::gzip );
+   uint32_t in_flight_limit = mode == bench_mode::pipelined ? std::max< uint32_t >( depth, 1 ) : 1;
+   std::deque< fc::time_point > in_flight;
+   uint32_t sent = 0;
+
+   while( result.latencies.size() < requests )
+   {
+      while( sent < requests && in_flight.size() < in_flight_limit )
+      {
+         in_flight.push_back( fc::time_point::now() );
+         asio::write( socket, asio::buffer( request ) );
+         ++sent;
+      }
+
+      result.bytes += read_response( socket, buffer );
+      result.latencies.push_back( ( fc::time_point::now() - in_flight.front() ).count() );
+      in_flight.pop_front();
+   }
+}
+
+void run_mode( const std::string& name, const tcp::endpoint& endpoint, bench_mode mode, uint32_t clients, uint32_t requests, uint32_t depth )
+{
+   std::vector< client_result > results( clients );
+   std::vector< std::thread > threads;
+
+   fc::time_point start = fc::time_point::now();
+   for( uint32_t c = 0; c < clients; ++c )
+      threads.emplace_back( [&, c]()
+      {
+         try
+         {
+            run_client( endpoint, mode, requests, depth, results[c] );
+         }
+         catch( const fc::exception& e )
+         {
+            std::cerr << e.to_detail_string() << std::endl;
+         }
+         catch( const std::exception& e )
+         {
+            std::cerr << e.what() << std::endl;
+         }
+      });
+   for( auto& t : threads )
+      t.join();
+   double seconds = double( ( fc::time_point::now() - start ).count() ) / 1000000;
+
+   std::vector< int64_t > latencies;
+   uint64_t bytes = 0;
+   for( const auto& r : results )
+   {
+      latencies.insert( latencies.end(), r.latencies.begin(), r.latencies.end() );
+      bytes += r.bytes;
+   }
+   if( latencies.empty() )
+   {
+      std::cout << name << ": no responses" << std::endl;
+      return;
+   }
+   std::sort( latencies.begin(), latencies.end() );
+   auto percentile = [&]( double p ){ return latencies[ std::min< size_t >( latencies.size() - 1, size_t( p * latencies.size() ) ) ]; };
+
+   std::cout << name << ": " << uint64_t( latencies.size() / seconds ) << " requests/s, latency p50 "
+             << percentile( 0.5 ) << " us, p99 " << percentile( 0.99 ) << " us, "
+             << bytes / latencies.size() << " bytes per response" << std::endl;
+}
+
+} // anonymous namespace
+
+int main( int argc, char** argv )
+{
+   try
+   {
+      bpo::options_description opts( "http_bench options" );
+      opts.add_options()
+         ( "help,h", "Print this help message and exit." )
+         ( "clients", bpo::value< uint32_t >()->default_value( 8 ), "Concurrent client connections." )
+         ( "requests", bpo::value< uint32_t >()->default_value( 2000 ), "Requests sent by each client in each mode." )
+         ( "response-size", bpo::value< uint32_t >()->default_value( 256 * 1024 ), "Bytes of JSON in each response." )
+         ( "pipeline-depth", bpo::value< uint32_t >()->default_value( 8 ), "Requests in flight per connection in the pipelined mode." )
+         ( "io-threads", bpo::value< uint32_t >()->default_value( 2 ), "Server io threads, each with its own SO_REUSEPORT acceptor." )
+         ( "handler-threads", bpo::value< uint32_t >()->default_value( 4 ), "Threads answering requests, like the webserver thread pool." )
+         ;
+
+      bpo::variables_map options;
+      bpo::store( bpo::parse_command_line( argc, argv, opts ), options );
+      if( options.count( "help" ) )
+      {
+         std::cout << opts << std::endl;
+         return 0;
+      }
+
+      const uint32_t clients = std::max< uint32_t >( options.at( "clients" ).as< uint32_t >(), 1 );
+      const uint32_t requests = std::max< uint32_t >( options.at( "requests" ).as< uint32_t >(), 1 );
+      const uint32_t depth = options.at( "pipeline-depth" ).as< uint32_t >();
+      const uint32_t handler_threads = std::max< uint32_t >( options.at( "handler-threads" ).as< uint32_t >(), 1 );
+      const std::string payload = make_payload( options.at( "response-size" ).as< uint32_t >() );
+
+      // Responses are produced off the io threads, as the webserver plugin does
+      asio::io_service pool_ios;
+      std::unique_ptr< asio::io_service::work > pool_work( new asio::io_service::work( pool_ios ) );
+      std::vector< std::thread > pool;
+      for( uint32_t i = 0; i < handler_threads; ++i )
+         pool.emplace_back( [&pool_ios](){ pool_ios.run(); } );
+
+      http_server_options server_options;
+      server_options.threads = options.at( "io-threads" ).as< uint32_t >();
+      http_server server( server_options, [&]( const std::string&, bool, const http_responder& respond )
+      {
+         pool_ios.post( [&payload, respond](){ respond( 200, payload ); } );
+      });
+      server.listen( tcp::endpoint( asio::ip::address_v4::loopback(), 0 ) );
+
+      std::cout << clients << " clients x " << requests << " requests, " << payload.size() << " byte responses, "
+                << server_options.threads << " io threads" << std::endl;
+
+      run_mode( "close     ", server.local_endpoint(), bench_mode::close, clients, requests, depth );
+      run_mode( "keep-alive", server.local_endpoint(), bench_mode::keep_alive, clients, requests, depth );
+      run_mode( "pipelined ", server.local_endpoint(), bench_mode::pipelined, clients, requests, depth );
+      run_mode( "gzip      ", server.local_endpoint(), bench_mode::gzip, clients, requests, depth );
+
+      server.stop();
+      pool_work.reset();
+      pool_ios.stop();
+      for( auto& t : pool )
+         t.join();
+   }
+   catch( const fc::exception& e )
+   {
+      std::cerr << e.to_detail_string() << std::endl;
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,167 @@
+/**
+ *  Compares the two ways the json_rpc plugin can render an API response:
+ *  converting the result to an fc::variant tree and printing it with
+ *  fc::json::to_string, or streaming it with fc::json_writer.  The payloads
+ *  are a get_block style signed block and a list of transactions built
+ *  from synthetic signed transfers.
+ *
+ *  Heap allocations are counted by replacing the global operator new.
+ */
+#include <amalgam/protocol/amalgam_operations.hpp>
+#include <amalgam/protocol/block.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/io/json_writer.hpp>
+#include <fc/time.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace bpo = boost::program_options;
+
+using amalgam::protocol::signed_block;
+using amalgam::protocol::signed_transaction;
+using amalgam::protocol::transfer_operation;
+
+namespace {
+
+std::atomic< uint64_t > allocation_count( 0 );
+std::atomic< uint64_t > allocation_bytes( 0 );
+
+} // anonymous namespace
+
+void* operator new( std::size_t size )
+{
+   allocation_count.fetch_add( 1, std::memory_order_relaxed );
+   allocation_bytes.fetch_add( size, std::memory_order_relaxed );
+   if( void* p = std::malloc( size ? size : 1 ) )
+      return p;
+   throw std::bad_alloc();
+}
+
+void operator delete( void* p ) noexcept
+{
+   std::free( p );
+}
+
+void operator delete( void* p, std::size_t ) noexcept
+{
+   std::free( p );
+}
+
+namespace {
+
+struct bench_result
+{
+   double   microseconds = 0;
+   double   allocations = 0;
+   double   allocated_bytes = 0;
+   size_t   output_size = 0;
+};
+
+template< typename Render >
+bench_result measure( uint32_t iterations, Render&& render )
+{
+   bench_result result;
+   uint64_t count_start = allocation_count.load();
+   uint64_t bytes_start = allocation_bytes.load();
+   fc::time_point start = fc::time_point::now();
+
+   for( uint32_t i = 0; i < iterations; ++i )
+      result.output_size = render().size();
+
+   result.microseconds = double( ( fc::time_point::now() - start ).count() ) / iterations;
+   result.allocations = double( allocation_count.load() - count_start ) / iterations;
+   result.allocated_bytes = double( allocation_bytes.load() - bytes_start ) / iterations;
+   return result;
+}
+
+void report( const std::string& name, const bench_result& r )
+{
+   std::cout << "  " << name << ": " << r.microseconds << " us, "
+             << r.allocations << " allocations (" << r.allocated_bytes << " bytes), "
+             << r.output_size << " bytes of JSON" << std::endl;
+}
+
+template< typename T >
+void compare( const std::string& name, const T& payload, uint32_t iterations )
+{
+   std::string expected = fc::json::to_string( fc::variant( payload ) );
+   FC_ASSERT( fc::json_writer::to_string( payload ) == expected, "json_writer output differs for ${n}", ("n", name) );
+
+   std::cout << name << " (" << iterations << " iterations)" << std::endl;
+   bench_result via_variant = measure( iterations, [&](){ return fc::json::to_string( fc::variant( payload ) ); } );
+   bench_result streamed = measure( iterations, [&](){ return fc::json_writer::to_string( payload ); } );
+   report( "fc::variant + json::to_string", via_variant );
+   report( "json_writer                 ", streamed );
+   std::cout << "  speedup " << via_variant.microseconds / streamed.microseconds << "x, "
+             << via_variant.allocations / std::max( streamed.allocations, 1.0 ) << "x fewer allocations" << std::endl;
+}
+
+} // anonymous namespace
+
+int main( int argc, char** argv )
+{
+   try
+   {
+      bpo::options_description opts( "json_bench options" );
+      opts.add_options()
+         ( "help,h", "Print this help message and exit." )
+         ( "transactions", bpo::value< uint32_t >()->default_value( 200 ), "Transactions in the synthetic block." )
+         ( "memo-size", bpo::value< uint32_t >()->default_value( 64 ), "Memo bytes in each synthetic transfer." )
+         ( "iterations", bpo::value< uint32_t >()->default_value( 200 ), "Renders of each payload." )
+         ;
+
+      bpo::variables_map options;
+      bpo::store( bpo::parse_command_line( argc, argv, opts ), options );
+      if( options.count( "help" ) )
+      {
+         std::cout << opts << std::endl;
+         return 0;
+      }
+
+      const uint32_t transaction_count = options.at( "transactions" ).as< uint32_t >();
+      const uint32_t memo_size = options.at( "memo-size" ).as< uint32_t >();
+      const uint32_t iterations = std::max< uint32_t >( options.at( "iterations" ).as< uint32_t >(), 1 );
+
+      fc::ecc::private_key signing_key = fc::ecc::private_key::regenerate( fc::sha256::hash( std::string( "json_bench" ) ) );
+      std::string memo( memo_size, 'm' );
+      fc::time_point_sec block_time( 1500000000 );
+
+      signed_block block;
+      for( uint32_t t = 0; t < transaction_count; ++t )
+      {
+         transfer_operation op;
+         op.from = "bench";
+         op.to = "bench" + std::to_string( t % 16 );
+         op.amount = amalgam::protocol::asset( 1 + t );
+         op.memo = memo + std::to_string( t );
+
+         signed_transaction trx;
+         trx.operations.push_back( op );
+         trx.set_expiration( block_time + fc::hours( 1 ) );
+         trx.sign( signing_key, amalgam::protocol::chain_id_type(), fc::ecc::bip_0062 );
+         block.transactions.push_back( trx );
+      }
+
+      block.timestamp = block_time;
+      block.witness = "bench";
+      block.transaction_merkle_root = block.calculate_merkle_root();
+      block.sign( signing_key );
+
+      compare( "signed block", block, iterations );
+      compare( "transaction list", block.transactions, iterations );
+   }
+   catch( const fc::exception& e )
+   {
+      std::cerr << e.to_detail_string() << std::endl;
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,528 @@
+/**
+ *  Runs a small p2p network of graphene::net::node instances on loopback,
+ *  each backed by an in-memory stub chain instead of a database.  Node 0
+ *  produces synthetic transactions and blocks; the others only relay.
+ *  The run reports propagation latency percentiles for blocks and
+ *  transactions, wire bytes per block and CPU time per node.
+ *
+ *  Node threads are timed by sampling CLOCK_THREAD_CPUTIME_ID inside each
+ *  node_delegate callback, which always runs on the node's own thread.
+ *  Any work a node does after its last callback is not counted.
+ */
+#include <graphene/net/node.hpp>
+#include <graphene/net/exceptions.hpp>
+
+#include <amalgam/protocol/amalgam_operations.hpp>
+#include <amalgam/protocol/block.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/network/ip.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/time.hpp>
+
+#include <boost/program_options.hpp>
+#include <boost/range/adaptor/reversed.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <time.h>
+
+namespace bpo = boost::program_options;
+
+using graphene::net::item_hash_t;
+using graphene::net::item_id;
+using graphene::net::message;
+using graphene::net::block_message;
+using graphene::net::trx_message;
+
+using amalgam::protocol::block_header;
+using amalgam::protocol::block_id_type;
+using amalgam::protocol::signed_block;
+using amalgam::protocol::signed_transaction;
+using amalgam::protocol::transfer_operation;
+using amalgam::protocol::chain_id_type;
+
+namespace {
+
+int64_t thread_cpu_microseconds()
+{
+   timespec ts;
+   clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts );
+   return int64_t( ts.tv_sec ) * 1000000 + ts.tv_nsec / 1000;
+}
+
+/** Collects send times from the producer and arrival times from every relay */
+class propagation_recorder
+{
+   public:
+      void item_sent( const item_hash_t& id )
+      {
+         std::lock_guard< std::mutex > lock( _mutex );
+         _sent_time[ id ] = fc::time_point::now();
+      }
+
+      void item_received( bool is_block, const item_hash_t& id )
+      {
+         fc::time_point now = fc::time_point::now();
+         std::lock_guard< std::mutex > lock( _mutex );
+         auto itr = _sent_time.find( id );
+         if( itr == _sent_time.end() )
+            return;
+         ( is_block ? _block_latencies : _transaction_latencies ).push_back( ( now - itr->second ).count() );
+      }
+
+      std::vector< int64_t > block_latencies()
+      {
+         std::lock_guard< std::mutex > lock( _mutex );
+         return _block_latencies;
+      }
+
+      std::vector< int64_t > transaction_latencies()
+      {
+         std::lock_guard< std::mutex > lock( _mutex );
+         return _transaction_latencies;
+      }
+
+   private:
+      std::mutex                             _mutex;
+      std::map< item_hash_t, fc::time_point > _sent_time;
+      std::vector< int64_t >                 _block_latencies;
+      std::vector< int64_t >                 _transaction_latencies;
+};
+
+/**
+ *  Just enough of a blockchain to keep node.cpp happy: a single linear chain
+ *  of block ids plus every block and transaction message seen.  Nothing is
+ *  validated.
+ */
+class stub_delegate : public graphene::net::node_delegate
+{
+   public:
+      stub_delegate( propagation_recorder& recorder ) : _recorder( recorder ) {}
+
+      void push_local_block( const signed_block& block )
+      {
+         std::lock_guard< std::mutex > lock( _mutex );
+         append_block( block_message( block ) );
+      }
+
+      void push_local_transaction( const message& trx_msg )
+      {
+         std::lock_guard< std::mutex > lock( _mutex );
+         _transactions.emplace( trx_msg.id(), trx_msg );
+      }
+
+      int64_t  cpu_microseconds()const { return _cpu_microseconds.load(); }
+      uint32_t connection_count()const { return _connection_count.load(); }
+
+      chain_id_type get_chain_id()const override { return chain_id_type(); }
+
+      bool has_item( const item_id& id ) override
+      {
+         sample_cpu();
+         std::lock_guard< std::mutex > lock( _mutex );
+         if( id.item_type == graphene::net::block_message_type )
+            return _blocks.find( id.item_hash ) != _blocks.end();
+         return _transactions.find( id.item_hash ) != _transactions.end();
+      }
+
+      bool handle_block( const block_message& blk_msg, bool sync_mode, std::vector< fc::uint160_t >& ) override
+      {
+         sample_cpu();
+         _recorder.item_received( true, blk_msg.block_id );
+
+         std::lock_guard< std::mutex > lock( _mutex );
+         if( _blocks.find( blk_msg.block_id ) != _blocks.end() )
+            return false;
+
+         if( blk_msg.block.block_num() > 1 && _blocks.find( blk_msg.block.previous ) == _blocks.end() )
+            FC_THROW_EXCEPTION( graphene::net::unlinkable_block_exception, "Block ${id} does not link to the stub chain", ("id", blk_msg.block_id) );
+
+         append_block( blk_msg );
+         return false;
+      }
+
+      void handle_transaction( const trx_message& trx_msg ) override
+      {
+         sample_cpu();
+         message msg( trx_msg );
+         _recorder.item_received( false, msg.id() );
+
+         std::lock_guard< std::mutex > lock( _mutex );
+         _transactions.emplace( msg.id(), msg );
+      }
+
+      void handle_message( const message& ) override
+      {
+         FC_THROW( "Invalid Message Type" );
+      }
+
+      std::vector< item_hash_t > get_block_ids( const std::vector< item_hash_t >& blockchain_synopsis,
+                                                uint32_t& remaining_item_count, uint32_t limit ) override
+      {
+         sample_cpu();
+         std::lock_guard< std::mutex > lock( _mutex );
+         std::vector< item_hash_t > result;
+         remaining_item_count = 0;
+         if( _chain.empty() )
+            return result;
+
+         uint32_t last_known_block_num = 0;
+         if( !blockchain_synopsis.empty() && !( blockchain_synopsis.size() == 1 && blockchain_synopsis[0] == block_id_type() ) )
+         {
+            bool found_a_block_in_synopsis = false;
+            for( const item_hash_t& block_id : boost::adaptors::reverse( blockchain_synopsis ) )
+            {
+               if( block_id == block_id_type() || is_on_chain( block_id ) )
+               {
+                  last_known_block_num = block_header::num_from_id( block_id );
+                  found_a_block_in_synopsis = true;
+                  break;
+               }
+            }
+
+            if( !found_a_block_in_synopsis )
+               FC_THROW_EXCEPTION( graphene::net::peer_is_on_an_unreachable_fork, "Unable to provide a list of blocks starting at any of the blocks in peer's synopsis" );
+         }
+
+         for( uint32_t num = std::max< uint32_t >( last_known_block_num, 1 ); num <= _chain.size() && result.size() < limit; ++num )
+            result.push_back( _chain[ num - 1 ] );
+
+         if( !result.empty() && block_header::num_from_id( result.back() ) < _chain.size() )
+            remaining_item_count = _chain.size() - block_header::num_from_id( result.back() );
+
+         return result;
+      }
+
+      message get_item( const item_id& id ) override
+      {
+         sample_cpu();
+         std::lock_guard< std::mutex > lock( _mutex );
+         if( id.item_type == graphene::net::block_message_type )
+         {
+            auto itr = _blocks.find( id.item_hash );
+            FC_ASSERT( itr != _blocks.end() );
+            return itr->second;
+         }
+         auto itr = _transactions.find( id.item_hash );
+         FC_ASSERT( itr != _transactions.end() );
+         return itr->second;
+      }
+
+      std::vector< item_hash_t > get_blockchain_synopsis( const item_hash_t& reference_point,
+                                                          uint32_t number_of_blocks_after_reference_point ) override
+      {
+         sample_cpu();
+         std::lock_guard< std::mutex > lock( _mutex );
+         std::vector< item_hash_t > synopsis;
+         uint32_t high_block_num = _chain.size();
+
+         if( reference_point != item_hash_t() )
+         {
+            FC_ASSERT( is_on_chain( reference_point ), "The stub chain has no forks" );
+            high_block_num = block_header::num_from_id( reference_point );
+         }
+
+         if( high_block_num == 0 )
+            return synopsis;
+
+         uint32_t low_block_num = 1;
+         uint32_t true_high_block_num = high_block_num + number_of_blocks_after_reference_point;
+         do
+         {
+            synopsis.push_back( _chain[ low_block_num - 1 ] );
+            low_block_num += ( true_high_block_num - low_block_num + 2 ) / 2;
+         }
+         while( low_block_num <= high_block_num );
+
+         return synopsis;
+      }
+
+      void sync_status( uint32_t, uint32_t ) override { sample_cpu(); }
+
+      void connection_count_changed( uint32_t c ) override
+      {
+         sample_cpu();
+         _connection_count.store( c );
+      }
+
+      uint32_t get_block_number( const item_hash_t& block_id ) override
+      {
+         return block_header::num_from_id( block_id );
+      }
+
+      fc::time_point_sec get_block_time( const item_hash_t& block_id ) override
+      {
+         std::lock_guard< std::mutex > lock( _mutex );
+         auto itr = _blocks.find( block_id );
+         if( itr == _blocks.end() )
+            return fc::time_point_sec::min();
+         return itr->second.as< block_message >().block.timestamp;
+      }
+
+      fc::time_point_sec get_blockchain_now() override { return fc::time_point::now(); }
+
+      item_hash_t get_head_block_id()const override
+      {
+         std::lock_guard< std::mutex > lock( _mutex );
+         return _chain.empty() ? item_hash_t() : _chain.back();
+      }
+
+      uint32_t estimate_last_known_fork_from_git_revision_timestamp( uint32_t )const override { return 0; }
+
+      void error_encountered( const std::string& message, const fc::oexception& error ) override
+      {
+         wlog( "${m}", ("m", message) );
+      }
+
+   private:
+      void sample_cpu() { _cpu_microseconds.store( thread_cpu_microseconds() ); }
+
+      bool is_on_chain( const item_hash_t& block_id )const
+      {
+         uint32_t num = block_header::num_from_id( block_id );
+         return num > 0 && num <= _chain.size() && _chain[ num - 1 ] == block_id;
+      }
+
+      void append_block( const block_message& blk_msg )
+      {
+         _chain.resize( blk_msg.block.block_num() - 1 );
+         _chain.push_back( blk_msg.block_id );
+         _blocks.emplace( blk_msg.block_id, message( blk_msg ) );
+      }
+
+      propagation_recorder&             _recorder;
+      mutable std::mutex                _mutex;
+      std::vector< block_id_type >      _chain;
+      std::map< item_hash_t, message >  _blocks;
+      std::map< item_hash_t, message >  _transactions;
+      std::atomic< int64_t >            _cpu_microseconds{ 0 };
+      std::atomic< uint32_t >           _connection_count{ 0 };
+};
+
+struct simulated_node
+{
+   fc::temp_directory                    data_dir;
+   std::unique_ptr< stub_delegate >      delegate;
+   std::shared_ptr< graphene::net::node > node;
+};
+
+uint64_t total_bytes_sent( const std::vector< simulated_node >& nodes )
+{
+   uint64_t total = 0;
+   for( const auto& n : nodes )
+      for( const auto& peer : n.node->get_connected_peers() )
+      {
+         auto itr = peer.info.find( "bytessent" );
+         if( itr != peer.info.end() )
+            total += itr->value().as_uint64();
+      }
+   return total;
+}
+
+void report_latencies( const char* name, std::vector< int64_t > latencies, uint64_t expected )
+{
+   std::cout << name << ": " << latencies.size() << "/" << expected << " deliveries";
+   if( !latencies.empty() )
+   {
+      std::sort( latencies.begin(), latencies.end() );
+      auto percentile = [&]( double p ) { return double( latencies[ size_t( p * ( latencies.size() - 1 ) ) ] ) / 1000.0; };
+      std::cout << std::fixed << std::setprecision( 2 )
+                << ", p50 " << percentile( 0.50 ) << " ms"
+                << ", p90 " << percentile( 0.90 ) << " ms"
+                << ", p99 " << percentile( 0.99 ) << " ms"
+                << ", max " << percentile( 1.0 ) << " ms";
+   }
+   std::cout << std::endl;
+}
+
+} // anonymous namespace
+
+int main( int argc, char** argv )
+{
+   try
+   {
+      bpo::options_description opts( "p2p_bench options" );
+      opts.add_options()
+         ( "help,h", "Print this help message and exit." )
+         ( "nodes", bpo::value< uint32_t >()->default_value( 8 ), "Number of nodes in the simulated network." )
+         ( "peers", bpo::value< uint32_t >()->default_value( 3 ), "Number of earlier nodes each node connects to on startup." )
+         ( "blocks", bpo::value< uint32_t >()->default_value( 100 ), "Number of blocks produced by node 0." )
+         ( "transactions-per-block", bpo::value< uint32_t >()->default_value( 50 ), "Transactions broadcast ahead of and included in each block." )
+         ( "memo-size", bpo::value< uint32_t >()->default_value( 64 ), "Memo bytes in each synthetic transfer." )
+         ( "block-interval-ms", bpo::value< uint32_t >()->default_value( 200 ), "Time between blocks." )
+         ( "settle-ms", bpo::value< uint32_t >()->default_value( 3000 ), "Time to wait for propagation after the last block." )
+         ( "p2p-parameters", bpo::value< std::string >(), "JSON node_configuration overrides applied to every node." )
+         ;
+
+      bpo::variables_map options;
+      bpo::store( bpo::parse_command_line( argc, argv, opts ), options );
+      if( options.count( "help" ) )
+      {
+         std::cout << opts << std::endl;
+         return 0;
+      }
+
+      const uint32_t node_count = std::max< uint32_t >( options.at( "nodes" ).as< uint32_t >(), 2 );
+      const uint32_t peer_count = options.at( "peers" ).as< uint32_t >();
+      const uint32_t block_count = options.at( "blocks" ).as< uint32_t >();
+      const uint32_t transactions_per_block = options.at( "transactions-per-block" ).as< uint32_t >();
+      const uint32_t memo_size = options.at( "memo-size" ).as< uint32_t >();
+      const fc::microseconds block_interval = fc::milliseconds( options.at( "block-interval-ms" ).as< uint32_t >() );
+      const fc::microseconds settle_time = fc::milliseconds( options.at( "settle-ms" ).as< uint32_t >() );
+
+      fc::mutable_variant_object parameters;
+      if( options.count( "p2p-parameters" ) )
+         parameters = fc::json::from_string( options.at( "p2p-parameters" ).as< std::string >(), fc::json::strict_parser ).get_object();
+      if( parameters.find( "desired_number_of_connections" ) == parameters.end() )
+         parameters.set( "desired_number_of_connections", fc::variant( peer_count ) );
+      if( parameters.find( "maximum_number_of_connections" ) == parameters.end() )
+         parameters.set( "maximum_number_of_connections", fc::variant( node_count ) );
+
+      fc::logger::get( "default" ).set_log_level( fc::log_level::warn );
+      fc::logger::get( "p2p" ).set_log_level( fc::log_level::warn );
+      fc::logger::get( "sync" ).set_log_level( fc::log_level::warn );
+
+      propagation_recorder recorder;
+      std::vector< simulated_node > nodes( node_count );
+
+      for( uint32_t i = 0; i < node_count; ++i )
+      {
+         simulated_node& n = nodes[i];
+         n.delegate.reset( new stub_delegate( recorder ) );
+         n.node = std::make_shared< graphene::net::node >( "p2p_bench" );
+         n.node->load_configuration( n.data_dir.path() );
+         n.node->set_node_delegate( n.delegate.get() );
+         n.node->listen_on_endpoint( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), 0 ), false );
+         n.node->set_advanced_node_parameters( parameters );
+         n.node->listen_to_p2p_network();
+         n.node->connect_to_p2p_network();
+         n.node->sync_from( item_id( graphene::net::block_message_type, block_id_type() ), std::vector< uint32_t >() );
+
+         for( uint32_t p = 1; p <= std::min( peer_count, i ); ++p )
+         {
+            fc::ip::endpoint ep = nodes[ i - p ].node->get_actual_listening_endpoint();
+            n.node->add_node( ep );
+            n.node->connect_to_endpoint( ep );
+         }
+      }
+
+      fc::time_point connect_deadline = fc::time_point::now() + fc::seconds( 30 );
+      while( fc::time_point::now() < connect_deadline &&
+             std::any_of( nodes.begin(), nodes.end(), []( const simulated_node& n ){ return n.delegate->connection_count() == 0; } ) )
+         fc::usleep( fc::milliseconds( 100 ) );
+      // let handshakes and address exchange finish before measuring
+      fc::usleep( fc::seconds( 1 ) );
+
+      uint32_t connections = 0;
+      for( const auto& n : nodes )
+         connections += n.node->get_connection_count();
+      std::cout << node_count << " nodes, " << connections / 2 << " connections, "
+                << block_count << " blocks of " << transactions_per_block << " transactions" << std::endl;
+
+      fc::ecc::private_key signing_key = fc::ecc::private_key::regenerate( fc::sha256::hash( std::string( "p2p_bench" ) ) );
+      std::string memo( memo_size, 'm' );
+      block_id_type head_block_id;
+      fc::time_point_sec block_time = fc::time_point::now();
+      uint64_t transaction_serial = 0;
+
+      std::vector< int64_t > cpu_start;
+      for( const auto& n : nodes )
+         cpu_start.push_back( n.delegate->cpu_microseconds() );
+      uint64_t bytes_start = total_bytes_sent( nodes );
+      std::clock_t process_cpu_start = std::clock();
+      fc::time_point load_start = fc::time_point::now();
+
+      for( uint32_t b = 0; b < block_count; ++b )
+      {
+         fc::time_point next_block_time = fc::time_point::now() + block_interval;
+
+         signed_block block;
+         for( uint32_t t = 0; t < transactions_per_block; ++t )
+         {
+            transfer_operation op;
+            op.from = "bench";
+            op.to = "bench" + std::to_string( t % 16 );
+            op.amount = amalgam::protocol::asset( 1 );
+            op.memo = memo + std::to_string( ++transaction_serial );
+
+            signed_transaction trx;
+            trx.operations.push_back( op );
+            trx.set_reference_block( head_block_id );
+            trx.set_expiration( block_time + fc::hours( 1 ) );
+
+            message msg( ( trx_message( trx ) ) );
+            nodes[0].delegate->push_local_transaction( msg );
+            recorder.item_sent( msg.id() );
+            nodes[0].node->broadcast( msg );
+            block.transactions.push_back( trx );
+         }
+
+         block_time += 3;
+         block.previous = head_block_id;
+         block.timestamp = block_time;
+         block.witness = "bench";
+         block.transaction_merkle_root = block.calculate_merkle_root();
+         block.sign( signing_key );
+         head_block_id = block.id();
+
+         nodes[0].delegate->push_local_block( block );
+         recorder.item_sent( head_block_id );
+         nodes[0].node->broadcast( block_message( block ) );
+
+         fc::usleep( std::max( next_block_time - fc::time_point::now(), fc::microseconds( 0 ) ) );
+      }
+
+      fc::time_point load_end = fc::time_point::now();
+      fc::usleep( settle_time );
+
+      double process_cpu_seconds = double( std::clock() - process_cpu_start ) / CLOCKS_PER_SEC;
+      uint64_t bytes_sent = total_bytes_sent( nodes ) - bytes_start;
+
+      report_latencies( "block propagation", recorder.block_latencies(), uint64_t( block_count ) * ( node_count - 1 ) );
+      report_latencies( "transaction propagation", recorder.transaction_latencies(),
+                        uint64_t( block_count ) * transactions_per_block * ( node_count - 1 ) );
+
+      std::cout << "bytes sent: " << bytes_sent << " total, "
+                << ( block_count ? bytes_sent / block_count : 0 ) << " per block, "
+                << ( block_count ? bytes_sent / block_count / node_count : 0 ) << " per block per node" << std::endl;
+
+      int64_t max_node_cpu = 0;
+      int64_t total_node_cpu = 0;
+      for( uint32_t i = 0; i < node_count; ++i )
+      {
+         int64_t node_cpu = nodes[i].delegate->cpu_microseconds() - cpu_start[i];
+         max_node_cpu = std::max( max_node_cpu, node_cpu );
+         total_node_cpu += node_cpu;
+      }
+      double load_seconds = double( ( load_end - load_start ).count() ) / 1000000.0;
+      std::cout << std::fixed << std::setprecision( 3 )
+                << "node thread cpu: " << double( total_node_cpu ) / node_count / 1000000.0 << "s mean, "
+                << double( max_node_cpu ) / 1000000.0 << "s max (node 0: "
+                << double( nodes[0].delegate->cpu_microseconds() - cpu_start[0] ) / 1000000.0 << "s)" << std::endl
+                << "process cpu: " << process_cpu_seconds << "s over " << load_seconds << "s of load, "
+                << process_cpu_seconds / node_count << "s per node" << std::endl;
+
+      for( auto& n : nodes )
+         n.node->close();
+      for( auto& n : nodes )
+         n.node.reset();
+   }
+   catch( const fc::exception& e )
+   {
+      std::cerr << e.to_detail_string() << std::endl;
+      return 1;
+   }
+   return 0;
+}